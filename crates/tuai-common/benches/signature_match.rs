@@ -0,0 +1,170 @@
+//! Agent signature matching: combined index against the per-signature loop
+//!
+//! Matches 10k synthetic processes, one in fifty an agent, as on a busy
+//! developer machine. The loop baseline is what `match_process` used to
+//! do: lowercase every field for every signature and try each regex in
+//! turn. The index is run with and without the match cache; the synthetic
+//! processes repeat, as real ones do, so the cached run is mostly hits.
+//! Allocations per process are printed before the timings.
+//!
+//! ```sh
+//! cargo bench -p tuai-common --bench signature_match
+//! ```
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+use regex::Regex;
+use tuai_common::{default_signatures, AgentSignature, ProcessInfo, SignatureMatcher};
+
+const PROCESSES: usize = 10_000;
+
+/// Every AGENT_EVERY-th process is an agent
+const AGENT_EVERY: usize = 50;
+
+struct CountingAlloc;
+
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+fn build_processes() -> Vec<ProcessInfo> {
+    let ordinary = [
+        ("bash", "/bin/bash --login", "/usr/bin/bash"),
+        ("rustc", "rustc --crate-name tuai --edition=2021 src/lib.rs", "/usr/bin/rustc"),
+        ("node", "node /usr/lib/node_modules/npm/bin/npm-cli.js install", "/usr/bin/node"),
+        ("python3", "python3 -m pytest tests/ -x", "/usr/bin/python3.12"),
+        ("kworker/3:1", "", ""),
+        ("systemd-journal", "/usr/lib/systemd/systemd-journald", "/usr/lib/systemd/systemd-journald"),
+        ("postgres", "postgres: checkpointer", "/usr/lib/postgresql/16/bin/postgres"),
+    ];
+    let agents = [
+        ("claude", "claude --resume", "/home/dev/.local/bin/claude"),
+        ("node", "node /usr/lib/node_modules/@anthropic-ai/claude-code/cli.js", "/usr/bin/node"),
+        ("python3", "python3 -m aider --model sonnet", "/usr/bin/python3.12"),
+        ("ollama", "ollama serve", "/usr/local/bin/ollama"),
+    ];
+
+    (0..PROCESSES)
+        .map(|i| {
+            let (name, cmdline, exe) = if i % AGENT_EVERY == 0 {
+                agents[i / AGENT_EVERY % agents.len()]
+            } else {
+                ordinary[i % ordinary.len()]
+            };
+            let mut process = ProcessInfo::new(i as u32 + 1, name.to_string());
+            process.cmdline = (!cmdline.is_empty()).then(|| cmdline.to_string());
+            process.exe_path = (!exe.is_empty()).then(|| exe.to_string());
+            process
+        })
+        .collect()
+}
+
+/// A signature as the old matcher held it
+struct LoopSignature {
+    name: String,
+    process_names: Vec<String>,
+    command_regexes: Vec<Regex>,
+    exe_regexes: Vec<Regex>,
+}
+
+impl LoopSignature {
+    fn new(sig: &AgentSignature) -> Self {
+        let compile = |patterns: &[tuai_common::CommandPattern]| {
+            patterns.iter().map(|p| Regex::new(&p.regex).unwrap()).collect()
+        };
+        Self {
+            name: sig.name.clone(),
+            process_names: sig.detection.process_names.clone(),
+            command_regexes: compile(&sig.detection.command_patterns),
+            exe_regexes: compile(&sig.detection.exe_patterns),
+        }
+    }
+
+    fn matches(&self, process: &ProcessInfo) -> bool {
+        let name_lower = process.name.to_lowercase();
+        if self.process_names.iter().any(|name| {
+            let target = name.to_lowercase();
+            name_lower == target || name_lower.starts_with(&target) || target.starts_with(&name_lower)
+        }) {
+            return true;
+        }
+        if let Some(ref cmdline) = process.cmdline {
+            let cmdline_lower = cmdline.to_lowercase();
+            if self.command_regexes.iter().any(|re| re.is_match(&cmdline_lower)) {
+                return true;
+            }
+        }
+        if let Some(ref exe_path) = process.exe_path {
+            let exe_lower = exe_path.to_lowercase();
+            if self.exe_regexes.iter().any(|re| re.is_match(&exe_lower)) {
+                return true;
+            }
+        }
+        false
+    }
+}
+
+fn match_loop<'a>(signatures: &'a [LoopSignature], processes: &[ProcessInfo]) -> Vec<Option<&'a str>> {
+    processes
+        .iter()
+        .map(|p| signatures.iter().find(|s| s.matches(p)).map(|s| s.name.as_str()))
+        .collect()
+}
+
+fn match_index<'a>(matcher: &'a SignatureMatcher, processes: &[ProcessInfo]) -> Vec<Option<&'a str>> {
+    processes.iter().map(|p| matcher.match_process(p)).collect()
+}
+
+fn allocations_per_process(run: impl Fn() -> usize) -> f64 {
+    let before = ALLOCATIONS.load(Ordering::Relaxed);
+    let matched = run();
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed) - before;
+    assert_eq!(matched, PROCESSES / AGENT_EVERY);
+    allocations as f64 / PROCESSES as f64
+}
+
+fn signature_match(c: &mut Criterion) {
+    let processes = build_processes();
+    let signatures: Vec<LoopSignature> = default_signatures().iter().map(LoopSignature::new).collect();
+    let mut uncached = SignatureMatcher::with_cache_capacity(0);
+    uncached.load(default_signatures()).unwrap();
+    let mut cached = SignatureMatcher::new();
+    cached.load(default_signatures()).unwrap();
+
+    let count = |matches: Vec<Option<&str>>| matches.iter().filter(|m| m.is_some()).count();
+    println!(
+        "allocations per process: loop {:.2}, index {:.2}, cached index {:.2}",
+        allocations_per_process(|| count(match_loop(&signatures, &processes))),
+        allocations_per_process(|| count(match_index(&uncached, &processes))),
+        allocations_per_process(|| count(match_index(&cached, &processes))),
+    );
+
+    let mut group = c.benchmark_group("signature_match");
+    group.throughput(Throughput::Elements(PROCESSES as u64));
+    group.bench_function("loop", |b| b.iter(|| match_loop(&signatures, &processes)));
+    group.bench_function("index", |b| b.iter(|| match_index(&uncached, &processes)));
+    group.bench_function("cached_index", |b| b.iter(|| match_index(&cached, &processes)));
+    group.finish();
+}
+
+criterion_group!(benches, signature_match);
+criterion_main!(benches);
@@ -4,6 +4,8 @@ use chrono::{DateTime, Utc};
 use serde::{Deserialize, Serialize};
 use uuid::Uuid;
 
+use crate::signatures::MatchConfidence;
+
 /// Unique identifier for tracked processes
 pub type ProcessId = Uuid;
 
@@ -36,6 +38,9 @@ pub struct ProcessInfo {
     pub exe_path: Option<String>,
     /// Detected agent type (e.g., "claude_code", "cursor")
     pub agent_type: Option<String>,
+    /// How much evidence backs the agent type
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub agent_confidence: Option<MatchConfidence>,
     /// Process start time
     pub start_time: DateTime<Utc>,
     /// Process end time (if exited)
@@ -57,6 +62,7 @@ impl ProcessInfo {
             cmdline: None,
             exe_path: None,
             agent_type: None,
+            agent_confidence: None,
             start_time: Utc::now(),
             end_time: None,
             user: None,
@@ -74,7 +80,7 @@ pub struct ProcessEvent {
 }
 
 /// Network protocol type
-#[derive(Debug, Clone, Serialize, Deserialize, PartialEq, Eq)]
+#[derive(Debug, Clone, Serialize, Deserialize, PartialEq, Eq, Hash)]
 #[serde(rename_all = "lowercase")]
 pub enum Protocol {
     Tcp,
@@ -95,6 +101,17 @@ pub enum ConnectionState {
     Unknown,
 }
 
+/// Kernel TCP counters of an established flow (from tcp_info)
+#[derive(Debug, Clone, Copy, Default, Serialize, Deserialize, PartialEq, Eq)]
+pub struct TcpStats {
+    /// Smoothed round trip time in microseconds
+    pub rtt_us: u32,
+    /// Bytes sent and acknowledged by the peer
+    pub bytes_acked: u64,
+    /// Bytes received
+    pub bytes_received: u64,
+}
+
 /// Network connection information
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct ConnectionInfo {
@@ -116,6 +133,9 @@ pub struct ConnectionInfo {
     pub remote_port: Option<u16>,
     /// Connection state
     pub state: ConnectionState,
+    /// Kernel TCP counters, when the backend provides them
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub stats: Option<TcpStats>,
     /// Event timestamp
     pub timestamp: DateTime<Utc>,
 }
@@ -133,11 +153,47 @@ impl ConnectionInfo {
             remote_addr: None,
             remote_port: None,
             state: ConnectionState::Connecting,
+            stats: None,
             timestamp: Utc::now(),
         }
     }
 }
 
+/// Connection lifecycle event type
+#[derive(Debug, Clone, Copy, Serialize, Deserialize, PartialEq, Eq)]
+#[serde(rename_all = "snake_case")]
+pub enum ConnectionEventType {
+    /// First seen
+    Opened,
+    /// State differs from the previous sample
+    StateChanged,
+    /// No longer present
+    Closed,
+}
+
+/// A change to a live connection
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct ConnectionEvent {
+    pub event_type: ConnectionEventType,
+    /// The connection, under the id it was first reported with
+    pub connection: ConnectionInfo,
+    /// State before the change (StateChanged and Closed)
+    pub previous_state: Option<ConnectionState>,
+    /// Milliseconds since the connection was opened (StateChanged and Closed)
+    pub duration_ms: Option<u64>,
+    pub timestamp: DateTime<Utc>,
+}
+
+/// A connection of an agent to an endpoint its signature does not expect
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct EndpointViolation {
+    /// Signature the agent was matched with
+    pub agent_type: String,
+    /// The opened connection
+    pub connection: ConnectionInfo,
+    pub timestamp: DateTime<Utc>,
+}
+
 /// File operation type
 #[derive(Debug, Clone, Serialize, Deserialize, PartialEq, Eq)]
 #[serde(rename_all = "lowercase")]
@@ -150,6 +206,18 @@ pub enum FileOperation {
     Create,
 }
 
+/// Identity of a file independent of the path used to reach it
+///
+/// Hard links, symlinks, bind mounts and relative paths to the same file
+/// all share one device and inode number.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Serialize, Deserialize)]
+pub struct FileId {
+    /// Device as reported by stat (`st_dev`)
+    pub dev: u64,
+    /// Inode number on that device
+    pub ino: u64,
+}
+
 /// File operation event
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct FileOpInfo {
@@ -165,6 +233,9 @@ pub struct FileOpInfo {
     pub path: String,
     /// New path (for rename operations)
     pub new_path: Option<String>,
+    /// Device and inode of the file, when the monitor could tell
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub file_id: Option<FileId>,
     /// Event timestamp
     pub timestamp: DateTime<Utc>,
 }
@@ -179,6 +250,7 @@ impl FileOpInfo {
             operation,
             path,
             new_path: None,
+            file_id: None,
             timestamp: Utc::now(),
         }
     }
@@ -189,6 +261,8 @@ impl FileOpInfo {
 #[serde(tag = "type", rename_all = "snake_case")]
 pub enum TelemetryEvent {
     Process(ProcessEvent),
-    Connection(ConnectionInfo),
+    Connection(ConnectionEvent),
     FileOp(FileOpInfo),
+    /// Alert: an agent connected outside its expected endpoints
+    EndpointViolation(EndpointViolation),
 }
@@ -2,8 +2,22 @@
 //!
 //! This module provides the signature format for detecting AI coding agents
 //! and a matching engine to identify processes.
+//!
+//! The matcher compiles all signatures together: process names into one
+//! case-insensitive byte trie, and command and exe patterns into one
+//! case-insensitive `RegexSet` each. A process is checked in a single pass
+//! over each field, whatever the number of signatures.
+//!
+//! Results, including misses, are cached by process identity (name, exe
+//! and command line) in a bounded LRU cache, since most new processes are
+//! the same few binaries run again.
+
+use std::collections::hash_map::DefaultHasher;
+use std::collections::HashMap;
+use std::hash::{Hash, Hasher};
+use std::sync::Mutex;
 
-use regex::Regex;
+use regex::{Regex, RegexBuilder, RegexSet, RegexSetBuilder};
 use serde::{Deserialize, Serialize};
 use thiserror::Error;
 
@@ -105,7 +119,7 @@ pub struct AgentSignature {
     pub network_endpoints: NetworkEndpoints,
 }
 
-/// Compiled signature for efficient matching
+/// Compiled signature for matching one signature on its own
 pub struct CompiledSignature {
     pub signature: AgentSignature,
     command_regexes: Vec<Regex>,
@@ -115,19 +129,14 @@ pub struct CompiledSignature {
 impl CompiledSignature {
     /// Compile a signature for matching
     pub fn new(signature: AgentSignature) -> Result<Self, SignatureError> {
-        let command_regexes = signature
-            .detection
-            .command_patterns
-            .iter()
-            .map(|p| Regex::new(&p.regex))
-            .collect::<Result<Vec<_>, _>>()?;
-
-        let exe_regexes = signature
-            .detection
-            .exe_patterns
-            .iter()
-            .map(|p| Regex::new(&p.regex))
-            .collect::<Result<Vec<_>, _>>()?;
+        let compile = |patterns: &[CommandPattern]| {
+            patterns
+                .iter()
+                .map(|p| RegexBuilder::new(&p.regex).case_insensitive(true).build())
+                .collect::<Result<Vec<_>, _>>()
+        };
+        let command_regexes = compile(&signature.detection.command_patterns)?;
+        let exe_regexes = compile(&signature.detection.exe_patterns)?;
 
         Ok(Self {
             signature,
@@ -157,16 +166,14 @@ impl CompiledSignature {
 
         // Check command line patterns (case-insensitive)
         if let Some(ref cmdline) = process.cmdline {
-            let cmdline_lower = cmdline.to_lowercase();
-            if self.command_regexes.iter().any(|re| re.is_match(&cmdline_lower)) {
+            if self.command_regexes.iter().any(|re| re.is_match(cmdline)) {
                 return true;
             }
         }
 
         // Check executable path patterns (case-insensitive)
         if let Some(ref exe_path) = process.exe_path {
-            let exe_lower = exe_path.to_lowercase();
-            if self.exe_regexes.iter().any(|re| re.is_match(&exe_lower)) {
+            if self.exe_regexes.iter().any(|re| re.is_match(exe_path)) {
                 return true;
             }
         }
@@ -175,31 +182,382 @@ impl CompiledSignature {
     }
 }
 
+/// Process names of all signatures in one trie of lowercased bytes
+///
+/// A name matches a signature name when either is a prefix of the other
+/// (Linux truncates process names to 15 bytes).
+#[derive(Debug)]
+struct NameTrie {
+    nodes: Vec<NameNode>,
+}
+
+#[derive(Debug)]
+struct NameNode {
+    /// (byte, node index), sorted by byte
+    children: Vec<(u8, usize)>,
+    /// First signature with a name ending here
+    terminal: Option<usize>,
+    /// First signature with a name ending here or below
+    subtree: usize,
+}
+
+impl NameNode {
+    fn new() -> Self {
+        Self {
+            children: Vec::new(),
+            terminal: None,
+            subtree: usize::MAX,
+        }
+    }
+}
+
+impl NameTrie {
+    fn new() -> Self {
+        Self {
+            nodes: vec![NameNode::new()],
+        }
+    }
+
+    fn insert(&mut self, name: &str, signature: usize) {
+        let mut node = 0;
+        self.nodes[0].subtree = self.nodes[0].subtree.min(signature);
+        for byte in name.to_lowercase().bytes() {
+            node = match self.nodes[node].children.binary_search_by_key(&byte, |(b, _)| *b) {
+                Ok(i) => self.nodes[node].children[i].1,
+                Err(i) => {
+                    let child = self.nodes.len();
+                    self.nodes.push(NameNode::new());
+                    self.nodes[node].children.insert(i, (byte, child));
+                    child
+                }
+            };
+            self.nodes[node].subtree = self.nodes[node].subtree.min(signature);
+        }
+        let terminal = &mut self.nodes[node].terminal;
+        *terminal = Some(terminal.map_or(signature, |t| t.min(signature)));
+    }
+
+    /// First signature whose name is a prefix of `name` or has it as prefix
+    fn first_match(&self, name: &str) -> Option<usize> {
+        let mut node = 0;
+        let mut best = self.nodes[0].terminal.unwrap_or(usize::MAX);
+        let mut utf8 = [0u8; 4];
+        for c in name.chars() {
+            for lower in c.to_lowercase() {
+                for &byte in lower.encode_utf8(&mut utf8).as_bytes() {
+                    let children = &self.nodes[node].children;
+                    match children.binary_search_by_key(&byte, |(b, _)| *b) {
+                        Ok(i) => node = children[i].1,
+                        // Only names that are a prefix of this one can match
+                        Err(_) => return (best != usize::MAX).then_some(best),
+                    }
+                    if let Some(terminal) = self.nodes[node].terminal {
+                        best = best.min(terminal);
+                    }
+                }
+            }
+        }
+        // All of `name` consumed: every name below starts with it
+        best = best.min(self.nodes[node].subtree);
+        (best != usize::MAX).then_some(best)
+    }
+}
+
+/// Patterns of every signature for one field, in one `RegexSet`
+#[derive(Debug)]
+struct PatternIndex {
+    set: RegexSet,
+    /// Signature each pattern belongs to, in pattern order
+    owners: Vec<usize>,
+}
+
+impl PatternIndex {
+    fn new<'a>(patterns: impl Iterator<Item = (usize, &'a CommandPattern)>) -> Result<Self, SignatureError> {
+        let (owners, regexes): (Vec<usize>, Vec<&str>) =
+            patterns.map(|(owner, p)| (owner, p.regex.as_str())).unzip();
+        let set = RegexSetBuilder::new(regexes).case_insensitive(true).build()?;
+        Ok(Self { set, owners })
+    }
+
+    /// First signature with a pattern matching `text`
+    fn first_match(&self, text: &str) -> Option<usize> {
+        // Most processes match nothing; that check does not allocate
+        if !self.set.is_match(text) {
+            return None;
+        }
+        // Patterns are in signature order, so the lowest match wins
+        self.set.matches(text).iter().next().map(|i| self.owners[i])
+    }
+}
+
+/// All signatures compiled together
+#[derive(Debug)]
+struct MatchIndex {
+    names: NameTrie,
+    commands: PatternIndex,
+    exes: PatternIndex,
+}
+
+impl MatchIndex {
+    fn new(signatures: &[CompiledSignature]) -> Result<Self, SignatureError> {
+        let mut names = NameTrie::new();
+        for (i, sig) in signatures.iter().enumerate() {
+            for name in &sig.signature.detection.process_names {
+                names.insert(name, i);
+            }
+        }
+        let patterns = |field: fn(&DetectionRules) -> &Vec<CommandPattern>| {
+            signatures
+                .iter()
+                .enumerate()
+                .flat_map(move |(i, sig)| field(&sig.signature.detection).iter().map(move |p| (i, p)))
+        };
+        Ok(Self {
+            names,
+            commands: PatternIndex::new(patterns(|d| &d.command_patterns))?,
+            exes: PatternIndex::new(patterns(|d| &d.exe_patterns))?,
+        })
+    }
+
+    /// Index of the first signature matching `process`
+    fn first_match(&self, process: &ProcessInfo) -> Option<usize> {
+        let mut best = self.names.first_match(&process.name);
+        // A later field can only improve on an earlier match
+        let fields = [
+            (&self.commands, process.cmdline.as_deref()),
+            (&self.exes, process.exe_path.as_deref()),
+        ];
+        for (index, text) in fields {
+            if best == Some(0) {
+                break;
+            }
+            if let Some(found) = text.and_then(|text| index.first_match(text)) {
+                best = Some(best.map_or(found, |b| b.min(found)));
+            }
+        }
+        best
+    }
+}
+
+/// How much evidence backs a signature match
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Serialize, Deserialize)]
+pub enum MatchConfidence {
+    /// Only a command or exe pattern matched, and the parent is none of
+    /// the signature's parent hints
+    Low,
+    /// Matched, with no ancestry evidence either way
+    Medium,
+    /// Matched, and the parent is one of the signature's parent hints
+    High,
+}
+
+/// A signature match scored with the process's ancestry
+#[derive(Debug, Clone, Copy)]
+pub struct AgentMatch<'a> {
+    pub signature: &'a AgentSignature,
+    pub confidence: MatchConfidence,
+}
+
+impl AgentMatch<'_> {
+    /// Name of the matched signature
+    pub fn name(&self) -> &str {
+        &self.signature.name
+    }
+
+    /// Whether processes the agent spawns are attributed to it
+    pub fn tracks_children(&self) -> bool {
+        self.signature.child_process_tracking
+    }
+}
+
+/// Whether a parent process name matches a parent hint
+///
+/// Case-insensitive; a version suffix on the parent is ignored, so the
+/// hint "python" covers "python3" and "python3.12".
+fn is_parent_hint(parent: &str, hint: &str) -> bool {
+    let (Some(head), Some(rest)) = (parent.get(..hint.len()), parent.get(hint.len()..)) else {
+        return false;
+    };
+    head.eq_ignore_ascii_case(hint) && rest.bytes().all(|b| b.is_ascii_digit() || b == b'.')
+}
+
+/// Match results kept by default
+pub const DEFAULT_MATCH_CACHE_CAPACITY: usize = 4096;
+
+/// Match cache counters
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct MatchCacheStats {
+    pub hits: u64,
+    pub misses: u64,
+    /// Results currently cached
+    pub len: usize,
+}
+
+const NIL: usize = usize::MAX;
+
+/// LRU cache of match results by process identity hash
+///
+/// Entries live in a slab and form a doubly linked list, most recently
+/// used first, so lookups, inserts and evictions are O(1).
+#[derive(Debug)]
+struct MatchCache {
+    capacity: usize,
+    slots: HashMap<u64, usize>,
+    entries: Vec<CacheEntry>,
+    head: usize,
+    tail: usize,
+    hits: u64,
+    misses: u64,
+}
+
+#[derive(Debug)]
+struct CacheEntry {
+    key: u64,
+    /// Index of the matching signature, None for no match
+    signature: Option<usize>,
+    prev: usize,
+    next: usize,
+}
+
+impl MatchCache {
+    fn new(capacity: usize) -> Self {
+        Self {
+            capacity,
+            slots: HashMap::with_capacity(capacity),
+            entries: Vec::with_capacity(capacity),
+            head: NIL,
+            tail: NIL,
+            hits: 0,
+            misses: 0,
+        }
+    }
+
+    fn get(&mut self, key: u64) -> Option<Option<usize>> {
+        match self.slots.get(&key) {
+            Some(&slot) => {
+                self.hits += 1;
+                self.unlink(slot);
+                self.push_front(slot);
+                Some(self.entries[slot].signature)
+            }
+            None => {
+                self.misses += 1;
+                None
+            }
+        }
+    }
+
+    fn insert(&mut self, key: u64, signature: Option<usize>) {
+        if self.capacity == 0 || self.slots.contains_key(&key) {
+            return;
+        }
+        let slot = if self.entries.len() < self.capacity {
+            self.entries.push(CacheEntry {
+                key,
+                signature,
+                prev: NIL,
+                next: NIL,
+            });
+            self.entries.len() - 1
+        } else {
+            // Reuse the least recently used entry
+            let slot = self.tail;
+            self.unlink(slot);
+            self.slots.remove(&self.entries[slot].key);
+            self.entries[slot].key = key;
+            self.entries[slot].signature = signature;
+            slot
+        };
+        self.slots.insert(key, slot);
+        self.push_front(slot);
+    }
+
+    fn clear(&mut self) {
+        self.slots.clear();
+        self.entries.clear();
+        self.head = NIL;
+        self.tail = NIL;
+    }
+
+    fn stats(&self) -> MatchCacheStats {
+        MatchCacheStats {
+            hits: self.hits,
+            misses: self.misses,
+            len: self.slots.len(),
+        }
+    }
+
+    fn unlink(&mut self, slot: usize) {
+        let (prev, next) = (self.entries[slot].prev, self.entries[slot].next);
+        match prev {
+            NIL => self.head = next,
+            prev => self.entries[prev].next = next,
+        }
+        match next {
+            NIL => self.tail = prev,
+            next => self.entries[next].prev = prev,
+        }
+    }
+
+    fn push_front(&mut self, slot: usize) {
+        self.entries[slot].prev = NIL;
+        self.entries[slot].next = self.head;
+        match self.head {
+            NIL => self.tail = slot,
+            head => self.entries[head].prev = slot,
+        }
+        self.head = slot;
+    }
+}
+
+/// Hash of what signatures look at
+fn identity(process: &ProcessInfo) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    process.name.hash(&mut hasher);
+    process.exe_path.hash(&mut hasher);
+    process.cmdline.hash(&mut hasher);
+    hasher.finish()
+}
+
 /// Signature matcher that holds all compiled signatures
 pub struct SignatureMatcher {
     signatures: Vec<CompiledSignature>,
+    index: MatchIndex,
+    cache: Mutex<MatchCache>,
 }
 
 impl SignatureMatcher {
     /// Create a new empty matcher
     pub fn new() -> Self {
+        Self::with_cache_capacity(DEFAULT_MATCH_CACHE_CAPACITY)
+    }
+
+    /// Create a matcher caching up to `capacity` results (0 disables caching)
+    pub fn with_cache_capacity(capacity: usize) -> Self {
         Self {
             signatures: Vec::new(),
+            index: MatchIndex::new(&[]).expect("an empty index always builds"),
+            cache: Mutex::new(MatchCache::new(capacity)),
         }
     }
 
     /// Load signatures from a list
     pub fn load(&mut self, signatures: Vec<AgentSignature>) -> Result<(), SignatureError> {
-        self.signatures = signatures
+        let signatures = signatures
             .into_iter()
             .map(CompiledSignature::new)
             .collect::<Result<Vec<_>, _>>()?;
+        self.index = MatchIndex::new(&signatures)?;
+        self.signatures = signatures;
+        self.invalidate();
         Ok(())
     }
 
     /// Add a single signature
     pub fn add(&mut self, signature: AgentSignature) -> Result<(), SignatureError> {
         self.signatures.push(CompiledSignature::new(signature)?);
+        self.index = MatchIndex::new(&self.signatures)?;
+        self.invalidate();
         Ok(())
     }
 
@@ -207,10 +565,64 @@ impl SignatureMatcher {
     ///
     /// Returns the name of the first matching signature, or None
     pub fn match_process(&self, process: &ProcessInfo) -> Option<&str> {
-        self.signatures
-            .iter()
-            .find(|sig| sig.matches(process))
-            .map(|sig| sig.signature.name.as_str())
+        self.first_match(process)
+            .map(|i| self.signatures[i].signature.name.as_str())
+    }
+
+    /// Match a process and score the match with its parent
+    ///
+    /// The parent's name is checked against the matched signature's
+    /// `parent_hints`. A hinted parent raises confidence; a pattern-only
+    /// match under a parent that contradicts the hints lowers it. Without
+    /// a parent or hints the match has medium confidence.
+    pub fn match_with_parent(&self, process: &ProcessInfo, parent: Option<&ProcessInfo>) -> Option<AgentMatch<'_>> {
+        let index = self.first_match(process)?;
+        let signature = &self.signatures[index].signature;
+        let hints = &signature.detection.parent_hints;
+
+        let confidence = match parent {
+            Some(parent) if !hints.is_empty() => {
+                if hints.iter().any(|hint| is_parent_hint(&parent.name, hint)) {
+                    MatchConfidence::High
+                } else if self.index.names.first_match(&process.name) == Some(index) {
+                    // A name match stands on its own
+                    MatchConfidence::Medium
+                } else {
+                    MatchConfidence::Low
+                }
+            }
+            _ => MatchConfidence::Medium,
+        };
+        Some(AgentMatch { signature, confidence })
+    }
+
+    /// Index of the first matching signature, through the cache
+    fn first_match(&self, process: &ProcessInfo) -> Option<usize> {
+        let key = identity(process);
+        let cached = self.lock_cache().get(key);
+        match cached {
+            Some(found) => found,
+            None => {
+                let found = self.index.first_match(process);
+                self.lock_cache().insert(key, found);
+                found
+            }
+        }
+    }
+
+    /// Hit and miss counts of the match cache
+    pub fn cache_stats(&self) -> MatchCacheStats {
+        self.lock_cache().stats()
+    }
+
+    /// Drop cached results; done whenever the signatures change
+    fn invalidate(&self) {
+        self.lock_cache().clear();
+    }
+
+    fn lock_cache(&self) -> std::sync::MutexGuard<'_, MatchCache> {
+        // Cache updates cannot panic midway, so a poisoned cache is intact
+        self.cache.lock().unwrap_or_else(|e| e.into_inner())
     }
 
     /// Get all signatures
@@ -932,6 +1344,36 @@ mod tests {
         assert!(aider.detection.parent_hints.contains(&"python".to_string()));
     }
 
+    #[test]
+    fn test_parent_hints_score_matches() {
+        let mut matcher = SignatureMatcher::new();
+        matcher.load(default_signatures()).unwrap();
+        let confidence = |process: &ProcessInfo, parent: Option<&str>| {
+            let parent = parent.map(|name| create_process(1, name));
+            matcher
+                .match_with_parent(process, parent.as_ref())
+                .map(|m| m.confidence)
+        };
+
+        // Copilot is only recognized by its command line
+        let copilot = create_process_with_cmdline(2, "node", "node /ext/github.copilot/dist/server.js");
+        assert_eq!(confidence(&copilot, Some("code")), Some(MatchConfidence::High));
+        assert_eq!(confidence(&copilot, Some("cron")), Some(MatchConfidence::Low));
+        assert_eq!(confidence(&copilot, None), Some(MatchConfidence::Medium));
+
+        // A name match is not lowered by an unhinted parent
+        let claude = create_process(3, "claude");
+        assert_eq!(confidence(&claude, Some("tmux")), Some(MatchConfidence::Medium));
+        assert_eq!(confidence(&claude, Some("zsh")), Some(MatchConfidence::High));
+
+        // Version suffixes on the parent still match the hint
+        let aider = create_process_with_cmdline(4, "aider", "aider --model x");
+        assert_eq!(confidence(&aider, Some("python3.12")), Some(MatchConfidence::High));
+        assert_eq!(confidence(&aider, Some("pythonista")), Some(MatchConfidence::Medium));
+
+        assert!(matcher.match_with_parent(&create_process(5, "vim"), None).is_none());
+    }
+
     // ========================================================================
     // Test Module: Network Endpoints
     // ========================================================================
@@ -1268,4 +1710,124 @@ mod tests {
         assert!(sig.detection.process_names.is_empty());
         assert!(!sig.child_process_tracking);
     }
+
+    #[test]
+    fn test_combined_index_agrees_with_per_signature_matching() {
+        let mut matcher = SignatureMatcher::new();
+        matcher.load(default_signatures()).unwrap();
+
+        let processes = [
+            create_full_process(1, "claude", None, None),
+            create_full_process(2, "CLAUDE-CLI", None, None),
+            create_full_process(3, "node", Some("node /usr/lib/@anthropic-ai/claude-code/cli.js"), None),
+            create_full_process(4, "python3", Some("python3 -m aider --model gpt-4"), None),
+            create_full_process(5, "Cursor Helper (R", None, None),
+            create_full_process(6, "cur", None, None),
+            create_full_process(7, "electron", None, Some("/Applications/Cursor.app/Contents/MacOS/Cursor")),
+            create_full_process(8, "bash", Some("bash -c make"), Some("/usr/bin/bash")),
+            create_full_process(9, "vim", Some("vim notes.md"), None),
+            create_full_process(10, "ollama", Some("ollama serve"), None),
+        ];
+        for process in &processes {
+            let expected = matcher
+                .signatures
+                .iter()
+                .find(|sig| sig.matches(process))
+                .map(|sig| sig.signature.name.as_str());
+            assert_eq!(matcher.match_process(process), expected, "{}", process.name);
+        }
+    }
+
+    #[test]
+    fn test_first_signature_wins() {
+        let signature = |name: &str, process_name: &str, regex: &str| AgentSignature {
+            name: name.to_string(),
+            display_name: name.to_string(),
+            icon: None,
+            detection: DetectionRules {
+                process_names: vec![process_name.to_string()],
+                command_patterns: vec![CommandPattern {
+                    regex: regex.to_string(),
+                }],
+                ..DetectionRules::default()
+            },
+            child_process_tracking: false,
+            network_endpoints: NetworkEndpoints::default(),
+        };
+        let mut matcher = SignatureMatcher::new();
+        matcher
+            .load(vec![signature("first", "zzz", "TOOL"), signature("second", "tool", "nothing")])
+            .unwrap();
+
+        // Name matches the second signature, command the first
+        let process = create_process_with_cmdline(1, "tool", "/usr/bin/tool --x");
+        assert_eq!(matcher.match_process(&process), Some("first"));
+        // Truncated name: prefix of a signature name
+        assert_eq!(matcher.match_process(&create_process(2, "too")), Some("second"));
+        assert_eq!(matcher.match_process(&create_process(3, "toolbox")), Some("second"));
+        assert_eq!(matcher.match_process(&create_process(4, "tx")), None);
+    }
+
+    #[test]
+    fn test_match_cache_hits_and_misses() {
+        let mut matcher = SignatureMatcher::new();
+        matcher.load(default_signatures()).unwrap();
+
+        let agent = create_process_with_cmdline(1, "claude", "claude --resume");
+        let shell = create_process_with_cmdline(2, "bash", "bash -l");
+        for pid in 0..3 {
+            let mut agent = agent.clone();
+            agent.pid = 100 + pid;
+            assert_eq!(matcher.match_process(&agent), Some("claude_code"));
+            // Misses are cached too
+            assert_eq!(matcher.match_process(&shell), None);
+        }
+        let stats = matcher.cache_stats();
+        assert_eq!((stats.hits, stats.misses, stats.len), (4, 2, 2));
+
+        // Same name, different command line: a separate entry
+        let other = create_process_with_cmdline(3, "bash", "bash -c claude --resume");
+        assert_eq!(matcher.match_process(&other), Some("claude_code"));
+        assert_eq!(matcher.cache_stats().len, 3);
+    }
+
+    #[test]
+    fn test_match_cache_invalidated_on_signature_change() {
+        let mut matcher = SignatureMatcher::new();
+        matcher.load(default_signatures()).unwrap();
+        let process = create_process(1, "mytool");
+        assert_eq!(matcher.match_process(&process), None);
+
+        let mut sig = default_signatures().remove(0);
+        sig.name = "mytool".to_string();
+        sig.detection.process_names = vec!["mytool".to_string()];
+        matcher.add(sig).unwrap();
+        assert_eq!(matcher.cache_stats().len, 0);
+        assert_eq!(matcher.match_process(&process), Some("mytool"));
+    }
+
+    #[test]
+    fn test_match_cache_evicts_least_recently_used() {
+        let mut matcher = SignatureMatcher::with_cache_capacity(2);
+        matcher.load(default_signatures()).unwrap();
+        let (a, b, c) = (create_process(1, "a"), create_process(2, "b"), create_process(3, "c"));
+
+        matcher.match_process(&a);
+        matcher.match_process(&b);
+        matcher.match_process(&a); // a is now the most recent
+        matcher.match_process(&c); // evicts b
+        let before = matcher.cache_stats();
+        matcher.match_process(&a);
+        matcher.match_process(&b);
+        let after = matcher.cache_stats();
+        assert_eq!(after.hits - before.hits, 1);
+        assert_eq!(after.misses - before.misses, 1);
+        assert_eq!(after.len, 2);
+
+        // Capacity 0 caches nothing
+        let mut uncached = SignatureMatcher::with_cache_capacity(0);
+        uncached.load(default_signatures()).unwrap();
+        assert_eq!(uncached.match_process(&create_process(4, "claude")), Some("claude_code"));
+        assert_eq!(uncached.cache_stats().len, 0);
+    }
 }
@@ -0,0 +1,132 @@
+//! /proc/<pid>/fd walking: FdWalker against plain std::fs
+//!
+//! Runs over a synthetic /proc-like tree (200 processes with 64
+//! descriptors each: files, sockets and pipes with fdinfo), so results do
+//! not depend on the host. Allocations per descriptor are counted with a
+//! wrapping global allocator and printed before the timings.
+//!
+//! ```sh
+//! cargo bench -p tuai --bench fd_walker
+//! ```
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::path::Path;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+use tuai::procfs::{parse_fdinfo_flags, FdWalker};
+
+const PROCESSES: u32 = 200;
+const FDS_PER_PROCESS: u32 = 64;
+
+struct CountingAlloc;
+
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+/// Build `<root>/<pid>/{fd,fdinfo}` with a mix of descriptor kinds
+fn build_tree(root: &Path) {
+    for pid in 1..=PROCESSES {
+        let fd_dir = root.join(format!("{}/fd", pid));
+        let fdinfo_dir = root.join(format!("{}/fdinfo", pid));
+        std::fs::create_dir_all(&fd_dir).unwrap();
+        std::fs::create_dir_all(&fdinfo_dir).unwrap();
+        for fd in 0..FDS_PER_PROCESS {
+            let target = match fd % 4 {
+                0 => format!("socket:[{}]", 10_000 + pid * 100 + fd),
+                1 => format!("pipe:[{}]", 20_000 + fd),
+                _ => format!("/home/dev/project/src/module_{}/file_{}.rs", pid, fd),
+            };
+            std::os::unix::fs::symlink(target, fd_dir.join(fd.to_string())).unwrap();
+            std::fs::write(fdinfo_dir.join(fd.to_string()), "pos:\t0\nflags:\t0100002\nmnt_id:\t25\n").unwrap();
+        }
+    }
+}
+
+/// What read_fd_for_pid used to do
+fn walk_std(root: &Path, pid: u32) -> usize {
+    let fd_path = format!("{}/{}/fd", root.display(), pid);
+    let fd_dir = Path::new(&fd_path);
+    if !fd_dir.exists() {
+        return 0;
+    }
+    let mut files = 0;
+    for entry in std::fs::read_dir(fd_dir).unwrap().flatten() {
+        if let Ok(target) = std::fs::read_link(entry.path()) {
+            let target = target.to_string_lossy().to_string();
+            if target.starts_with("socket:") || target.starts_with("pipe:") {
+                continue;
+            }
+            let fdinfo = format!("{}/{}/fdinfo/{}", root.display(), pid, entry.file_name().to_string_lossy());
+            if let Ok(content) = std::fs::read_to_string(fdinfo) {
+                files += parse_fdinfo_flags(content.as_bytes()).is_some() as usize;
+            }
+        }
+    }
+    files
+}
+
+fn walk_fd_walker(walker: &mut FdWalker, pid: u32) -> usize {
+    let mut files = 0;
+    walker
+        .walk(pid, |mut link| {
+            if link.target.starts_with(b"socket:") || link.target.starts_with(b"pipe:") {
+                return;
+            }
+            files += link.flags().is_some() as usize;
+        })
+        .unwrap();
+    files
+}
+
+fn allocations_per_fd(mut sweep: impl FnMut() -> usize) -> f64 {
+    sweep(); // warm up buffers
+    let before = ALLOCATIONS.load(Ordering::Relaxed);
+    let files = sweep();
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed) - before;
+    assert!(files > 0);
+    allocations as f64 / f64::from(PROCESSES * FDS_PER_PROCESS)
+}
+
+fn fd_walk(c: &mut Criterion) {
+    let root = tempfile::tempdir().unwrap();
+    build_tree(root.path());
+    let mut walker = FdWalker::with_root(root.path());
+
+    println!(
+        "allocations per fd: std::fs {:.2}, FdWalker {:.4}",
+        allocations_per_fd(|| (1..=PROCESSES).map(|pid| walk_std(root.path(), pid)).sum()),
+        allocations_per_fd(|| (1..=PROCESSES).map(|pid| walk_fd_walker(&mut walker, pid)).sum()),
+    );
+
+    let mut group = c.benchmark_group("fd_walk");
+    group.throughput(Throughput::Elements(u64::from(PROCESSES * FDS_PER_PROCESS)));
+    group.bench_function("std_fs", |b| {
+        b.iter(|| (1..=PROCESSES).map(|pid| walk_std(root.path(), pid)).sum::<usize>())
+    });
+    group.bench_function("fd_walker", |b| {
+        b.iter(|| (1..=PROCESSES).map(|pid| walk_fd_walker(&mut walker, pid)).sum::<usize>())
+    });
+    group.finish();
+}
+
+criterion_group!(benches, fd_walk);
+criterion_main!(benches);
@@ -0,0 +1,163 @@
+//! /proc/net/tcp parsing: byte-level parser against the old String parser
+//!
+//! Runs over a 100k-row table in the kernel's /proc/net/tcp format,
+//! generated up front so results do not depend on the host. One row in a
+//! hundred belongs to a watched process, as with a few agents on a busy
+//! host. Allocations per row are printed before the timings.
+//!
+//! ```sh
+//! cargo bench -p tuai --bench proc_net_parse
+//! ```
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::collections::HashMap;
+use std::net::{IpAddr, Ipv4Addr};
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+use tuai::network::{parse_table, TableKind};
+use tuai_common::{ConnectionInfo, Protocol};
+
+const ROWS: u32 = 100_000;
+
+/// Every OWNED_EVERY-th socket belongs to a watched process
+const OWNED_EVERY: u32 = 100;
+
+struct CountingAlloc;
+
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+/// A /proc/net/tcp table with ROWS established and listening sockets
+fn build_table() -> Vec<u8> {
+    let mut table = String::from(
+        "  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode\n",
+    );
+    for i in 0..ROWS {
+        let local = u32::from_ne_bytes([10, 0, (i >> 8) as u8, i as u8]);
+        let remote = u32::from_ne_bytes([93, 184, (i >> 16) as u8, (i >> 8) as u8]);
+        let state = if i % 10 == 0 { 0x0A } else { 0x01 };
+        table.push_str(&format!(
+            "{:>4}: {:08X}:{:04X} {:08X}:{:04X} {:02X} 00000000:00000000 00:00000000 00000000  1000        0 {} 1 0000000000000000 20 4 30 10 -1\n",
+            i,
+            local,
+            32768 + (i % 28000),
+            remote,
+            443,
+            state,
+            100_000 + i,
+        ));
+    }
+    table.into_bytes()
+}
+
+fn owners() -> HashMap<u64, u32> {
+    (0..ROWS)
+        .filter(|i| i % OWNED_EVERY == 0)
+        .map(|i| (u64::from(100_000 + i), 4242))
+        .collect()
+}
+
+/// What parse_tcp_file used to do, then keep the watched rows
+fn parse_string(table: &[u8], owners: &HashMap<u64, u32>) -> usize {
+    let content = String::from_utf8(table.to_vec()).unwrap();
+    let mut connections = Vec::new();
+    for line in content.lines().skip(1) {
+        let parts: Vec<&str> = line.split_whitespace().collect();
+        if parts.len() < 10 {
+            continue;
+        }
+        let (local_addr, local_port) = parse_ipv4_addr(parts[1]);
+        let (remote_addr, remote_port) = parse_ipv4_addr(parts[2]);
+        let inode: u64 = parts[9].parse().unwrap_or(0);
+        let pid = owners.get(&inode).copied().unwrap_or(0);
+
+        let mut conn = ConnectionInfo::new(pid, Protocol::Tcp);
+        conn.local_addr = Some(local_addr);
+        conn.local_port = Some(local_port);
+        conn.remote_addr = Some(remote_addr);
+        conn.remote_port = Some(remote_port);
+        connections.push(conn);
+    }
+    connections.retain(|c| c.pid != 0);
+    connections.len()
+}
+
+fn parse_ipv4_addr(addr: &str) -> (String, u16) {
+    let parts: Vec<&str> = addr.split(':').collect();
+    let ip_hex = parts[0];
+    let bytes: [u8; 4] = [
+        u8::from_str_radix(&ip_hex[6..8], 16).unwrap_or(0),
+        u8::from_str_radix(&ip_hex[4..6], 16).unwrap_or(0),
+        u8::from_str_radix(&ip_hex[2..4], 16).unwrap_or(0),
+        u8::from_str_radix(&ip_hex[0..2], 16).unwrap_or(0),
+    ];
+    (Ipv4Addr::from(bytes).to_string(), u16::from_str_radix(parts[1], 16).unwrap_or(0))
+}
+
+/// Byte-level parse, materializing only the watched rows
+fn parse_bytes(table: &[u8], owners: &HashMap<u64, u32>) -> usize {
+    let mut connections = Vec::new();
+    for row in parse_table(table, TableKind::Tcp) {
+        let Some(&pid) = owners.get(&row.inode) else {
+            continue;
+        };
+        let mut conn = ConnectionInfo::new(pid, Protocol::Tcp);
+        if let (Some(local), Some(remote)) = (row.local, row.remote) {
+            conn.local_addr = Some(local.ip().to_string());
+            conn.local_port = Some(local.port());
+            if remote.ip() != IpAddr::V4(Ipv4Addr::UNSPECIFIED) {
+                conn.remote_addr = Some(remote.ip().to_string());
+            }
+            conn.remote_port = Some(remote.port());
+        }
+        connections.push(conn);
+    }
+    connections.len()
+}
+
+fn allocations_per_row(parse: impl Fn() -> usize) -> f64 {
+    let before = ALLOCATIONS.load(Ordering::Relaxed);
+    let kept = parse();
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed) - before;
+    assert_eq!(kept, (ROWS / OWNED_EVERY) as usize);
+    allocations as f64 / f64::from(ROWS)
+}
+
+fn tcp_table(c: &mut Criterion) {
+    let table = build_table();
+    let owners = owners();
+
+    println!(
+        "allocations per row: String parser {:.2}, byte parser {:.4}",
+        allocations_per_row(|| parse_string(&table, &owners)),
+        allocations_per_row(|| parse_bytes(&table, &owners)),
+    );
+
+    let mut group = c.benchmark_group("proc_net_tcp");
+    group.throughput(Throughput::Elements(u64::from(ROWS)));
+    group.bench_function("string", |b| b.iter(|| parse_string(&table, &owners)));
+    group.bench_function("bytes", |b| b.iter(|| parse_bytes(&table, &owners)));
+    group.finish();
+}
+
+criterion_group!(benches, tcp_table);
+criterion_main!(benches);
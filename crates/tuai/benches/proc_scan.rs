@@ -0,0 +1,44 @@
+//! /proc sweep scaling with the scan thread budget
+//!
+//! Each iteration reads every `/proc/<pid>/fd` link on the host, which is
+//! the work behind socket inode mapping and open file listing. Run on a
+//! busy host to see how sweep time scales with thread count:
+//!
+//! ```sh
+//! cargo bench -p tuai --bench proc_scan
+//! ```
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use tuai::procfs;
+
+fn fd_sweep(c: &mut Criterion) {
+    let pids = match procfs::list_pids() {
+        Ok(pids) => pids,
+        Err(e) => {
+            eprintln!("skipping /proc sweep benchmark: {}", e);
+            return;
+        }
+    };
+    let max_threads = std::thread::available_parallelism().map_or(1, |n| n.get());
+
+    let mut group = c.benchmark_group("proc_fd_sweep");
+    group.throughput(Throughput::Elements(pids.len() as u64));
+    let mut threads = 1;
+    while threads <= max_threads {
+        group.bench_with_input(BenchmarkId::from_parameter(threads), &threads, |b, &threads| {
+            b.iter(|| {
+                procfs::par_flat_map(&pids, threads, |pid| {
+                    let mut links = 0usize;
+                    let _ = procfs::with_fd_walker(|walker| walker.walk(pid, |_| links += 1));
+                    vec![links]
+                })
+                .len()
+            });
+        });
+        threads *= 2;
+    }
+    group.finish();
+}
+
+criterion_group!(benches, fd_sweep);
+criterion_main!(benches);
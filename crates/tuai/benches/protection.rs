@@ -0,0 +1,126 @@
+//! Protected path checks: compiled trie and glob set against the old scan
+//!
+//! Runs a config with thousands of files, directories and patterns over a
+//! stream of paths like those agents open (sources, dependencies, build
+//! output, system libraries), with one path in fifty protected. The
+//! baseline is the previous `is_protected`: a hash lookup, a `starts_with`
+//! per directory and a `glob::Pattern` compiled per pattern per call. It
+//! is only run up to a thousand entries of each kind; beyond that a
+//! single iteration takes seconds.
+//!
+//! ```sh
+//! cargo bench -p tuai --bench protection
+//! ```
+
+use std::collections::HashSet;
+use std::path::{Path, PathBuf};
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use tuai::protection::ProtectionConfig;
+
+const PATHS: usize = 10_000;
+
+/// Every PROTECTED_EVERY-th path in the stream is protected
+const PROTECTED_EVERY: usize = 50;
+
+/// Largest config the baseline is run against
+const BASELINE_MAX: usize = 1_000;
+
+/// A config with `n` files, `n` directories and `n` patterns
+fn config(n: usize) -> ProtectionConfig {
+    let mut config = ProtectionConfig::new();
+    config.files = (0..n).map(|i| PathBuf::from(format!("/home/dev/.config/app{}/token", i))).collect();
+    config.directories = (0..n).map(|i| PathBuf::from(format!("/srv/vault{}", i))).collect();
+    config.patterns = (0..n)
+        .map(|i| match i % 4 {
+            0 => format!("**/secret{}.key", i),
+            1 => format!("**/*.vault{}", i),
+            2 => format!("**/.credentials{}/*", i),
+            _ => format!("/home/*/private{}/**", i),
+        })
+        .collect();
+    config.rebuild_cache();
+    config
+}
+
+fn path_stream() -> Vec<String> {
+    (0..PATHS)
+        .map(|i| {
+            if i % PROTECTED_EVERY == 0 {
+                return match i % 4 {
+                    0 => format!("/srv/vault{}/db.sqlite", i % 100),
+                    1 => format!("/home/dev/project/secret{}.key", (i % 100) / 4 * 4),
+                    2 => format!("/home/dev/private{}/notes.txt", (i % 100) / 4 * 4 + 3),
+                    _ => "/root/.ssh/id_ed25519".to_string(),
+                };
+            }
+            match i % 5 {
+                0 => format!("/home/dev/project/src/module_{}/file_{}.rs", i % 40, i),
+                1 => format!("/home/dev/project/node_modules/pkg{}/lib/index.js", i % 300),
+                2 => format!("/home/dev/project/target/debug/deps/lib{}.rlib", i % 200),
+                3 => format!("/usr/lib/x86_64-linux-gnu/libfoo{}.so.1", i % 50),
+                _ => format!("/tmp/agent-{}/scratch.txt", i % 20),
+            }
+        })
+        .collect()
+}
+
+/// What is_protected used to do
+struct Baseline {
+    files: HashSet<PathBuf>,
+    directories: HashSet<PathBuf>,
+    patterns: Vec<String>,
+}
+
+impl Baseline {
+    fn new(config: &ProtectionConfig) -> Self {
+        let defaults = tuai::protection::DEFAULT_PROTECTED_FILES.iter().map(PathBuf::from);
+        let default_dirs = tuai::protection::DEFAULT_PROTECTED_DIRS.iter().map(PathBuf::from);
+        Self {
+            files: config.files.iter().cloned().chain(defaults).collect(),
+            directories: config.directories.iter().cloned().chain(default_dirs).collect(),
+            patterns: config.patterns.clone(),
+        }
+    }
+
+    fn is_protected(&self, path: &str) -> bool {
+        let path = Path::new(path);
+        if self.files.contains(path) {
+            return true;
+        }
+        if self.directories.iter().any(|dir| path.starts_with(dir)) {
+            return true;
+        }
+        self.patterns
+            .iter()
+            .any(|pattern| glob::Pattern::new(pattern).is_ok_and(|glob| glob.matches_path(path)))
+    }
+}
+
+fn is_protected(c: &mut Criterion) {
+    let paths = path_stream();
+
+    let mut group = c.benchmark_group("is_protected");
+    group.throughput(Throughput::Elements(PATHS as u64));
+    group.sample_size(10);
+    for n in [100, 1_000, 10_000] {
+        let config = config(n);
+        let hits = paths.iter().filter(|p| config.is_protected(p)).count();
+        assert!(hits >= PATHS / PROTECTED_EVERY / 2);
+
+        if n <= BASELINE_MAX {
+            let baseline = Baseline::new(&config);
+            assert_eq!(hits, paths.iter().filter(|p| baseline.is_protected(p)).count());
+            group.bench_with_input(BenchmarkId::new("baseline", n), &paths, |b, paths| {
+                b.iter(|| paths.iter().filter(|p| baseline.is_protected(p)).count())
+            });
+        }
+        group.bench_with_input(BenchmarkId::new("compiled", n), &paths, |b, paths| {
+            b.iter(|| paths.iter().filter(|p| config.is_protected(p)).count())
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, is_protected);
+criterion_main!(benches);
@@ -9,6 +9,8 @@
 // - sched_process_exit: Process termination
 // - sys_enter_connect: Network connections (TCP/UDP/Unix)
 // - sys_enter_openat: File opens
+// - fentry/security_file_open: Opens of protected files by tracked
+//   processes, matched by inode (optional, needs BPF trampolines)
 
 #include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
@@ -25,6 +27,7 @@
 #define EVENT_PROCESS_EXIT 2
 #define EVENT_NETWORK_CONNECT 3
 #define EVENT_FILE_OPEN 4
+#define EVENT_PROTECTED_OPEN 5
 
 // Address families (from socket.h)
 #define AF_UNIX 1
@@ -67,6 +70,14 @@ struct file_event {
     char path[MAX_PATH_LEN];
     int flags;          // Open flags (O_RDONLY, O_WRONLY, etc.)
     int dirfd;          // Directory fd for relative paths
+    u64 dev;            // Device of the opened file (protected opens only)
+    u64 ino;            // Inode of the opened file (protected opens only)
+};
+
+// Identity of a protected file (kernel dev_t encoding)
+struct inode_key {
+    u64 dev;
+    u64 ino;
 };
 
 // Ring buffers for each event type
@@ -85,6 +96,24 @@ struct {
     __uint(max_entries, 128 * 1024);
 } file_events SEC(".maps");
 
+// Protected files, filled from user space
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 65536);
+    __type(key, struct inode_key);
+    __type(value, u8);
+} protected_inodes SEC(".maps");
+
+// Processes counted towards an agent (tgid), filled from user space.
+// Children that exec are added here too, so short-lived tools an agent
+// runs are covered before user space sees them.
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 65536);
+    __type(key, u32);
+    __type(value, u8);
+} tracked_pids SEC(".maps");
+
 // Get current task's parent PID
 static __always_inline u32 get_ppid(void)
 {
@@ -125,6 +154,12 @@ int handle_exec(struct trace_event_raw_sched_process_exec *ctx)
     event->event_type = EVENT_PROCESS_EXEC;
     event->pid = pid;
     event->ppid = get_ppid();
+
+    // Children of tracked processes are tracked too
+    if (bpf_map_lookup_elem(&tracked_pids, &event->ppid)) {
+        u8 one = 1;
+        bpf_map_update_elem(&tracked_pids, &pid, &one, BPF_ANY);
+    }
     event->uid = uid;
     event->gid = gid;
     event->timestamp_ns = bpf_ktime_get_ns();
@@ -163,6 +198,11 @@ int handle_exit(struct trace_event_raw_sched_process_template *ctx)
     id = bpf_get_current_pid_tgid();
     pid = id >> 32;
 
+    // Forget the process once its main thread exits
+    if (pid == (u32)id) {
+        bpf_map_delete_elem(&tracked_pids, &pid);
+    }
+
     // Fill event data
     event->event_type = EVENT_PROCESS_EXIT;
     event->pid = pid;
@@ -299,6 +339,8 @@ int handle_openat(struct trace_event_raw_sys_enter *ctx)
     } else {
         event->path[0] = '\0';
     }
+    event->dev = 0;
+    event->ino = 0;
 
     // Submit event
     bpf_ringbuf_submit(event, 0);
@@ -306,5 +348,49 @@ int handle_openat(struct trace_event_raw_sys_enter *ctx)
     return 0;
 }
 
+// Hook into every successful path resolution of an open
+// Matches the opened inode against protected_inodes, so symlinks, hard
+// links, bind mounts and relative paths to a protected file are all caught.
+// Only tracked processes are checked: every open on the host passes here.
+SEC("fentry/security_file_open")
+int BPF_PROG(handle_file_open, struct file *file)
+{
+    struct file_event *event;
+    struct inode_key key = {};
+    u32 pid = bpf_get_current_pid_tgid() >> 32;
+
+    if (!bpf_map_lookup_elem(&tracked_pids, &pid)) {
+        return 0;
+    }
+
+    key.dev = BPF_CORE_READ(file, f_inode, i_sb, s_dev);
+    key.ino = BPF_CORE_READ(file, f_inode, i_ino);
+    if (!bpf_map_lookup_elem(&protected_inodes, &key)) {
+        return 0;
+    }
+
+    event = bpf_ringbuf_reserve(&file_events, sizeof(*event), 0);
+    if (!event) {
+        return 0;
+    }
+
+    event->event_type = EVENT_PROTECTED_OPEN;
+    event->pid = pid;
+    event->uid = bpf_get_current_uid_gid() & 0xFFFFFFFF;
+    event->timestamp_ns = bpf_ktime_get_ns();
+    bpf_get_current_comm(&event->comm, sizeof(event->comm));
+
+    // The path is looked up in user space from the inode
+    event->path[0] = '\0';
+    event->flags = BPF_CORE_READ(file, f_flags);
+    event->dirfd = -1;
+    event->dev = key.dev;
+    event->ino = key.ino;
+
+    bpf_ringbuf_submit(event, 0);
+
+    return 0;
+}
+
 // License declaration required for BPF programs
 char LICENSE[] SEC("license") = "Dual BSD/GPL";
@@ -0,0 +1,945 @@
+//! Single collection engine for agent telemetry
+//!
+//! The collector diffs each published snapshot once and turns the changes
+//! into [`TelemetryEvent`]s on a fan-out bus. Connection events come
+//! already diffed from the network monitor and are only filtered here.
+//! The TUI, the text event stream, gRPC watchers and the storage writer
+//! all subscribe to the same bus, so collection cost does not grow with
+//! the number of consumers.
+//!
+//! Only agent activity is emitted:
+//! - process spawns, updates and exits for agents and their descendants
+//!   (agents carry their `agent_type`)
+//! - connection opens, state changes and closes, and opened files of agent
+//!   processes
+//! - alerts for agent connections to endpoints their signature does not
+//!   expect
+
+use std::collections::{HashMap, HashSet};
+use std::hash::{DefaultHasher, Hash, Hasher};
+
+use chrono::{DateTime, Utc};
+use parking_lot::RwLock;
+use tokio::sync::broadcast;
+use tuai_common::{
+    AgentMatch, ConnectionEvent, ConnectionEventType, EndpointViolation, MatchConfidence, ProcessEvent,
+    ProcessEventType, ProcessInfo, SignatureMatcher, TelemetryEvent,
+};
+
+use crate::monitor::{AgentRole, ProcessTree};
+use crate::network::{EndpointPolicy, Verdict};
+use crate::sampler::Snapshot;
+
+/// Events buffered per subscriber before it starts lagging
+const BUS_CAPACITY: usize = 4096;
+
+/// Agent connections kept for an endpoint check until their name is known
+const MAX_UNRESOLVED: usize = 1024;
+
+/// Fan-out bus for collected telemetry
+pub struct TelemetryBus {
+    tx: broadcast::Sender<TelemetryEvent>,
+    /// Live agents, for subscribers that attach after they were spawned
+    agents: RwLock<Vec<ProcessInfo>>,
+}
+
+impl TelemetryBus {
+    /// Create a bus with no subscribers
+    pub fn new() -> Self {
+        let (tx, _) = broadcast::channel(BUS_CAPACITY);
+        Self {
+            tx,
+            agents: RwLock::new(Vec::new()),
+        }
+    }
+
+    /// Subscribe to events emitted from now on
+    ///
+    /// Subscribe before calling [`agents`](Self::agents) so no spawn falls
+    /// in between.
+    pub fn subscribe(&self) -> broadcast::Receiver<TelemetryEvent> {
+        self.tx.subscribe()
+    }
+
+    /// Agents alive as of the last collection
+    pub fn agents(&self) -> Vec<ProcessInfo> {
+        self.agents.read().clone()
+    }
+
+    /// Number of attached subscribers
+    pub fn subscriber_count(&self) -> usize {
+        self.tx.receiver_count()
+    }
+
+    /// Replace the list of live agents
+    pub fn set_agents(&self, agents: Vec<ProcessInfo>) {
+        *self.agents.write() = agents;
+    }
+
+    /// Send events to all subscribers
+    pub fn publish(&self, events: impl IntoIterator<Item = TelemetryEvent>) {
+        for event in events {
+            // No subscribers is fine
+            let _ = self.tx.send(event);
+        }
+    }
+}
+
+impl Default for TelemetryBus {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Name to show for a process
+///
+/// Uses the agent type when known. Runtimes that report a version number
+/// as their name (e.g. "2.1.7" from Bun) fall back to the command.
+pub fn display_name(process: &ProcessInfo) -> String {
+    if let Some(agent) = &process.agent_type {
+        agent.clone()
+    } else if process.name.chars().all(|c| c.is_ascii_digit() || c == '.') {
+        process
+            .cmdline
+            .as_ref()
+            .and_then(|c| c.split_whitespace().next())
+            .and_then(|s| s.rsplit('/').next())
+            .unwrap_or(&process.name)
+            .to_string()
+    } else {
+        process.name.clone()
+    }
+}
+
+/// Agent type to show for a process, marked with '?' on a low-confidence match
+pub fn agent_label(process: &ProcessInfo) -> Option<String> {
+    let agent = process.agent_type.as_deref()?;
+    Some(match process.agent_confidence {
+        Some(MatchConfidence::Low) => format!("{}?", agent),
+        _ => agent.to_string(),
+    })
+}
+
+/// Match a process against the signatures, using its parent as evidence
+///
+/// Every match counts, whatever its confidence: the parent only scores
+/// it. A loose pattern under a parent the signature does not expect (an
+/// agent under tmux, sshd or a remote editor host) has low confidence.
+pub fn detect<'m>(
+    matcher: &'m SignatureMatcher,
+    snapshot: &Snapshot,
+    process: &ProcessInfo,
+) -> Option<AgentMatch<'m>> {
+    let parent = process.ppid.and_then(|ppid| snapshot.processes.get(&ppid)).map(|p| &**p);
+    matcher.match_with_parent(process, parent)
+}
+
+/// Set the agent type and confidence of a process from a match
+pub fn tag(process: &mut ProcessInfo, found: Option<&AgentMatch<'_>>) {
+    process.agent_type = found.map(|m| m.name().to_string());
+    process.agent_confidence = found.map(|m| m.confidence);
+}
+
+/// Tree role for a detection result
+pub fn role(found: Option<&AgentMatch<'_>>) -> AgentRole {
+    match found {
+        Some(m) if m.tracks_children() => AgentRole::Tracking,
+        Some(_) => AgentRole::Solo,
+        None => AgentRole::None,
+    }
+}
+
+/// Diff state shared by all consumers
+#[derive(Debug, Default)]
+pub struct Collector {
+    /// Process generation of the last collected snapshot
+    generation: u64,
+    /// Every live PID seen so far, with a hash of its image
+    known: HashMap<u32, u64>,
+    /// Agents and their descendants, as last emitted
+    related: HashMap<u32, ProcessInfo>,
+    /// PIDs that are agents themselves
+    tracked: HashSet<u32>,
+    known_files: HashSet<(u32, String)>,
+    /// Opens of agent connections whose remote address had not been
+    /// looked up yet, to be checked again
+    unresolved: Vec<ConnectionEvent>,
+}
+
+impl Collector {
+    /// Create a collector that has seen nothing yet
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Take in the current state without emitting events for it
+    pub fn baseline(&mut self, snapshot: &Snapshot, tree: &mut ProcessTree, matcher: &SignatureMatcher) {
+        self.diff(snapshot, tree, matcher, false);
+    }
+
+    /// Diff a snapshot against what was collected so far
+    pub fn collect(
+        &mut self,
+        snapshot: &Snapshot,
+        tree: &mut ProcessTree,
+        matcher: &SignatureMatcher,
+    ) -> Vec<TelemetryEvent> {
+        self.diff(snapshot, tree, matcher, true)
+    }
+
+    /// Re-evaluate live processes after the signatures changed
+    ///
+    /// Only agent roles in the tree are updated, so the collector and tree
+    /// state carry over. Processes that became related are reported as
+    /// spawned. Agents whose type changed or that no longer match are
+    /// reported as updated, the latter without an agent type.
+    pub fn rematch(
+        &mut self,
+        snapshot: &Snapshot,
+        tree: &mut ProcessTree,
+        matcher: &SignatureMatcher,
+    ) -> Vec<TelemetryEvent> {
+        let mut events = Vec::new();
+        let now = Utc::now();
+        let processes = snapshot.process_list();
+
+        let mut matched: HashMap<u32, AgentMatch<'_>> = HashMap::new();
+        tree.rematch(|pid| {
+            let found = snapshot
+                .processes
+                .get(&pid)
+                .and_then(|process| detect(matcher, snapshot, process));
+            if let Some(found) = found {
+                matched.insert(pid, found);
+            }
+            role(found.as_ref())
+        });
+
+        for process in &processes {
+            let found = matched.get(&process.pid);
+            events.extend(self.reconcile(process, tree, found, now));
+        }
+
+        events
+    }
+
+    /// Report an exit pushed by the monitor ahead of the next snapshot
+    ///
+    /// The PID stays known, so the snapshot that drops it emits nothing.
+    pub fn process_exited(&mut self, pid: u32, timestamp: DateTime<Utc>) -> Option<TelemetryEvent> {
+        let process = self.related.remove(&pid)?;
+        self.forget_resources(pid);
+        Some(exit_event(process, timestamp))
+    }
+
+    /// Pass on a connection event of a tracked agent
+    ///
+    /// Connections without a remote endpoint (listeners, Unix sockets) are
+    /// dropped.
+    pub fn connection_event(&self, event: ConnectionEvent) -> Option<TelemetryEvent> {
+        let conn = &event.connection;
+        if !self.tracked.contains(&conn.pid) {
+            return None;
+        }
+        let (Some(remote_addr), Some(remote_port)) = (&conn.remote_addr, conn.remote_port) else {
+            return None;
+        };
+        if remote_addr.is_empty() || remote_port == 0 {
+            return None;
+        }
+        Some(TelemetryEvent::Connection(event))
+    }
+
+    /// Alert for a connection an agent opened to an unexpected endpoint
+    ///
+    /// Opens are checked against the endpoints expected by the agent's
+    /// signature. An open whose remote address has not been looked up yet
+    /// is kept until it closes, and checked again by
+    /// [`recheck_endpoints`](Self::recheck_endpoints). Nothing is allocated
+    /// for connections to expected endpoints.
+    pub fn endpoint_violation(&mut self, event: &ConnectionEvent, policy: &EndpointPolicy) -> Option<TelemetryEvent> {
+        match event.event_type {
+            ConnectionEventType::Opened => {}
+            ConnectionEventType::Closed => {
+                if !self.unresolved.is_empty() {
+                    self.unresolved.retain(|open| open.connection.id != event.connection.id);
+                }
+                return None;
+            }
+            _ => return None,
+        }
+        if !self.tracked.contains(&event.connection.pid) {
+            return None;
+        }
+        let agent_type = self.related.get(&event.connection.pid)?.agent_type.as_deref()?;
+        match policy.check_connection(agent_type, &event.connection) {
+            Verdict::Unexpected => Some(violation(agent_type, event)),
+            Verdict::Unknown => {
+                if self.unresolved.len() < MAX_UNRESOLVED {
+                    self.unresolved.push(event.clone());
+                }
+                None
+            }
+            Verdict::Expected | Verdict::NotEnforced => None,
+        }
+    }
+
+    /// Check again the opens whose remote address had not been looked up
+    ///
+    /// Returns alerts for those that turn out unexpected. Opens still
+    /// waiting for their name are kept; those of exited agents are dropped.
+    pub fn recheck_endpoints(&mut self, policy: &EndpointPolicy) -> Vec<TelemetryEvent> {
+        let mut alerts = Vec::new();
+        for event in std::mem::take(&mut self.unresolved) {
+            let pid = event.connection.pid;
+            if !self.tracked.contains(&pid) {
+                continue;
+            }
+            let Some(agent_type) = self.related.get(&pid).and_then(|p| p.agent_type.as_deref()) else {
+                continue;
+            };
+            match policy.check_connection(agent_type, &event.connection) {
+                Verdict::Unexpected => alerts.push(violation(agent_type, &event)),
+                Verdict::Unknown => self.unresolved.push(event),
+                Verdict::Expected | Verdict::NotEnforced => {}
+            }
+        }
+        alerts
+    }
+
+    /// PIDs of live agents
+    pub fn tracked_pids(&self) -> Vec<u32> {
+        self.tracked.iter().copied().collect()
+    }
+
+    /// Agent each live agent or descendant is attributed to
+    ///
+    /// Agents map to themselves.
+    pub fn attribution(&self, tree: &ProcessTree) -> HashMap<u32, u32> {
+        self.related
+            .keys()
+            .filter_map(|pid| Some((*pid, tree.agent_for(*pid)?)))
+            .collect()
+    }
+
+    /// Live agents
+    pub fn agents(&self) -> Vec<ProcessInfo> {
+        self.tracked
+            .iter()
+            .filter_map(|pid| self.related.get(pid).cloned())
+            .collect()
+    }
+
+    fn diff(
+        &mut self,
+        snapshot: &Snapshot,
+        tree: &mut ProcessTree,
+        matcher: &SignatureMatcher,
+        emit: bool,
+    ) -> Vec<TelemetryEvent> {
+        let mut events = Vec::new();
+        let now = Utc::now();
+
+        let delta = snapshot.process_changes_since(self.generation);
+        if !delta.is_empty() {
+            self.generation = delta.generation;
+
+            // Signatures are only matched for processes new to the tree (or
+            // that exec'd), and the match is kept so agents are not matched
+            // a second time
+            let mut matched: HashMap<u32, AgentMatch<'_>> = HashMap::new();
+            tree.apply_delta(&delta, |p| {
+                let found = detect(matcher, snapshot, p);
+                if let Some(found) = found {
+                    matched.insert(p.pid, found);
+                }
+                role(found.as_ref())
+            });
+
+            // Exits first, so a reused PID reads as exit + spawn
+            let exited: Vec<u32> = if delta.full_resync {
+                let current: HashSet<u32> = delta.added.iter().map(|p| p.pid).collect();
+                self.known.keys().filter(|pid| !current.contains(pid)).copied().collect()
+            } else {
+                delta.removed.clone()
+            };
+            for pid in exited {
+                self.known.remove(&pid);
+                if let Some(process) = self.related.remove(&pid) {
+                    self.forget_resources(pid);
+                    if emit {
+                        events.push(exit_event(process, now));
+                    }
+                }
+            }
+
+            // Known processes whose image changed exec'd since they were
+            // seen, possibly in an earlier window than their fork
+            let mut execd = Vec::new();
+
+            for process in &delta.added {
+                // A full resync lists known processes as added
+                if let Some(image) = self.known.insert(process.pid, image_hash(process)) {
+                    if image != image_hash(process) {
+                        execd.push(process);
+                    }
+                    continue;
+                }
+                let is_agent = tree.is_agent(process.pid);
+                // Any depth below an agent, not just direct children
+                if !is_agent && !tree.is_descendant_of_agent(process.pid) {
+                    continue;
+                }
+
+                let mut process = process.clone();
+                if is_agent {
+                    let found = matched
+                        .get(&process.pid)
+                        .copied()
+                        .or_else(|| detect(matcher, snapshot, &process));
+                    tag(&mut process, found.as_ref());
+                    self.tracked.insert(process.pid);
+                }
+                self.related.insert(process.pid, process.clone());
+                if emit {
+                    events.push(TelemetryEvent::Process(ProcessEvent {
+                        event_type: ProcessEventType::Spawn,
+                        process,
+                        timestamp: now,
+                    }));
+                }
+            }
+
+            // Parent and cwd changes (cwd is only refreshed for tracked agents)
+            for process in &delta.updated {
+                let image = image_hash(process);
+                if self.known.insert(process.pid, image).is_some_and(|old| old != image) {
+                    execd.push(process);
+                    continue;
+                }
+                if let Some(known) = self.related.get_mut(&process.pid) {
+                    if known.ppid == process.ppid && known.cwd == process.cwd {
+                        continue;
+                    }
+                    known.ppid = process.ppid;
+                    known.cwd = process.cwd.clone();
+                    if emit {
+                        events.push(TelemetryEvent::Process(ProcessEvent {
+                            event_type: ProcessEventType::Update,
+                            process: known.clone(),
+                            timestamp: now,
+                        }));
+                    }
+                }
+            }
+
+            for process in execd {
+                let event = self.redetect(process, snapshot, tree, matcher, now);
+                if emit {
+                    events.extend(event);
+                }
+            }
+        }
+
+        // Agents' open files, and protected opens of any related process
+        for file_op in snapshot.file_ops.iter() {
+            if !self.related.contains_key(&file_op.pid) {
+                continue;
+            }
+            if self.known_files.insert((file_op.pid, file_op.path.clone())) && emit {
+                events.push(TelemetryEvent::FileOp(file_op.clone()));
+            }
+        }
+
+        events
+    }
+
+    /// Bring the record of a live process in line with its tree role
+    ///
+    /// `found` is the signature the process matched, if any. Returns
+    /// a spawn for a process that became related, and an update when the
+    /// agent type or the image (after an exec) of a related one changed.
+    fn reconcile(
+        &mut self,
+        process: &ProcessInfo,
+        tree: &ProcessTree,
+        found: Option<&AgentMatch<'_>>,
+        now: DateTime<Utc>,
+    ) -> Option<TelemetryEvent> {
+        let pid = process.pid;
+        let is_agent = tree.is_agent(pid);
+        let is_related = is_agent || tree.is_descendant_of_agent(pid);
+        let found = found.filter(|_| is_agent);
+
+        match self.related.get_mut(&pid) {
+            Some(known) if is_related => {
+                if known.agent_type.as_deref() == found.map(|m| m.name())
+                    && known.agent_confidence == found.map(|m| m.confidence)
+                    && image_hash(known) == image_hash(process)
+                {
+                    return None;
+                }
+                refresh(known, process);
+                tag(known, found);
+                let process = known.clone();
+                if is_agent {
+                    self.tracked.insert(pid);
+                } else {
+                    self.forget_resources(pid);
+                }
+                Some(update_event(process, now))
+            }
+            Some(_) => {
+                let mut known = self.related.remove(&pid).expect("checked above");
+                self.forget_resources(pid);
+                refresh(&mut known, process);
+                known.agent_confidence = None;
+                known.agent_type.take().map(|_| update_event(known, now))
+            }
+            None if is_related => {
+                let mut process = process.clone();
+                tag(&mut process, found);
+                if is_agent {
+                    self.tracked.insert(pid);
+                }
+                self.related.insert(pid, process.clone());
+                Some(TelemetryEvent::Process(ProcessEvent {
+                    event_type: ProcessEventType::Spawn,
+                    process,
+                    timestamp: now,
+                }))
+            }
+            None => None,
+        }
+    }
+
+    /// Detect a process again after its image changed
+    fn redetect(
+        &mut self,
+        process: &ProcessInfo,
+        snapshot: &Snapshot,
+        tree: &mut ProcessTree,
+        matcher: &SignatureMatcher,
+        now: DateTime<Utc>,
+    ) -> Option<TelemetryEvent> {
+        let found = detect(matcher, snapshot, process);
+        tree.redetect(process.pid, || role(found.as_ref()));
+        self.reconcile(process, tree, found.as_ref(), now)
+    }
+
+    /// Drop per-process dedup state once a process is gone
+    fn forget_resources(&mut self, pid: u32) {
+        self.tracked.remove(&pid);
+        self.known_files.retain(|(p, _)| *p != pid);
+        self.unresolved.retain(|open| open.connection.pid != pid);
+    }
+}
+
+/// Alert for `event`, an agent of type `agent_type` opening a connection
+fn violation(agent_type: &str, event: &ConnectionEvent) -> TelemetryEvent {
+    TelemetryEvent::EndpointViolation(EndpointViolation {
+        agent_type: agent_type.to_string(),
+        connection: event.connection.clone(),
+        timestamp: event.timestamp,
+    })
+}
+
+/// Hash of what an exec replaces: name, executable and command line
+fn image_hash(process: &ProcessInfo) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    (&process.name, &process.exe_path, &process.cmdline).hash(&mut hasher);
+    hasher.finish()
+}
+
+/// Copy the fields that change over a process' life into a record
+fn refresh(known: &mut ProcessInfo, process: &ProcessInfo) {
+    known.name = process.name.clone();
+    known.exe_path = process.exe_path.clone();
+    known.cmdline = process.cmdline.clone();
+    known.ppid = process.ppid;
+    known.cwd = process.cwd.clone();
+}
+
+fn update_event(process: ProcessInfo, timestamp: DateTime<Utc>) -> TelemetryEvent {
+    TelemetryEvent::Process(ProcessEvent {
+        event_type: ProcessEventType::Update,
+        process,
+        timestamp,
+    })
+}
+
+fn exit_event(mut process: ProcessInfo, timestamp: DateTime<Utc>) -> TelemetryEvent {
+    process.end_time = Some(timestamp);
+    TelemetryEvent::Process(ProcessEvent {
+        event_type: ProcessEventType::Exit,
+        process,
+        timestamp,
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use std::sync::Arc;
+
+    use super::*;
+    use crate::monitor::ProcessDelta;
+    use tuai_common::{default_signatures, ConnectionInfo, FileOpInfo, FileOperation, Protocol};
+
+    fn matcher() -> SignatureMatcher {
+        let mut matcher = SignatureMatcher::new();
+        matcher.load(default_signatures()).unwrap();
+        matcher
+    }
+
+    fn process(pid: u32, name: &str, ppid: Option<u32>) -> ProcessInfo {
+        let mut p = ProcessInfo::new(pid, name.to_string());
+        p.ppid = ppid;
+        p.cmdline = Some(name.to_string());
+        p
+    }
+
+    fn kinds(events: &[TelemetryEvent]) -> Vec<(ProcessEventType, u32)> {
+        events
+            .iter()
+            .filter_map(|e| match e {
+                TelemetryEvent::Process(p) => Some((p.event_type.clone(), p.process.pid)),
+                _ => None,
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_baseline_is_silent_then_reports_agent_activity() {
+        let matcher = matcher();
+        let mut tree = ProcessTree::new();
+        let mut collector = Collector::new();
+
+        let base = Snapshot::with_processes(1, vec![process(1, "init", None), process(10, "claude", Some(1))]);
+        collector.baseline(&base, &mut tree, &matcher);
+        assert_eq!(collector.tracked_pids(), vec![10]);
+        assert_eq!(collector.agents()[0].agent_type.as_deref(), Some("claude_code"));
+
+        // A child of the agent and an unrelated process appear
+        let mut next = Snapshot::with_processes(2, vec![
+            process(1, "init", None),
+            process(10, "claude", Some(1)),
+            process(11, "rustc", Some(10)),
+            process(20, "vim", Some(1)),
+        ]);
+        Arc::make_mut(&mut next.file_ops).push(FileOpInfo::new(10, FileOperation::Open, "/tmp/x".into()));
+        Arc::make_mut(&mut next.file_ops).push(FileOpInfo::new(20, FileOperation::Open, "/tmp/y".into()));
+        // Reported by the kernel for the agent's child
+        Arc::make_mut(&mut next.file_ops).push(FileOpInfo::new(11, FileOperation::Read, "/etc/shadow".into()));
+
+        let events = collector.collect(&next, &mut tree, &matcher);
+        assert_eq!(kinds(&events), vec![(ProcessEventType::Spawn, 11)]);
+        let files: Vec<_> = events
+            .iter()
+            .filter_map(|e| match e {
+                TelemetryEvent::FileOp(f) => Some(f.pid),
+                _ => None,
+            })
+            .collect();
+        assert_eq!(files, vec![10, 11]);
+
+        // Same snapshot again: nothing new
+        assert!(collector.collect(&next, &mut tree, &matcher).is_empty());
+    }
+
+    #[test]
+    fn test_connection_events_of_agents_only() {
+        let matcher = matcher();
+        let mut tree = ProcessTree::new();
+        let mut collector = Collector::new();
+        let base = Snapshot::with_processes(1, vec![process(1, "init", None), process(10, "claude", Some(1))]);
+        collector.baseline(&base, &mut tree, &matcher);
+
+        let event = |pid, remote_port| {
+            let mut conn = ConnectionInfo::new(pid, Protocol::Tcp);
+            conn.remote_addr = Some("1.2.3.4".to_string());
+            conn.remote_port = Some(remote_port);
+            ConnectionEvent {
+                event_type: ConnectionEventType::Opened,
+                connection: conn,
+                previous_state: None,
+                duration_ms: None,
+                timestamp: Utc::now(),
+            }
+        };
+        assert!(matches!(
+            collector.connection_event(event(10, 443)),
+            Some(TelemetryEvent::Connection(_))
+        ));
+        // Not an agent, and a listener without a peer
+        assert!(collector.connection_event(event(20, 443)).is_none());
+        assert!(collector.connection_event(event(10, 0)).is_none());
+    }
+
+    #[test]
+    fn test_endpoint_violations() {
+        let mut signatures = default_signatures();
+        let claude = signatures.iter_mut().find(|s| s.name == "claude_code").unwrap();
+        claude.network_endpoints.suspicious_if_not_in_list = true;
+        let policy = EndpointPolicy::compile(&signatures, |_| Vec::new());
+
+        let matcher = matcher();
+        let mut tree = ProcessTree::new();
+        let mut collector = Collector::new();
+        let base = Snapshot::with_processes(1, vec![process(1, "init", None), process(10, "claude", Some(1))]);
+        collector.baseline(&base, &mut tree, &matcher);
+
+        let event = |pid, remote: &str, event_type| {
+            let mut conn = ConnectionInfo::new(pid, Protocol::Tcp);
+            conn.remote_addr = Some(remote.to_string());
+            conn.remote_port = Some(443);
+            ConnectionEvent {
+                event_type,
+                connection: conn,
+                previous_state: None,
+                duration_ms: None,
+                timestamp: Utc::now(),
+            }
+        };
+        let opened = ConnectionEventType::Opened;
+        // Resolved addresses: an expected name and a bare IP without one
+        policy.names().insert("160.79.104.10".parse().unwrap(), Some("api.anthropic.com".to_string()));
+        policy.names().insert("203.0.113.9".parse().unwrap(), None);
+        assert!(collector
+            .endpoint_violation(&event(10, "160.79.104.10", opened), &policy)
+            .is_none());
+        match collector.endpoint_violation(&event(10, "203.0.113.9", opened), &policy) {
+            Some(TelemetryEvent::EndpointViolation(v)) => {
+                assert_eq!(v.agent_type, "claude_code");
+                assert_eq!(v.connection.remote_addr.as_deref(), Some("203.0.113.9"));
+            }
+            other => panic!("expected a violation, got {:?}", other),
+        }
+        // Only opens of agents are checked
+        assert!(collector
+            .endpoint_violation(&event(10, "203.0.113.9", ConnectionEventType::Closed), &policy)
+            .is_none());
+        assert!(collector
+            .endpoint_violation(&event(20, "203.0.113.9", opened), &policy)
+            .is_none());
+        assert!(collector.recheck_endpoints(&policy).is_empty());
+
+        // Not looked up yet: checked again once the name is in
+        let pending = event(10, "198.51.100.20", opened);
+        let closed = event(10, "198.51.100.21", opened);
+        assert!(collector.endpoint_violation(&pending, &policy).is_none());
+        assert!(collector.endpoint_violation(&closed, &policy).is_none());
+        assert!(collector.recheck_endpoints(&policy).is_empty());
+        let mut close = closed.clone();
+        close.event_type = ConnectionEventType::Closed;
+        assert!(collector.endpoint_violation(&close, &policy).is_none());
+
+        policy.names().resolve_pending(|_| Some("exfil.example.net".to_string()));
+        let alerts = collector.recheck_endpoints(&policy);
+        assert_eq!(alerts.len(), 1);
+        match &alerts[0] {
+            TelemetryEvent::EndpointViolation(v) => assert_eq!(v.connection.id, pending.connection.id),
+            other => panic!("expected a violation, got {:?}", other),
+        }
+        assert!(collector.recheck_endpoints(&policy).is_empty());
+    }
+
+    #[test]
+    fn test_children_follow_child_process_tracking() {
+        let matcher = matcher();
+        let mut tree = ProcessTree::new();
+        let mut collector = Collector::new();
+
+        let mut copilot = process(20, "node", Some(2));
+        copilot.cmdline = Some("node /ext/github.copilot/dist/server.js".to_string());
+        let mut processes = vec![
+            process(1, "init", None),
+            process(2, "code", Some(1)),
+            copilot,
+            process(10, "claude", Some(1)),
+        ];
+        let base = Snapshot::with_processes(1, processes.clone());
+        collector.baseline(&base, &mut tree, &matcher);
+
+        // claude tracks its children, however deep; copilot does not
+        processes.extend([
+            process(11, "bash", Some(10)),
+            process(12, "cargo", Some(11)),
+            process(13, "claude", Some(12)),
+            process(21, "rg", Some(20)),
+        ]);
+        let next = Snapshot::with_processes(2, processes);
+
+        let mut events = kinds(&collector.collect(&next, &mut tree, &matcher));
+        events.sort_by_key(|(_, pid)| *pid);
+        assert_eq!(events, vec![
+            (ProcessEventType::Spawn, 11),
+            (ProcessEventType::Spawn, 12),
+            (ProcessEventType::Spawn, 13),
+        ]);
+        // The nested claude is tracked itself and attributed to the root agent
+        let mut tracked = collector.tracked_pids();
+        tracked.sort();
+        assert_eq!(tracked, vec![10, 13, 20]);
+        assert_eq!(tree.nearest_agent(13), Some(10));
+        assert!(collector.agents().iter().any(|a| a.pid == 13 && a.agent_type.as_deref() == Some("claude_code")));
+
+        // Traffic of attributed processes goes to their nearest agent
+        let attribution = collector.attribution(&tree);
+        assert_eq!(attribution.get(&12), Some(&10));
+        assert_eq!(attribution.get(&13), Some(&13));
+        assert_eq!(attribution.get(&20), Some(&20));
+        assert_eq!(attribution.get(&21), None);
+    }
+
+    #[test]
+    fn test_low_confidence_matches_are_kept() {
+        let matcher = matcher();
+        let mut tree = ProcessTree::new();
+        let mut collector = Collector::new();
+
+        // A Copilot server under sshd (a remote host) rather than the editor
+        let copilot = |pid, ppid| {
+            let mut p = process(pid, "node", Some(ppid));
+            p.cmdline = Some("node /ext/github.copilot/dist/server.js".to_string());
+            p
+        };
+        let base = Snapshot::with_processes(1, vec![
+            process(1, "init", None),
+            process(2, "sshd", Some(1)),
+            process(3, "code", Some(1)),
+            copilot(20, 2),
+            copilot(30, 3),
+        ]);
+        collector.baseline(&base, &mut tree, &matcher);
+
+        let mut tracked = collector.tracked_pids();
+        tracked.sort();
+        assert_eq!(tracked, vec![20, 30]);
+        let confidence = |pid| {
+            let agents = collector.agents();
+            let agent = agents.iter().find(|a| a.pid == pid).unwrap();
+            assert_eq!(agent.agent_type.as_deref(), Some("copilot"));
+            agent.agent_confidence
+        };
+        assert_eq!(confidence(20), Some(MatchConfidence::Low));
+        assert_eq!(confidence(30), Some(MatchConfidence::High));
+        let label = |pid| collector.agents().iter().find(|a| a.pid == pid).and_then(agent_label);
+        assert_eq!(label(20).as_deref(), Some("copilot?"));
+        assert_eq!(label(30).as_deref(), Some("copilot"));
+    }
+
+    #[test]
+    fn test_exec_after_fork_is_detected() {
+        let matcher = matcher();
+        let mut tree = ProcessTree::new();
+        let mut collector = Collector::new();
+
+        // The fork lands in one window, still running the shell's image
+        let base = Snapshot::with_processes(1, vec![process(1, "init", None), process(10, "bash", Some(1))]);
+        collector.baseline(&base, &mut tree, &matcher);
+        assert!(collector.tracked_pids().is_empty());
+
+        // The exec comes as an update in the next one
+        let claude = process(10, "claude", Some(1));
+        let delta = ProcessDelta {
+            generation: 2,
+            updated: vec![claude.clone()],
+            ..Default::default()
+        };
+        let next = Snapshot::with_processes(2, vec![process(1, "init", None), claude]).with_delta(1, delta);
+        let events = collector.collect(&next, &mut tree, &matcher);
+        assert_eq!(kinds(&events), vec![(ProcessEventType::Spawn, 10)]);
+        assert_eq!(collector.tracked_pids(), vec![10]);
+        assert_eq!(collector.agents()[0].agent_type.as_deref(), Some("claude_code"));
+
+        // Exec'ing again, seen through a full resync, ends the agent
+        let resync = Snapshot::with_processes(3, vec![process(1, "init", None), process(10, "vim", Some(1))]);
+        let events = collector.collect(&resync, &mut tree, &matcher);
+        assert_eq!(kinds(&events), vec![(ProcessEventType::Update, 10)]);
+        match &events[0] {
+            TelemetryEvent::Process(p) => {
+                assert_eq!(p.process.name, "vim");
+                assert!(p.process.agent_type.is_none());
+            }
+            other => panic!("expected an update, got {:?}", other),
+        }
+        assert!(collector.tracked_pids().is_empty());
+        assert!(!tree.is_agent(10));
+    }
+
+    #[test]
+    fn test_rematch_after_signature_change() {
+        let mut tree = ProcessTree::new();
+        let mut collector = Collector::new();
+        let snapshot = Snapshot::with_processes(1, vec![
+            process(1, "init", None),
+            process(10, "claude", Some(1)),
+            process(20, "new-agent", Some(1)),
+            process(21, "cargo", Some(20)),
+        ]);
+        collector.baseline(&snapshot, &mut tree, &matcher());
+        assert_eq!(collector.tracked_pids(), vec![10]);
+
+        // A pack adds new-agent and drops nothing
+        let mut signatures = default_signatures();
+        let mut new_agent = signatures[0].clone();
+        new_agent.name = "new_agent".to_string();
+        new_agent.detection = Default::default();
+        new_agent.detection.process_names = vec!["new-agent".to_string()];
+        signatures.push(new_agent);
+        let mut reloaded = SignatureMatcher::new();
+        reloaded.load(signatures).unwrap();
+
+        let mut events = kinds(&collector.rematch(&snapshot, &mut tree, &reloaded));
+        events.sort_by_key(|(_, pid)| *pid);
+        assert_eq!(events, vec![(ProcessEventType::Spawn, 20), (ProcessEventType::Spawn, 21)]);
+        let mut tracked = collector.tracked_pids();
+        tracked.sort();
+        assert_eq!(tracked, vec![10, 20]);
+        // Nothing changed since: nothing to report
+        assert!(collector.rematch(&snapshot, &mut tree, &reloaded).is_empty());
+
+        // Back to the defaults: new-agent is no longer an agent
+        let events = collector.rematch(&snapshot, &mut tree, &matcher());
+        assert_eq!(kinds(&events), vec![(ProcessEventType::Update, 20)]);
+        assert_eq!(collector.tracked_pids(), vec![10]);
+        assert!(collector.collect(&snapshot, &mut tree, &matcher()).is_empty());
+    }
+
+    #[test]
+    fn test_pushed_exit_is_reported_once() {
+        let matcher = matcher();
+        let mut tree = ProcessTree::new();
+        let mut collector = Collector::new();
+        let base = Snapshot::with_processes(1, vec![process(1, "init", None), process(10, "claude", Some(1))]);
+        collector.baseline(&base, &mut tree, &matcher);
+
+        let exit = collector.process_exited(10, Utc::now()).unwrap();
+        assert_eq!(kinds(&[exit]), vec![(ProcessEventType::Exit, 10)]);
+        assert!(collector.tracked_pids().is_empty());
+
+        let gone = Snapshot::with_processes(2, vec![process(1, "init", None)]);
+        assert!(collector.collect(&gone, &mut tree, &matcher).is_empty());
+        assert!(collector.process_exited(10, Utc::now()).is_none());
+    }
+
+    #[test]
+    fn test_bus_fans_out_to_all_subscribers() {
+        let bus = TelemetryBus::new();
+        let mut a = bus.subscribe();
+        let mut b = bus.subscribe();
+        bus.publish(vec![TelemetryEvent::FileOp(FileOpInfo::new(1, FileOperation::Open, "/x".into()))]);
+        assert!(matches!(a.try_recv(), Ok(TelemetryEvent::FileOp(_))));
+        assert!(matches!(b.try_recv(), Ok(TelemetryEvent::FileOp(_))));
+        assert_eq!(bus.subscriber_count(), 2);
+    }
+
+    #[test]
+    fn test_display_name() {
+        let mut p = process(5, "2.1.7", None);
+        p.cmdline = Some("/usr/bin/bun run x".to_string());
+        assert_eq!(display_name(&p), "bun");
+        p.agent_type = Some("claude_code".to_string());
+        assert_eq!(display_name(&p), "claude_code");
+    }
+}
@@ -94,6 +94,20 @@ impl FileMonitorService {
         }
     }
 
+    /// Get open files of the given PIDs only
+    pub fn snapshot_for(&self, pids: &[u32]) -> PlatformResult<Vec<FileOpInfo>> {
+        let files = self.inner.snapshot_for(pids)?;
+
+        if self.filter_noise {
+            Ok(files
+                .into_iter()
+                .filter(|f| !Self::is_noise_path(&f.path))
+                .collect())
+        } else {
+            Ok(files)
+        }
+    }
+
     /// Get all open files across all processes
     pub fn snapshot(&self) -> PlatformResult<Vec<FileOpInfo>> {
         let files = self.inner.snapshot()?;
@@ -203,4 +217,14 @@ pub trait FileMonitorBackend: Send + Sync {
     fn is_running(&self) -> bool;
     fn snapshot(&self) -> PlatformResult<Vec<FileOpInfo>>;
     fn open_files_for_pid(&self, pid: u32) -> PlatformResult<Vec<FileOpInfo>>;
+
+    /// Open files of `pids` only, without scanning other processes
+    fn snapshot_for(&self, pids: &[u32]) -> PlatformResult<Vec<FileOpInfo>> {
+        let mut files = Vec::new();
+        for &pid in pids {
+            // Exited processes simply have no files
+            files.extend(self.open_files_for_pid(pid).unwrap_or_default());
+        }
+        Ok(files)
+    }
 }
@@ -2,13 +2,18 @@
 //!
 //! Tracks open file descriptors for processes.
 
-use std::fs;
-use std::path::Path;
 use std::sync::atomic::{AtomicBool, Ordering};
 
-use tuai_common::{FileOpInfo, FileOperation, PlatformError, PlatformResult};
+use tuai_common::{FileOpInfo, FileOperation, PlatformResult};
 
 use super::FileMonitorBackend;
+use crate::procfs;
+
+/// Link target prefixes that are not regular files
+const SKIPPED_TARGETS: &[&[u8]] = &[b"socket:", b"pipe:", b"anon_inode:", b"/dev/", b"/proc/", b"/sys/"];
+
+/// Initial fdinfo buffer, enough for the lines of a regular file
+const FDINFO_BUF_SIZE: usize = 256;
 
 /// File monitor using /proc/*/fd (Linux)
 pub struct ProcFdMonitor {
@@ -23,72 +28,56 @@ impl ProcFdMonitor {
     }
 
     /// Get open files for a specific PID
+    #[cfg(unix)]
     fn read_fd_for_pid(pid: u32) -> PlatformResult<Vec<FileOpInfo>> {
-        let fd_path = format!("/proc/{}/fd", pid);
-        let fd_dir = Path::new(&fd_path);
-
-        if !fd_dir.exists() {
-            return Ok(vec![]);
-        }
-
         let mut files = Vec::new();
+        let mut fds = Vec::new();
 
-        let entries = match fs::read_dir(fd_dir) {
-            Ok(e) => e,
-            Err(_) => return Ok(vec![]), // Process may have exited or permission denied
-        };
-
-        for entry in entries.flatten() {
-            // Read the symlink to get the actual file path
-            if let Ok(link_target) = fs::read_link(entry.path()) {
-                let path_str = link_target.to_string_lossy().to_string();
-
+        // Process may have exited or permission denied: no files
+        let _ = procfs::with_fd_walker(|walker| {
+            walker.walk(pid, |link| {
                 // Skip non-file entries (sockets, pipes, etc.)
-                if path_str.starts_with("socket:")
-                    || path_str.starts_with("pipe:")
-                    || path_str.starts_with("anon_inode:")
-                    || path_str.starts_with("/dev/")
-                    || path_str.starts_with("/proc/")
-                    || path_str.starts_with("/sys/")
-                {
-                    continue;
+                if SKIPPED_TARGETS.iter().any(|prefix| link.target.starts_with(prefix)) {
+                    return;
                 }
 
-                // Try to determine operation type from fdinfo
-                let operation = Self::get_fd_operation(pid, &entry.file_name());
-
-                let file_op = FileOpInfo::new(pid, operation, path_str);
+                let path_str = String::from_utf8_lossy(link.target).into_owned();
+                let mut file_op = FileOpInfo::new(pid, FileOperation::Open, path_str);
+                // Lets protection match by inode, however the path was spelled
+                file_op.file_id = link.file_id();
                 files.push(file_op);
+                fds.push(link.fd);
+            })
+        });
+
+        // fdinfo is only read for the files we keep, in one batch
+        let fdinfo: Vec<String> = fds
+            .iter()
+            .map(|fd| format!("/proc/{}/fdinfo/{}", pid, fd))
+            .collect();
+        for (file_op, content) in files.iter_mut().zip(procfs::read_files(&fdinfo, FDINFO_BUF_SIZE)) {
+            if let Some(flags) = content.as_deref().and_then(procfs::parse_fdinfo_flags) {
+                file_op.operation = Self::operation_from_flags(flags);
             }
         }
 
         Ok(files)
     }
 
-    /// Try to determine the operation type from /proc/*/fdinfo/*
-    fn get_fd_operation(pid: u32, fd: &std::ffi::OsStr) -> FileOperation {
-        let fdinfo_path = format!("/proc/{}/fdinfo/{}", pid, fd.to_string_lossy());
-
-        if let Ok(content) = fs::read_to_string(&fdinfo_path) {
-            // Parse flags to determine read/write mode
-            for line in content.lines() {
-                if line.starts_with("flags:") {
-                    let flags_str = line.trim_start_matches("flags:").trim();
-                    if let Ok(flags) = u32::from_str_radix(flags_str.trim_start_matches("0"), 8) {
-                        // O_RDONLY = 0, O_WRONLY = 1, O_RDWR = 2
-                        let access_mode = flags & 3;
-                        return match access_mode {
-                            0 => FileOperation::Read,
-                            1 => FileOperation::Write,
-                            2 => FileOperation::Write, // RDWR counts as write
-                            _ => FileOperation::Open,
-                        };
-                    }
-                }
-            }
-        }
+    #[cfg(not(unix))]
+    fn read_fd_for_pid(_pid: u32) -> PlatformResult<Vec<FileOpInfo>> {
+        Ok(vec![])
+    }
 
-        FileOperation::Open
+    /// Determine the operation type from fdinfo open flags
+    pub(crate) fn operation_from_flags(flags: u32) -> FileOperation {
+        // O_RDONLY = 0, O_WRONLY = 1, O_RDWR = 2
+        match flags & 3 {
+            0 => FileOperation::Read,
+            1 => FileOperation::Write,
+            2 => FileOperation::Write, // RDWR counts as write
+            _ => FileOperation::Open,
+        }
     }
 }
 
@@ -106,7 +95,7 @@ impl FileMonitorBackend for ProcFdMonitor {
 
         #[cfg(not(target_os = "linux"))]
         {
-            return Err(PlatformError::NotSupported(
+            return Err(tuai_common::PlatformError::NotSupported(
                 "/proc/*/fd is only available on Linux".to_string(),
             ));
         }
@@ -127,35 +116,11 @@ impl FileMonitorBackend for ProcFdMonitor {
     }
 
     fn snapshot(&self) -> PlatformResult<Vec<FileOpInfo>> {
-        let mut all_files = Vec::new();
-
-        let proc_dir = match fs::read_dir("/proc") {
-            Ok(dir) => dir,
-            Err(e) => {
-                return Err(PlatformError::CollectionFailed(format!(
-                    "Failed to read /proc: {}",
-                    e
-                )))
-            }
-        };
-
-        for entry in proc_dir.flatten() {
-            let name = entry.file_name();
-            let name_str = name.to_string_lossy();
-
-            // Only process numeric directories (PIDs)
-            if !name_str.chars().all(|c| c.is_ascii_digit()) {
-                continue;
-            }
-
-            if let Ok(pid) = name_str.parse::<u32>() {
-                if let Ok(files) = Self::read_fd_for_pid(pid) {
-                    all_files.extend(files);
-                }
-            }
-        }
-
-        Ok(all_files)
+        // Sharded across the /proc thread budget
+        let pids = procfs::list_pids()?;
+        Ok(procfs::par_flat_map(&pids, procfs::thread_budget(), |pid| {
+            Self::read_fd_for_pid(pid).unwrap_or_default()
+        }))
     }
 
     fn open_files_for_pid(&self, pid: u32) -> PlatformResult<Vec<FileOpInfo>> {
@@ -176,4 +141,18 @@ mod tests {
         // Current process should have at least stdout/stderr open
         // but those are filtered as /dev/
     }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_operation_from_flags() {
+        let op = |fdinfo: &[u8]| {
+            procfs::parse_fdinfo_flags(fdinfo)
+                .map(ProcFdMonitor::operation_from_flags)
+                .unwrap_or(FileOperation::Open)
+        };
+        assert_eq!(op(b"pos:\t0\nflags:\t0100002\nmnt_id:\t25\n"), FileOperation::Write);
+        assert_eq!(op(b"flags:\t02100001\n"), FileOperation::Write);
+        assert_eq!(op(b"flags:\t0100000\n"), FileOperation::Read);
+        assert_eq!(op(b""), FileOperation::Open);
+    }
 }
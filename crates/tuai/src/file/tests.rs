@@ -855,6 +855,22 @@ mod backend_tests {
         let pid_3000 = monitor.open_files_for_pid(3000).unwrap();
         assert_eq!(pid_3000.len(), 0);
     }
+
+    #[test]
+    fn test_snapshot_for_pids() {
+        let ops = vec![
+            create_file_op(1000, FileOperation::Read, "/file1"),
+            create_file_op(2000, FileOperation::Read, "/file2"),
+            create_file_op(3000, FileOperation::Read, "/file3"),
+        ];
+
+        let monitor = MockFileMonitor::with_file_ops(ops);
+
+        let scoped = monitor.snapshot_for(&[1000, 3000, 4000]).unwrap();
+        let mut paths: Vec<&str> = scoped.iter().map(|op| op.path.as_str()).collect();
+        paths.sort();
+        assert_eq!(paths, vec!["/file1", "/file3"]);
+    }
 }
 
 // ============================================================================
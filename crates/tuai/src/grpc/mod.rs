@@ -3,19 +3,24 @@
 //! Provides the IPC interface for the UI to communicate with the daemon.
 
 use std::pin::Pin;
+use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::Arc;
-use std::time::Instant;
+use std::time::{Duration, Instant};
 
+use arc_swap::ArcSwap;
 use chrono::Utc;
 use futures_core::Stream;
 use parking_lot::RwLock;
-use tuai_common::{default_signatures, ProcessEventType, SignatureMatcher};
+use tuai_common::{ConnectionEvent, ProcessEventType, TelemetryEvent};
+use tokio::sync::broadcast::{self, error::RecvError};
 use tokio_stream::wrappers::BroadcastStream;
 use tonic::{Request, Response, Status};
 
-use crate::file::FileMonitorService;
-use crate::monitor::ProcessMonitorService;
-use crate::network::NetworkMonitorService;
+use crate::collector::{Collector, TelemetryBus};
+use crate::monitor::{ProcessMonitorService, ProcessTree};
+use crate::network::{self, EndpointPolicy};
+use crate::sampler::{Sampler, Snapshot};
+use crate::signature_packs::SignatureStore;
 use crate::storage::Storage;
 
 // Include generated protobuf code
@@ -26,160 +31,241 @@ pub mod proto {
 use proto::tuai_agent_server::{TuaiAgent, TuaiAgentServer};
 use proto::*;
 
+/// How often the collector diffs the latest snapshot
+const COLLECT_INTERVAL: Duration = Duration::from_millis(500);
+
 /// State shared across the gRPC service
+///
+/// Shared as a plain `Arc`: monitor data is read from snapshots published
+/// by the sampler thread, so no reader takes a lock around a /proc scan.
 pub struct AgentState {
-    pub monitor: ProcessMonitorService,
-    pub network_monitor: NetworkMonitorService,
-    pub file_monitor: FileMonitorService,
+    /// Process monitor for event subscriptions and tracked-PID hints
+    /// (only the sampler polls it)
+    pub monitor: Arc<ProcessMonitorService>,
     pub storage: Arc<Storage>,
-    pub signature_matcher: SignatureMatcher,
+    /// Agent signatures; reloads swap in a new matcher
+    pub signatures: Arc<SignatureStore>,
+    /// Expected endpoints per agent, recompiled from `signatures`
+    pub endpoint_policy: Arc<ArcSwap<EndpointPolicy>>,
+    /// Process tree with agent ancestry, kept in sync with snapshots
+    pub process_tree: RwLock<ProcessTree>,
+    /// Collected agent telemetry shared by every consumer
+    pub telemetry: TelemetryBus,
     pub start_time: Instant,
+    snapshots: Arc<ArcSwap<Snapshot>>,
+    /// Connection lifecycle events from the sampler
+    connection_events: broadcast::Sender<ConnectionEvent>,
+    sampler_running: Arc<AtomicBool>,
 }
 
 impl AgentState {
-    pub fn new(storage: Arc<Storage>) -> Self {
-        let mut signature_matcher = SignatureMatcher::new();
-        if let Err(e) = signature_matcher.load(default_signatures()) {
-            tracing::warn!("Failed to load default signatures: {}", e);
+    /// Create the state and start the sampler thread
+    ///
+    /// The first sample is taken before returning, so the initial snapshot
+    /// is populated.
+    pub fn new(storage: Arc<Storage>, mut sampler: Sampler, signatures: Arc<SignatureStore>) -> Self {
+        sampler.sample_all();
+        let monitor = sampler.process_monitor();
+        let snapshots = sampler.published();
+        let connection_events = sampler.connection_events();
+        let sampler_running = Arc::new(AtomicBool::new(true));
+        if let Err(e) = sampler.spawn(sampler_running.clone()) {
+            tracing::warn!("Failed to start sampler thread: {}", e);
+        }
+        if let Err(e) = signatures.spawn_watcher(sampler_running.clone()) {
+            tracing::warn!("Failed to watch signature packs: {}", e);
+        }
+        // Nothing is enforced until the refresh thread's first compile with
+        // DNS: startup never waits on a resolver, and the connections that
+        // already exist, reported as opened by the first poll, raise no
+        // alerts against a policy that does not know their addresses yet
+        let endpoint_policy = Arc::new(ArcSwap::from_pointee(EndpointPolicy::empty()));
+        let store = signatures.clone();
+        if let Err(e) =
+            network::spawn_refresh(endpoint_policy.clone(), move || store.load(), sampler_running.clone())
+        {
+            tracing::warn!("Failed to start endpoint policy refresh: {}", e);
         }
 
         Self {
-            monitor: ProcessMonitorService::new(),
-            network_monitor: NetworkMonitorService::new(),
-            file_monitor: FileMonitorService::new(),
+            monitor,
             storage,
-            signature_matcher,
+            signatures,
+            endpoint_policy,
+            process_tree: RwLock::new(ProcessTree::new()),
+            telemetry: TelemetryBus::new(),
             start_time: Instant::now(),
+            snapshots,
+            connection_events,
+            sampler_running,
         }
     }
 
-    /// Scan existing processes and detect AI agents
-    pub fn scan_existing_processes(&self) {
-        tracing::info!("Scanning existing processes for AI agents...");
-
-        match self.monitor.snapshot() {
-            Ok(processes) => {
-                // Build a map of PID -> process and PID -> agent_type
-                let mut pid_to_process: std::collections::HashMap<u32, &tuai_common::ProcessInfo> =
-                    std::collections::HashMap::new();
-                let mut agent_processes: std::collections::HashMap<u32, String> =
-                    std::collections::HashMap::new();
-
-                for process in &processes {
-                    pid_to_process.insert(process.pid, process);
-                    if let Some(agent_type) = self.signature_matcher.match_process(process) {
-                        agent_processes.insert(process.pid, agent_type.to_string());
-                    }
-                }
+    /// Latest published snapshot (a single atomic load, never blocks)
+    pub fn snapshot(&self) -> Arc<Snapshot> {
+        self.snapshots.load_full()
+    }
 
-                // Find root AI agents (processes whose parent is NOT also an AI agent)
-                let mut root_agents: std::collections::HashMap<u32, (String, String, u32)> =
-                    std::collections::HashMap::new(); // pid -> (agent_type, cmdline, child_count)
-
-                for (&pid, agent_type) in &agent_processes {
-                    let process = pid_to_process.get(&pid).unwrap();
-
-                    // Walk up the parent chain to find if any parent is also an AI agent
-                    let mut is_root = true;
-                    let mut root_pid = pid;
-                    let mut current_ppid = process.ppid;
-
-                    while let Some(ppid) = current_ppid {
-                        if agent_processes.contains_key(&ppid) {
-                            // Parent is also an AI agent, so this is not a root
-                            is_root = false;
-                            root_pid = ppid;
-                            // Continue walking up to find the true root
-                            if let Some(parent) = pid_to_process.get(&ppid) {
-                                current_ppid = parent.ppid;
-                            } else {
-                                break;
-                            }
-                        } else {
-                            break;
+    /// Start the collection engine feeding [`telemetry`](Self::telemetry)
+    ///
+    /// The current state is taken in before returning, so subscribers can
+    /// read the live agents from the bus right away. Needs a Tokio runtime.
+    pub fn spawn_collector(self: &Arc<Self>) -> tokio::task::JoinHandle<()> {
+        let mut collector = Collector::new();
+        let mut matcher = self.signatures.load();
+        collector.baseline(&self.snapshot(), &mut self.process_tree.write(), &matcher);
+        self.publish_tracking(&collector);
+
+        let state = self.clone();
+        // Pushed exits (pidfd/netlink) are reported ahead of the next snapshot
+        let mut process_events = state.monitor.subscribe();
+        let mut connection_events = state.connection_events.subscribe();
+        tokio::spawn(async move {
+            let mut interval = tokio::time::interval(COLLECT_INTERVAL);
+            let mut pushed_events = true;
+            let mut pushed_connections = true;
+            loop {
+                let events = tokio::select! {
+                    _ = interval.tick() => {
+                        let snapshot = state.snapshot();
+                        let mut tree = state.process_tree.write();
+                        let mut events = collector.collect(&snapshot, &mut tree, &matcher);
+                        // Reloaded signatures: re-evaluate what is already running
+                        let current = state.signatures.load();
+                        if !Arc::ptr_eq(&current, &matcher) {
+                            matcher = current;
+                            events.extend(collector.rematch(&snapshot, &mut tree, &matcher));
                         }
+                        // Opens whose remote address has been looked up since
+                        events.extend(collector.recheck_endpoints(&state.endpoint_policy.load()));
+                        events
                     }
-
-                    if is_root {
-                        // This is a root AI agent
-                        let cmdline = process.cmdline.as_deref().unwrap_or("<none>").to_string();
-                        root_agents.insert(pid, (agent_type.clone(), cmdline, 1));
-                    } else {
-                        // Increment child count for the root agent
-                        if let Some((_, _, count)) = root_agents.get_mut(&root_pid) {
-                            *count += 1;
+                    event = process_events.recv(), if pushed_events => match event {
+                        Ok(event) if event.event_type == ProcessEventType::Exit => collector
+                            .process_exited(event.process.pid, event.timestamp)
+                            .into_iter()
+                            .collect(),
+                        Ok(_) | Err(RecvError::Lagged(_)) => continue,
+                        Err(RecvError::Closed) => {
+                            pushed_events = false;
+                            continue;
                         }
-                    }
-                }
+                    },
+                    event = connection_events.recv(), if pushed_connections => match event {
+                        Ok(event) => {
+                            let violation = collector.endpoint_violation(&event, &state.endpoint_policy.load());
+                            collector.connection_event(event).into_iter().chain(violation).collect()
+                        }
+                        Err(RecvError::Lagged(_)) => continue,
+                        Err(RecvError::Closed) => {
+                            pushed_connections = false;
+                            continue;
+                        }
+                    },
+                };
 
-                // Log the root AI agents
-                for (pid, (agent_type, cmdline, child_count)) in &root_agents {
-                    let process = pid_to_process.get(pid).unwrap();
-                    if *child_count > 1 {
-                        tracing::info!(
-                            "🤖 Detected AI agent: {} (type: {}, PID: {}, {} child processes)",
-                            process.name,
-                            agent_type,
-                            pid,
-                            child_count - 1
-                        );
-                    } else {
-                        tracing::info!(
-                            "🤖 Detected AI agent: {} (type: {}, PID: {}, cmdline: {})",
-                            process.name,
-                            agent_type,
-                            pid,
-                            cmdline
-                        );
-                    }
+                if events.iter().any(|e| matches!(e, TelemetryEvent::Process(_))) {
+                    state.publish_tracking(&collector);
                 }
-
-                tracing::info!(
-                    "Process scan complete: {} total processes, {} root AI agents ({} total AI processes)",
-                    processes.len(),
-                    root_agents.len(),
-                    agent_processes.len()
-                );
+                state.telemetry.publish(events);
             }
-            Err(e) => {
-                tracing::warn!("Failed to scan existing processes: {}", e);
-            }
-        }
+        })
     }
 
-    /// Apply signature matching to a process and return updated process
-    pub fn match_and_tag_process(&self, mut process: tuai_common::ProcessInfo) -> tuai_common::ProcessInfo {
-        if process.agent_type.is_none() {
-            if let Some(agent_type) = self.signature_matcher.match_process(&process) {
+    /// Share the collector's agent set with the monitor and the bus
+    fn publish_tracking(&self, collector: &Collector) {
+        self.monitor.set_tracked_pids(&collector.tracked_pids());
+        self.monitor.set_attribution(collector.attribution(&self.process_tree.read()));
+        self.telemetry.set_agents(collector.agents());
+    }
+
+    /// Log the agents found among the existing processes
+    ///
+    /// Reads what the collector took in, so call it after
+    /// [`spawn_collector`](Self::spawn_collector).
+    pub fn scan_existing_processes(&self) {
+        tracing::info!("Scanning existing processes for AI agents...");
+
+        let snapshot = self.snapshot();
+        let tree = self.process_tree.read();
+        let mut root_agents = 0;
+
+        // Root AI agents are agents without an agent above them
+        for agent in self.telemetry.agents() {
+            if tree.is_descendant_of_agent(agent.pid) {
+                continue;
+            }
+            root_agents += 1;
+
+            let pid = agent.pid;
+            let agent_type = agent.agent_type.as_deref().unwrap_or_default();
+            let child_count = tree.subtree(pid).filter(|p| tree.agent_for(*p) == Some(pid)).count();
+            if child_count > 1 {
+                tracing::info!(
+                    "🤖 Detected AI agent: {} (type: {}, PID: {}, {} child processes)",
+                    agent.name,
+                    agent_type,
+                    pid,
+                    child_count - 1
+                );
+            } else {
                 tracing::info!(
-                    "🤖 Tracking AI agent: {} (type: {}, PID: {})",
-                    process.name,
+                    "🤖 Detected AI agent: {} (type: {}, PID: {}, cmdline: {})",
+                    agent.name,
                     agent_type,
-                    process.pid
+                    pid,
+                    agent.cmdline.as_deref().unwrap_or("<none>")
                 );
-                process.agent_type = Some(agent_type.to_string());
             }
         }
-        process
+
+        tracing::info!(
+            "Process scan complete: {} total processes, {} root AI agents ({} total AI processes)",
+            snapshot.processes.len(),
+            root_agents,
+            snapshot.processes.keys().filter(|pid| tree.agent_for(**pid).is_some()).count()
+        );
     }
 
-    /// Get snapshot with signature matching applied
+    /// Live processes, with agents tagged as the collector detected them
+    ///
+    /// Agent types come from the collector's agent set (parent scoring,
+    /// nested agents, exec re-detection), so queries agree with the
+    /// event stream. Processes the collector has not seen yet are untagged.
     pub fn get_processes_with_agents(&self) -> Result<Vec<tuai_common::ProcessInfo>, tuai_common::PlatformError> {
-        let processes = self.monitor.snapshot()?;
+        let agents: std::collections::HashMap<u32, tuai_common::ProcessInfo> = self
+            .telemetry
+            .agents()
+            .into_iter()
+            .map(|agent| (agent.pid, agent))
+            .collect();
+        let processes = self.snapshot().process_list();
         Ok(processes
             .into_iter()
-            .map(|p| self.match_and_tag_process(p))
+            .map(|mut process| {
+                if let Some(agent) = agents.get(&process.pid) {
+                    process.agent_type = agent.agent_type.clone();
+                    process.agent_confidence = agent.agent_confidence;
+                }
+                process
+            })
             .collect())
     }
 }
 
+impl Drop for AgentState {
+    fn drop(&mut self) {
+        self.sampler_running.store(false, Ordering::Relaxed);
+    }
+}
+
 /// gRPC service implementation
 pub struct TuaiAgentService {
-    state: Arc<RwLock<AgentState>>,
+    state: Arc<AgentState>,
 }
 
 impl TuaiAgentService {
-    pub fn new(state: Arc<RwLock<AgentState>>) -> Self {
+    pub fn new(state: Arc<AgentState>) -> Self {
         Self { state }
     }
 
@@ -218,12 +304,12 @@ impl TuaiAgent for TuaiAgentService {
         request: Request<WatchRequest>,
     ) -> Result<Response<Self::WatchProcessesStream>, Status> {
         let req = request.into_inner();
-        let state = self.state.read();
+        let state = &self.state;
 
-        // Get event receiver
-        let rx = state.monitor.subscribe();
+        // Collected agent process events
+        let rx = state.telemetry.subscribe();
 
-        // If include_existing, send current processes first (with signature matching applied)
+        // If include_existing, send current processes first (tagged by the collector)
         let existing_processes = if req.include_existing {
             state
                 .get_processes_with_agents()
@@ -262,7 +348,7 @@ impl TuaiAgent for TuaiAgentService {
 
             while let Some(event_result) = rx_stream.next().await {
                 match event_result {
-                    Ok(event) => {
+                    Ok(TelemetryEvent::Process(event)) => {
                         // Filter by agent type if specified
                         if !agent_filter.is_empty() {
                             if let Some(ref agent_type) = event.process.agent_type {
@@ -286,6 +372,7 @@ impl TuaiAgent for TuaiAgentService {
                             timestamp: event.timestamp.timestamp_millis(),
                         });
                     }
+                    Ok(_) => {}
                     Err(_) => {
                         // Lagged or closed
                         break;
@@ -302,9 +389,9 @@ impl TuaiAgent for TuaiAgentService {
         request: Request<QueryRequest>,
     ) -> Result<Response<QueryResponse>, Status> {
         let req = request.into_inner();
-        let state = self.state.read();
+        let state = &self.state;
 
-        // Get live snapshot with signature matching applied
+        // Live snapshot with the collector's agents tagged
         let all_processes = state
             .get_processes_with_agents()
             .map_err(|e| Status::internal(format!("Failed to get processes: {}", e)))?;
@@ -352,13 +439,10 @@ impl TuaiAgent for TuaiAgentService {
         &self,
         _request: Request<QueryRequest>,
     ) -> Result<Response<ConnectionsResponse>, Status> {
-        let state = self.state.read();
+        let state = &self.state;
 
         // Get current connections snapshot
-        let conn_infos = state
-            .network_monitor
-            .snapshot()
-            .map_err(|e| Status::internal(format!("Failed to get connections: {}", e)))?;
+        let conn_infos = state.snapshot().connections.as_ref().clone();
 
         let connections: Vec<Connection> = conn_infos
             .into_iter()
@@ -388,13 +472,10 @@ impl TuaiAgent for TuaiAgentService {
         &self,
         _request: Request<QueryRequest>,
     ) -> Result<Response<FileOpsResponse>, Status> {
-        let state = self.state.read();
+        let state = &self.state;
 
         // Get current open files snapshot
-        let file_infos = state
-            .file_monitor
-            .snapshot()
-            .map_err(|e| Status::internal(format!("Failed to get file ops: {}", e)))?;
+        let file_infos = state.snapshot().file_ops.as_ref().clone();
 
         let file_ops: Vec<FileOp> = file_infos
             .into_iter()
@@ -417,14 +498,49 @@ impl TuaiAgent for TuaiAgentService {
         }))
     }
 
+    async fn query_throughput(
+        &self,
+        _request: Request<Empty>,
+    ) -> Result<Response<ThroughputResponse>, Status> {
+        let agents: std::collections::HashMap<u32, String> = self
+            .state
+            .telemetry
+            .agents()
+            .into_iter()
+            .filter_map(|a| Some((a.pid, a.agent_type?)))
+            .collect();
+
+        let flows = self
+            .state
+            .snapshot()
+            .throughput
+            .iter()
+            .map(|f| Flow {
+                pid: f.agent_pid as i32,
+                agent_type: agents.get(&f.agent_pid).cloned().unwrap_or_default(),
+                endpoint_class: f.class.name().to_string(),
+                remote_addr: f.remote_addr.clone(),
+                bytes_sent: f.bytes_sent,
+                bytes_received: f.bytes_received,
+                sent_per_sec: f.sent_per_sec,
+                received_per_sec: f.received_per_sec,
+                rtt_us: f.rtt_us.unwrap_or(0),
+                connections: f.connections as i32,
+            })
+            .collect();
+
+        Ok(Response::new(ThroughputResponse { flows }))
+    }
+
     async fn get_agent_signatures(
         &self,
         _request: Request<Empty>,
     ) -> Result<Response<SignaturesResponse>, Status> {
-        let state = self.state.read();
+        let state = &self.state;
 
         let signatures: Vec<AgentSignature> = state
-            .signature_matcher
+            .signatures
+            .load()
             .signatures()
             .map(|sig| AgentSignature {
                 name: sig.name.clone(),
@@ -442,7 +558,7 @@ impl TuaiAgent for TuaiAgentService {
         &self,
         _request: Request<Empty>,
     ) -> Result<Response<StatusResponse>, Status> {
-        let state = self.state.read();
+        let state = &self.state;
 
         let uptime = state.start_time.elapsed().as_secs() as i64;
         let processes_tracked = state
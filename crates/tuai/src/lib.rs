@@ -8,19 +8,27 @@
 
 #![allow(dead_code)]
 
+pub mod collector;
 pub mod file;
 pub mod grpc;
 pub mod monitor;
 pub mod network;
+pub mod procfs;
 pub mod protection;
+pub mod sampler;
+pub mod signature_packs;
 pub mod storage;
 pub mod tui;
+pub mod watch;
 
+pub use collector::{Collector, TelemetryBus};
 pub use file::FileMonitorService;
 pub use grpc::{AgentState, TuaiAgentService};
 pub use monitor::ProcessMonitorService;
 pub use network::NetworkMonitorService;
 pub use protection::{ProtectionConfig, ProtectionEvent, ProtectionService};
+pub use sampler::{Sampler, Snapshot};
+pub use signature_packs::SignatureStore;
 pub use storage::{Storage, StorageConfig};
 
 // Re-export eBPF types when compiled with eBPF support
@@ -6,17 +6,23 @@
 //! # File Protection
 //!
 //! Use `--protect-config <file.toml>` to monitor sensitive files and
-//! generate alerts when AI agents access them.
+//! generate alerts when AI agents access them. The TUI reloads the file
+//! when it changes.
 
 #![allow(dead_code)]
 
+mod collector;
 mod file;
 mod grpc;
 mod monitor;
 mod network;
+mod procfs;
 pub mod protection;
+mod sampler;
+mod signature_packs;
 mod storage;
 mod tui;
+mod watch;
 
 use std::collections::{HashMap, HashSet};
 use std::net::SocketAddr;
@@ -26,13 +32,20 @@ use std::sync::Arc;
 use anyhow::{Context, Result};
 use chrono::Local;
 use directories::ProjectDirs;
-use parking_lot::RwLock;
+use tokio::sync::broadcast::error::RecvError;
 use tonic::transport::Server;
 use tracing::info;
 use tracing_subscriber::{layer::SubscriberExt, util::SubscriberInitExt};
 
+use crate::collector::display_name;
+use crate::file::FileMonitorService;
 use crate::grpc::{AgentState, TuaiAgentService};
+use crate::monitor::ProcessMonitorService;
+use crate::network::{EndpointClassifier, EndpointRules, NetworkBackend, NetworkMonitorService};
+use crate::sampler::Sampler;
+use crate::signature_packs::SignatureStore;
 use crate::storage::{Storage, StorageConfig};
+use tuai_common::{ConnectionEventType, MatchConfidence, ProcessEventType, TelemetryEvent};
 
 /// Default gRPC server address
 const DEFAULT_ADDR: &str = "127.0.0.1:50051";
@@ -56,6 +69,16 @@ struct Config {
     protect_config: Option<PathBuf>,
     /// Generate example protection config and exit
     gen_protect_config: bool,
+    /// Thread budget for /proc sweeps (None for the default)
+    scan_threads: Option<usize>,
+    /// Read /proc files through io_uring where available
+    io_uring: bool,
+    /// Network monitor backend
+    net_backend: NetworkBackend,
+    /// Path to endpoint classification rules
+    endpoint_rules: Option<PathBuf>,
+    /// Directory of signature packs, reloaded on change
+    signatures_dir: Option<PathBuf>,
 }
 
 impl Default for Config {
@@ -72,6 +95,11 @@ impl Default for Config {
             server_mode: false,
             protect_config: None,
             gen_protect_config: false,
+            scan_threads: None,
+            io_uring: true,
+            net_backend: NetworkBackend::Auto,
+            endpoint_rules: None,
+            signatures_dir: None,
         }
     }
 }
@@ -106,6 +134,37 @@ impl Config {
                         i += 1;
                     }
                 }
+                "--scan-threads" => {
+                    if let Some(threads) = args.get(i + 1) {
+                        if let Ok(parsed) = threads.parse() {
+                            config.scan_threads = Some(parsed);
+                        }
+                        i += 1;
+                    }
+                }
+                "--no-io-uring" => {
+                    config.io_uring = false;
+                }
+                "--net-backend" => {
+                    if let Some(name) = args.get(i + 1) {
+                        if let Some(backend) = NetworkBackend::parse(name) {
+                            config.net_backend = backend;
+                        }
+                        i += 1;
+                    }
+                }
+                "--endpoint-rules" => {
+                    if let Some(path) = args.get(i + 1) {
+                        config.endpoint_rules = Some(PathBuf::from(path));
+                        i += 1;
+                    }
+                }
+                "--signatures-dir" => {
+                    if let Some(path) = args.get(i + 1) {
+                        config.signatures_dir = Some(PathBuf::from(path));
+                        i += 1;
+                    }
+                }
                 "--gen-protect-config" => {
                     config.gen_protect_config = true;
                 }
@@ -143,6 +202,26 @@ impl Config {
             config.protect_config = Some(PathBuf::from(path));
         }
 
+        if let Ok(threads) = std::env::var("TUAI_SCAN_THREADS") {
+            if let Ok(parsed) = threads.parse() {
+                config.scan_threads = Some(parsed);
+            }
+        }
+
+        if let Ok(name) = std::env::var("TUAI_NET_BACKEND") {
+            if let Some(backend) = NetworkBackend::parse(&name) {
+                config.net_backend = backend;
+            }
+        }
+
+        if let Ok(path) = std::env::var("TUAI_ENDPOINT_RULES") {
+            config.endpoint_rules = Some(PathBuf::from(path));
+        }
+
+        if let Ok(path) = std::env::var("TUAI_SIGNATURES_DIR") {
+            config.signatures_dir = Some(PathBuf::from(path));
+        }
+
         config
     }
 }
@@ -162,7 +241,12 @@ fn print_help() {
     println!();
     println!("OPTIONS:");
     println!("    -l, --listen <ADDR>         Address to bind gRPC server (default: 127.0.0.1:50051)");
-    println!("    -p, --protect-config <FILE> Path to protection config (TOML)");
+    println!("    -p, --protect-config <FILE> Path to protection config (TOML), reloaded on change");
+    println!("    --scan-threads <N>          Threads per /proc sweep (default: CPUs, max 8)");
+    println!("    --no-io-uring               Read /proc with plain syscalls instead of io_uring");
+    println!("    --net-backend <NAME>        Network backend: auto, sock-diag, procfs (default: auto)");
+    println!("    --endpoint-rules <FILE>     Endpoint classification rules (TOML)");
+    println!("    --signatures-dir <DIR>      Agent signature packs (YAML/TOML), reloaded on change");
     println!("    --gen-protect-config        Generate example protection config and exit");
     println!("    -h, --help                  Print this help message");
     println!();
@@ -179,6 +263,10 @@ fn print_help() {
     println!("    TUAI_RETENTION_HOURS    Data retention period in hours");
     println!("    TUAI_LOG_LEVEL          Log level (trace, debug, info, warn, error)");
     println!("    TUAI_PROTECT_CONFIG     Protection config file path");
+    println!("    TUAI_SCAN_THREADS       Threads per /proc sweep");
+    println!("    TUAI_NET_BACKEND        Network backend (auto, sock-diag, procfs)");
+    println!("    TUAI_ENDPOINT_RULES     Path to endpoint classification rules");
+    println!("    TUAI_SIGNATURES_DIR     Directory of agent signature packs");
     println!();
     println!("EXAMPLES:");
     println!("    tuai                                # Run with TUI (default)");
@@ -202,11 +290,12 @@ async fn main() -> Result<()> {
     let tui_mode = !config.server_mode && !config.show_events;
 
     // Load protection config if specified
-    let protection_config = if let Some(ref path) = config.protect_config {
-        match protection::ProtectionConfig::from_file(path) {
-            Ok(cfg) => {
-                eprintln!("Loaded protection config from {:?} ({} items)", path, cfg.protected_count());
-                Some(cfg)
+    // The TUI reloads it when the file changes
+    let protection = if let Some(ref path) = config.protect_config {
+        match protection::ProtectionStore::from_file(path.clone()) {
+            Ok(store) => {
+                eprintln!("Loaded protection config from {:?} ({} items)", path, store.load().protected_count());
+                Some(Arc::new(store))
             }
             Err(e) => {
                 eprintln!("Error loading protection config: {}", e);
@@ -216,7 +305,7 @@ async fn main() -> Result<()> {
     } else {
         // Use default protection in TUI mode
         if tui_mode {
-            Some(protection::ProtectionConfig::default())
+            Some(Arc::new(protection::ProtectionStore::new(protection::ProtectionConfig::default())))
         } else {
             None
         }
@@ -239,6 +328,11 @@ async fn main() -> Result<()> {
         }
     }
 
+    if let Some(threads) = config.scan_threads {
+        procfs::set_thread_budget(threads);
+    }
+    procfs::set_io_uring(config.io_uring);
+
     // Initialize storage
     let storage_config = StorageConfig {
         db_path: config.db_path.map(|p| p.to_string_lossy().to_string()),
@@ -253,48 +347,63 @@ async fn main() -> Result<()> {
         tracing::info!("Storage initialized");
     }
 
-    // Create agent state
-    let state = Arc::new(RwLock::new(AgentState::new(storage.clone())));
-
     // Start process monitor
-    {
-        let mut state_lock = state.write();
-        state_lock
-            .monitor
-            .start()
-            .context("Failed to start process monitor")?;
-    }
+    let mut monitor = ProcessMonitorService::new();
+    monitor.start().context("Failed to start process monitor")?;
     if !tui_mode {
         tracing::info!("Process monitor started");
     }
 
-    // Scan existing processes for AI agents
-    {
-        let state_lock = state.read();
-        state_lock.scan_existing_processes();
-    }
-
     // Start network monitor
-    {
-        let mut state_lock = state.write();
-        if let Err(e) = state_lock.network_monitor.start() {
-            if !tui_mode {
-                tracing::warn!("Network monitor failed to start: {} (continuing without it)", e);
+    let mut network_monitor = NetworkMonitorService::with_backend(config.net_backend);
+    if let Some(ref path) = config.endpoint_rules {
+        match EndpointRules::from_file(path).and_then(|rules| EndpointClassifier::new(&rules)) {
+            Ok(classifier) => network_monitor.set_classifier(classifier),
+            Err(e) => {
+                eprintln!("Error loading endpoint rules: {}", e);
+                std::process::exit(1);
             }
-        } else if !tui_mode {
-            tracing::info!("Network monitor started");
         }
     }
+    if let Err(e) = network_monitor.start() {
+        if !tui_mode {
+            tracing::warn!("Network monitor failed to start: {} (continuing without it)", e);
+        }
+    } else if !tui_mode {
+        tracing::info!("Network monitor started ({})", network_monitor.backend_name());
+    }
 
     // Start file monitor
-    {
-        let mut state_lock = state.write();
-        if let Err(e) = state_lock.file_monitor.start() {
-            if !tui_mode {
-                tracing::warn!("File monitor failed to start: {} (continuing without it)", e);
+    let mut file_monitor = FileMonitorService::new();
+    if let Err(e) = file_monitor.start() {
+        if !tui_mode {
+            tracing::warn!("File monitor failed to start: {} (continuing without it)", e);
+        }
+    } else if !tui_mode {
+        tracing::info!("File monitor started");
+    }
+
+    // Create agent state; the sampler thread owns the monitors from here on
+    let signatures = match config.signatures_dir {
+        Some(ref dir) => match SignatureStore::with_dir(dir.clone()) {
+            Ok(store) => store,
+            Err(e) => {
+                eprintln!("Error loading signature packs: {}", e);
+                std::process::exit(1);
             }
-        } else if !tui_mode {
-            tracing::info!("File monitor started");
+        },
+        None => SignatureStore::builtin(),
+    };
+    let sampler = Sampler::new(monitor, network_monitor, file_monitor);
+    let state = Arc::new(AgentState::new(storage.clone(), sampler, Arc::new(signatures)));
+
+    // One collection engine feeds every consumer below; it takes in the
+    // existing processes before returning
+    state.spawn_collector();
+    state.scan_existing_processes();
+    if let Err(e) = spawn_storage_writer(&state) {
+        if !tui_mode {
+            tracing::warn!("Storage writer failed to start: {} (continuing without it)", e);
         }
     }
 
@@ -325,87 +434,83 @@ async fn main() -> Result<()> {
     }
 
     // Default: TUI mode
-    tui::run_tui(state, protection_config)
+    tui::run_tui(state, protection)
         .await
         .map_err(|e| anyhow::anyhow!("TUI error: {}", e))
 }
 
-/// Start background tasks to stream events to stdout
-fn start_event_streaming(state: Arc<RwLock<AgentState>>) {
-    println!("\nLive event streaming enabled. Showing events for tracked AI agents...\n");
+/// Persist collected telemetry on a dedicated thread
+///
+/// DuckDB calls block, so they stay off the async runtime.
+fn spawn_storage_writer(state: &Arc<AgentState>) -> std::io::Result<()> {
+    let mut events = state.telemetry.subscribe();
+    let storage = state.storage.clone();
+    for agent in state.telemetry.agents() {
+        if let Err(e) = storage.insert_process(&agent) {
+            tracing::debug!("Failed to store process {}: {}", agent.pid, e);
+        }
+    }
 
-    // Get the tracked AI agent PIDs and their info
-    let tracked_pids: Arc<RwLock<HashSet<u32>>> = Arc::new(RwLock::new(HashSet::new()));
-    let known_processes: Arc<RwLock<HashMap<u32, String>>> = Arc::new(RwLock::new(HashMap::new()));
-    let known_connections: Arc<RwLock<HashSet<(u32, String, u16)>>> = Arc::new(RwLock::new(HashSet::new()));
-    let known_files: Arc<RwLock<HashSet<(u32, String)>>> = Arc::new(RwLock::new(HashSet::new()));
-
-    // Populate initial tracked PIDs
-    {
-        let state_lock = state.read();
-        if let Ok(processes) = state_lock.monitor.snapshot() {
-            let mut pids = tracked_pids.write();
-            let mut known = known_processes.write();
-            for process in &processes {
-                if state_lock.signature_matcher.match_process(process).is_some() {
-                    pids.insert(process.pid);
+    std::thread::Builder::new()
+        .name("tuai-storage".to_string())
+        .spawn(move || loop {
+            match events.blocking_recv() {
+                Ok(event) => {
+                    if let Err(e) = storage.record_event(&event) {
+                        tracing::debug!("Failed to store event: {}", e);
+                    }
                 }
-                known.insert(process.pid, process.name.clone());
+                Err(RecvError::Lagged(n)) => tracing::warn!("Storage writer dropped {} events", n),
+                Err(RecvError::Closed) => break,
             }
-            println!("Tracking {} AI agent processes (polling every 500ms)\n", pids.len());
-        }
+        })?;
+    Ok(())
+}
+
+/// Print collected events for tracked AI agents to stdout
+fn start_event_streaming(state: Arc<AgentState>) {
+    println!("\nLive event streaming enabled. Showing events for tracked AI agents...\n");
+
+    let mut events = state.telemetry.subscribe();
+
+    // Display names of agents and their descendants, for NET/FILE lines
+    let mut names: HashMap<u32, String> = HashMap::new();
+    let mut tracked_pids: HashSet<u32> = HashSet::new();
+    for agent in state.telemetry.agents() {
+        tracked_pids.insert(agent.pid);
+        names.insert(agent.pid, display_name(&agent));
     }
+    println!("Tracking {} AI agent processes (polling every 500ms)\n", tracked_pids.len());
 
-    // Spawn polling task for process changes
-    let tracked_pids_clone = tracked_pids.clone();
-    let known_processes_clone = known_processes.clone();
-    let state_clone = state.clone();
     tokio::spawn(async move {
-        let mut interval = tokio::time::interval(std::time::Duration::from_millis(500));
         loop {
-            interval.tick().await;
-
-            let state_lock = state_clone.read();
-            if let Ok(processes) = state_lock.monitor.snapshot() {
-                let mut pids = tracked_pids_clone.write();
-                let mut known = known_processes_clone.write();
-                let current_pids: HashSet<u32> = processes.iter().map(|p| p.pid).collect();
-
-                // Check for new processes
-                for process in &processes {
-                    if !known.contains_key(&process.pid) {
-                        let is_agent = state_lock.signature_matcher.match_process(process).is_some();
-                        let agent_type = state_lock.signature_matcher.match_process(process);
-                        if is_agent {
-                            pids.insert(process.pid);
-                        }
-
-                        // Check if parent is tracked
-                        let parent_tracked = process.ppid.map(|p| pids.contains(&p)).unwrap_or(false);
-
-                        if is_agent || parent_tracked || pids.contains(&process.pid) {
-                            let timestamp = Local::now().format("%H:%M:%S%.3f");
-
-                            // Get a display name - use agent type if detected, otherwise process name
-                            // Handle weird names like version numbers (e.g., "2.1.7" from Bun)
-                            let display_name = if let Some(agent) = &agent_type {
-                                agent.to_string()
-                            } else if process.name.chars().all(|c| c.is_ascii_digit() || c == '.') {
-                                // Name looks like a version number, try to get from cmdline
-                                process.cmdline.as_ref()
-                                    .and_then(|c| c.split_whitespace().next())
-                                    .and_then(|s| s.rsplit('/').next())
-                                    .unwrap_or(&process.name)
-                                    .to_string()
-                            } else {
-                                process.name.clone()
-                            };
+            let event = match events.recv().await {
+                Ok(event) => event,
+                Err(RecvError::Lagged(_)) => continue,
+                Err(RecvError::Closed) => break,
+            };
+            let timestamp = Local::now().format("%H:%M:%S%.3f");
+
+            match event {
+                TelemetryEvent::Process(event) => {
+                    let process = &event.process;
+                    match event.event_type {
+                        ProcessEventType::Spawn => {
+                            let name = display_name(process);
+                            let is_agent = process.agent_type.is_some();
+                            if is_agent {
+                                tracked_pids.insert(process.pid);
+                            }
 
                             let cmdline_display = process.cmdline.as_deref().unwrap_or("");
-                            let agent_marker = if is_agent { " [AI]" } else { "" };
+                            let agent_marker = match (is_agent, process.agent_confidence) {
+                                (true, Some(MatchConfidence::Low)) => " [AI?]",
+                                (true, _) => " [AI]",
+                                (false, _) => "",
+                            };
 
                             // Don't repeat the name in cmdline if they're the same
-                            let cmdline_show = if cmdline_display == display_name || cmdline_display.is_empty() {
+                            let cmdline_show = if cmdline_display == name || cmdline_display.is_empty() {
                                 "".to_string()
                             } else {
                                 format!(" {}", cmdline_display)
@@ -413,133 +518,70 @@ fn start_event_streaming(state: Arc<RwLock<AgentState>>) {
 
                             println!(
                                 "[{}] SPAWN PID:{} {}{}{}",
-                                timestamp,
-                                process.pid,
-                                display_name,
-                                cmdline_show,
-                                agent_marker
+                                timestamp, process.pid, name, cmdline_show, agent_marker
                             );
+                            names.insert(process.pid, name);
                         }
-                        // Store the better display name for later use in FILE/NET events
-                        let stored_name = if let Some(agent) = &agent_type {
-                            agent.to_string()
-                        } else if process.name.chars().all(|c| c.is_ascii_digit() || c == '.') {
-                            process.cmdline.as_ref()
-                                .and_then(|c| c.split_whitespace().next())
-                                .and_then(|s| s.rsplit('/').next())
-                                .unwrap_or(&process.name)
-                                .to_string()
-                        } else {
-                            process.name.clone()
-                        };
-                        known.insert(process.pid, stored_name);
-                    }
-                }
-
-                // Check for exited processes
-                let exited: Vec<(u32, String)> = known.iter()
-                    .filter(|(pid, _)| !current_pids.contains(pid))
-                    .map(|(pid, name)| (*pid, name.clone()))
-                    .collect();
-
-                for (pid, name) in exited {
-                    if pids.contains(&pid) {
-                        let timestamp = Local::now().format("%H:%M:%S%.3f");
-                        println!("[{}] EXIT  PID:{} {}", timestamp, pid, name);
-                        info!("No longer tracking AI agent: {} (PID: {})", name, pid);
-                        pids.remove(&pid);
-                    }
-                    known.remove(&pid);
-                }
-            }
-            drop(state_lock);
-        }
-    });
-
-    // Spawn polling task for network connections
-    let tracked_pids_clone = tracked_pids.clone();
-    let known_connections_clone = known_connections.clone();
-    let known_processes_clone1 = known_processes.clone();
-    let state_clone = state.clone();
-    tokio::spawn(async move {
-        let mut interval = tokio::time::interval(std::time::Duration::from_millis(1000));
-        loop {
-            interval.tick().await;
-
-            let state_lock = state_clone.read();
-            if let Ok(connections) = state_lock.network_monitor.snapshot() {
-                let pids = tracked_pids_clone.read();
-                let mut known = known_connections_clone.write();
-                let processes = known_processes_clone1.read();
-
-                for conn in &connections {
-                    if pids.contains(&conn.pid) {
-                        let remote_addr = conn.remote_addr.as_deref().unwrap_or("").to_string();
-                        let remote_port = conn.remote_port.unwrap_or(0);
-                        let key = (conn.pid, remote_addr.clone(), remote_port);
-
-                        if !known.contains(&key) && !remote_addr.is_empty() && remote_port > 0 {
-                            known.insert(key);
-                            let timestamp = Local::now().format("%H:%M:%S%.3f");
-                            let proc_name = processes.get(&conn.pid).map(|s| s.as_str()).unwrap_or("?");
-                            let local_addr = conn.local_addr.as_deref().unwrap_or("?");
-                            let local_port = conn.local_port.map(|p| p.to_string()).unwrap_or_else(|| "?".to_string());
-                            println!(
-                                "[{}] NET   PID:{} {} {:?} {}:{} -> {}:{}",
-                                timestamp,
-                                conn.pid,
-                                proc_name,
-                                conn.protocol,
-                                local_addr,
-                                local_port,
-                                remote_addr,
-                                remote_port
-                            );
+                        ProcessEventType::Exit => {
+                            let name = names.remove(&process.pid).unwrap_or_else(|| display_name(process));
+                            if tracked_pids.remove(&process.pid) {
+                                println!("[{}] EXIT  PID:{} {}", timestamp, process.pid, name);
+                                info!("No longer tracking AI agent: {} (PID: {})", name, process.pid);
+                            }
                         }
+                        ProcessEventType::Update => {}
                     }
                 }
-            }
-            drop(state_lock);
-        }
-    });
-
-    // Spawn polling task for file operations
-    let tracked_pids_clone = tracked_pids.clone();
-    let known_files_clone = known_files.clone();
-    let known_processes_clone2 = known_processes.clone();
-    let state_clone = state.clone();
-    tokio::spawn(async move {
-        let mut interval = tokio::time::interval(std::time::Duration::from_millis(1000));
-        loop {
-            interval.tick().await;
-
-            let state_lock = state_clone.read();
-            if let Ok(files) = state_lock.file_monitor.snapshot() {
-                let pids = tracked_pids_clone.read();
-                let mut known = known_files_clone.write();
-                let processes = known_processes_clone2.read();
-
-                for file_op in &files {
-                    if pids.contains(&file_op.pid) {
-                        let key = (file_op.pid, file_op.path.clone());
-
-                        if !known.contains(&key) {
-                            known.insert(key);
-                            let timestamp = Local::now().format("%H:%M:%S%.3f");
-                            let proc_name = processes.get(&file_op.pid).map(|s| s.as_str()).unwrap_or("?");
-                            println!(
-                                "[{}] FILE  PID:{} {} {:?} {}",
-                                timestamp,
-                                file_op.pid,
-                                proc_name,
-                                file_op.operation,
-                                file_op.path
-                            );
+                TelemetryEvent::Connection(event) => {
+                    let conn = &event.connection;
+                    let proc_name = names.get(&conn.pid).map(|s| s.as_str()).unwrap_or("?");
+                    let local_addr = conn.local_addr.as_deref().unwrap_or("?");
+                    let local_port = conn.local_port.map(|p| p.to_string()).unwrap_or_else(|| "?".to_string());
+                    let suffix = match event.event_type {
+                        ConnectionEventType::Opened => String::new(),
+                        ConnectionEventType::StateChanged => format!(
+                            " {:?} -> {:?}",
+                            event.previous_state.as_ref().unwrap_or(&conn.state),
+                            conn.state
+                        ),
+                        ConnectionEventType::Closed => {
+                            format!(" closed after {}ms", event.duration_ms.unwrap_or(0))
                         }
-                    }
+                    };
+                    println!(
+                        "[{}] NET   PID:{} {} {:?} {}:{} -> {}:{}{}",
+                        timestamp,
+                        conn.pid,
+                        proc_name,
+                        conn.protocol,
+                        local_addr,
+                        local_port,
+                        conn.remote_addr.as_deref().unwrap_or(""),
+                        conn.remote_port.unwrap_or(0),
+                        suffix
+                    );
+                }
+                TelemetryEvent::FileOp(file_op) => {
+                    let proc_name = names.get(&file_op.pid).map(|s| s.as_str()).unwrap_or("?");
+                    println!(
+                        "[{}] FILE  PID:{} {} {:?} {}",
+                        timestamp, file_op.pid, proc_name, file_op.operation, file_op.path
+                    );
+                }
+                TelemetryEvent::EndpointViolation(violation) => {
+                    let conn = &violation.connection;
+                    let proc_name = names.get(&conn.pid).map(|s| s.as_str()).unwrap_or("?");
+                    println!(
+                        "[{}] ALERT PID:{} {} unexpected endpoint {}:{} for {}",
+                        timestamp,
+                        conn.pid,
+                        proc_name,
+                        conn.remote_addr.as_deref().unwrap_or(""),
+                        conn.remote_port.unwrap_or(0),
+                        violation.agent_type
+                    );
                 }
             }
-            drop(state_lock);
         }
     });
 }
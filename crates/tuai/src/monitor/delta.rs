@@ -0,0 +1,272 @@
+//! Generation-numbered process deltas
+//!
+//! Backends bump a generation number whenever the process table changes
+//! and keep a bounded log of which PIDs changed in which generation.
+//! Consumers remember the generation they last saw and ask for
+//! `changes_since(generation)`, so each poll costs time proportional to
+//! process churn instead of copying and re-diffing the whole table.
+//!
+//! A consumer that falls further behind than the log reaches (or passes
+//! generation 0) gets a full resync instead.
+
+use std::collections::{HashMap, VecDeque};
+
+use tuai_common::ProcessInfo;
+
+/// Number of change records kept before old generations are forgotten
+const DEFAULT_LOG_CAPACITY: usize = 16 * 1024;
+
+/// Changes to the process table between two generations
+#[derive(Debug, Clone, Default)]
+pub struct ProcessDelta {
+    /// Generation the delta brings the consumer up to
+    pub generation: u64,
+    /// `added` holds the complete table; drop all local state first
+    pub full_resync: bool,
+    /// Processes that appeared (apply after `removed`)
+    pub added: Vec<ProcessInfo>,
+    /// Known processes whose fields changed
+    pub updated: Vec<ProcessInfo>,
+    /// PIDs that exited (or were reused, in which case they are also in `added`)
+    pub removed: Vec<u32>,
+}
+
+impl ProcessDelta {
+    /// A delta that replaces all consumer state with `processes`
+    pub fn full(generation: u64, processes: Vec<ProcessInfo>) -> Self {
+        Self {
+            generation,
+            full_resync: true,
+            added: processes,
+            updated: Vec::new(),
+            removed: Vec::new(),
+        }
+    }
+
+    /// Whether the delta carries no changes
+    pub fn is_empty(&self) -> bool {
+        !self.full_resync && self.added.is_empty() && self.updated.is_empty() && self.removed.is_empty()
+    }
+
+    /// Combine consecutive deltas into one
+    ///
+    /// `deltas` must be in generation order and contiguous. A full resync
+    /// anywhere in the chain makes the result one as well, in which case
+    /// the caller should fall back to a full listing.
+    pub fn merge<'a, I>(deltas: I) -> Self
+    where
+        I: IntoIterator<Item = &'a ProcessDelta>,
+    {
+        #[derive(Default)]
+        struct Entry {
+            removed: bool,
+            added: Option<ProcessInfo>,
+            updated: Option<ProcessInfo>,
+        }
+
+        fn entry<'e>(
+            entries: &'e mut HashMap<u32, Entry>,
+            order: &mut Vec<u32>,
+            pid: u32,
+        ) -> &'e mut Entry {
+            entries.entry(pid).or_insert_with(|| {
+                order.push(pid);
+                Entry::default()
+            })
+        }
+
+        let mut merged = Self::default();
+        let mut entries: HashMap<u32, Entry> = HashMap::new();
+        let mut order = Vec::new();
+
+        for delta in deltas {
+            merged.generation = delta.generation;
+            merged.full_resync |= delta.full_resync;
+
+            for pid in &delta.removed {
+                let e = entry(&mut entries, &mut order, *pid);
+                e.removed = true;
+                e.added = None;
+                e.updated = None;
+            }
+            for process in &delta.added {
+                let e = entry(&mut entries, &mut order, process.pid);
+                e.added = Some(process.clone());
+                e.updated = None;
+            }
+            for process in &delta.updated {
+                let e = entry(&mut entries, &mut order, process.pid);
+                if e.added.is_some() {
+                    e.added = Some(process.clone());
+                } else {
+                    e.updated = Some(process.clone());
+                }
+            }
+        }
+
+        for pid in order {
+            let e = entries.remove(&pid).expect("recorded above");
+            if e.removed {
+                merged.removed.push(pid);
+            }
+            if let Some(process) = e.added {
+                merged.added.push(process);
+            } else if let Some(process) = e.updated {
+                merged.updated.push(process);
+            }
+        }
+
+        merged
+    }
+
+    /// Apply the delta to a consumer-side process map
+    pub fn apply_to(&self, processes: &mut HashMap<u32, ProcessInfo>) {
+        if self.full_resync {
+            processes.clear();
+        }
+        for pid in &self.removed {
+            processes.remove(pid);
+        }
+        for process in self.added.iter().chain(&self.updated) {
+            processes.insert(process.pid, process.clone());
+        }
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum ChangeKind {
+    Added,
+    Updated,
+    Removed,
+}
+
+/// Bounded log of per-generation process table changes
+#[derive(Debug)]
+pub struct ChangeLog {
+    /// Last published generation
+    generation: u64,
+    /// Whether changes were recorded since the last publish
+    dirty: bool,
+    log: VecDeque<(u64, u32, ChangeKind)>,
+    /// Highest generation whose records were trimmed
+    floor: u64,
+    capacity: usize,
+}
+
+impl ChangeLog {
+    /// Create an empty change log
+    pub fn new() -> Self {
+        Self::with_capacity(DEFAULT_LOG_CAPACITY)
+    }
+
+    /// Create a change log that keeps at most `capacity` records
+    pub fn with_capacity(capacity: usize) -> Self {
+        Self {
+            generation: 0,
+            dirty: false,
+            log: VecDeque::new(),
+            floor: 0,
+            capacity: capacity.max(1),
+        }
+    }
+
+    /// Last published generation
+    pub fn generation(&self) -> u64 {
+        self.generation
+    }
+
+    /// Record a newly seen process
+    pub fn added(&mut self, pid: u32) {
+        self.record(pid, ChangeKind::Added);
+    }
+
+    /// Record a change to a known process
+    pub fn updated(&mut self, pid: u32) {
+        self.record(pid, ChangeKind::Updated);
+    }
+
+    /// Record an exited process
+    pub fn removed(&mut self, pid: u32) {
+        self.record(pid, ChangeKind::Removed);
+    }
+
+    /// Publish recorded changes as a new generation
+    ///
+    /// Call once per refresh (or per event); does nothing if nothing changed.
+    pub fn publish(&mut self) -> u64 {
+        if self.dirty {
+            self.generation += 1;
+            self.dirty = false;
+        }
+        self.generation
+    }
+
+    /// Build the delta from `since` to the current generation
+    ///
+    /// `lookup` resolves a PID against the current table and `all` lists it
+    /// in full when a resync is needed.
+    pub fn changes_since<L, A>(&self, since: u64, lookup: L, all: A) -> ProcessDelta
+    where
+        L: Fn(u32) -> Option<ProcessInfo>,
+        A: FnOnce() -> Vec<ProcessInfo>,
+    {
+        // Unknown history (first call, trimmed log, or another monitor instance)
+        if since == 0 || since < self.floor || since > self.generation {
+            return ProcessDelta::full(self.generation, all());
+        }
+
+        let mut delta = ProcessDelta {
+            generation: self.generation,
+            ..Default::default()
+        };
+        if since == self.generation {
+            return delta;
+        }
+
+        // Records are in generation order; skip what the consumer has seen
+        let start = self.log.partition_point(|(generation, _, _)| *generation <= since);
+        let mut touched: HashMap<u32, (bool, bool)> = HashMap::new();
+        for (generation, pid, kind) in self.log.range(start..) {
+            if *generation > self.generation {
+                break; // recorded but not yet published
+            }
+            let (added, removed) = touched.entry(*pid).or_default();
+            match kind {
+                ChangeKind::Added => *added = true,
+                ChangeKind::Removed => *removed = true,
+                ChangeKind::Updated => {}
+            }
+        }
+
+        for (pid, (added, removed)) in touched {
+            match lookup(pid) {
+                Some(process) if added => {
+                    if removed {
+                        delta.removed.push(pid);
+                    }
+                    delta.added.push(process);
+                }
+                Some(process) => delta.updated.push(process),
+                None => delta.removed.push(pid),
+            }
+        }
+
+        delta
+    }
+
+    fn record(&mut self, pid: u32, kind: ChangeKind) {
+        self.dirty = true;
+        self.log.push_back((self.generation + 1, pid, kind));
+        while self.log.len() > self.capacity {
+            if let Some((generation, _, _)) = self.log.pop_front() {
+                self.floor = self.floor.max(generation);
+            }
+        }
+    }
+}
+
+impl Default for ChangeLog {
+    fn default() -> Self {
+        Self::new()
+    }
+}
@@ -13,28 +13,36 @@
 //!
 //! This module is only compiled when the ebpf_available cfg flag is set by build.rs,
 //! which happens when vmlinux.h is present and the BPF program compiles successfully.
+//!
+//! Protected files are mirrored by device and inode into the
+//! `protected_inodes` map (see [`set_protected_inodes`]), so the kernel
+//! reports opens of them however the path was spelled. Only processes
+//! in the `tracked_pids` map, kept in line with the attribution set by
+//! the collector, are checked. Reported opens are handed to the sampler
+//! as file operations. That hook needs fentry support; without it the
+//! monitor runs with the tracepoints alone.
 
 #![cfg(all(target_os = "linux", ebpf_available))]
 
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::mem::MaybeUninit;
-use std::path::Path;
-use std::sync::Arc;
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, OnceLock};
 use std::time::Duration;
 
 use chrono::DateTime;
 use libbpf_rs::{
     skel::{OpenSkel, Skel, SkelBuilder},
-    RingBufferBuilder, OpenObject,
+    MapCore, MapFlags, MapHandle, RingBufferBuilder, OpenObject,
 };
-use parking_lot::RwLock;
+use parking_lot::{Mutex, RwLock};
 use thiserror::Error;
 use tokio::sync::broadcast;
 use tracing::{debug, error, info, warn};
 use uuid::Uuid;
 
 use tuai_common::events::ProcessInfo;
-use tuai_common::{ProcessEvent, ProcessEventType};
+use tuai_common::{FileId, FileOpInfo, ProcessEvent, ProcessEventType};
 use sysinfo::{ProcessRefreshKind, ProcessesToUpdate, System, UpdateKind};
 
 // Include generated skeleton
@@ -49,6 +57,10 @@ const EVENT_PROCESS_EXEC: u32 = 1;
 const EVENT_PROCESS_EXIT: u32 = 2;
 const EVENT_NETWORK_CONNECT: u32 = 3;
 const EVENT_FILE_OPEN: u32 = 4;
+const EVENT_PROTECTED_OPEN: u32 = 5;
+
+/// Protected opens kept until the sampler takes them
+const MAX_PENDING_OPENS: usize = 1024;
 
 /// Address families
 const AF_UNIX: u16 = 1;
@@ -97,6 +109,8 @@ struct BpfFileEvent {
     path: [u8; 256],
     flags: i32,
     dirfd: i32,
+    dev: u64,
+    ino: u64,
 }
 
 /// Errors from eBPF monitor
@@ -114,11 +128,127 @@ pub enum EbpfError {
     InsufficientPrivileges,
 }
 
+/// Protected files mirrored into the `protected_inodes` map
+#[derive(Default)]
+struct ProtectedMirror {
+    /// Kernel (dev, ino) -> the file as stat sees it, and the path it was
+    /// resolved from
+    files: HashMap<(u64, u64), (FileId, PathBuf)>,
+    /// The map, once the BPF program is loaded
+    map: Option<MapHandle>,
+}
+
+impl ProtectedMirror {
+    /// Make the map hold exactly `files`
+    fn sync(&self) {
+        let Some(map) = &self.map else {
+            return;
+        };
+        let stale: Vec<Vec<u8>> = map
+            .keys()
+            .filter(|key| decode_key(key).map_or(true, |key| !self.files.contains_key(&key)))
+            .collect();
+        for key in stale {
+            let _ = map.delete(&key);
+        }
+        for &key in self.files.keys() {
+            if let Err(e) = map.update(&encode_key(key), &[1], MapFlags::ANY) {
+                warn!("Failed to mirror protected inodes: {}", e);
+                return;
+            }
+        }
+        debug!("Mirrored {} protected inodes into BPF map", self.files.len());
+    }
+}
+
+fn protected_mirror() -> &'static Mutex<ProtectedMirror> {
+    static MIRROR: OnceLock<Mutex<ProtectedMirror>> = OnceLock::new();
+    MIRROR.get_or_init(Default::default)
+}
+
+/// Replace the protected files matched in the kernel
+///
+/// Takes effect right away when the eBPF monitor is running, otherwise
+/// once it starts.
+pub fn set_protected_inodes<'a>(files: impl IntoIterator<Item = (FileId, &'a Path)>) {
+    let mut mirror = protected_mirror().lock();
+    mirror.files = files
+        .into_iter()
+        .map(|(id, path)| (kernel_key(id), (id, path.to_path_buf())))
+        .collect();
+    mirror.sync();
+}
+
+/// Processes mirrored into the `tracked_pids` map
+///
+/// The kernel adds children that exec and removes processes that exit on
+/// its own; only the entries written from here are removed from here.
+#[derive(Default)]
+struct TrackedMirror {
+    pids: HashSet<u32>,
+    /// The map, once the BPF program is loaded
+    map: Option<MapHandle>,
+}
+
+impl TrackedMirror {
+    fn attach(&mut self, map: MapHandle) {
+        for pid in &self.pids {
+            Self::insert(&map, *pid);
+        }
+        self.map = Some(map);
+    }
+
+    /// Make the map hold `pids`, writing only the difference
+    fn set(&mut self, pids: HashSet<u32>) {
+        if let Some(map) = &self.map {
+            for pid in self.pids.difference(&pids) {
+                let _ = map.delete(&pid.to_ne_bytes());
+            }
+            for pid in pids.difference(&self.pids) {
+                Self::insert(map, *pid);
+            }
+        }
+        self.pids = pids;
+    }
+
+    fn insert(map: &MapHandle, pid: u32) {
+        if let Err(e) = map.update(&pid.to_ne_bytes(), &[1], MapFlags::ANY) {
+            debug!("Failed to track PID {} in BPF map: {}", pid, e);
+        }
+    }
+}
+
+/// Key as the kernel sees it: stat's st_dev uses the glibc encoding, the
+/// kernel's s_dev is `major << 20 | minor`
+fn kernel_key(id: FileId) -> (u64, u64) {
+    let major = ((id.dev >> 32) & 0xffff_f000) | ((id.dev >> 8) & 0xfff);
+    let minor = ((id.dev >> 12) & 0xffff_ff00) | (id.dev & 0xff);
+    ((major << 20) | minor, id.ino)
+}
+
+/// struct inode_key { u64 dev; u64 ino; }
+fn encode_key((dev, ino): (u64, u64)) -> [u8; 16] {
+    let mut key = [0; 16];
+    key[..8].copy_from_slice(&dev.to_ne_bytes());
+    key[8..].copy_from_slice(&ino.to_ne_bytes());
+    key
+}
+
+fn decode_key(key: &[u8]) -> Option<(u64, u64)> {
+    let dev = u64::from_ne_bytes(key.get(..8)?.try_into().ok()?);
+    let ino = u64::from_ne_bytes(key.get(8..16)?.try_into().ok()?);
+    Some((dev, ino))
+}
+
 /// eBPF-based process monitor
 pub struct EbpfProcessMonitor {
     running: bool,
     processes: Arc<RwLock<HashMap<u32, ProcessInfo>>>,
     event_tx: broadcast::Sender<ProcessEvent>,
+    /// Processes whose protected opens the kernel reports
+    tracked: Mutex<TrackedMirror>,
+    /// Protected opens reported since the sampler last took them
+    protected_opens: Arc<Mutex<Vec<FileOpInfo>>>,
 }
 
 impl EbpfProcessMonitor {
@@ -130,6 +260,8 @@ impl EbpfProcessMonitor {
             running: false,
             processes: Arc::new(RwLock::new(HashMap::new())),
             event_tx,
+            tracked: Mutex::new(TrackedMirror::default()),
+            protected_opens: Arc::new(Mutex::new(Vec::new())),
         }
     }
 
@@ -156,21 +288,47 @@ impl EbpfProcessMonitor {
 
         info!("Starting eBPF process monitor");
 
-        // Open and load BPF skeleton
-        // We leak the open_object to give it 'static lifetime since the skel is moved to a thread
-        let skel_builder = ProcessMonitorSkelBuilder::default();
-        let open_object: &'static mut MaybeUninit<OpenObject> = Box::leak(Box::new(MaybeUninit::uninit()));
-        let open_skel = skel_builder
-            .open(open_object)
-            .map_err(|e| EbpfError::LoadFailed(e.to_string()))?;
+        // The protected open hook is fentry based, which older kernels and
+        // some configurations lack; load without it rather than not at all
+        let (mut skel, mut protected_opens) = match Self::load_skel(true) {
+            Ok(skel) => (skel, true),
+            Err(e) => {
+                warn!("Protected file opens will not be reported by the kernel: {}", e);
+                (Self::load_skel(false)?, false)
+            }
+        };
 
-        let mut skel = open_skel
-            .load()
-            .map_err(|e| EbpfError::LoadFailed(e.to_string()))?;
+        // Attach BPF programs; only the protected open hook may fail
+        let attach_failed = |e: libbpf_rs::Error| EbpfError::AttachFailed(e.to_string());
+        skel.links.handle_exec = Some(skel.progs.handle_exec.attach().map_err(attach_failed)?);
+        skel.links.handle_exit = Some(skel.progs.handle_exit.attach().map_err(attach_failed)?);
+        skel.links.handle_connect = Some(skel.progs.handle_connect.attach().map_err(attach_failed)?);
+        skel.links.handle_openat = Some(skel.progs.handle_openat.attach().map_err(attach_failed)?);
+        if protected_opens {
+            match skel.progs.handle_file_open.attach() {
+                Ok(link) => skel.links.handle_file_open = Some(link),
+                Err(e) => {
+                    warn!("Protected file opens will not be reported by the kernel: {}", e);
+                    protected_opens = false;
+                }
+            }
+        }
 
-        // Attach BPF programs
-        skel.attach()
-            .map_err(|e| EbpfError::AttachFailed(e.to_string()))?;
+        // Fill the protected inode map with what was configured so far
+        match MapHandle::try_from(&skel.maps.protected_inodes) {
+            Ok(map) => {
+                let mut mirror = protected_mirror().lock();
+                mirror.map = Some(map);
+                mirror.sync();
+            }
+            Err(e) => warn!("Protected inode map unavailable: {}", e),
+        }
+        if protected_opens {
+            match MapHandle::try_from(&skel.maps.tracked_pids) {
+                Ok(map) => self.tracked.lock().attach(map),
+                Err(e) => warn!("Tracked PID map unavailable: {}", e),
+            }
+        }
 
         info!("eBPF programs attached successfully");
 
@@ -180,16 +338,34 @@ impl EbpfProcessMonitor {
         // Set up ring buffer polling
         let processes = self.processes.clone();
         let event_tx = self.event_tx.clone();
+        let protected_opens = self.protected_opens.clone();
 
         // Spawn polling task
         std::thread::spawn(move || {
-            Self::poll_events(skel, processes, event_tx);
+            Self::poll_events(skel, processes, event_tx, protected_opens);
         });
 
         self.running = true;
         Ok(())
     }
 
+    /// Open and load the BPF skeleton, with or without the fentry hook
+    ///
+    /// The open object is leaked to give the skeleton a 'static lifetime,
+    /// since it is moved to the polling thread.
+    fn load_skel(with_fentry: bool) -> Result<ProcessMonitorSkel<'static>, EbpfError> {
+        let open_object: &'static mut MaybeUninit<OpenObject> = Box::leak(Box::new(MaybeUninit::uninit()));
+        let mut open_skel = ProcessMonitorSkelBuilder::default()
+            .open(open_object)
+            .map_err(|e| EbpfError::LoadFailed(e.to_string()))?;
+        if !with_fentry {
+            let _ = open_skel.progs.handle_file_open.set_autoload(false);
+        }
+        open_skel
+            .load()
+            .map_err(|e| EbpfError::LoadFailed(e.to_string()))
+    }
+
     /// Scan existing processes using sysinfo to populate initial state
     fn scan_existing_processes(&self) {
         info!("Scanning existing processes for initial state...");
@@ -220,6 +396,7 @@ impl EbpfProcessMonitor {
                 cmdline: if cmdline.is_empty() { None } else { Some(cmdline) },
                 exe_path: proc.exe().map(|p| p.to_string_lossy().to_string()),
                 agent_type: None,
+                agent_confidence: None,
                 start_time: DateTime::from_timestamp(proc.start_time() as i64, 0)
                     .unwrap_or_default(),
                 end_time: None,
@@ -255,6 +432,7 @@ impl EbpfProcessMonitor {
         skel: ProcessMonitorSkel<'static>,
         processes: Arc<RwLock<HashMap<u32, ProcessInfo>>>,
         event_tx: broadcast::Sender<ProcessEvent>,
+        protected_opens: Arc<Mutex<Vec<FileOpInfo>>>,
     ) {
         // Process events callback
         let processes_clone = processes.clone();
@@ -289,7 +467,7 @@ impl EbpfProcessMonitor {
         };
 
         // File events callback
-        let file_event_callback = |data: &[u8]| {
+        let file_event_callback = move |data: &[u8]| {
             if data.len() < std::mem::size_of::<BpfFileEvent>() {
                 warn!("Received truncated BPF file event");
                 return 0;
@@ -299,7 +477,7 @@ impl EbpfProcessMonitor {
                 &*(data.as_ptr() as *const BpfFileEvent)
             };
 
-            Self::handle_file_event(event);
+            Self::handle_file_event(event, &protected_opens);
             0
         };
 
@@ -357,8 +535,25 @@ impl EbpfProcessMonitor {
     }
 
     /// Handle a file event from eBPF
-    fn handle_file_event(event: &BpfFileEvent) {
+    ///
+    /// Protected opens are queued for the sampler, which passes them on
+    /// with the other file operations.
+    fn handle_file_event(event: &BpfFileEvent, protected_opens: &Mutex<Vec<FileOpInfo>>) {
         let comm = cstr_to_string(&event.comm);
+
+        if event.event_type == EVENT_PROTECTED_OPEN {
+            let Some(file_op) = protected_open(event, &protected_mirror().lock().files) else {
+                // Unprotected since the kernel matched it
+                return;
+            };
+            debug!("BPF: Protected file open: {} (PID: {}) -> {}", comm, event.pid, file_op.path);
+            let mut pending = protected_opens.lock();
+            if pending.len() < MAX_PENDING_OPENS {
+                pending.push(file_op);
+            }
+            return;
+        }
+
         let path = cstr_to_string(&event.path);
 
         // Filter out common noise paths
@@ -397,6 +592,7 @@ impl EbpfProcessMonitor {
                     start_time: timestamp,
                     end_time: None,
                     agent_type: None,
+                    agent_confidence: None,
                 };
 
                 debug!("BPF: Process spawned: {} (PID: {})", comm, event.pid);
@@ -457,6 +653,25 @@ impl super::ProcessMonitorBackend for EbpfProcessMonitor {
     fn snapshot(&self) -> tuai_common::PlatformResult<Vec<tuai_common::ProcessInfo>> {
         Ok(self.snapshot())
     }
+
+    fn set_attribution(&self, attribution: &HashMap<u32, u32>) {
+        self.tracked.lock().set(attribution.keys().copied().collect());
+    }
+
+    fn take_file_ops(&self) -> Vec<FileOpInfo> {
+        std::mem::take(&mut *self.protected_opens.lock())
+    }
+}
+
+/// File operation for a protected open the kernel reported
+///
+/// `None` when the file is no longer protected.
+fn protected_open(event: &BpfFileEvent, files: &HashMap<(u64, u64), (FileId, PathBuf)>) -> Option<FileOpInfo> {
+    let (id, path) = files.get(&(event.dev, event.ino))?;
+    let operation = crate::file::ProcFdMonitor::operation_from_flags(event.flags as u32);
+    let mut file_op = FileOpInfo::new(event.pid, operation, path.display().to_string());
+    file_op.file_id = Some(*id);
+    Some(file_op)
 }
 
 /// Convert C string bytes to Rust String
@@ -489,6 +704,41 @@ fn has_bpf_capability() -> bool {
 mod tests {
     use super::*;
 
+    #[test]
+    fn test_kernel_key() {
+        // 8:1 (sda1) in glibc encoding is 0x801; the kernel uses 8 << 20 | 1
+        let id = FileId { dev: 0x801, ino: 42 };
+        assert_eq!(kernel_key(id), ((8 << 20) | 1, 42));
+        assert_eq!(decode_key(&encode_key(kernel_key(id))), Some(kernel_key(id)));
+    }
+
+    #[test]
+    fn test_protected_open() {
+        let id = FileId { dev: 0x801, ino: 42 };
+        let files = HashMap::from([(kernel_key(id), (id, PathBuf::from("/root/.ssh/id_rsa")))]);
+        let mut event = BpfFileEvent {
+            event_type: EVENT_PROTECTED_OPEN,
+            pid: 7,
+            uid: 0,
+            timestamp_ns: 0,
+            comm: [0; 256],
+            path: [0; 256],
+            flags: 0o2,
+            dirfd: -1,
+            dev: (8 << 20) | 1,
+            ino: 42,
+        };
+
+        let file_op = protected_open(&event, &files).unwrap();
+        assert_eq!(file_op.pid, 7);
+        assert_eq!(file_op.path, "/root/.ssh/id_rsa");
+        assert_eq!(file_op.file_id, Some(id));
+        assert_eq!(file_op.operation, tuai_common::FileOperation::Write);
+
+        event.ino = 43;
+        assert!(protected_open(&event, &files).is_none());
+    }
+
     #[test]
     fn test_cstr_to_string() {
         let bytes = b"hello\0world";
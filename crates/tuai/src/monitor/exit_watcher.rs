@@ -0,0 +1,180 @@
+//! pidfd-based exit notification for tracked agent processes
+//!
+//! Snapshot diffing only notices an exit on the next poll, and it needs a
+//! full process scan to do so. For the handful of processes we actually
+//! track, this module opens a pidfd (`pidfd_open(2)`, Linux 5.3+) per PID
+//! and registers it with the tokio reactor. The pidfd becomes readable as
+//! soon as the process terminates, and an Exit event is published right
+//! away.
+//!
+//! The pidfd is opened by `sync`, in the same call that decides to watch
+//! the PID, so it refers to the process that was tracked; only the wait
+//! runs on the reactor. Opening it later could pick up an unrelated
+//! process if the PID was recycled in the meantime.
+//!
+//! Each tracked PID reports its exit at most once. A PID that has already
+//! been reported is not watched again until it leaves the tracked set.
+//! Zombies still show up in /proc, so this matters when the tracked set is
+//! re-synced before the consumer has processed the exit.
+//!
+//! On other platforms, or without a tokio runtime, this is a no-op and
+//! exits are still picked up by snapshot diffing.
+
+use std::collections::HashMap;
+use std::sync::Arc;
+
+use parking_lot::Mutex;
+use tokio::sync::broadcast;
+use tuai_common::ProcessEvent;
+
+/// Watch state of a single PID
+enum WatchState {
+    /// A task is waiting on the pidfd
+    Watching(tokio::task::AbortHandle),
+    /// The exit was already reported
+    Exited,
+    /// pidfds are unavailable for this PID; left to snapshot diffing
+    Unwatchable,
+}
+
+/// Watches tracked PIDs for exit via pidfds
+pub struct ExitWatcher {
+    watched: Arc<Mutex<HashMap<u32, WatchState>>>,
+    event_tx: broadcast::Sender<ProcessEvent>,
+}
+
+impl ExitWatcher {
+    /// Create a watcher that publishes Exit events on `event_tx`
+    pub fn new(event_tx: broadcast::Sender<ProcessEvent>) -> Self {
+        Self {
+            watched: Arc::new(Mutex::new(HashMap::new())),
+            event_tx,
+        }
+    }
+
+    /// Make the watched set match `pids`
+    ///
+    /// New PIDs start being watched. PIDs that are no longer tracked have
+    /// their watch cancelled and their exit-reported marker cleared.
+    pub fn sync(&self, pids: &[u32]) {
+        let mut watched = self.watched.lock();
+
+        watched.retain(|pid, state| {
+            let keep = pids.contains(pid);
+            if !keep {
+                if let WatchState::Watching(handle) = state {
+                    handle.abort();
+                }
+            }
+            keep
+        });
+
+        for pid in pids {
+            if !watched.contains_key(pid) {
+                if let Some(state) = self.spawn_watch(*pid) {
+                    watched.insert(*pid, state);
+                }
+            }
+        }
+    }
+
+    /// Number of PIDs with an outstanding watch
+    pub fn watching_count(&self) -> usize {
+        self.watched
+            .lock()
+            .values()
+            .filter(|s| matches!(s, WatchState::Watching(_)))
+            .count()
+    }
+
+    /// Open a pidfd for `pid` now and wait for it on the reactor
+    #[cfg(target_os = "linux")]
+    fn spawn_watch(&self, pid: u32) -> Option<WatchState> {
+        let runtime = tokio::runtime::Handle::try_current().ok()?;
+        let pidfd = match linux::pidfd_open(pid) {
+            Ok(fd) => Some(fd),
+            // Already gone: report the exit right away
+            Err(e) if e.raw_os_error() == Some(libc::ESRCH) => None,
+            Err(e) => {
+                // Without a pidfd, snapshot diffing still reports the exit
+                tracing::debug!("pidfd watch for {} unavailable: {}", pid, e);
+                return Some(WatchState::Unwatchable);
+            }
+        };
+        let watched = self.watched.clone();
+        let event_tx = self.event_tx.clone();
+
+        let task = runtime.spawn(async move {
+            if let Some(pidfd) = pidfd {
+                if let Err(e) = linux::wait_for_exit(pidfd).await {
+                    tracing::debug!("pidfd watch for {} failed: {}", pid, e);
+                    if let Some(state) = watched.lock().get_mut(&pid) {
+                        *state = WatchState::Unwatchable;
+                    }
+                    return;
+                }
+            }
+
+            // Only report if the PID is still tracked and was not reported yet
+            {
+                let mut watched = watched.lock();
+                match watched.get_mut(&pid) {
+                    Some(state @ WatchState::Watching(_)) => *state = WatchState::Exited,
+                    _ => return,
+                }
+            }
+
+            let timestamp = chrono::Utc::now();
+            let mut process = tuai_common::ProcessInfo::new(pid, String::new());
+            process.end_time = Some(timestamp);
+            let _ = event_tx.send(ProcessEvent {
+                event_type: tuai_common::ProcessEventType::Exit,
+                process,
+                timestamp,
+            });
+        });
+
+        Some(WatchState::Watching(task.abort_handle()))
+    }
+
+    #[cfg(not(target_os = "linux"))]
+    fn spawn_watch(&self, _pid: u32) -> Option<WatchState> {
+        let _ = &self.event_tx;
+        None
+    }
+}
+
+impl Drop for ExitWatcher {
+    fn drop(&mut self) {
+        for (_, state) in self.watched.lock().drain() {
+            if let WatchState::Watching(handle) = state {
+                handle.abort();
+            }
+        }
+    }
+}
+
+#[cfg(target_os = "linux")]
+mod linux {
+    use std::io;
+    use std::os::fd::{FromRawFd, OwnedFd};
+
+    use tokio::io::unix::AsyncFd;
+    use tokio::io::Interest;
+
+    /// Open a pidfd for `pid`
+    pub(super) fn pidfd_open(pid: u32) -> io::Result<OwnedFd> {
+        let fd = unsafe { libc::syscall(libc::SYS_pidfd_open, pid as libc::pid_t, 0) };
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(unsafe { OwnedFd::from_raw_fd(fd as libc::c_int) })
+    }
+
+    /// Resolve once the process behind `pidfd` has terminated
+    pub(super) async fn wait_for_exit(pidfd: OwnedFd) -> io::Result<()> {
+        let async_fd = AsyncFd::with_interest(pidfd, Interest::READABLE)?;
+        let _guard = async_fd.readable().await?;
+        Ok(())
+    }
+}
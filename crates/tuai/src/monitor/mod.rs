@@ -3,15 +3,19 @@
 //! Provides platform-specific and fallback process monitoring.
 //!
 //! On Linux with eBPF support, uses kernel tracepoints for real-time
-//! process monitoring. Falls back to sysinfo polling on other platforms
-//! or when eBPF is not available.
+//! process monitoring. Without eBPF, the netlink process connector gives
+//! fork/exec/exit events when CAP_NET_ADMIN is available. Falls back to
+//! sysinfo polling on other platforms or when neither is available.
 //!
 //! To enable eBPF on Linux:
 //! 1. Generate vmlinux.h: `bpftool btf dump file /sys/kernel/btf/vmlinux format c > src/bpf/vmlinux.h`
 //! 2. Rebuild the crate
 //! 3. Run as root or with CAP_BPF capability
 
+mod delta;
+mod exit_watcher;
 mod sysinfo_monitor;
+mod tree;
 
 #[cfg(test)]
 mod tests;
@@ -19,13 +23,26 @@ mod tests;
 #[cfg(all(target_os = "linux", ebpf_available))]
 mod ebpf_monitor;
 
+#[cfg(target_os = "linux")]
+mod netlink_monitor;
+
+pub use delta::{ChangeLog, ProcessDelta};
+pub use exit_watcher::ExitWatcher;
 pub use sysinfo_monitor::SysinfoMonitor;
+pub use tree::{AgentRole, ProcessTree, TreeChanges};
+
+#[cfg(target_os = "linux")]
+pub use netlink_monitor::NetlinkProcMonitor;
 
 #[cfg(all(target_os = "linux", ebpf_available))]
 #[allow(unused_imports)]  // Public API export
-pub use ebpf_monitor::{EbpfProcessMonitor, EbpfError};
+pub use ebpf_monitor::{set_protected_inodes, EbpfProcessMonitor, EbpfError};
 
-use tuai_common::{ProcessEvent, ProcessInfo, PlatformResult};
+use std::collections::HashMap;
+use std::sync::Arc;
+
+use parking_lot::RwLock;
+use tuai_common::{FileOpInfo, ProcessEvent, ProcessInfo, PlatformResult};
 use tokio::sync::broadcast;
 use tracing::{info, warn};
 
@@ -33,6 +50,12 @@ use tracing::{info, warn};
 pub struct ProcessMonitorService {
     inner: Box<dyn ProcessMonitorBackend>,
     event_tx: broadcast::Sender<ProcessEvent>,
+    /// Immediate exit notification for tracked PIDs
+    exit_watcher: ExitWatcher,
+    /// Last PID set passed to `set_tracked_pids`
+    tracked: RwLock<Vec<u32>>,
+    /// Last map passed to `set_attribution`
+    attribution: RwLock<Arc<HashMap<u32, u32>>>,
     #[allow(dead_code)]
     backend_name: &'static str,
 }
@@ -41,8 +64,9 @@ impl ProcessMonitorService {
     /// Create a new process monitor service
     ///
     /// On Linux with eBPF compiled in, attempts to use kernel tracepoints
-    /// for real-time process monitoring. Falls back to sysinfo polling
-    /// if eBPF is not available at runtime.
+    /// for real-time process monitoring. Next tries the netlink process
+    /// connector, and falls back to sysinfo polling if neither is
+    /// available at runtime.
     pub fn new() -> Self {
         let (event_tx, _) = broadcast::channel(1000);
 
@@ -51,11 +75,7 @@ impl ProcessMonitorService {
         {
             if EbpfProcessMonitor::is_available() {
                 info!("eBPF process monitoring available, using kernel tracepoints");
-                return Self {
-                    inner: Box::new(EbpfProcessMonitor::new()),
-                    event_tx,
-                    backend_name: "ebpf",
-                };
+                return Self::with_backend(Box::new(EbpfProcessMonitor::new()), event_tx, "ebpf");
             } else {
                 warn!("eBPF not available at runtime (requires root/CAP_BPF and BTF support), falling back to sysinfo");
             }
@@ -66,12 +86,37 @@ impl ProcessMonitorService {
             info!("eBPF not compiled in (vmlinux.h not found during build)");
         }
 
+        // Event-driven process connector (needs CAP_NET_ADMIN, not CAP_BPF)
+        #[cfg(target_os = "linux")]
+        {
+            if NetlinkProcMonitor::is_available() {
+                info!("Netlink process connector available, using CN_PROC events");
+                let monitor = NetlinkProcMonitor::new();
+                // Events are pushed by the backend, so share its channel
+                let event_tx = monitor.event_sender();
+                return Self::with_backend(Box::new(monitor), event_tx, "netlink");
+            } else {
+                warn!("Netlink process connector not available (requires CAP_NET_ADMIN), falling back to sysinfo");
+            }
+        }
+
         // Fallback to sysinfo-based monitoring
         info!("Using sysinfo-based process monitoring");
+        Self::with_backend(Box::new(SysinfoMonitor::new()), event_tx, "sysinfo")
+    }
+
+    fn with_backend(
+        inner: Box<dyn ProcessMonitorBackend>,
+        event_tx: broadcast::Sender<ProcessEvent>,
+        backend_name: &'static str,
+    ) -> Self {
         Self {
-            inner: Box::new(SysinfoMonitor::new()),
+            inner,
+            exit_watcher: ExitWatcher::new(event_tx.clone()),
+            tracked: RwLock::new(Vec::new()),
+            attribution: RwLock::new(Arc::default()),
             event_tx,
-            backend_name: "sysinfo",
+            backend_name,
         }
     }
 
@@ -100,6 +145,52 @@ impl ProcessMonitorService {
         self.inner.snapshot()
     }
 
+    /// Get the changes since a previously returned generation
+    ///
+    /// Pass 0 on the first call; the result then holds the full table.
+    pub fn changes_since(&self, generation: u64) -> PlatformResult<ProcessDelta> {
+        self.inner.changes_since(generation)
+    }
+
+    /// Tell the backend which PIDs are tracked AI agents
+    ///
+    /// Polling backends use this to limit per-process refreshes of
+    /// fields that change over a process lifetime (such as cwd). Tracked
+    /// PIDs are also watched via pidfd, and their exits are published on
+    /// the event channel as soon as they happen, once per PID.
+    pub fn set_tracked_pids(&self, pids: &[u32]) {
+        self.inner.set_tracked_pids(pids);
+        self.exit_watcher.sync(pids);
+        *self.tracked.write() = pids.to_vec();
+    }
+
+    /// PIDs of tracked AI agents, as last set by `set_tracked_pids`
+    pub fn tracked_pids(&self) -> Vec<u32> {
+        self.tracked.read().clone()
+    }
+
+    /// Set the agent each process below an agent is attributed to
+    ///
+    /// Keyed by PID; agents map to themselves. The sampler reads these
+    /// processes' connections too and credits their traffic to the agent.
+    /// The eBPF backend reports protected file opens of these processes.
+    pub fn set_attribution(&self, attribution: HashMap<u32, u32>) {
+        self.inner.set_attribution(&attribution);
+        *self.attribution.write() = Arc::new(attribution);
+    }
+
+    /// Agent of every attributed process, as last set by `set_attribution`
+    pub fn attribution(&self) -> Arc<HashMap<u32, u32>> {
+        self.attribution.read().clone()
+    }
+
+    /// File operations the backend saw since the last call
+    ///
+    /// Only the eBPF backend reports any: opens of protected files.
+    pub fn take_file_ops(&self) -> Vec<FileOpInfo> {
+        self.inner.take_file_ops()
+    }
+
     /// Subscribe to process events
     pub fn subscribe(&self) -> broadcast::Receiver<ProcessEvent> {
         self.event_tx.subscribe()
@@ -123,4 +214,20 @@ pub trait ProcessMonitorBackend: Send + Sync {
     fn stop(&mut self) -> PlatformResult<()>;
     fn is_running(&self) -> bool;
     fn snapshot(&self) -> PlatformResult<Vec<ProcessInfo>>;
+
+    /// Changes since `generation`; backends without a change log resync
+    fn changes_since(&self, _generation: u64) -> PlatformResult<ProcessDelta> {
+        Ok(ProcessDelta::full(0, self.snapshot()?))
+    }
+
+    /// Hint which PIDs are tracked agents (ignored by event-driven backends)
+    fn set_tracked_pids(&self, _pids: &[u32]) {}
+
+    /// Processes counted towards an agent, keyed by PID
+    fn set_attribution(&self, _attribution: &HashMap<u32, u32>) {}
+
+    /// File operations seen since the last call
+    fn take_file_ops(&self) -> Vec<FileOpInfo> {
+        Vec::new()
+    }
 }
@@ -0,0 +1,868 @@
+//! Netlink process connector based process monitor for Linux
+//!
+//! Subscribes to the kernel process connector (CN_PROC) over a
+//! NETLINK_CONNECTOR socket and receives PROC_EVENT_FORK, PROC_EVENT_EXEC
+//! and PROC_EVENT_EXIT notifications as they happen. Unlike polling, this
+//! sees short-lived children that fork, exec and exit between two ticks,
+//! and in steady state it never scans /proc: only the process that just
+//! exec'd is read to fill in its name, cmdline and exe.
+//!
+//! Requires:
+//! - Linux with CONFIG_PROC_EVENTS (enabled in all mainstream kernels)
+//! - CAP_NET_ADMIN to join the CN_IDX_PROC multicast group
+//!
+//! This sits between eBPF (needs CAP_BPF and BTF) and sysinfo polling
+//! (needs nothing) in ProcessMonitorService::new.
+
+#![cfg(target_os = "linux")]
+
+use std::collections::HashMap;
+use std::io;
+use std::mem;
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+use std::os::unix::fs::MetadataExt;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+
+use chrono::{DateTime, Utc};
+use parking_lot::RwLock;
+use tokio::sync::broadcast;
+use tracing::{debug, error, info, warn};
+
+use tuai_common::{PlatformError, PlatformResult, ProcessEvent, ProcessEventType, ProcessInfo};
+
+use super::{ChangeLog, ProcessDelta};
+use crate::procfs;
+
+/// Initial buffer for stat and cmdline, enough for most processes
+const PROC_FILE_BUF_SIZE: usize = 1024;
+
+/// Connector index/value for the process events connector (linux/connector.h)
+const CN_IDX_PROC: u32 = 1;
+const CN_VAL_PROC: u32 = 1;
+
+/// Multicast subscription ops (linux/cn_proc.h)
+const PROC_CN_MCAST_LISTEN: u32 = 1;
+const PROC_CN_MCAST_IGNORE: u32 = 2;
+
+/// Event kinds (linux/cn_proc.h)
+const PROC_EVENT_NONE: u32 = 0;
+const PROC_EVENT_FORK: u32 = 0x0000_0001;
+const PROC_EVENT_EXEC: u32 = 0x0000_0002;
+const PROC_EVENT_EXIT: u32 = 0x8000_0000;
+
+/// Netlink message types
+const NLMSG_NOOP: u16 = 1;
+const NLMSG_ERROR: u16 = 2;
+const NLMSG_DONE: u16 = 3;
+
+/// sizeof(struct nlmsghdr)
+const NLMSG_HDRLEN: usize = 16;
+/// sizeof(struct cn_msg)
+const CN_MSG_LEN: usize = 20;
+/// Offset of event_data within struct proc_event (what, cpu, timestamp_ns)
+const PROC_EVENT_DATA_OFFSET: usize = 16;
+
+/// Receive buffer size; large enough for bursts of fork/exec/exit storms
+const SOCKET_RCVBUF: libc::c_int = 4 * 1024 * 1024;
+
+/// A decoded process connector event
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) enum ProcConnEvent {
+    Fork {
+        parent_tgid: u32,
+        child_pid: u32,
+        child_tgid: u32,
+    },
+    Exec {
+        pid: u32,
+        tgid: u32,
+    },
+    Exit {
+        pid: u32,
+        tgid: u32,
+        exit_code: u32,
+    },
+    /// Reply to a subscription request (err is an errno, 0 on success)
+    Ack {
+        err: u32,
+    },
+}
+
+/// Known processes plus the generation log of changes to them
+#[derive(Default)]
+struct ProcessTable {
+    processes: HashMap<u32, ProcessInfo>,
+    changes: ChangeLog,
+}
+
+/// Process monitor using the netlink process connector
+pub struct NetlinkProcMonitor {
+    running: Arc<AtomicBool>,
+    table: Arc<RwLock<ProcessTable>>,
+    event_tx: broadcast::Sender<ProcessEvent>,
+}
+
+impl NetlinkProcMonitor {
+    /// Create a new netlink process monitor
+    pub fn new() -> Self {
+        let (event_tx, _) = broadcast::channel(1024);
+
+        Self {
+            running: Arc::new(AtomicBool::new(false)),
+            table: Arc::new(RwLock::new(ProcessTable::default())),
+            event_tx,
+        }
+    }
+
+    /// Check if the process connector can be used
+    ///
+    /// Joining the CN_IDX_PROC group needs CAP_NET_ADMIN, and the bind fails
+    /// with EPERM without it, so a successful bind is the capability check.
+    pub fn is_available() -> bool {
+        open_connector_socket().is_ok()
+    }
+
+    /// Get the sender used to publish process events
+    pub fn event_sender(&self) -> broadcast::Sender<ProcessEvent> {
+        self.event_tx.clone()
+    }
+
+    /// Subscribe to process events
+    pub fn subscribe(&self) -> broadcast::Receiver<ProcessEvent> {
+        self.event_tx.subscribe()
+    }
+
+    /// Start listening for process events
+    pub fn start(&mut self) -> PlatformResult<()> {
+        if self.running.load(Ordering::Relaxed) {
+            return Ok(());
+        }
+
+        let socket = open_connector_socket().map_err(|e| {
+            PlatformError::InitializationFailed(format!("netlink connector socket: {}", e))
+        })?;
+        set_listen(&socket, true).map_err(|e| {
+            PlatformError::InitializationFailed(format!("CN_PROC subscription failed: {}", e))
+        })?;
+
+        // Subscribe before scanning so nothing falls into the gap between them
+        let count = Self::scan_existing_processes(&self.table);
+        info!("Loaded {} existing processes into netlink monitor state", count);
+
+        self.running.store(true, Ordering::Relaxed);
+
+        let running = self.running.clone();
+        let table = self.table.clone();
+        let event_tx = self.event_tx.clone();
+        std::thread::Builder::new()
+            .name("tuai-cn-proc".to_string())
+            .spawn(move || Self::poll_events(socket, running, table, event_tx))
+            .map_err(|e| PlatformError::InitializationFailed(e.to_string()))?;
+
+        info!("Netlink process connector monitor started");
+        Ok(())
+    }
+
+    /// Stop listening (the receive thread exits on its next timeout)
+    pub fn stop(&mut self) {
+        self.running.store(false, Ordering::Relaxed);
+        info!("Netlink process connector monitor stopped");
+    }
+
+    /// Get a snapshot of currently known processes
+    pub fn snapshot(&self) -> Vec<ProcessInfo> {
+        self.table.read().processes.values().cloned().collect()
+    }
+
+    /// Get the changes since a previously returned generation
+    pub fn changes_since(&self, generation: u64) -> ProcessDelta {
+        let table = self.table.read();
+        table.changes.changes_since(
+            generation,
+            |pid| table.processes.get(&pid).cloned(),
+            || table.processes.values().cloned().collect(),
+        )
+    }
+
+    /// Populate the process table from /proc (startup and overrun recovery)
+    fn scan_existing_processes(table: &RwLock<ProcessTable>) -> usize {
+        let pids = procfs::list_pids().unwrap_or_default();
+        let mut scanned: HashMap<u32, ProcessInfo> = pids
+            .iter()
+            .zip(read_proc_infos(&pids))
+            .filter_map(|(pid, info)| Some((*pid, info?)))
+            .collect();
+
+        let mut table = table.write();
+        let ProcessTable { processes, changes } = &mut *table;
+
+        // Keep internal IDs of processes we already knew about
+        for (pid, info) in scanned.iter_mut() {
+            match processes.get(pid) {
+                Some(known) if known.start_time == info.start_time => info.id = known.id,
+                Some(_) => {
+                    changes.removed(*pid);
+                    changes.added(*pid);
+                }
+                None => changes.added(*pid),
+            }
+        }
+        for pid in processes.keys() {
+            if !scanned.contains_key(pid) {
+                changes.removed(*pid);
+            }
+        }
+        *processes = scanned;
+        changes.publish();
+        processes.len()
+    }
+
+    /// Receive loop for the connector socket
+    fn poll_events(
+        socket: OwnedFd,
+        running: Arc<AtomicBool>,
+        table: Arc<RwLock<ProcessTable>>,
+        event_tx: broadcast::Sender<ProcessEvent>,
+    ) {
+        let mut buf = vec![0u8; 64 * 1024];
+        let mut events = Vec::new();
+
+        while running.load(Ordering::Relaxed) {
+            let mut sender: libc::sockaddr_nl = unsafe { mem::zeroed() };
+            let mut sender_len = mem::size_of::<libc::sockaddr_nl>() as libc::socklen_t;
+            let n = unsafe {
+                libc::recvfrom(
+                    socket.as_raw_fd(),
+                    buf.as_mut_ptr() as *mut libc::c_void,
+                    buf.len(),
+                    0,
+                    &mut sender as *mut libc::sockaddr_nl as *mut libc::sockaddr,
+                    &mut sender_len,
+                )
+            };
+
+            if n < 0 {
+                let err = io::Error::last_os_error();
+                match err.raw_os_error() {
+                    Some(libc::EINTR) | Some(libc::EAGAIN) => continue,
+                    Some(libc::ENOBUFS) => {
+                        // The kernel dropped events; reconcile against /proc
+                        warn!("CN_PROC receive buffer overrun, rescanning /proc");
+                        Self::scan_existing_processes(&table);
+                        continue;
+                    }
+                    _ => {
+                        error!("CN_PROC receive failed: {}", err);
+                        break;
+                    }
+                }
+            }
+
+            // Any local process may send to our port; only the kernel's
+            // messages describe real processes
+            if !from_kernel(&sender, sender_len) {
+                debug!("Dropped CN_PROC message from port {}", sender.nl_pid);
+                continue;
+            }
+
+            events.clear();
+            parse_messages(&buf[..n as usize], &mut events);
+            for event in &events {
+                Self::handle_event(*event, &table, &event_tx);
+            }
+        }
+
+        let _ = set_listen(&socket, false);
+        debug!("CN_PROC receive loop exited");
+    }
+
+    /// Apply a single connector event to the process table
+    fn handle_event(
+        event: ProcConnEvent,
+        table: &RwLock<ProcessTable>,
+        event_tx: &broadcast::Sender<ProcessEvent>,
+    ) {
+        let timestamp = Utc::now();
+
+        match event {
+            ProcConnEvent::Fork { parent_tgid, child_pid, child_tgid } => {
+                // New threads share the parent's tgid; only track processes
+                if child_pid != child_tgid {
+                    return;
+                }
+
+                // Until it execs, a forked child runs the parent's image
+                let mut process = match table.read().processes.get(&parent_tgid) {
+                    Some(parent) => {
+                        let mut child = ProcessInfo::new(child_tgid, parent.name.clone());
+                        child.cmdline = parent.cmdline.clone();
+                        child.exe_path = parent.exe_path.clone();
+                        child.user = parent.user.clone();
+                        child.cwd = parent.cwd.clone();
+                        child
+                    }
+                    None => match read_proc_info(child_tgid) {
+                        Some(info) => info,
+                        None => ProcessInfo::new(child_tgid, String::new()),
+                    },
+                };
+                process.ppid = Some(parent_tgid);
+                // The real start time, so the entry matches the next /proc
+                // scan; the fork time only if the child is already gone
+                process.start_time = read_start_time(child_tgid).unwrap_or(timestamp);
+
+                debug!("CN_PROC: fork {} -> {}", parent_tgid, child_tgid);
+                {
+                    let mut table = table.write();
+                    table.processes.insert(child_tgid, process.clone());
+                    table.changes.added(child_tgid);
+                    table.changes.publish();
+                }
+
+                let _ = event_tx.send(ProcessEvent {
+                    event_type: ProcessEventType::Spawn,
+                    process,
+                    timestamp,
+                });
+            }
+            ProcConnEvent::Exec { pid, tgid } => {
+                if pid != tgid {
+                    return;
+                }
+
+                let mut table = table.write();
+                let ProcessTable { processes, changes } = &mut *table;
+                if processes.contains_key(&tgid) {
+                    changes.updated(tgid);
+                } else {
+                    changes.added(tgid);
+                }
+                changes.publish();
+                let process = processes
+                    .entry(tgid)
+                    .or_insert_with(|| ProcessInfo::new(tgid, String::new()));
+
+                // The process may already be gone for very short-lived execs
+                if let Some(fresh) = read_proc_info(tgid) {
+                    process.name = fresh.name;
+                    process.cmdline = fresh.cmdline;
+                    process.exe_path = fresh.exe_path;
+                    process.user = fresh.user;
+                    process.cwd = fresh.cwd;
+                    if process.ppid.is_none() {
+                        process.ppid = fresh.ppid;
+                    }
+                }
+
+                debug!("CN_PROC: exec {} ({})", process.name, tgid);
+                let process = process.clone();
+                drop(table);
+
+                let _ = event_tx.send(ProcessEvent {
+                    event_type: ProcessEventType::Update,
+                    process,
+                    timestamp,
+                });
+            }
+            ProcConnEvent::Exit { pid, tgid, exit_code } => {
+                // Individual threads exiting are not process exits
+                if pid != tgid {
+                    return;
+                }
+
+                debug!("CN_PROC: exit {} (code: {})", tgid, exit_code);
+                let removed = {
+                    let mut table = table.write();
+                    let removed = table.processes.remove(&tgid);
+                    if removed.is_some() {
+                        table.changes.removed(tgid);
+                        table.changes.publish();
+                    }
+                    removed
+                };
+                if let Some(mut process) = removed {
+                    process.end_time = Some(timestamp);
+
+                    let _ = event_tx.send(ProcessEvent {
+                        event_type: ProcessEventType::Exit,
+                        process,
+                        timestamp,
+                    });
+                }
+            }
+            ProcConnEvent::Ack { err } => {
+                if err != 0 {
+                    warn!("CN_PROC subscription acknowledged with error {}", err);
+                }
+            }
+        }
+    }
+}
+
+impl Default for NetlinkProcMonitor {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl super::ProcessMonitorBackend for NetlinkProcMonitor {
+    fn start(&mut self) -> PlatformResult<()> {
+        self.start()
+    }
+
+    fn stop(&mut self) -> PlatformResult<()> {
+        self.stop();
+        Ok(())
+    }
+
+    fn is_running(&self) -> bool {
+        self.running.load(Ordering::Relaxed)
+    }
+
+    fn snapshot(&self) -> PlatformResult<Vec<ProcessInfo>> {
+        Ok(self.snapshot())
+    }
+
+    fn changes_since(&self, generation: u64) -> PlatformResult<ProcessDelta> {
+        Ok(self.changes_since(generation))
+    }
+}
+
+/// Open a NETLINK_CONNECTOR socket bound to the CN_IDX_PROC group
+/// Whether a netlink message was sent by the kernel (port id 0)
+fn from_kernel(sender: &libc::sockaddr_nl, len: libc::socklen_t) -> bool {
+    len as usize >= mem::size_of::<libc::sockaddr_nl>()
+        && sender.nl_family == libc::AF_NETLINK as libc::sa_family_t
+        && sender.nl_pid == 0
+}
+
+fn open_connector_socket() -> io::Result<OwnedFd> {
+    let fd = unsafe {
+        libc::socket(
+            libc::AF_NETLINK,
+            libc::SOCK_DGRAM | libc::SOCK_CLOEXEC,
+            libc::NETLINK_CONNECTOR,
+        )
+    };
+    if fd < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    let socket = unsafe { OwnedFd::from_raw_fd(fd) };
+
+    let mut addr: libc::sockaddr_nl = unsafe { mem::zeroed() };
+    addr.nl_family = libc::AF_NETLINK as libc::sa_family_t;
+    addr.nl_pid = 0; // let the kernel assign a port id
+    addr.nl_groups = CN_IDX_PROC;
+
+    let rc = unsafe {
+        libc::bind(
+            socket.as_raw_fd(),
+            &addr as *const libc::sockaddr_nl as *const libc::sockaddr,
+            mem::size_of::<libc::sockaddr_nl>() as libc::socklen_t,
+        )
+    };
+    if rc < 0 {
+        return Err(io::Error::last_os_error());
+    }
+
+    // Best effort: a larger buffer makes overruns during fork storms rarer
+    unsafe {
+        libc::setsockopt(
+            socket.as_raw_fd(),
+            libc::SOL_SOCKET,
+            libc::SO_RCVBUF,
+            &SOCKET_RCVBUF as *const libc::c_int as *const libc::c_void,
+            mem::size_of::<libc::c_int>() as libc::socklen_t,
+        );
+    }
+
+    // Wake up periodically so stop() is noticed
+    let timeout = libc::timeval {
+        tv_sec: 0,
+        tv_usec: Duration::from_millis(250).as_micros() as libc::suseconds_t,
+    };
+    unsafe {
+        libc::setsockopt(
+            socket.as_raw_fd(),
+            libc::SOL_SOCKET,
+            libc::SO_RCVTIMEO,
+            &timeout as *const libc::timeval as *const libc::c_void,
+            mem::size_of::<libc::timeval>() as libc::socklen_t,
+        );
+    }
+
+    Ok(socket)
+}
+
+/// Send a PROC_CN_MCAST_LISTEN / PROC_CN_MCAST_IGNORE request
+fn set_listen(socket: &OwnedFd, listen: bool) -> io::Result<()> {
+    let op = if listen { PROC_CN_MCAST_LISTEN } else { PROC_CN_MCAST_IGNORE };
+    let msg = build_mcast_message(op);
+
+    let n = unsafe {
+        libc::send(
+            socket.as_raw_fd(),
+            msg.as_ptr() as *const libc::c_void,
+            msg.len(),
+            0,
+        )
+    };
+    if n < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(())
+}
+
+/// Build nlmsghdr + cn_msg + proc_cn_mcast_op
+fn build_mcast_message(op: u32) -> [u8; NLMSG_HDRLEN + CN_MSG_LEN + 4] {
+    let mut msg = [0u8; NLMSG_HDRLEN + CN_MSG_LEN + 4];
+    let total = msg.len() as u32;
+
+    // struct nlmsghdr
+    msg[0..4].copy_from_slice(&total.to_ne_bytes());
+    msg[4..6].copy_from_slice(&NLMSG_DONE.to_ne_bytes());
+    msg[12..16].copy_from_slice(&std::process::id().to_ne_bytes());
+
+    // struct cn_msg
+    let cn = NLMSG_HDRLEN;
+    msg[cn..cn + 4].copy_from_slice(&CN_IDX_PROC.to_ne_bytes());
+    msg[cn + 4..cn + 8].copy_from_slice(&CN_VAL_PROC.to_ne_bytes());
+    msg[cn + 16..cn + 18].copy_from_slice(&4u16.to_ne_bytes());
+
+    // enum proc_cn_mcast_op
+    msg[cn + CN_MSG_LEN..].copy_from_slice(&op.to_ne_bytes());
+    msg
+}
+
+/// Decode all process connector events in a received datagram
+pub(crate) fn parse_messages(buf: &[u8], out: &mut Vec<ProcConnEvent>) {
+    let mut offset = 0;
+
+    while offset + NLMSG_HDRLEN <= buf.len() {
+        let len = read_u32(buf, offset) as usize;
+        let msg_type = u16::from_ne_bytes([buf[offset + 4], buf[offset + 5]]);
+        if len < NLMSG_HDRLEN || offset + len > buf.len() {
+            break;
+        }
+
+        if msg_type != NLMSG_NOOP && msg_type != NLMSG_ERROR {
+            if let Some(event) = parse_cn_msg(&buf[offset + NLMSG_HDRLEN..offset + len]) {
+                out.push(event);
+            }
+        }
+
+        if msg_type == NLMSG_DONE && len == buf.len() - offset {
+            break;
+        }
+        // NLMSG_ALIGN
+        offset += (len + 3) & !3;
+    }
+}
+
+/// Decode a cn_msg carrying a struct proc_event
+fn parse_cn_msg(msg: &[u8]) -> Option<ProcConnEvent> {
+    if msg.len() < CN_MSG_LEN + PROC_EVENT_DATA_OFFSET {
+        return None;
+    }
+    if read_u32(msg, 0) != CN_IDX_PROC || read_u32(msg, 4) != CN_VAL_PROC {
+        return None;
+    }
+
+    // Trust cn_msg.len over the datagram, which may carry padding
+    let data_len = u16::from_ne_bytes([msg[16], msg[17]]) as usize;
+    let event = &msg[CN_MSG_LEN..(CN_MSG_LEN + data_len).min(msg.len())];
+
+    let what = read_u32(event, 0);
+    let data = PROC_EVENT_DATA_OFFSET;
+    let field = |index: usize| -> Option<u32> {
+        let at = data + index * 4;
+        (at + 4 <= event.len()).then(|| read_u32(event, at))
+    };
+
+    match what {
+        PROC_EVENT_NONE => Some(ProcConnEvent::Ack { err: field(0)? }),
+        PROC_EVENT_FORK => Some(ProcConnEvent::Fork {
+            parent_tgid: field(1)?,
+            child_pid: field(2)?,
+            child_tgid: field(3)?,
+        }),
+        PROC_EVENT_EXEC => Some(ProcConnEvent::Exec {
+            pid: field(0)?,
+            tgid: field(1)?,
+        }),
+        PROC_EVENT_EXIT => Some(ProcConnEvent::Exit {
+            pid: field(0)?,
+            tgid: field(1)?,
+            exit_code: field(2)?,
+        }),
+        _ => None,
+    }
+}
+
+fn read_u32(buf: &[u8], at: usize) -> u32 {
+    u32::from_ne_bytes([buf[at], buf[at + 1], buf[at + 2], buf[at + 3]])
+}
+
+/// Read a single process' details from /proc/<pid>
+fn read_proc_info(pid: u32) -> Option<ProcessInfo> {
+    read_proc_infos(&[pid]).pop().flatten()
+}
+
+/// Read the details of `pids`, their stat and cmdline files in one batch
+fn read_proc_infos(pids: &[u32]) -> Vec<Option<ProcessInfo>> {
+    let paths: Vec<String> = pids
+        .iter()
+        .flat_map(|pid| [format!("/proc/{}/stat", pid), format!("/proc/{}/cmdline", pid)])
+        .collect();
+    let mut contents = procfs::read_files(&paths, PROC_FILE_BUF_SIZE).into_iter();
+    pids.iter()
+        .map(|&pid| {
+            let stat = contents.next().flatten();
+            let cmdline = contents.next().flatten();
+            proc_info_from(pid, &stat?, cmdline)
+        })
+        .collect()
+}
+
+/// Build a process' details from its stat and cmdline contents
+fn proc_info_from(pid: u32, stat: &[u8], cmdline: Option<Vec<u8>>) -> Option<ProcessInfo> {
+    let base = format!("/proc/{}", pid);
+    let stat = std::str::from_utf8(stat).ok()?;
+
+    // comm may contain spaces and parentheses; it ends at the last ')'
+    let open = stat.find('(')?;
+    let close = stat.rfind(')')?;
+    let name = stat[open + 1..close].to_string();
+    let fields: Vec<&str> = stat[close + 1..].split_whitespace().collect();
+
+    let mut info = ProcessInfo::new(pid, name);
+    info.ppid = fields.get(1).and_then(|s| s.parse().ok()).filter(|p| *p > 0);
+    if let Some(time) = start_time_from_fields(&fields) {
+        info.start_time = time;
+    }
+
+    info.cmdline = cmdline
+        .map(|raw| {
+            raw.split(|b| *b == 0)
+                .filter(|s| !s.is_empty())
+                .map(|s| String::from_utf8_lossy(s).into_owned())
+                .collect::<Vec<_>>()
+                .join(" ")
+        })
+        .filter(|c| !c.is_empty());
+    // No readlinkat in io_uring: links stay on std::fs
+    info.exe_path = std::fs::read_link(format!("{}/exe", base))
+        .ok()
+        .map(|p| p.to_string_lossy().to_string());
+    info.cwd = std::fs::read_link(format!("{}/cwd", base))
+        .ok()
+        .map(|p| p.to_string_lossy().to_string());
+    info.user = std::fs::metadata(&base).ok().map(|m| m.uid().to_string());
+
+    Some(info)
+}
+
+/// Start time of a process from /proc/<pid>/stat (field 22)
+fn read_start_time(pid: u32) -> Option<DateTime<Utc>> {
+    let stat = std::fs::read_to_string(format!("/proc/{}/stat", pid)).ok()?;
+    let close = stat.rfind(')')?;
+    let fields: Vec<&str> = stat[close + 1..].split_whitespace().collect();
+    start_time_from_fields(&fields)
+}
+
+/// Start time from the stat fields following the comm field
+fn start_time_from_fields(fields: &[&str]) -> Option<DateTime<Utc>> {
+    fields.get(19)?.parse::<u64>().ok().and_then(start_time_from_ticks)
+}
+
+/// Convert a start time in clock ticks since boot to wall-clock time
+fn start_time_from_ticks(ticks: u64) -> Option<DateTime<Utc>> {
+    static BOOT: std::sync::OnceLock<Option<(i64, u64)>> = std::sync::OnceLock::new();
+
+    let (btime, hz) = (*BOOT.get_or_init(|| {
+        let stat = std::fs::read_to_string("/proc/stat").ok()?;
+        let btime = stat
+            .lines()
+            .find_map(|l| l.strip_prefix("btime "))?
+            .trim()
+            .parse::<i64>()
+            .ok()?;
+        let hz = unsafe { libc::sysconf(libc::_SC_CLK_TCK) };
+        (hz > 0).then_some((btime, hz as u64))
+    }))?;
+
+    DateTime::from_timestamp(btime + (ticks / hz) as i64, 0)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Build a netlink datagram carrying one proc_event
+    fn datagram(what: u32, data: &[u32]) -> Vec<u8> {
+        let mut event = Vec::new();
+        event.extend_from_slice(&what.to_ne_bytes());
+        event.extend_from_slice(&0u32.to_ne_bytes()); // cpu
+        event.extend_from_slice(&0u64.to_ne_bytes()); // timestamp_ns
+        for value in data {
+            event.extend_from_slice(&value.to_ne_bytes());
+        }
+
+        let mut msg = Vec::new();
+        let total = (NLMSG_HDRLEN + CN_MSG_LEN + event.len()) as u32;
+        msg.extend_from_slice(&total.to_ne_bytes());
+        msg.extend_from_slice(&NLMSG_DONE.to_ne_bytes());
+        msg.extend_from_slice(&0u16.to_ne_bytes());
+        msg.extend_from_slice(&0u32.to_ne_bytes());
+        msg.extend_from_slice(&0u32.to_ne_bytes());
+        msg.extend_from_slice(&CN_IDX_PROC.to_ne_bytes());
+        msg.extend_from_slice(&CN_VAL_PROC.to_ne_bytes());
+        msg.extend_from_slice(&0u32.to_ne_bytes()); // seq
+        msg.extend_from_slice(&0u32.to_ne_bytes()); // ack
+        msg.extend_from_slice(&(event.len() as u16).to_ne_bytes());
+        msg.extend_from_slice(&0u16.to_ne_bytes()); // flags
+        msg.extend_from_slice(&event);
+        msg
+    }
+
+    fn parse(buf: &[u8]) -> Vec<ProcConnEvent> {
+        let mut events = Vec::new();
+        parse_messages(buf, &mut events);
+        events
+    }
+
+    #[test]
+    fn test_parse_fork_event() {
+        let buf = datagram(PROC_EVENT_FORK, &[100, 100, 200, 200]);
+        assert_eq!(
+            parse(&buf),
+            vec![ProcConnEvent::Fork { parent_tgid: 100, child_pid: 200, child_tgid: 200 }]
+        );
+    }
+
+    #[test]
+    fn test_only_kernel_messages_are_accepted() {
+        let mut sender: libc::sockaddr_nl = unsafe { mem::zeroed() };
+        sender.nl_family = libc::AF_NETLINK as libc::sa_family_t;
+        let len = mem::size_of::<libc::sockaddr_nl>() as libc::socklen_t;
+        assert!(from_kernel(&sender, len));
+
+        // A user space process sending to our port
+        sender.nl_pid = 4242;
+        assert!(!from_kernel(&sender, len));
+        sender.nl_pid = 0;
+        assert!(!from_kernel(&sender, 0));
+    }
+
+    #[test]
+    fn test_parse_exec_and_exit_events() {
+        let buf = datagram(PROC_EVENT_EXEC, &[300, 300]);
+        assert_eq!(parse(&buf), vec![ProcConnEvent::Exec { pid: 300, tgid: 300 }]);
+
+        let buf = datagram(PROC_EVENT_EXIT, &[300, 300, 256, 17]);
+        assert_eq!(
+            parse(&buf),
+            vec![ProcConnEvent::Exit { pid: 300, tgid: 300, exit_code: 256 }]
+        );
+    }
+
+    #[test]
+    fn test_parse_ack_and_unknown_events() {
+        let buf = datagram(PROC_EVENT_NONE, &[1]);
+        assert_eq!(parse(&buf), vec![ProcConnEvent::Ack { err: 1 }]);
+
+        // PROC_EVENT_UID is not decoded
+        let buf = datagram(0x4, &[1, 1, 1000, 1000]);
+        assert!(parse(&buf).is_empty());
+    }
+
+    #[test]
+    fn test_parse_truncated_message() {
+        let buf = datagram(PROC_EVENT_FORK, &[100, 100, 200, 200]);
+        assert!(parse(&buf[..NLMSG_HDRLEN + 8]).is_empty());
+    }
+
+    #[test]
+    fn test_mcast_message_layout() {
+        let msg = build_mcast_message(PROC_CN_MCAST_LISTEN);
+        assert_eq!(read_u32(&msg, 0) as usize, msg.len());
+        assert_eq!(read_u32(&msg, NLMSG_HDRLEN), CN_IDX_PROC);
+        assert_eq!(read_u32(&msg, msg.len() - 4), PROC_CN_MCAST_LISTEN);
+    }
+
+    #[test]
+    fn test_fork_exec_exit_lifecycle() {
+        let table = RwLock::new(ProcessTable::default());
+        let (event_tx, mut rx) = broadcast::channel(16);
+        let parent = std::process::id();
+        table.write().processes.insert(parent, read_proc_info(parent).unwrap());
+
+        let child = u32::MAX - 1;
+        NetlinkProcMonitor::handle_event(
+            ProcConnEvent::Fork { parent_tgid: parent, child_pid: child, child_tgid: child },
+            &table,
+            &event_tx,
+        );
+        let spawned = rx.try_recv().unwrap();
+        assert_eq!(spawned.event_type, ProcessEventType::Spawn);
+        assert_eq!(spawned.process.ppid, Some(parent));
+        assert!(table.read().processes.contains_key(&child));
+
+        // Thread exits are ignored
+        NetlinkProcMonitor::handle_event(
+            ProcConnEvent::Exit { pid: child + 1, tgid: child, exit_code: 0 },
+            &table,
+            &event_tx,
+        );
+        assert!(rx.try_recv().is_err());
+
+        NetlinkProcMonitor::handle_event(
+            ProcConnEvent::Exit { pid: child, tgid: child, exit_code: 0 },
+            &table,
+            &event_tx,
+        );
+        let exited = rx.try_recv().unwrap();
+        assert_eq!(exited.event_type, ProcessEventType::Exit);
+        assert!(exited.process.end_time.is_some());
+        assert!(!table.read().processes.contains_key(&child));
+
+        // A consumer that already saw the fork only gets the removal
+        let table = table.read();
+        let delta = table.changes.changes_since(1, |pid| table.processes.get(&pid).cloned(), Vec::new);
+        assert_eq!(delta.generation, 2);
+        assert_eq!(delta.removed, vec![child]);
+        assert!(delta.added.is_empty());
+    }
+
+    #[test]
+    fn test_read_proc_info_current_process() {
+        let info = read_proc_info(std::process::id()).unwrap();
+        assert!(!info.name.is_empty());
+        assert!(info.exe_path.is_some());
+        assert!(info.ppid.is_some());
+    }
+
+    #[test]
+    fn test_fork_uses_proc_start_time() {
+        let table = RwLock::new(ProcessTable::default());
+        let (event_tx, mut rx) = broadcast::channel(16);
+        let mut child = std::process::Command::new("sleep").arg("5").spawn().unwrap();
+        let pid = child.id();
+        let expected = read_proc_info(pid).unwrap().start_time;
+
+        std::thread::sleep(std::time::Duration::from_millis(1100));
+        NetlinkProcMonitor::handle_event(
+            ProcConnEvent::Fork { parent_tgid: std::process::id(), child_pid: pid, child_tgid: pid },
+            &table,
+            &event_tx,
+        );
+        let _ = child.kill();
+        let _ = child.wait();
+
+        // Matches what a later /proc scan reads, not the event time
+        assert_eq!(rx.try_recv().unwrap().process.start_time, expected);
+        assert_eq!(read_start_time(u32::MAX - 1), None);
+    }
+}
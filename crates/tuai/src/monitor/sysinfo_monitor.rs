@@ -2,8 +2,21 @@
 //!
 //! Uses the sysinfo crate to poll process information.
 //! This is a fallback when platform-specific APIs are unavailable.
+//!
+//! Refreshes are differential: every tick only enumerates PIDs (parent and
+//! start time come from the same cheap stat read), and the expensive fields
+//! (cmdline, exe, user) are fetched once per newly seen (pid, start_time)
+//! pair. The working directory is only refreshed for tracked agents, so
+//! steady-state cost scales with process churn rather than host size.
+//! Every change is also recorded in a ChangeLog for `changes_since`.
+//!
+//! An exec keeps the PID and start time, so known processes are also
+//! checked for one on every tick: on Linux by the target of their
+//! /proc/<pid>/exe link (one readlink per process), elsewhere by name.
+//! Only processes that exec'd are read again in full.
 
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
+use std::path::PathBuf;
 use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::Arc;
 
@@ -12,7 +25,7 @@ use parking_lot::RwLock;
 use tuai_common::{PlatformResult, ProcessInfo};
 use sysinfo::{Pid, ProcessRefreshKind, ProcessesToUpdate, System, UpdateKind};
 
-use super::ProcessMonitorBackend;
+use super::{ChangeLog, ProcessDelta, ProcessMonitorBackend};
 
 /// Process monitor using sysinfo crate
 pub struct SysinfoMonitor {
@@ -20,6 +33,12 @@ pub struct SysinfoMonitor {
     running: AtomicBool,
     /// Cache of known processes with their internal IDs
     process_cache: Arc<RwLock<HashMap<u32, ProcessInfo>>>,
+    /// Tracked agent PIDs whose cwd is kept up to date
+    tracked_pids: RwLock<HashSet<u32>>,
+    /// Executable link target of each cached process, to notice execs
+    exe_links: RwLock<HashMap<u32, PathBuf>>,
+    /// Generation log of process_cache changes
+    changes: RwLock<ChangeLog>,
 }
 
 impl SysinfoMonitor {
@@ -29,24 +48,165 @@ impl SysinfoMonitor {
             system: Arc::new(RwLock::new(System::new())),
             running: AtomicBool::new(false),
             process_cache: Arc::new(RwLock::new(HashMap::new())),
+            tracked_pids: RwLock::new(HashSet::new()),
+            exe_links: RwLock::new(HashMap::new()),
+            changes: RwLock::new(ChangeLog::new()),
         }
     }
 
     /// Refresh process list and detect changes
     fn refresh(&self) -> PlatformResult<()> {
         let mut system = self.system.write();
+        let mut cache = self.process_cache.write();
+        let mut exe_links = self.exe_links.write();
+        let mut changes = self.changes.write();
+
+        // Cheap pass: enumerate PIDs with parent and start time only
         system.refresh_processes_specifics(
             ProcessesToUpdate::All,
             true,
-            ProcessRefreshKind::nothing()
-                .with_cmd(UpdateKind::Always)
-                .with_cwd(UpdateKind::Always)
-                .with_exe(UpdateKind::Always)
-                .with_user(UpdateKind::Always),
+            ProcessRefreshKind::nothing(),
         );
+
+        // Drop exited processes and PIDs that were reused by a new process
+        cache.retain(|pid, info| {
+            let alive = system
+                .process(Pid::from_u32(*pid))
+                .map_or(false, |proc| Self::same_process(info, proc));
+            if !alive {
+                changes.removed(*pid);
+                exe_links.remove(pid);
+            }
+            alive
+        });
+
+        // Parents change when a process is reparented, so keep them current
+        let mut new_pids = Vec::new();
+        let mut execd = Vec::new();
+        for (pid, proc) in system.processes() {
+            match cache.get_mut(&pid.as_u32()) {
+                Some(info) => {
+                    let ppid = proc.parent().map(|p| p.as_u32());
+                    if info.ppid != ppid {
+                        info.ppid = ppid;
+                        changes.updated(pid.as_u32());
+                    }
+                    if Self::execd(info, proc, &mut exe_links) {
+                        execd.push(*pid);
+                    }
+                }
+                None => new_pids.push(*pid),
+            }
+        }
+
+        // An exec replaces name, cmdline, exe and possibly user
+        if !execd.is_empty() {
+            system.refresh_processes_specifics(
+                ProcessesToUpdate::Some(&execd),
+                false,
+                ProcessRefreshKind::nothing()
+                    .with_cmd(UpdateKind::Always)
+                    .with_exe(UpdateKind::Always)
+                    .with_user(UpdateKind::Always),
+            );
+            for pid in execd {
+                if let (Some(proc), Some(info)) = (system.process(pid), cache.get_mut(&pid.as_u32())) {
+                    let fresh = Self::convert_process(pid, proc);
+                    info.name = comm(pid.as_u32()).unwrap_or(fresh.name);
+                    info.cmdline = fresh.cmdline;
+                    info.exe_path = fresh.exe_path;
+                    info.user = fresh.user;
+                    changes.updated(pid.as_u32());
+                }
+            }
+        }
+
+        // Expensive pass: cmdline, exe and user only for newly seen processes
+        if !new_pids.is_empty() {
+            system.refresh_processes_specifics(
+                ProcessesToUpdate::Some(&new_pids),
+                false,
+                ProcessRefreshKind::nothing()
+                    .with_cmd(UpdateKind::OnlyIfNotSet)
+                    .with_exe(UpdateKind::OnlyIfNotSet)
+                    .with_user(UpdateKind::OnlyIfNotSet),
+            );
+            for pid in new_pids {
+                if let Some(proc) = system.process(pid) {
+                    cache.insert(pid.as_u32(), Self::convert_process(pid, proc));
+                    if let Some(link) = exe_link(pid.as_u32()) {
+                        exe_links.insert(pid.as_u32(), link);
+                    }
+                    changes.added(pid.as_u32());
+                }
+            }
+        }
+
+        // cwd changes over a process lifetime, but we only care for agents
+        let tracked: Vec<Pid> = self
+            .tracked_pids
+            .read()
+            .iter()
+            .filter(|pid| cache.contains_key(pid))
+            .map(|pid| Pid::from_u32(*pid))
+            .collect();
+        if !tracked.is_empty() {
+            system.refresh_processes_specifics(
+                ProcessesToUpdate::Some(&tracked),
+                false,
+                ProcessRefreshKind::nothing().with_cwd(UpdateKind::Always),
+            );
+            for pid in tracked {
+                if let (Some(proc), Some(info)) =
+                    (system.process(pid), cache.get_mut(&pid.as_u32()))
+                {
+                    let cwd = proc.cwd().map(|p| p.to_string_lossy().to_string());
+                    if info.cwd != cwd {
+                        info.cwd = cwd;
+                        changes.updated(pid.as_u32());
+                    }
+                }
+            }
+        }
+
+        changes.publish();
         Ok(())
     }
 
+    /// Check whether a cached entry still describes the live process
+    /// (same PID and same start time, i.e. the PID was not reused)
+    fn same_process(info: &ProcessInfo, proc: &sysinfo::Process) -> bool {
+        info.start_time.timestamp() == proc.start_time() as i64
+    }
+
+    /// Whether a known process exec'd since it was cached
+    ///
+    /// On Linux the executable link decides; the current one is recorded.
+    /// A link that could not be read before, or cannot be read now, is not
+    /// a change. Elsewhere a changed name is.
+    #[cfg(target_os = "linux")]
+    fn execd(info: &ProcessInfo, _proc: &sysinfo::Process, exe_links: &mut HashMap<u32, PathBuf>) -> bool {
+        let Some(link) = exe_link(info.pid) else {
+            return false;
+        };
+        match exe_links.get_mut(&info.pid) {
+            Some(last) if *last != link => {
+                *last = link;
+                true
+            }
+            Some(_) => false,
+            None => {
+                exe_links.insert(info.pid, link);
+                false
+            }
+        }
+    }
+
+    #[cfg(not(target_os = "linux"))]
+    fn execd(info: &ProcessInfo, proc: &sysinfo::Process, _exe_links: &mut HashMap<u32, PathBuf>) -> bool {
+        proc.name().to_string_lossy() != info.name.as_str()
+    }
+
     /// Convert sysinfo process to our ProcessInfo
     fn convert_process(pid: Pid, proc: &sysinfo::Process) -> ProcessInfo {
         let mut info = ProcessInfo::new(pid.as_u32(), proc.name().to_string_lossy().to_string());
@@ -68,6 +228,29 @@ impl SysinfoMonitor {
     }
 }
 
+/// Target of /proc/<pid>/exe, which an exec replaces
+#[cfg(target_os = "linux")]
+fn exe_link(pid: u32) -> Option<PathBuf> {
+    std::fs::read_link(format!("/proc/{}/exe", pid)).ok()
+}
+
+#[cfg(not(target_os = "linux"))]
+fn exe_link(_pid: u32) -> Option<PathBuf> {
+    None
+}
+
+/// Kernel name of a process (/proc/<pid>/comm), as of its last exec
+#[cfg(target_os = "linux")]
+fn comm(pid: u32) -> Option<String> {
+    let comm = std::fs::read_to_string(format!("/proc/{}/comm", pid)).ok()?;
+    Some(comm.trim_end_matches('\n').to_string())
+}
+
+#[cfg(not(target_os = "linux"))]
+fn comm(_pid: u32) -> Option<String> {
+    None
+}
+
 impl Default for SysinfoMonitor {
     fn default() -> Self {
         Self::new()
@@ -102,13 +285,24 @@ impl ProcessMonitorBackend for SysinfoMonitor {
         // Refresh before taking snapshot
         self.refresh()?;
 
-        let system = self.system.read();
-        let processes: Vec<ProcessInfo> = system
-            .processes()
-            .iter()
-            .map(|(pid, proc)| Self::convert_process(*pid, proc))
-            .collect();
+        Ok(self.process_cache.read().values().cloned().collect())
+    }
+
+    fn changes_since(&self, generation: u64) -> PlatformResult<ProcessDelta> {
+        self.refresh()?;
+
+        let cache = self.process_cache.read();
+        let changes = self.changes.read();
+        Ok(changes.changes_since(
+            generation,
+            |pid| cache.get(&pid).cloned(),
+            || cache.values().cloned().collect(),
+        ))
+    }
 
-        Ok(processes)
+    fn set_tracked_pids(&self, pids: &[u32]) {
+        let mut tracked = self.tracked_pids.write();
+        tracked.clear();
+        tracked.extend(pids.iter().copied());
     }
 }
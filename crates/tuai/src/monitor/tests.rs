@@ -1100,4 +1100,560 @@ mod sysinfo_integration_tests {
         assert!(snap1.iter().any(|p| p.pid == current_pid));
         assert!(snap2.iter().any(|p| p.pid == current_pid));
     }
+
+    #[test]
+    fn test_sysinfo_ids_stable_across_snapshots() {
+        let mut monitor = SysinfoMonitor::new();
+        monitor.start().unwrap();
+
+        let current_pid = std::process::id();
+        let id1 = monitor.snapshot().unwrap().into_iter().find(|p| p.pid == current_pid).unwrap().id;
+        let id2 = monitor.snapshot().unwrap().into_iter().find(|p| p.pid == current_pid).unwrap().id;
+
+        // Details are fetched once per process, so the cached entry is reused
+        assert_eq!(id1, id2);
+    }
+
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_sysinfo_exec_rereads_known_process() {
+        let mut monitor = SysinfoMonitor::new();
+        monitor.start().unwrap();
+
+        let mut child = std::process::Command::new("sh")
+            .args(["-c", "sleep 0.3; exec sleep 5"])
+            .spawn()
+            .unwrap();
+        let pid = child.id();
+        let before = monitor.snapshot().unwrap().into_iter().find(|p| p.pid == pid).unwrap();
+        assert_eq!(before.name, "sh");
+
+        std::thread::sleep(std::time::Duration::from_millis(800));
+        let after = monitor.snapshot().unwrap().into_iter().find(|p| p.pid == pid).unwrap();
+        child.kill().unwrap();
+        child.wait().unwrap();
+
+        assert_eq!(after.id, before.id);
+        assert_eq!(after.name, "sleep");
+        assert_eq!(after.cmdline.as_deref(), Some("sleep 5"));
+    }
+
+    #[test]
+    fn test_sysinfo_cwd_refreshed_for_tracked_only() {
+        let mut monitor = SysinfoMonitor::new();
+        monitor.start().unwrap();
+
+        let current_pid = std::process::id();
+        monitor.set_tracked_pids(&[current_pid]);
+
+        let snapshot = monitor.snapshot().unwrap();
+        let current = snapshot.iter().find(|p| p.pid == current_pid).unwrap();
+        assert!(current.cwd.is_some(), "tracked process should have cwd");
+    }
+
+    #[test]
+    fn test_sysinfo_exited_process_removed() {
+        let mut monitor = SysinfoMonitor::new();
+        monitor.start().unwrap();
+
+        let mut child = match std::process::Command::new("sleep").arg("30").spawn() {
+            Ok(child) => child,
+            Err(_) => return, // sleep not available on this platform
+        };
+        let child_pid = child.id();
+
+        let snapshot = monitor.snapshot().unwrap();
+        let found = snapshot.iter().find(|p| p.pid == child_pid);
+        assert!(found.is_some(), "new child should appear in snapshot");
+        assert_eq!(found.unwrap().ppid, Some(std::process::id()));
+
+        child.kill().unwrap();
+        child.wait().unwrap();
+
+        let snapshot = monitor.snapshot().unwrap();
+        assert!(!snapshot.iter().any(|p| p.pid == child_pid));
+    }
+}
+
+// ============================================================================
+// pidfd Exit Watcher Tests
+// ============================================================================
+
+#[cfg(target_os = "linux")]
+mod exit_watcher_tests {
+    use super::*;
+    use crate::monitor::ExitWatcher;
+    use tokio::sync::broadcast;
+    use tuai_common::ProcessEventType;
+
+    #[tokio::test]
+    async fn test_exit_reported_once() {
+        let (event_tx, mut rx) = broadcast::channel(16);
+        let watcher = ExitWatcher::new(event_tx);
+
+        let mut child = match std::process::Command::new("sleep").arg("30").spawn() {
+            Ok(child) => child,
+            Err(_) => return,
+        };
+        let child_pid = child.id();
+
+        watcher.sync(&[child_pid]);
+        child.kill().unwrap();
+
+        let event = tokio::time::timeout(Duration::from_secs(5), rx.recv())
+            .await
+            .expect("exit should be reported without polling")
+            .unwrap();
+        assert_eq!(event.event_type, ProcessEventType::Exit);
+        assert_eq!(event.process.pid, child_pid);
+        assert!(event.process.end_time.is_some());
+
+        // Re-syncing while the zombie is still around must not re-report
+        watcher.sync(&[child_pid]);
+        tokio::time::sleep(Duration::from_millis(100)).await;
+        assert!(rx.try_recv().is_err());
+        assert_eq!(watcher.watching_count(), 0);
+
+        child.wait().unwrap();
+    }
+
+    #[tokio::test]
+    async fn test_untracked_pid_not_reported() {
+        let (event_tx, mut rx) = broadcast::channel(16);
+        let watcher = ExitWatcher::new(event_tx);
+
+        let mut child = match std::process::Command::new("sleep").arg("30").spawn() {
+            Ok(child) => child,
+            Err(_) => return,
+        };
+
+        watcher.sync(&[child.id()]);
+        assert_eq!(watcher.watching_count(), 1);
+        watcher.sync(&[]);
+        assert_eq!(watcher.watching_count(), 0);
+
+        child.kill().unwrap();
+        child.wait().unwrap();
+        tokio::time::sleep(Duration::from_millis(100)).await;
+        assert!(rx.try_recv().is_err());
+    }
+
+    #[test]
+    fn test_sync_without_runtime_is_noop() {
+        let (event_tx, _rx) = broadcast::channel(16);
+        let watcher = ExitWatcher::new(event_tx);
+        watcher.sync(&[std::process::id()]);
+        assert_eq!(watcher.watching_count(), 0);
+    }
+}
+
+// ============================================================================
+// Incremental Process Tree Tests
+// ============================================================================
+
+mod process_tree_tests {
+    use super::*;
+    use crate::monitor::{AgentRole, ProcessTree};
+
+    /// agent(100) → sh(101) → cargo(102) → rustc(103), plus unrelated bash(200)
+    fn agent_tree() -> ProcessTree {
+        let mut tree = ProcessTree::new();
+        tree.insert(1, None, false);
+        tree.insert(100, Some(1), true);
+        tree.insert(101, Some(100), false);
+        tree.insert(102, Some(101), false);
+        tree.insert(103, Some(102), false);
+        tree.insert(200, Some(1), false);
+        tree
+    }
+
+    #[test]
+    fn test_grandchildren_attributed_to_agent() {
+        let tree = agent_tree();
+
+        assert!(tree.is_descendant_of_agent(103));
+        assert_eq!(tree.nearest_agent(103), Some(100));
+        assert_eq!(tree.agent_for(100), Some(100));
+        assert!(!tree.is_descendant_of_agent(100));
+        assert!(!tree.is_descendant_of_agent(200));
+    }
+
+    #[test]
+    fn test_subtree_enumeration() {
+        let tree = agent_tree();
+
+        let subtree: Vec<u32> = tree.subtree(101).collect();
+        assert_eq!(subtree, vec![101, 102, 103]);
+        assert_eq!(tree.subtree(1).count(), 6);
+        assert_eq!(tree.subtree(999).count(), 0);
+    }
+
+    #[test]
+    fn test_child_inserted_before_parent() {
+        let mut tree = ProcessTree::new();
+        tree.insert(103, Some(102), false);
+        tree.insert(102, Some(100), false);
+        assert!(!tree.is_descendant_of_agent(103));
+
+        tree.insert(100, Some(1), true);
+        assert_eq!(tree.nearest_agent(102), Some(100));
+        assert_eq!(tree.nearest_agent(103), Some(100));
+    }
+
+    #[test]
+    fn test_orphans_keep_attribution() {
+        let mut tree = agent_tree();
+
+        // sh exits, cargo is reparented to init
+        tree.remove(101);
+        tree.reparent(102, Some(1));
+
+        assert!(!tree.contains(101));
+        assert_eq!(tree.parent(102), Some(1));
+        assert_eq!(tree.nearest_agent(102), Some(100));
+        assert_eq!(tree.nearest_agent(103), Some(100));
+        assert!(tree.children(100).is_empty());
+        assert!(tree.children(1).contains(&102));
+    }
+
+    #[test]
+    fn test_reused_pid_does_not_adopt_children() {
+        let mut tree = agent_tree();
+
+        // The agent exits and a plain process gets its PID in the same delta
+        let mut reused = ProcessInfo::new(100, "bash".to_string());
+        reused.ppid = Some(1);
+        let delta = crate::monitor::ProcessDelta {
+            generation: 2,
+            removed: vec![100],
+            added: vec![reused],
+            ..Default::default()
+        };
+        tree.apply_delta(&delta, |_| false);
+
+        assert!(tree.children(100).is_empty());
+        assert_eq!(tree.parent(101), None);
+        assert_eq!(tree.agent_for(101), None);
+        assert_eq!(tree.agent_for(103), None);
+
+        // Reused by an agent: still not attributed the old processes
+        tree.set_agent(100, true);
+        assert_eq!(tree.agent_for(103), None);
+    }
+
+    #[test]
+    fn test_agent_exit_moves_attribution_up() {
+        let mut tree = agent_tree();
+        tree.insert(50, Some(1), true);
+        tree.reparent(100, Some(50));
+        assert_eq!(tree.agent_for(103), Some(100));
+
+        tree.remove(100);
+        tree.reparent(101, Some(1));
+        assert_eq!(tree.agent_for(101), Some(50));
+        assert_eq!(tree.agent_for(103), Some(50));
+    }
+
+    #[test]
+    fn test_reparent_under_other_agent() {
+        let mut tree = agent_tree();
+        tree.insert(300, Some(1), true);
+
+        tree.reparent(102, Some(300));
+        assert_eq!(tree.nearest_agent(102), Some(300));
+        assert_eq!(tree.nearest_agent(103), Some(300));
+    }
+
+    #[test]
+    fn test_set_agent_updates_descendants() {
+        let mut tree = agent_tree();
+
+        // A nested agent becomes the nearest ancestor for its subtree
+        tree.set_agent(102, true);
+        assert_eq!(tree.nearest_agent(103), Some(102));
+        assert_eq!(tree.nearest_agent(102), Some(100));
+
+        tree.set_agent(102, false);
+        assert_eq!(tree.nearest_agent(103), Some(100));
+
+        tree.set_agent(100, false);
+        assert!(!tree.is_descendant_of_agent(101));
+        assert!(!tree.is_descendant_of_agent(103));
+    }
+
+    #[test]
+    fn test_sync_from_snapshot() {
+        let mut processes = vec![
+            create_process_fixture(1, "init", None),
+            create_process_fixture(100, "claude", Some(1)),
+            create_process_fixture(101, "sh", Some(100)),
+        ];
+
+        let mut tree = ProcessTree::new();
+        let mut matched = 0;
+        let changes = tree.sync(&processes, |p| {
+            matched += 1;
+            p.name == "claude"
+        });
+        assert_eq!(changes.spawned.len(), 3);
+        assert!(changes.exited.is_empty());
+
+        // sh runs under the agent and is matched too
+        assert_eq!(matched, 3);
+        assert_eq!(tree.nearest_agent(101), Some(100));
+
+        // Next tick: sh exited, rustc appeared under the agent
+        processes.pop();
+        processes.push(create_process_fixture(102, "rustc", Some(100)));
+        let changes = tree.sync(&processes, |p| {
+            matched += 1;
+            p.name == "claude"
+        });
+        assert_eq!(changes.spawned, vec![102]);
+        assert_eq!(changes.exited, vec![101]);
+        assert_eq!(matched, 4);
+        assert!(tree.is_descendant_of_agent(102));
+    }
+
+    #[test]
+    fn test_solo_agent_does_not_claim_children() {
+        let mut tree = ProcessTree::new();
+        tree.insert(1, None, false);
+        tree.insert(100, Some(1), AgentRole::Solo);
+        tree.insert(101, Some(100), false);
+        assert!(tree.is_agent(100));
+        assert!(!tree.is_descendant_of_agent(101));
+
+        // Below a tracking agent, children of a solo agent go to the outer one
+        tree.insert(50, Some(1), true);
+        tree.reparent(100, Some(50));
+        assert_eq!(tree.nearest_agent(101), Some(50));
+
+        tree.set_agent(50, false);
+        assert!(!tree.is_descendant_of_agent(101));
+    }
+
+    #[test]
+    fn test_batch_roles_do_not_depend_on_order() {
+        // Children listed before their parents: an agent nested under a
+        // tracking agent is an agent itself and attributed to the outer one
+        let processes = vec![
+            create_process_fixture(102, "claude", Some(101)),
+            create_process_fixture(101, "sh", Some(100)),
+            create_process_fixture(100, "cursor", Some(1)),
+            create_process_fixture(1, "init", None),
+        ];
+        let mut tree = ProcessTree::new();
+        let mut matched = Vec::new();
+        tree.sync(&processes, |p| {
+            matched.push(p.pid);
+            p.name == "cursor" || p.name == "claude"
+        });
+
+        matched.sort();
+        assert_eq!(matched, vec![1, 100, 101, 102]);
+        assert!(tree.is_agent(102));
+        assert_eq!(tree.nearest_agent(102), Some(100));
+        assert_eq!(tree.agent_for(101), Some(100));
+    }
+
+    #[test]
+    fn test_rematch_goes_parents_first() {
+        let mut tree = agent_tree();
+        // 102 becomes an agent on its own, 100 stops being one
+        let mut changed = tree.rematch(|pid| pid == 102);
+        changed.sort();
+        assert_eq!(changed, vec![100, 102]);
+        assert_eq!(tree.nearest_agent(103), Some(102));
+        assert!(!tree.is_descendant_of_agent(101));
+
+        // Both match: 102 stays an agent, now under 100
+        let changed = tree.rematch(|pid| pid == 100 || pid == 102);
+        assert_eq!(changed, vec![100]);
+        assert!(tree.is_agent(102));
+        assert_eq!(tree.nearest_agent(102), Some(100));
+        assert_eq!(tree.nearest_agent(103), Some(102));
+        assert_eq!(tree.agent_for(101), Some(100));
+    }
+}
+
+// ============================================================================
+// Generation Delta Tests
+// ============================================================================
+
+mod delta_tests {
+    use super::*;
+    use crate::monitor::{ChangeLog, ProcessDelta};
+
+    fn delta(
+        log: &ChangeLog,
+        table: &HashMap<u32, ProcessInfo>,
+        since: u64,
+    ) -> ProcessDelta {
+        log.changes_since(
+            since,
+            |pid| table.get(&pid).cloned(),
+            || table.values().cloned().collect(),
+        )
+    }
+
+    #[test]
+    fn test_first_call_is_full_resync() {
+        let mut log = ChangeLog::new();
+        let mut table = HashMap::new();
+        for pid in [1, 2, 3] {
+            table.insert(pid, create_process_fixture(pid, "p", None));
+            log.added(pid);
+        }
+        assert_eq!(log.publish(), 1);
+
+        let d = delta(&log, &table, 0);
+        assert!(d.full_resync);
+        assert_eq!(d.generation, 1);
+        assert_eq!(d.added.len(), 3);
+    }
+
+    #[test]
+    fn test_delta_only_contains_churn() {
+        let mut log = ChangeLog::new();
+        let mut table = HashMap::new();
+        for pid in 1..=100 {
+            table.insert(pid, create_process_fixture(pid, "p", None));
+            log.added(pid);
+        }
+        let seen = log.publish();
+
+        table.remove(&7);
+        log.removed(7);
+        table.insert(200, create_process_fixture(200, "new", Some(1)));
+        log.added(200);
+        table.get_mut(&8).unwrap().cwd = Some("/tmp".to_string());
+        log.updated(8);
+        log.publish();
+
+        let d = delta(&log, &table, seen);
+        assert!(!d.full_resync);
+        assert_eq!(d.generation, seen + 1);
+        assert_eq!(d.removed, vec![7]);
+        assert_eq!(d.added.iter().map(|p| p.pid).collect::<Vec<_>>(), vec![200]);
+        assert_eq!(d.updated.iter().map(|p| p.pid).collect::<Vec<_>>(), vec![8]);
+
+        // Nothing changed since the latest generation
+        assert!(delta(&log, &table, d.generation).is_empty());
+        // Publishing without changes does not bump the generation
+        assert_eq!(log.publish(), d.generation);
+    }
+
+    #[test]
+    fn test_pid_reuse_reported_as_remove_and_add() {
+        let mut log = ChangeLog::new();
+        let mut table = HashMap::new();
+        table.insert(5, create_process_fixture(5, "old", None));
+        log.added(5);
+        let seen = log.publish();
+
+        log.removed(5);
+        log.publish();
+        table.insert(5, create_process_fixture(5, "new", None));
+        log.added(5);
+        log.publish();
+
+        let d = delta(&log, &table, seen);
+        assert_eq!(d.removed, vec![5]);
+        assert_eq!(d.added[0].name, "new");
+
+        let mut consumer: HashMap<u32, ProcessInfo> = HashMap::new();
+        consumer.insert(5, create_process_fixture(5, "old", None));
+        d.apply_to(&mut consumer);
+        assert_eq!(consumer[&5].name, "new");
+    }
+
+    #[test]
+    fn test_trimmed_log_forces_resync() {
+        let mut log = ChangeLog::with_capacity(4);
+        let mut table = HashMap::new();
+        for pid in 1..=10 {
+            table.insert(pid, create_process_fixture(pid, "p", None));
+            log.added(pid);
+            log.publish();
+        }
+
+        assert!(delta(&log, &table, 2).full_resync);
+        assert!(!delta(&log, &table, 8).full_resync);
+        // A generation from the future (e.g. another monitor) resyncs too
+        assert!(delta(&log, &table, 99).full_resync);
+    }
+
+    #[test]
+    fn test_merge_collapses_consecutive_deltas() {
+        let d1 = ProcessDelta {
+            generation: 2,
+            added: vec![create_process_fixture(10, "a", None)],
+            updated: vec![create_process_fixture(3, "three", None)],
+            ..Default::default()
+        };
+        let d2 = ProcessDelta {
+            generation: 3,
+            updated: vec![create_process_fixture(10, "a2", None)],
+            removed: vec![3],
+            ..Default::default()
+        };
+        let d3 = ProcessDelta {
+            generation: 4,
+            added: vec![create_process_fixture(11, "b", None)],
+            removed: vec![11],
+            ..Default::default()
+        };
+
+        let merged = ProcessDelta::merge([&d1, &d2, &d3]);
+        assert!(!merged.full_resync);
+        assert_eq!(merged.generation, 4);
+        // An added process that is later updated is still an add
+        assert_eq!(merged.added.iter().map(|p| p.name.as_str()).collect::<Vec<_>>(), vec!["a2", "b"]);
+        assert!(merged.updated.is_empty());
+        assert_eq!(merged.removed, vec![3, 11]);
+
+        // Same result as applying the deltas one by one
+        let mut stepwise: HashMap<u32, ProcessInfo> = HashMap::new();
+        stepwise.insert(3, create_process_fixture(3, "p", None));
+        let mut at_once = stepwise.clone();
+        for d in [&d1, &d2, &d3] {
+            d.apply_to(&mut stepwise);
+        }
+        merged.apply_to(&mut at_once);
+        let mut a: Vec<_> = stepwise.values().map(|p| (p.pid, p.name.clone())).collect();
+        let mut b: Vec<_> = at_once.values().map(|p| (p.pid, p.name.clone())).collect();
+        a.sort();
+        b.sort();
+        assert_eq!(a, b);
+
+        let resync = ProcessDelta::full(5, Vec::new());
+        assert!(ProcessDelta::merge([&d1, &resync]).full_resync);
+    }
+
+    #[test]
+    fn test_sysinfo_changes_since() {
+        use crate::monitor::SysinfoMonitor;
+
+        let mut monitor = SysinfoMonitor::new();
+        monitor.start().unwrap();
+
+        let full = monitor.changes_since(0).unwrap();
+        assert!(full.full_resync);
+        assert!(full.added.iter().any(|p| p.pid == std::process::id()));
+
+        let mut child = match std::process::Command::new("sleep").arg("30").spawn() {
+            Ok(child) => child,
+            Err(_) => return,
+        };
+        let d = monitor.changes_since(full.generation).unwrap();
+        assert!(!d.full_resync);
+        assert!(d.added.iter().any(|p| p.pid == child.id()));
+        assert!(d.added.len() < full.added.len());
+
+        child.kill().unwrap();
+        child.wait().unwrap();
+        let d2 = monitor.changes_since(d.generation).unwrap();
+        assert!(d2.removed.contains(&child.id()));
+    }
 }
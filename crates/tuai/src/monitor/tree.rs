@@ -0,0 +1,437 @@
+//! Incrementally maintained process tree
+//!
+//! Keeps parent → children adjacency and, for every process, a cached
+//! pointer to its nearest AI agent ancestor. Spawns, exits and reparents
+//! are applied one at a time, so ancestry questions ("is this rustc running
+//! under an agent?") are answered with a single lookup instead of walking
+//! the parent chain over a freshly built map.
+//!
+//! Attribution is sticky while the agent lives. When a child is reparented
+//! to init or a subreaper, it and its descendants keep pointing at the
+//! agent that started them: a daemonized child of an agent is still that
+//! agent's work. Once the agent itself exits, whatever pointed at it moves
+//! up to the agent above it, if any, so a process that later reuses the
+//! PID does not collect the old agent's processes.
+//!
+//! Only agents that track their children (`child_process_tracking`) pass
+//! attribution down; below other agents, processes inherit whatever is
+//! above the agent. Processes below a tracking agent are still matched,
+//! so an agent started by another one (claude in a Cursor terminal, a
+//! nested claude session) keeps its own identity: its processes are
+//! attributed to it, and it is attributed to the outer agent.
+
+use std::collections::{HashMap, HashSet};
+
+use tuai_common::ProcessInfo;
+
+use super::ProcessDelta;
+
+/// What detection made of a process
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum AgentRole {
+    /// Not an agent
+    #[default]
+    None,
+    /// An agent; processes below it are attributed to it
+    Tracking,
+    /// An agent whose children are not attributed to it
+    Solo,
+}
+
+impl AgentRole {
+    /// Whether the process is an agent itself
+    pub fn is_agent(self) -> bool {
+        self != AgentRole::None
+    }
+}
+
+impl From<bool> for AgentRole {
+    fn from(is_agent: bool) -> Self {
+        if is_agent {
+            AgentRole::Tracking
+        } else {
+            AgentRole::None
+        }
+    }
+}
+
+#[derive(Debug, Clone)]
+struct Node {
+    ppid: Option<u32>,
+    role: AgentRole,
+    /// Nearest agent strictly above this process
+    agent_ancestor: Option<u32>,
+}
+
+/// PIDs that appeared and disappeared in a [`ProcessTree::sync`]
+#[derive(Debug, Default, Clone, PartialEq, Eq)]
+pub struct TreeChanges {
+    pub spawned: Vec<u32>,
+    pub exited: Vec<u32>,
+}
+
+/// Process tree with cached agent ancestry
+#[derive(Debug, Default)]
+pub struct ProcessTree {
+    nodes: HashMap<u32, Node>,
+    /// Keyed by parent PID, which may not be in `nodes` (yet)
+    children: HashMap<u32, Vec<u32>>,
+}
+
+impl ProcessTree {
+    /// Create an empty tree
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Number of processes in the tree
+    pub fn len(&self) -> usize {
+        self.nodes.len()
+    }
+
+    /// Whether the tree is empty
+    pub fn is_empty(&self) -> bool {
+        self.nodes.is_empty()
+    }
+
+    /// Whether a process is in the tree
+    pub fn contains(&self, pid: u32) -> bool {
+        self.nodes.contains_key(&pid)
+    }
+
+    /// Whether a process was itself matched as an agent
+    pub fn is_agent(&self, pid: u32) -> bool {
+        self.nodes.get(&pid).map_or(false, |n| n.role.is_agent())
+    }
+
+    /// Detection result of a process
+    pub fn role(&self, pid: u32) -> AgentRole {
+        self.nodes.get(&pid).map_or(AgentRole::None, |n| n.role)
+    }
+
+    /// Parent of a process
+    pub fn parent(&self, pid: u32) -> Option<u32> {
+        self.nodes.get(&pid).and_then(|n| n.ppid)
+    }
+
+    /// Direct children of a process
+    pub fn children(&self, pid: u32) -> &[u32] {
+        self.children.get(&pid).map_or(&[], |c| c.as_slice())
+    }
+
+    /// Nearest agent strictly above a process
+    pub fn nearest_agent(&self, pid: u32) -> Option<u32> {
+        self.nodes.get(&pid).and_then(|n| n.agent_ancestor)
+    }
+
+    /// The agent a process is attributed to: itself, or its nearest agent ancestor
+    pub fn agent_for(&self, pid: u32) -> Option<u32> {
+        let node = self.nodes.get(&pid)?;
+        if node.role.is_agent() {
+            Some(pid)
+        } else {
+            node.agent_ancestor
+        }
+    }
+
+    /// The agent children of a process are attributed to
+    fn inherited(&self, pid: u32) -> Option<u32> {
+        let node = self.nodes.get(&pid)?;
+        match node.role {
+            AgentRole::Tracking => Some(pid),
+            AgentRole::Solo | AgentRole::None => node.agent_ancestor,
+        }
+    }
+
+    /// Whether a process runs (transitively) under an agent
+    pub fn is_descendant_of_agent(&self, pid: u32) -> bool {
+        self.nearest_agent(pid).is_some()
+    }
+
+    /// Iterate over a process and all its descendants (pre-order)
+    ///
+    /// Cost is proportional to the size of the subtree.
+    pub fn subtree(&self, pid: u32) -> impl Iterator<Item = u32> + '_ {
+        let mut stack = if self.nodes.contains_key(&pid) { vec![pid] } else { Vec::new() };
+        std::iter::from_fn(move || {
+            let pid = stack.pop()?;
+            stack.extend(self.children(pid).iter().rev().copied());
+            Some(pid)
+        })
+    }
+
+    /// Add a process, or update parent and role of a known one
+    pub fn insert(&mut self, pid: u32, ppid: Option<u32>, role: impl Into<AgentRole>) {
+        let role = role.into();
+        if self.nodes.contains_key(&pid) {
+            self.reparent(pid, ppid);
+            self.set_agent(pid, role);
+            return;
+        }
+
+        let agent_ancestor = ppid.and_then(|p| self.inherited(p));
+        self.nodes.insert(pid, Node { ppid, role, agent_ancestor });
+        if let Some(ppid) = ppid {
+            self.children.entry(ppid).or_default().push(pid);
+        }
+
+        // Children seen before their parent inherit from it now
+        if self.children.contains_key(&pid) {
+            self.propagate_below(pid);
+        }
+    }
+
+    /// Remove an exited process
+    ///
+    /// Its children are left without a parent until they are reparented,
+    /// so a new process reusing the PID does not adopt them. They keep
+    /// their attribution unless the exited process was the agent they
+    /// are attributed to (see the module docs).
+    pub fn remove(&mut self, pid: u32) {
+        let Some(node) = self.nodes.remove(&pid) else {
+            return;
+        };
+        if let Some(ppid) = node.ppid {
+            self.unlink_child(ppid, pid);
+        }
+        for child in self.children.remove(&pid).unwrap_or_default() {
+            if let Some(child) = self.nodes.get_mut(&child) {
+                child.ppid = None;
+            }
+        }
+        // Sticky attribution may point at the agent from anywhere in the
+        // tree; agents exit rarely enough for a full pass
+        if node.role.is_agent() {
+            for other in self.nodes.values_mut() {
+                if other.agent_ancestor == Some(pid) {
+                    other.agent_ancestor = node.agent_ancestor;
+                }
+            }
+        }
+    }
+
+    /// Move a process under a new parent
+    ///
+    /// The process takes the new parent's attribution if there is one and
+    /// otherwise keeps its own (see the module docs).
+    pub fn reparent(&mut self, pid: u32, new_ppid: Option<u32>) {
+        let Some(node) = self.nodes.get(&pid) else {
+            return;
+        };
+        let old_ppid = node.ppid;
+        if old_ppid == new_ppid {
+            return;
+        }
+
+        if let Some(old) = old_ppid {
+            self.unlink_child(old, pid);
+        }
+        if let Some(new) = new_ppid {
+            self.children.entry(new).or_default().push(pid);
+        }
+
+        let inherited = new_ppid.and_then(|p| self.inherited(p));
+        let node = self.nodes.get_mut(&pid).expect("checked above");
+        node.ppid = new_ppid;
+        if inherited.is_some() && inherited != node.agent_ancestor {
+            node.agent_ancestor = inherited;
+            if node.role != AgentRole::Tracking {
+                self.propagate_below(pid);
+            }
+        }
+    }
+
+    /// Mark or unmark a process as an agent
+    pub fn set_agent(&mut self, pid: u32, role: impl Into<AgentRole>) {
+        let role = role.into();
+        let Some(node) = self.nodes.get_mut(&pid) else {
+            return;
+        };
+        if node.role == role {
+            return;
+        }
+        node.role = role;
+        self.propagate_below(pid);
+    }
+
+    /// Bring the tree in line with a full snapshot
+    ///
+    /// `is_agent` is only called for processes not yet in the tree. Known
+    /// processes just have their parent checked.
+    pub fn sync<F, R>(&mut self, processes: &[ProcessInfo], is_agent: F) -> TreeChanges
+    where
+        F: FnMut(&ProcessInfo) -> R,
+        R: Into<AgentRole>,
+    {
+        let mut changes = TreeChanges::default();
+
+        let current: std::collections::HashSet<u32> = processes.iter().map(|p| p.pid).collect();
+        changes.exited = self
+            .nodes
+            .keys()
+            .filter(|pid| !current.contains(pid))
+            .copied()
+            .collect();
+        for pid in &changes.exited {
+            self.remove(*pid);
+        }
+
+        let mut spawned = Vec::new();
+        for process in processes {
+            match self.nodes.get(&process.pid) {
+                Some(node) => {
+                    if node.ppid != process.ppid {
+                        self.reparent(process.pid, process.ppid);
+                    }
+                }
+                None => spawned.push(process),
+            }
+        }
+        changes.spawned = spawned.iter().map(|p| p.pid).collect();
+        self.add_all(&spawned, is_agent);
+
+        changes
+    }
+
+    /// Apply a generation delta from the monitor
+    ///
+    /// Like [`sync`](Self::sync), `is_agent` is only called for added
+    /// processes, but the cost follows the size of the delta.
+    pub fn apply_delta<F, R>(&mut self, delta: &ProcessDelta, is_agent: F)
+    where
+        F: FnMut(&ProcessInfo) -> R,
+        R: Into<AgentRole>,
+    {
+        if delta.full_resync {
+            self.sync(&delta.added, is_agent);
+            return;
+        }
+
+        for pid in &delta.removed {
+            self.remove(*pid);
+        }
+        let added: Vec<&ProcessInfo> = delta.added.iter().collect();
+        self.add_all(&added, is_agent);
+        for process in &delta.updated {
+            self.reparent(process.pid, process.ppid);
+        }
+    }
+
+    /// Re-evaluate the role of every process, e.g. after signatures changed
+    ///
+    /// Goes parents first, so attribution below a process is settled
+    /// before its children are looked at. Returns the PIDs whose role
+    /// changed.
+    pub fn rematch<F, R>(&mut self, mut role_of: F) -> Vec<u32>
+    where
+        F: FnMut(u32) -> R,
+        R: Into<AgentRole>,
+    {
+        let pids: Vec<u32> = self.nodes.keys().copied().collect();
+        let mut changed = Vec::new();
+        for pid in self.parents_first(&pids) {
+            let role = role_of(pid).into();
+            if self.role(pid) != role {
+                self.set_agent(pid, role);
+                changed.push(pid);
+            }
+        }
+        changed
+    }
+
+    /// Re-evaluate the role of one known process, e.g. after it exec'd
+    ///
+    /// Returns whether the role changed.
+    pub fn redetect<F, R>(&mut self, pid: u32, role_of: F) -> bool
+    where
+        F: FnOnce() -> R,
+        R: Into<AgentRole>,
+    {
+        if !self.nodes.contains_key(&pid) {
+            return false;
+        }
+        let role = role_of().into();
+        if self.role(pid) == role {
+            return false;
+        }
+        self.set_agent(pid, role);
+        true
+    }
+
+    /// Insert new processes, deciding their roles parents first
+    ///
+    /// The whole batch is linked up before any role is decided, so the
+    /// outcome does not depend on the order processes come in.
+    fn add_all<F, R>(&mut self, processes: &[&ProcessInfo], mut is_agent: F)
+    where
+        F: FnMut(&ProcessInfo) -> R,
+        R: Into<AgentRole>,
+    {
+        let mut by_pid = HashMap::with_capacity(processes.len());
+        for process in processes {
+            self.insert(process.pid, process.ppid, AgentRole::None);
+            by_pid.insert(process.pid, *process);
+        }
+        let pids: Vec<u32> = processes.iter().map(|p| p.pid).collect();
+        for pid in self.parents_first(&pids) {
+            // Also below a tracking agent, so nested agents are tracked
+            let role = is_agent(by_pid[&pid]).into();
+            if role.is_agent() {
+                self.set_agent(pid, role);
+            }
+        }
+    }
+
+    /// `pids` ordered so that parents in the set come before their children
+    fn parents_first(&self, pids: &[u32]) -> Vec<u32> {
+        let set: HashSet<u32> = pids.iter().copied().collect();
+        let mut order = Vec::with_capacity(pids.len());
+        let mut stack: Vec<u32> = set
+            .iter()
+            .filter(|pid| self.parent(**pid).map_or(true, |ppid| !set.contains(&ppid)))
+            .copied()
+            .collect();
+        while let Some(pid) = stack.pop() {
+            order.push(pid);
+            stack.extend(self.children(pid).iter().filter(|c| set.contains(c)));
+        }
+        order
+    }
+
+    /// Recompute cached ancestors below `pid` after its attribution changed
+    fn propagate_below(&mut self, pid: u32) {
+        let mut stack = vec![pid];
+        while let Some(parent) = stack.pop() {
+            let inherited = self.inherited(parent);
+            let Some(children) = self.children.get(&parent) else {
+                continue;
+            };
+            for &child in children {
+                if let Some(node) = self.nodes.get_mut(&child) {
+                    // Sticky: an unattributed parent does not clear attribution
+                    if inherited.is_some() && node.agent_ancestor != inherited {
+                        node.agent_ancestor = inherited;
+                        if node.role != AgentRole::Tracking {
+                            stack.push(child);
+                        }
+                    } else if inherited.is_none() && node.agent_ancestor == Some(pid) {
+                        // `pid` stopped being an agent
+                        node.agent_ancestor = None;
+                        stack.push(child);
+                    }
+                }
+            }
+        }
+    }
+
+    fn unlink_child(&mut self, ppid: u32, pid: u32) {
+        if let Some(siblings) = self.children.get_mut(&ppid) {
+            if let Some(pos) = siblings.iter().position(|c| *c == pid) {
+                siblings.swap_remove(pos);
+            }
+            if siblings.is_empty() && !self.nodes.contains_key(&ppid) {
+                self.children.remove(&ppid);
+            }
+        }
+    }
+}
@@ -0,0 +1,528 @@
+//! Compiled endpoint classification
+//!
+//! Endpoint rules are lists of hostname suffixes and IP ranges per class,
+//! built in or loaded from a TOML file. They are compiled once:
+//! - hostname suffixes into a trie keyed by labels, read right to left
+//!   (`api.github.com` is `com` -> `github` -> `api`)
+//! - IP ranges into a binary prefix tree per address family
+//! - local LLM server ports into a 64K-bit set
+//!
+//! Classifying walks at most one trie node per label or address bit and
+//! does not allocate, so it can run on every connection event.
+
+use std::cmp::Ordering;
+use std::net::IpAddr;
+use std::path::Path;
+use std::sync::{Arc, OnceLock};
+
+use serde::{Deserialize, Serialize};
+use tuai_common::{PlatformError, PlatformResult};
+
+use super::EndpointClass;
+
+/// LLM API hosts
+pub const DEFAULT_LLM_API: &[&str] = &[
+    "api.anthropic.com",
+    "api.openai.com",
+    "api.cursor.sh",
+    "api.groq.com",
+    "api.together.xyz",
+    "api.mistral.ai",
+    "generativelanguage.googleapis.com",
+];
+
+/// Hostnames of local LLM servers (e.g. compose service names)
+pub const DEFAULT_LOCAL_LLM: &[&str] = &["ollama", "lmstudio", "localai"];
+
+/// Ports local LLM servers listen on by default
+pub const DEFAULT_LOCAL_LLM_PORTS: &[u16] = &[
+    11434, // Ollama
+    1234,  // LM Studio
+    8080,  // LocalAI, vLLM
+    5000,  // Various local servers
+    5001,  // Alternative local server port
+    8000,  // FastAPI/uvicorn
+    3000,  // Local LLM UIs
+];
+
+pub const DEFAULT_GITHUB: &[&str] = &["github.com", "githubusercontent.com"];
+
+pub const DEFAULT_PACKAGE_REGISTRY: &[&str] = &["npmjs.org", "pypi.org", "crates.io"];
+
+pub const DEFAULT_TELEMETRY: &[&str] = &["sentry.io", "statsig.com", "statsigapi.net", "amplitude.com"];
+
+pub const DEFAULT_LOCALHOST: &[&str] = &["localhost", "127.0.0.0/8", "::1"];
+
+/// Endpoint rules as written in the config file
+///
+/// Each class lists hostname suffixes (`github.com` also matches
+/// `api.github.com`, but not `notgithub.com`), IP addresses and CIDR
+/// ranges. When rules overlap, the longest match wins; on a tie the class
+/// listed first here wins.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct EndpointRules {
+    /// Include the built-in rules
+    #[serde(default = "default_true")]
+    pub include_defaults: bool,
+
+    #[serde(default)]
+    pub llm_api: Vec<String>,
+
+    #[serde(default)]
+    pub local_llm: Vec<String>,
+
+    /// Ports that make a loopback endpoint a local LLM server
+    #[serde(default)]
+    pub local_llm_ports: Vec<u16>,
+
+    #[serde(default)]
+    pub github: Vec<String>,
+
+    #[serde(default)]
+    pub package_registry: Vec<String>,
+
+    #[serde(default)]
+    pub telemetry: Vec<String>,
+
+    #[serde(default)]
+    pub localhost: Vec<String>,
+}
+
+fn default_true() -> bool {
+    true
+}
+
+impl Default for EndpointRules {
+    fn default() -> Self {
+        Self {
+            include_defaults: true,
+            llm_api: Vec::new(),
+            local_llm: Vec::new(),
+            local_llm_ports: Vec::new(),
+            github: Vec::new(),
+            package_registry: Vec::new(),
+            telemetry: Vec::new(),
+            localhost: Vec::new(),
+        }
+    }
+}
+
+impl EndpointRules {
+    /// Load endpoint rules from a TOML file
+    pub fn from_file(path: &Path) -> PlatformResult<Self> {
+        let contents = std::fs::read_to_string(path).map_err(|e| {
+            PlatformError::InitializationFailed(format!("Cannot read {}: {}", path.display(), e))
+        })?;
+        Self::from_str(&contents)
+    }
+
+    /// Load endpoint rules from a TOML string
+    pub fn from_str(contents: &str) -> PlatformResult<Self> {
+        toml::from_str(contents)
+            .map_err(|e| PlatformError::InitializationFailed(format!("Invalid endpoint rules: {}", e)))
+    }
+
+    /// Rules per class, in priority order
+    fn classes(&self) -> [(EndpointClass, &[String], &[&str]); 6] {
+        [
+            (EndpointClass::LlmApi, &self.llm_api, DEFAULT_LLM_API),
+            (EndpointClass::LocalLlm, &self.local_llm, DEFAULT_LOCAL_LLM),
+            (EndpointClass::GitHub, &self.github, DEFAULT_GITHUB),
+            (EndpointClass::PackageRegistry, &self.package_registry, DEFAULT_PACKAGE_REGISTRY),
+            (EndpointClass::Telemetry, &self.telemetry, DEFAULT_TELEMETRY),
+            (EndpointClass::Localhost, &self.localhost, DEFAULT_LOCALHOST),
+        ]
+    }
+}
+
+/// Endpoint rules compiled for lookup
+#[derive(Debug)]
+pub struct EndpointClassifier {
+    hosts: LabelTrie<EndpointClass>,
+    ipv4: PrefixTree<EndpointClass>,
+    ipv6: PrefixTree<EndpointClass>,
+    local_llm_ports: PortSet,
+}
+
+impl EndpointClassifier {
+    /// Compile endpoint rules
+    pub fn new(rules: &EndpointRules) -> PlatformResult<Self> {
+        let mut classifier = Self {
+            hosts: LabelTrie::new(),
+            ipv4: PrefixTree::new(),
+            ipv6: PrefixTree::new(),
+            local_llm_ports: PortSet::new(),
+        };
+
+        for (class, custom, defaults) in rules.classes() {
+            let defaults = if rules.include_defaults { defaults } else { &[] };
+            for rule in defaults.iter().copied().chain(custom.iter().map(String::as_str)) {
+                classifier.add(rule, class)?;
+            }
+        }
+
+        let default_ports = if rules.include_defaults { DEFAULT_LOCAL_LLM_PORTS } else { &[] };
+        for &port in default_ports.iter().chain(&rules.local_llm_ports) {
+            classifier.local_llm_ports.insert(port);
+        }
+
+        Ok(classifier)
+    }
+
+    /// The built-in rules, compiled once
+    pub fn builtin() -> Arc<Self> {
+        static BUILTIN: OnceLock<Arc<EndpointClassifier>> = OnceLock::new();
+        BUILTIN
+            .get_or_init(|| {
+                Arc::new(Self::new(&EndpointRules::default()).expect("built-in endpoint rules are valid"))
+            })
+            .clone()
+    }
+
+    /// Classify a remote host (name or IP address) and port
+    ///
+    /// Loopback and unspecified addresses on a local LLM port are
+    /// `LocalLlm`.
+    pub fn classify(&self, host: &str, port: Option<u16>) -> EndpointClass {
+        let host = host.trim_start_matches('[').trim_end_matches(']');
+        let (class, local_ip) = match host.parse::<IpAddr>() {
+            Ok(ip) => {
+                let ip = canonical(ip);
+                let class = match ip {
+                    IpAddr::V4(v4) => self.ipv4.matches(u32::from(v4).into(), 32).last(),
+                    IpAddr::V6(v6) => self.ipv6.matches(u128::from(v6), 128).last(),
+                };
+                (class.copied(), ip.is_loopback() || ip.is_unspecified())
+            }
+            Err(_) => (self.hosts.matches(host).last().copied(), false),
+        };
+
+        let on_llm_port = port.is_some_and(|port| self.local_llm_ports.contains(port));
+        match class {
+            Some(EndpointClass::Localhost) if on_llm_port => EndpointClass::LocalLlm,
+            None if local_ip && on_llm_port => EndpointClass::LocalLlm,
+            Some(class) => class,
+            None => EndpointClass::Unknown,
+        }
+    }
+
+    /// Classify `host`, `host:port`, `ip`, `ip:port` or `[ipv6]:port`
+    pub fn classify_addr(&self, addr: &str) -> EndpointClass {
+        let (host, port) = split_host_port(addr);
+        self.classify(host, port)
+    }
+
+    fn add(&mut self, rule: &str, class: EndpointClass) -> PlatformResult<()> {
+        // An earlier, higher-priority rule for the same suffix or range wins
+        let slot = match Rule::parse(rule)? {
+            Rule::Host(host) => self.hosts.insert(host),
+            Rule::V4(addr, len) => self.ipv4.insert(addr.into(), 32, len),
+            Rule::V6(addr, len) => self.ipv6.insert(addr, 128, len),
+        };
+        slot.get_or_insert(class);
+        Ok(())
+    }
+}
+
+/// A hostname suffix, IP address or CIDR range
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(super) enum Rule<'a> {
+    Host(&'a str),
+    /// Address and prefix length
+    V4(u32, u8),
+    V6(u128, u8),
+}
+
+impl<'a> Rule<'a> {
+    pub(super) fn parse(rule: &'a str) -> PlatformResult<Self> {
+        let invalid = || PlatformError::InitializationFailed(format!("Invalid endpoint rule: {:?}", rule));
+
+        let (addr, prefix) = match rule.split_once('/') {
+            Some((addr, prefix)) => (addr, Some(prefix.parse::<u8>().map_err(|_| invalid())?)),
+            None => (rule, None),
+        };
+        match addr.parse::<IpAddr>().map(canonical) {
+            Ok(IpAddr::V4(v4)) => match prefix.unwrap_or(32) {
+                len @ 0..=32 => Ok(Rule::V4(u32::from(v4), len)),
+                _ => Err(invalid()),
+            },
+            Ok(IpAddr::V6(v6)) => match prefix.unwrap_or(128) {
+                len @ 0..=128 => Ok(Rule::V6(u128::from(v6), len)),
+                _ => Err(invalid()),
+            },
+            Err(_) if prefix.is_none() && !rule.is_empty() => Ok(Rule::Host(rule)),
+            Err(_) => Err(invalid()),
+        }
+    }
+}
+
+/// IPv4-mapped IPv6 addresses are looked up as IPv4
+pub(super) fn canonical(ip: IpAddr) -> IpAddr {
+    match ip {
+        IpAddr::V6(v6) => v6.to_ipv4_mapped().map_or(ip, IpAddr::V4),
+        v4 => v4,
+    }
+}
+
+pub(super) fn split_host_port(addr: &str) -> (&str, Option<u16>) {
+    if let Some(rest) = addr.strip_prefix('[') {
+        if let Some((host, tail)) = rest.split_once(']') {
+            return (host, tail.strip_prefix(':').and_then(|p| p.parse().ok()));
+        }
+    }
+    match addr.rsplit_once(':') {
+        // More than one colon: a bare IPv6 address
+        Some((host, port)) if !host.contains(':') => (host, port.parse().ok()),
+        _ => (addr, None),
+    }
+}
+
+/// Values keyed by hostname suffix, with labels read from the right
+#[derive(Debug)]
+pub(super) struct LabelTrie<T> {
+    nodes: Vec<LabelNode<T>>,
+}
+
+#[derive(Debug)]
+struct LabelNode<T> {
+    /// Lowercase label -> node index, sorted by label
+    children: Vec<(Box<str>, usize)>,
+    value: Option<T>,
+}
+
+impl<T> LabelNode<T> {
+    fn new() -> Self {
+        Self {
+            children: Vec::new(),
+            value: None,
+        }
+    }
+}
+
+impl<T> LabelTrie<T> {
+    pub(super) fn new() -> Self {
+        Self {
+            nodes: vec![LabelNode::new()],
+        }
+    }
+
+    /// Value slot of a suffix, created empty if missing
+    pub(super) fn insert(&mut self, suffix: &str) -> &mut Option<T> {
+        let mut node = 0;
+        for label in labels(suffix) {
+            let label = label.to_ascii_lowercase();
+            node = match self.nodes[node].children.binary_search_by(|(l, _)| (**l).cmp(&label)) {
+                Ok(i) => self.nodes[node].children[i].1,
+                Err(i) => {
+                    let child = self.nodes.len();
+                    self.nodes.push(LabelNode::new());
+                    self.nodes[node].children.insert(i, (label.into_boxed_str(), child));
+                    child
+                }
+            };
+        }
+        &mut self.nodes[node].value
+    }
+
+    /// Values of every suffix of `host`, shortest first
+    pub(super) fn matches<'a>(&'a self, host: &'a str) -> impl Iterator<Item = &'a T> + 'a {
+        let mut node = 0;
+        let mut labels = labels(host);
+        std::iter::from_fn(move || {
+            while node != NO_NODE {
+                let label = labels.next()?;
+                let children = &self.nodes[node].children;
+                node = match children.binary_search_by(|(l, _)| cmp_lowercase(l, label)) {
+                    Ok(i) => children[i].1,
+                    // No longer suffix can match
+                    Err(_) => NO_NODE,
+                };
+                if let Some(value) = self.nodes.get(node).and_then(|n| n.value.as_ref()) {
+                    return Some(value);
+                }
+            }
+            None
+        })
+    }
+}
+
+/// Marks the end of a trie walk
+const NO_NODE: usize = usize::MAX;
+
+/// Labels of a hostname, right to left
+fn labels(host: &str) -> impl Iterator<Item = &str> {
+    host.trim_end_matches('.').rsplit('.')
+}
+
+/// Compare a lowercase label with one of any case
+fn cmp_lowercase(lower: &str, label: &str) -> Ordering {
+    lower.bytes().cmp(label.bytes().map(|b| b.to_ascii_lowercase()))
+}
+
+/// Values keyed by IP range, as a binary trie over address bits
+#[derive(Debug)]
+pub(super) struct PrefixTree<T> {
+    nodes: Vec<PrefixNode<T>>,
+}
+
+#[derive(Debug)]
+struct PrefixNode<T> {
+    /// Child per bit value; 0 means none (the root is never a child)
+    children: [usize; 2],
+    value: Option<T>,
+}
+
+impl<T> PrefixNode<T> {
+    fn new() -> Self {
+        Self {
+            children: [0; 2],
+            value: None,
+        }
+    }
+}
+
+impl<T> PrefixTree<T> {
+    pub(super) fn new() -> Self {
+        Self {
+            nodes: vec![PrefixNode::new()],
+        }
+    }
+
+    /// Value slot of the first `len` bits of a `width`-bit address
+    pub(super) fn insert(&mut self, addr: u128, width: u8, len: u8) -> &mut Option<T> {
+        let mut node = 0;
+        for i in 0..len {
+            let bit = bit_at(addr, width, i);
+            if self.nodes[node].children[bit] == 0 {
+                self.nodes[node].children[bit] = self.nodes.len();
+                self.nodes.push(PrefixNode::new());
+            }
+            node = self.nodes[node].children[bit];
+        }
+        &mut self.nodes[node].value
+    }
+
+    /// Values of every prefix containing `addr`, shortest first
+    pub(super) fn matches(&self, addr: u128, width: u8) -> impl Iterator<Item = &T> + '_ {
+        let mut node = 0;
+        let mut depth = 0;
+        std::iter::from_fn(move || {
+            while node != NO_NODE {
+                let current = node;
+                node = if depth < width {
+                    match self.nodes[current].children[bit_at(addr, width, depth)] {
+                        0 => NO_NODE,
+                        child => child,
+                    }
+                } else {
+                    NO_NODE
+                };
+                depth += 1;
+                if let Some(value) = &self.nodes[current].value {
+                    return Some(value);
+                }
+            }
+            None
+        })
+    }
+}
+
+/// Bit `i` of a `width`-bit address, counting from the most significant
+fn bit_at(addr: u128, width: u8, i: u8) -> usize {
+    ((addr >> (width - 1 - i)) & 1) as usize
+}
+
+/// One bit per TCP/UDP port
+#[derive(Debug)]
+struct PortSet {
+    words: Box<[u64; 1024]>,
+}
+
+impl PortSet {
+    fn new() -> Self {
+        Self {
+            words: Box::new([0; 1024]),
+        }
+    }
+
+    fn insert(&mut self, port: u16) {
+        self.words[usize::from(port / 64)] |= 1 << (port % 64);
+    }
+
+    fn contains(&self, port: u16) -> bool {
+        self.words[usize::from(port / 64)] & (1 << (port % 64)) != 0
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_suffixes_match_on_label_boundaries() {
+        let classifier = EndpointClassifier::builtin();
+        assert_eq!(classifier.classify("api.github.com", None), EndpointClass::GitHub);
+        assert_eq!(classifier.classify("API.GitHub.com.", None), EndpointClass::GitHub);
+        assert_eq!(classifier.classify("notgithub.com", None), EndpointClass::Unknown);
+        assert_eq!(classifier.classify("github.com.evil.net", None), EndpointClass::Unknown);
+        assert_eq!(classifier.classify("anthropic.com", None), EndpointClass::Unknown);
+    }
+
+    #[test]
+    fn test_ip_ranges_and_local_llm_ports() {
+        let classifier = EndpointClassifier::builtin();
+        assert_eq!(classifier.classify("127.0.0.5", Some(22)), EndpointClass::Localhost);
+        assert_eq!(classifier.classify("127.0.0.1", Some(11434)), EndpointClass::LocalLlm);
+        assert_eq!(classifier.classify("::ffff:127.0.0.1", None), EndpointClass::Localhost);
+        assert_eq!(classifier.classify("0.0.0.0", Some(8080)), EndpointClass::LocalLlm);
+        assert_eq!(classifier.classify("0.0.0.0", Some(22)), EndpointClass::Unknown);
+        assert_eq!(classifier.classify("8.8.8.8", Some(11434)), EndpointClass::Unknown);
+        assert_eq!(classifier.classify("ollama", Some(11434)), EndpointClass::LocalLlm);
+
+        assert_eq!(classifier.classify_addr("127.0.0.1:1234"), EndpointClass::LocalLlm);
+        assert_eq!(classifier.classify_addr("[::1]:11434"), EndpointClass::LocalLlm);
+        assert_eq!(classifier.classify_addr("::1"), EndpointClass::Localhost);
+        assert_eq!(classifier.classify_addr("localhost:3000"), EndpointClass::LocalLlm);
+    }
+
+    #[test]
+    fn test_rules_from_toml() {
+        let rules = EndpointRules::from_str(
+            r#"
+            llm_api = ["llm.corp.example", "10.20.0.0/16"]
+            local_llm_ports = [9999]
+            telemetry = ["10.20.30.0/24"]
+            "#,
+        )
+        .unwrap();
+        let classifier = EndpointClassifier::new(&rules).unwrap();
+
+        assert_eq!(classifier.classify("gw.llm.corp.example", None), EndpointClass::LlmApi);
+        assert_eq!(classifier.classify("10.20.1.1", None), EndpointClass::LlmApi);
+        // Longest prefix wins over class priority
+        assert_eq!(classifier.classify("10.20.30.40", None), EndpointClass::Telemetry);
+        assert_eq!(classifier.classify("127.0.0.1", Some(9999)), EndpointClass::LocalLlm);
+        // Defaults still apply
+        assert_eq!(classifier.classify("api.openai.com", None), EndpointClass::LlmApi);
+    }
+
+    #[test]
+    fn test_without_defaults() {
+        let rules = EndpointRules::from_str("include_defaults = false\ngithub = [\"git.corp\"]").unwrap();
+        let classifier = EndpointClassifier::new(&rules).unwrap();
+        assert_eq!(classifier.classify("git.corp", None), EndpointClass::GitHub);
+        assert_eq!(classifier.classify("github.com", None), EndpointClass::Unknown);
+        assert_eq!(classifier.classify("127.0.0.1", Some(11434)), EndpointClass::Unknown);
+    }
+
+    #[test]
+    fn test_invalid_rules() {
+        for rule in ["10.0.0.0/33", "::/129", "example.com/8", ""] {
+            let rules = EndpointRules {
+                github: vec![rule.to_string()],
+                ..EndpointRules::default()
+            };
+            assert!(EndpointClassifier::new(&rules).is_err(), "{:?}", rule);
+        }
+    }
+}
@@ -0,0 +1,217 @@
+//! Live connection table and lifecycle diffing
+//!
+//! Each sample of the watched connections is diffed against the table of
+//! live connections. New entries are reported as opened, entries whose
+//! state changed as state changes, and entries missing from the sample as
+//! closed, along with how long they were open. Closed connections leave
+//! the table, so its size follows the number of live connections.
+
+use std::collections::hash_map::Entry;
+use std::collections::HashMap;
+
+use chrono::{DateTime, Utc};
+use tuai_common::{ConnectionEvent, ConnectionEventType, ConnectionInfo, ConnectionState, Protocol};
+
+/// What identifies a connection across samples
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+struct ConnectionKey {
+    pid: u32,
+    protocol: Protocol,
+    local_addr: Option<String>,
+    local_port: Option<u16>,
+    remote_addr: Option<String>,
+    remote_port: Option<u16>,
+}
+
+impl ConnectionKey {
+    fn of(conn: &ConnectionInfo) -> Self {
+        Self {
+            pid: conn.pid,
+            protocol: conn.protocol.clone(),
+            local_addr: conn.local_addr.clone(),
+            local_port: conn.local_port,
+            remote_addr: conn.remote_addr.clone(),
+            remote_port: conn.remote_port,
+        }
+    }
+}
+
+#[derive(Debug)]
+struct LiveConnection {
+    /// As first reported, with the latest state and counters
+    info: ConnectionInfo,
+    opened_at: DateTime<Utc>,
+    /// Sample in which the connection was last seen
+    last_seen: u64,
+}
+
+/// Connections alive as of the last sample
+#[derive(Debug, Default)]
+pub struct ConnectionTable {
+    live: HashMap<ConnectionKey, LiveConnection>,
+    /// Number of samples taken
+    samples: u64,
+}
+
+impl ConnectionTable {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Number of live connections
+    pub fn len(&self) -> usize {
+        self.live.len()
+    }
+
+    /// Whether no connection is live
+    pub fn is_empty(&self) -> bool {
+        self.live.is_empty()
+    }
+
+    /// Live connections, each under the id it was first reported with
+    pub fn connections(&self) -> Vec<ConnectionInfo> {
+        self.live.values().map(|live| live.info.clone()).collect()
+    }
+
+    /// Diff a full sample of the watched connections against the table
+    pub fn update(&mut self, sample: &[ConnectionInfo], now: DateTime<Utc>) -> Vec<ConnectionEvent> {
+        self.samples += 1;
+        let sample_id = self.samples;
+        let mut events = Vec::new();
+
+        for conn in sample {
+            match self.live.entry(ConnectionKey::of(conn)) {
+                Entry::Vacant(entry) => {
+                    let mut info = conn.clone();
+                    info.timestamp = now;
+                    events.push(event(ConnectionEventType::Opened, info.clone(), None, None, now));
+                    entry.insert(LiveConnection {
+                        info,
+                        opened_at: now,
+                        last_seen: sample_id,
+                    });
+                }
+                Entry::Occupied(mut entry) => {
+                    let live = entry.get_mut();
+                    live.last_seen = sample_id;
+                    live.info.stats = conn.stats;
+                    if live.info.state != conn.state {
+                        let previous = std::mem::replace(&mut live.info.state, conn.state.clone());
+                        live.info.timestamp = now;
+                        events.push(event(
+                            ConnectionEventType::StateChanged,
+                            live.info.clone(),
+                            Some(previous),
+                            Some(duration_ms(live.opened_at, now)),
+                            now,
+                        ));
+                    }
+                }
+            }
+        }
+
+        self.live.retain(|_, live| {
+            if live.last_seen == sample_id {
+                return true;
+            }
+            let mut info = live.info.clone();
+            let previous = std::mem::replace(&mut info.state, ConnectionState::Closed);
+            info.timestamp = now;
+            events.push(event(
+                ConnectionEventType::Closed,
+                info,
+                Some(previous),
+                Some(duration_ms(live.opened_at, now)),
+                now,
+            ));
+            false
+        });
+
+        events
+    }
+}
+
+fn event(
+    event_type: ConnectionEventType,
+    connection: ConnectionInfo,
+    previous_state: Option<ConnectionState>,
+    duration_ms: Option<u64>,
+    timestamp: DateTime<Utc>,
+) -> ConnectionEvent {
+    ConnectionEvent {
+        event_type,
+        connection,
+        previous_state,
+        duration_ms,
+        timestamp,
+    }
+}
+
+fn duration_ms(from: DateTime<Utc>, to: DateTime<Utc>) -> u64 {
+    (to - from).num_milliseconds().max(0) as u64
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use chrono::Duration;
+
+    fn tcp(pid: u32, remote_port: u16, state: ConnectionState) -> ConnectionInfo {
+        let mut conn = ConnectionInfo::new(pid, Protocol::Tcp);
+        conn.local_addr = Some("10.0.0.2".to_string());
+        conn.local_port = Some(50000 + remote_port);
+        conn.remote_addr = Some("1.1.1.1".to_string());
+        conn.remote_port = Some(remote_port);
+        conn.state = state;
+        conn
+    }
+
+    fn types(events: &[ConnectionEvent]) -> Vec<ConnectionEventType> {
+        events.iter().map(|e| e.event_type).collect()
+    }
+
+    #[test]
+    fn test_lifecycle() {
+        let mut table = ConnectionTable::new();
+        let t0 = Utc::now();
+
+        let opened = table.update(&[tcp(1, 443, ConnectionState::Connecting)], t0);
+        assert_eq!(types(&opened), vec![ConnectionEventType::Opened]);
+        let id = opened[0].connection.id;
+
+        // Same connection with a new state; fresh ids from the backend are ignored
+        let t1 = t0 + Duration::milliseconds(250);
+        let changed = table.update(&[tcp(1, 443, ConnectionState::Established)], t1);
+        assert_eq!(types(&changed), vec![ConnectionEventType::StateChanged]);
+        assert_eq!(changed[0].connection.id, id);
+        assert_eq!(changed[0].previous_state, Some(ConnectionState::Connecting));
+        assert_eq!(changed[0].duration_ms, Some(250));
+
+        // Unchanged: nothing to report
+        assert!(table.update(&[tcp(1, 443, ConnectionState::Established)], t1).is_empty());
+
+        let t2 = t0 + Duration::seconds(3);
+        let closed = table.update(&[], t2);
+        assert_eq!(types(&closed), vec![ConnectionEventType::Closed]);
+        assert_eq!(closed[0].connection.id, id);
+        assert_eq!(closed[0].connection.state, ConnectionState::Closed);
+        assert_eq!(closed[0].previous_state, Some(ConnectionState::Established));
+        assert_eq!(closed[0].duration_ms, Some(3000));
+        assert!(table.is_empty());
+    }
+
+    #[test]
+    fn test_table_only_holds_live_connections() {
+        let mut table = ConnectionTable::new();
+        let now = Utc::now();
+
+        for round in 0..100u16 {
+            let sample: Vec<_> = (0..10)
+                .map(|i| tcp(1, round * 10 + i, ConnectionState::Established))
+                .collect();
+            table.update(&sample, now);
+            assert_eq!(table.len(), 10);
+        }
+        assert_eq!(table.connections().len(), 10);
+    }
+}
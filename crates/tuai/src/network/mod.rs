@@ -1,8 +1,26 @@
 //! Network connection monitoring
 //!
 //! Tracks TCP/UDP connections and correlates them with processes.
+//! Successive samples are diffed into open, state change and close events,
+//! published on `NetworkMonitorService::subscribe`.
+//!
+//! On Linux, sockets are dumped through NETLINK_SOCK_DIAG when available,
+//! with the /proc/net text tables as the fallback. The dump only sees
+//! tuai's own network namespace; agents in other namespaces are still read
+//! through their /proc/<pid>/net tables.
+//!
+//! Connections of agents are checked against the endpoints their
+//! signatures expect (see `EndpointPolicy`).
 
+mod classifier;
+mod lifecycle;
+mod net_table;
+mod policy;
 mod proc_net;
+mod socket_index;
+mod throughput;
+#[cfg(target_os = "linux")]
+mod sock_diag;
 // Always compiled so parse_netstat_output tests run on any platform.
 // Only used as the active backend on Windows (see NetworkMonitorService::new).
 mod windows_net;
@@ -10,42 +28,113 @@ mod windows_net;
 #[cfg(test)]
 mod tests;
 
-use std::collections::HashMap;
+use std::collections::HashSet;
 use std::sync::Arc;
 
-use parking_lot::RwLock;
-use tuai_common::{ConnectionInfo, PlatformResult};
+use chrono::Utc;
+use parking_lot::Mutex;
+use tuai_common::{ConnectionEvent, ConnectionInfo, PlatformResult};
 use tokio::sync::broadcast;
 
+pub use classifier::{EndpointClassifier, EndpointRules};
+pub use lifecycle::ConnectionTable;
+pub use net_table::{parse_table, SocketRow, TableKind};
+pub use policy::{resolve_host, reverse_lookup, spawn_refresh, EndpointPolicy, ReverseDns, Verdict};
 pub use proc_net::ProcNetMonitor;
+pub use socket_index::SocketIndex;
+pub use throughput::{FlowStats, ThroughputTracker};
+#[cfg(target_os = "linux")]
+pub use sock_diag::SockDiagMonitor;
 pub use windows_net::WindowsNetMonitor;
 
+/// Which network backend to use
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum NetworkBackend {
+    /// sock_diag when available, else /proc/net
+    #[default]
+    Auto,
+    /// NETLINK_SOCK_DIAG (Linux)
+    SockDiag,
+    /// /proc/net text tables
+    ProcNet,
+}
+
+impl NetworkBackend {
+    /// Parse a backend name as given on the command line
+    pub fn parse(name: &str) -> Option<Self> {
+        match name {
+            "auto" => Some(Self::Auto),
+            "sock-diag" | "sock_diag" => Some(Self::SockDiag),
+            "procfs" | "proc-net" => Some(Self::ProcNet),
+            _ => None,
+        }
+    }
+}
+
 /// Network monitor service
 pub struct NetworkMonitorService {
     inner: Box<dyn NetworkMonitorBackend>,
-    event_tx: broadcast::Sender<ConnectionInfo>,
-    /// Cache of known connections by (pid, remote_addr, remote_port)
-    connection_cache: Arc<RwLock<HashMap<(u32, String, u16), ConnectionInfo>>>,
+    backend_name: &'static str,
+    event_tx: broadcast::Sender<ConnectionEvent>,
+    /// Connections alive as of the last poll
+    live: Mutex<ConnectionTable>,
+    classifier: Arc<EndpointClassifier>,
+    /// Traffic per agent and remote endpoint
+    throughput: Mutex<ThroughputTracker>,
 }
 
 impl NetworkMonitorService {
-    /// Create a new network monitor service
+    /// Create a new network monitor service with the best available backend
     pub fn new() -> Self {
+        Self::with_backend(NetworkBackend::Auto)
+    }
+
+    /// Create a network monitor service using `backend`
+    ///
+    /// On Linux, sock_diag falls back to /proc/net if it is not available.
+    /// Windows always uses netstat.
+    pub fn with_backend(backend: NetworkBackend) -> Self {
         let (event_tx, _) = broadcast::channel(1000);
 
         #[cfg(target_os = "windows")]
-        let inner: Box<dyn NetworkMonitorBackend> = Box::new(WindowsNetMonitor::new());
+        let (inner, backend_name): (Box<dyn NetworkMonitorBackend>, _) = {
+            let _ = backend;
+            (Box::new(WindowsNetMonitor::new()), "netstat")
+        };
 
-        #[cfg(not(target_os = "windows"))]
-        let inner: Box<dyn NetworkMonitorBackend> = Box::new(ProcNetMonitor::new());
+        #[cfg(target_os = "linux")]
+        let (inner, backend_name): (Box<dyn NetworkMonitorBackend>, _) = match backend {
+            NetworkBackend::Auto | NetworkBackend::SockDiag if SockDiagMonitor::is_available() => {
+                (Box::new(SockDiagMonitor::new()), "sock_diag")
+            }
+            NetworkBackend::SockDiag => {
+                tracing::warn!("sock_diag not available, falling back to /proc/net");
+                (Box::new(ProcNetMonitor::new()), "procfs")
+            }
+            _ => (Box::new(ProcNetMonitor::new()), "procfs"),
+        };
+
+        #[cfg(not(any(target_os = "windows", target_os = "linux")))]
+        let (inner, backend_name): (Box<dyn NetworkMonitorBackend>, _) = {
+            let _ = backend;
+            (Box::new(ProcNetMonitor::new()), "procfs")
+        };
 
         Self {
             inner,
+            backend_name,
             event_tx,
-            connection_cache: Arc::new(RwLock::new(HashMap::new())),
+            live: Mutex::new(ConnectionTable::new()),
+            classifier: EndpointClassifier::builtin(),
+            throughput: Mutex::new(ThroughputTracker::new()),
         }
     }
 
+    /// Get the name of the active backend
+    pub fn backend_name(&self) -> &'static str {
+        self.backend_name
+    }
+
     /// Start monitoring
     pub fn start(&mut self) -> PlatformResult<()> {
         self.inner.start()
@@ -66,88 +155,82 @@ impl NetworkMonitorService {
         self.inner.snapshot()
     }
 
+    /// Get connections of the given PIDs only
+    ///
+    /// Cost scales with the number of PIDs, not with the number of
+    /// processes on the host.
+    pub fn snapshot_for(&self, pids: &[u32]) -> PlatformResult<Vec<ConnectionInfo>> {
+        self.inner.snapshot_for(pids)
+    }
+
     /// Get connections for a specific PID
     pub fn connections_for_pid(&self, pid: u32) -> PlatformResult<Vec<ConnectionInfo>> {
-        let all = self.snapshot()?;
-        Ok(all.into_iter().filter(|c| c.pid == pid).collect())
+        self.snapshot_for(&[pid])
     }
 
-    /// Subscribe to connection events
-    pub fn subscribe(&self) -> broadcast::Receiver<ConnectionInfo> {
+    /// Sample the connections of `pids` and publish what changed
+    ///
+    /// The sample is diffed against the connections seen on the previous
+    /// poll; opened, changed and closed connections are sent to
+    /// subscribers, and socket counters are added to the throughput
+    /// totals of the agent `agent_of` attributes each PID to. Returns the
+    /// live connections, each keeping the id it was first reported with.
+    pub fn poll_for<A>(&self, pids: &[u32], agent_of: A) -> PlatformResult<Vec<ConnectionInfo>>
+    where
+        A: Fn(u32) -> u32,
+    {
+        let sample = self.snapshot_for(pids)?;
+        let now = Utc::now();
+        let connections = {
+            let mut live = self.live.lock();
+            for event in live.update(&sample, now) {
+                // No subscribers is fine
+                let _ = self.event_tx.send(event);
+            }
+            live.connections()
+        };
+        self.throughput.lock().record(&connections, &self.classifier, agent_of, now);
+        Ok(connections)
+    }
+
+    /// Traffic per (agent, endpoint class, remote address) as of the last poll
+    pub fn throughput(&self) -> Vec<FlowStats> {
+        self.throughput.lock().flows(Utc::now())
+    }
+
+    /// Subscribe to connection lifecycle events
+    pub fn subscribe(&self) -> broadcast::Receiver<ConnectionEvent> {
         self.event_tx.subscribe()
     }
 
-    /// Check if a remote address is a known API endpoint
-    pub fn classify_endpoint(remote_addr: &str) -> EndpointClass {
-        // Check against known API endpoints (including local LLM servers)
-        if remote_addr.contains("api.anthropic.com")
-            || remote_addr.contains("api.openai.com")
-            || remote_addr.contains("api.cursor.sh")
-            || remote_addr.contains("api.groq.com")
-            || remote_addr.contains("api.together.xyz")
-            || remote_addr.contains("api.mistral.ai")
-            || remote_addr.contains("generativelanguage.googleapis.com")
-        {
-            EndpointClass::LlmApi
-        } else if Self::is_local_llm_endpoint(remote_addr) {
-            EndpointClass::LocalLlm
-        } else if remote_addr.contains("github.com")
-            || remote_addr.contains("api.github.com")
-            || remote_addr.contains("githubusercontent.com")
-        {
-            EndpointClass::GitHub
-        } else if remote_addr.contains("npmjs.org")
-            || remote_addr.contains("registry.npmjs.org")
-            || remote_addr.contains("pypi.org")
-            || remote_addr.contains("crates.io")
-        {
-            EndpointClass::PackageRegistry
-        } else if remote_addr.contains("sentry.io")
-            || remote_addr.contains("statsig")
-            || remote_addr.contains("amplitude")
-        {
-            EndpointClass::Telemetry
-        } else if remote_addr.starts_with("127.")
-            || remote_addr.starts_with("localhost")
-            || remote_addr == "::1"
-        {
-            EndpointClass::Localhost
-        } else {
-            EndpointClass::Unknown
-        }
+    /// Get the connection event sender, for subscribing later
+    pub fn event_sender(&self) -> broadcast::Sender<ConnectionEvent> {
+        self.event_tx.clone()
     }
 
-    /// Check if an endpoint is a local LLM server (Ollama, LM Studio, LocalAI, etc.)
-    fn is_local_llm_endpoint(remote_addr: &str) -> bool {
-        // Common local LLM server ports
-        let local_llm_ports = [
-            "11434", // Ollama default port
-            "1234",  // LM Studio default port
-            "8080",  // LocalAI, vLLM default ports
-            "5000",  // Various local servers
-            "5001",  // Alternative local server port
-            "8000",  // Common FastAPI/uvicorn port for local LLMs
-            "3000",  // Some local LLM UIs
-        ];
-
-        // Check if it's a localhost address with a known LLM port
-        let is_localhost = remote_addr.starts_with("127.")
-            || remote_addr.starts_with("localhost")
-            || remote_addr.starts_with("0.0.0.0")
-            || remote_addr == "::1";
-
-        if is_localhost {
-            for port in local_llm_ports {
-                if remote_addr.contains(&format!(":{}", port)) {
-                    return true;
-                }
-            }
+    /// Replace the endpoint classifier, e.g. with one built from a config file
+    pub fn set_classifier(&mut self, classifier: EndpointClassifier) {
+        self.classifier = Arc::new(classifier);
+    }
+
+    /// The endpoint classifier, for classifying connection events
+    pub fn classifier(&self) -> Arc<EndpointClassifier> {
+        self.classifier.clone()
+    }
+
+    /// Classify the remote end of a connection
+    pub fn classify(&self, conn: &ConnectionInfo) -> EndpointClass {
+        match &conn.remote_addr {
+            Some(addr) => self.classifier.classify(addr, conn.remote_port),
+            None => EndpointClass::Unknown,
         }
+    }
 
-        // Also check for common local LLM hostnames
-        remote_addr.contains("ollama")
-            || remote_addr.contains("lmstudio")
-            || remote_addr.contains("localai")
+    /// Classify a remote address against the built-in endpoint rules
+    ///
+    /// Accepts a hostname or IP address, optionally with a port.
+    pub fn classify_endpoint(remote_addr: &str) -> EndpointClass {
+        EndpointClassifier::builtin().classify_addr(remote_addr)
     }
 }
 
@@ -158,7 +241,7 @@ impl Default for NetworkMonitorService {
 }
 
 /// Classification of network endpoints
-#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 pub enum EndpointClass {
     /// LLM API endpoints (Anthropic, OpenAI, etc.)
     LlmApi,
@@ -176,10 +259,36 @@ pub enum EndpointClass {
     Unknown,
 }
 
+impl EndpointClass {
+    /// Name as used in endpoint rules
+    pub fn name(self) -> &'static str {
+        match self {
+            EndpointClass::LlmApi => "llm_api",
+            EndpointClass::LocalLlm => "local_llm",
+            EndpointClass::GitHub => "github",
+            EndpointClass::PackageRegistry => "package_registry",
+            EndpointClass::Telemetry => "telemetry",
+            EndpointClass::Localhost => "localhost",
+            EndpointClass::Unknown => "unknown",
+        }
+    }
+}
+
 /// Trait for network monitoring backends
 pub trait NetworkMonitorBackend: Send + Sync {
     fn start(&mut self) -> PlatformResult<()>;
     fn stop(&mut self) -> PlatformResult<()>;
     fn is_running(&self) -> bool;
     fn snapshot(&self) -> PlatformResult<Vec<ConnectionInfo>>;
+
+    /// Connections of `pids` only; backends that cannot scope their
+    /// reads filter a full snapshot
+    fn snapshot_for(&self, pids: &[u32]) -> PlatformResult<Vec<ConnectionInfo>> {
+        let pids: HashSet<u32> = pids.iter().copied().collect();
+        Ok(self
+            .snapshot()?
+            .into_iter()
+            .filter(|c| pids.contains(&c.pid))
+            .collect())
+    }
 }
@@ -0,0 +1,230 @@
+//! Byte-level parser for /proc/net socket tables
+//!
+//! Rows are decoded in place from the raw table bytes: addresses go
+//! straight from hex to `SocketAddr`, and nothing is allocated per row.
+//! Callers look at the inode first and only build a `ConnectionInfo` for
+//! the rows they keep.
+
+use std::net::{IpAddr, Ipv4Addr, Ipv6Addr, SocketAddr};
+
+use tuai_common::Protocol;
+
+/// One of the socket tables under a /proc net directory
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TableKind {
+    Tcp,
+    Tcp6,
+    Udp,
+    Udp6,
+    Unix,
+}
+
+/// Every table read for a snapshot
+pub const TABLES: [TableKind; 5] = [
+    TableKind::Tcp,
+    TableKind::Tcp6,
+    TableKind::Udp,
+    TableKind::Udp6,
+    TableKind::Unix,
+];
+
+impl TableKind {
+    /// File name under the net directory
+    pub fn file_name(self) -> &'static str {
+        match self {
+            TableKind::Tcp => "tcp",
+            TableKind::Tcp6 => "tcp6",
+            TableKind::Udp => "udp",
+            TableKind::Udp6 => "udp6",
+            TableKind::Unix => "unix",
+        }
+    }
+
+    pub fn protocol(self) -> Protocol {
+        match self {
+            TableKind::Tcp | TableKind::Tcp6 => Protocol::Tcp,
+            TableKind::Udp | TableKind::Udp6 => Protocol::Udp,
+            TableKind::Unix => Protocol::Unix,
+        }
+    }
+
+    fn ipv6(self) -> bool {
+        matches!(self, TableKind::Tcp6 | TableKind::Udp6)
+    }
+}
+
+/// A decoded table row, borrowing from the table bytes
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SocketRow<'a> {
+    pub kind: TableKind,
+    pub inode: u64,
+    /// Local address (TCP/UDP only)
+    pub local: Option<SocketAddr>,
+    /// Remote address (TCP/UDP only)
+    pub remote: Option<SocketAddr>,
+    /// Kernel socket state (`st` column)
+    pub state: u8,
+    /// Bound path (Unix only)
+    pub path: Option<&'a [u8]>,
+}
+
+/// Rows of one table; the header and malformed lines are skipped
+pub fn parse_table(content: &[u8], kind: TableKind) -> impl Iterator<Item = SocketRow<'_>> {
+    content
+        .split(|b| *b == b'\n')
+        .skip(1)
+        .filter_map(move |line| match kind {
+            TableKind::Unix => parse_unix_line(line),
+            _ => parse_inet_line(line, kind),
+        })
+}
+
+/// `sl local_address rem_address st tx:rx tr:when retrnsmt uid timeout inode ...`
+fn parse_inet_line(line: &[u8], kind: TableKind) -> Option<SocketRow<'_>> {
+    let mut fields = fields(line);
+    fields.next()?; // slot
+    let local = decode_addr(fields.next()?, kind.ipv6())?;
+    let remote = decode_addr(fields.next()?, kind.ipv6())?;
+    let state = hex(fields.next()?).map_or(0, |st| st as u8);
+    // Skip tx:rx, tr:when, retrnsmt, uid and timeout
+    let inode = decimal(fields.nth(5)?)?;
+    Some(SocketRow {
+        kind,
+        inode,
+        local: Some(local),
+        remote: Some(remote),
+        state,
+        path: None,
+    })
+}
+
+/// `Num RefCount Protocol Flags Type St Inode [Path]`
+fn parse_unix_line(line: &[u8]) -> Option<SocketRow<'_>> {
+    let mut fields = fields(line);
+    let state = fields.nth(5).and_then(hex).map_or(0, |st| st as u8);
+    let inode = decimal(fields.next()?)?;
+    Some(SocketRow {
+        kind: TableKind::Unix,
+        inode,
+        local: None,
+        remote: None,
+        state,
+        path: fields.next(),
+    })
+}
+
+/// Decode `0100007F:0050`, or the 32-digit IPv6 form
+///
+/// The kernel prints each 32-bit word of the address in host byte order.
+pub fn decode_addr(field: &[u8], ipv6: bool) -> Option<SocketAddr> {
+    let colon = field.iter().position(|b| *b == b':')?;
+    let (ip_hex, port_hex) = (&field[..colon], &field[colon + 1..]);
+    if port_hex.len() > 4 {
+        return None;
+    }
+    let port = hex(port_hex)? as u16;
+
+    let ip = if ipv6 {
+        if ip_hex.len() != 32 {
+            return None;
+        }
+        let mut bytes = [0u8; 16];
+        for (word, out) in ip_hex.chunks_exact(8).zip(bytes.chunks_exact_mut(4)) {
+            out.copy_from_slice(&hex(word)?.to_ne_bytes());
+        }
+        IpAddr::V6(Ipv6Addr::from(bytes))
+    } else {
+        if ip_hex.len() != 8 {
+            return None;
+        }
+        IpAddr::V4(Ipv4Addr::from(hex(ip_hex)?.to_ne_bytes()))
+    };
+
+    Some(SocketAddr::new(ip, port))
+}
+
+fn fields(line: &[u8]) -> impl Iterator<Item = &[u8]> {
+    line.split(u8::is_ascii_whitespace).filter(|field| !field.is_empty())
+}
+
+/// Up to 8 hex digits
+fn hex(digits: &[u8]) -> Option<u32> {
+    if digits.is_empty() || digits.len() > 8 {
+        return None;
+    }
+    digits.iter().try_fold(0u32, |acc, b| {
+        let digit = (*b as char).to_digit(16)?;
+        Some(acc << 4 | digit)
+    })
+}
+
+fn decimal(digits: &[u8]) -> Option<u64> {
+    if digits.is_empty() || !digits.iter().all(u8::is_ascii_digit) {
+        return None;
+    }
+    digits
+        .iter()
+        .try_fold(0u64, |acc, b| acc.checked_mul(10)?.checked_add(u64::from(b - b'0')))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const TCP: &[u8] = b"  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode
+   0: 0100007F:0CEA 00000000:0000 0A 00000000:00000000 00:00000000 00000000   999        0 23871 1 0000000000000000 100 0 0 10 0
+   1: 0201A8C0:D431 08080808:01BB 01 00000000:00000000 02:00000A2B 00000000  1000        0 54321 2 0000000000000000 20 4 30 10 -1
+   2: garbage
+";
+
+    #[test]
+    fn test_parse_tcp_table() {
+        let rows: Vec<_> = parse_table(TCP, TableKind::Tcp).collect();
+        assert_eq!(rows.len(), 2);
+
+        assert_eq!(rows[0].local, Some("127.0.0.1:3306".parse().unwrap()));
+        assert_eq!(rows[0].remote, Some("0.0.0.0:0".parse().unwrap()));
+        assert_eq!(rows[0].state, 0x0A);
+        assert_eq!(rows[0].inode, 23871);
+
+        assert_eq!(rows[1].local, Some("192.168.1.2:54321".parse().unwrap()));
+        assert_eq!(rows[1].remote, Some("8.8.8.8:443".parse().unwrap()));
+        assert_eq!(rows[1].state, 1);
+        assert_eq!(rows[1].inode, 54321);
+    }
+
+    #[test]
+    fn test_parse_tcp6_table() {
+        let table = b"  sl  local_address                         remote_address                        st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode
+   0: 00000000000000000000000001000000:1F90 00000000000000000000000000000000:0000 0A 00000000:00000000 00:00000000 00000000  1000        0 777 1 0000000000000000 100 0 0 10 0
+";
+        let rows: Vec<_> = parse_table(table, TableKind::Tcp6).collect();
+        assert_eq!(rows.len(), 1);
+        assert_eq!(rows[0].local, Some("[::1]:8080".parse().unwrap()));
+        assert_eq!(rows[0].inode, 777);
+    }
+
+    #[test]
+    fn test_parse_unix_table() {
+        let table = b"Num       RefCount Protocol Flags    Type St Inode Path
+0000000000000000: 00000002 00000000 00010000 0001 01 12345 /run/user/1000/bus
+0000000000000000: 00000003 00000000 00000000 0001 03 12346
+";
+        let rows: Vec<_> = parse_table(table, TableKind::Unix).collect();
+        assert_eq!(rows.len(), 2);
+        assert_eq!(rows[0].inode, 12345);
+        assert_eq!(rows[0].path, Some(&b"/run/user/1000/bus"[..]));
+        assert_eq!(rows[1].inode, 12346);
+        assert_eq!(rows[1].state, 3);
+        assert_eq!(rows[1].path, None);
+    }
+
+    #[test]
+    fn test_decode_addr_invalid() {
+        assert_eq!(decode_addr(b"invalid", false), None);
+        assert_eq!(decode_addr(b"0100007F", false), None);
+        assert_eq!(decode_addr(b"0100007F:1FFFF", false), None);
+        assert_eq!(decode_addr(b"0100007F:0050", true), None);
+        assert_eq!(decode_addr(b"0100G07F:0050", false), None);
+    }
+}
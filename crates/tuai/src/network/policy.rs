@@ -0,0 +1,509 @@
+//! Expected-endpoint policy per agent
+//!
+//! Signatures list the endpoints an agent is expected to talk to. For
+//! signatures with `suspicious_if_not_in_list`, those lists are compiled
+//! into one allowlist per agent, in the same structures the endpoint
+//! classifier uses: a label trie of hostname suffixes and a prefix tree of
+//! IP ranges per address family. An entry is a hostname suffix, IP address
+//! or CIDR range, optionally restricted to a port (`localhost:11434`).
+//!
+//! Connections carry addresses, not names. An address is expected if an
+//! IP entry covers it, or if a hostname entry resolves to it. Otherwise
+//! it is checked by name: the remote address's reverse DNS name, kept
+//! only if it resolves back to the address, goes through the hostname
+//! trie, so subdomains and addresses that rotate behind a CDN still
+//! match. An address that has not been looked up yet is
+//! [`Verdict::Unknown`]; callers check it again once its name is in. An
+//! address the lookup found no confirmed name for is unexpected: a bare
+//! IP matches no hostname entry.
+//!
+//! Lookups happen on a refresh thread, which recompiles the policy
+//! periodically and whenever the signatures are reloaded, then swaps it
+//! in. It also looks up the addresses checks queued because their name
+//! was not known yet. Checking a connection is a map lookup, a trie walk
+//! and a read-locked cache lookup; only a cache miss allocates.
+
+use std::collections::{HashMap, HashSet};
+use std::net::{IpAddr, ToSocketAddrs};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+
+use arc_swap::ArcSwap;
+use parking_lot::{Mutex, RwLock};
+use tuai_common::{AgentSignature, ConnectionInfo, SignatureMatcher};
+
+use super::classifier::{canonical, split_host_port, LabelTrie, PrefixTree, Rule};
+
+/// How often hostname entries are resolved again
+const DNS_REFRESH: Duration = Duration::from_secs(300);
+
+/// How often the refresh thread checks for new signatures and `running`
+const TICK: Duration = Duration::from_secs(1);
+
+/// Addresses whose names are cached before the cache starts over
+const MAX_NAMES: usize = 4096;
+
+/// Outcome of checking a connection against the policy
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Verdict {
+    /// The endpoint is on the agent's list
+    Expected,
+    /// The agent only expects other endpoints
+    Unexpected,
+    /// The remote address has not been looked up yet; check again later
+    Unknown,
+    /// The agent's signature does not restrict its endpoints
+    NotEnforced,
+}
+
+/// Ports an entry admits
+#[derive(Debug, Default)]
+struct Ports {
+    any: bool,
+    listed: Vec<u16>,
+}
+
+impl Ports {
+    fn add(&mut self, port: Option<u16>) {
+        match port {
+            Some(port) if !self.listed.contains(&port) => self.listed.push(port),
+            Some(_) => {}
+            None => self.any = true,
+        }
+    }
+
+    fn admits(&self, port: Option<u16>) -> bool {
+        self.any || port.is_some_and(|port| self.listed.contains(&port))
+    }
+}
+
+/// Compiled expected endpoints of one agent
+#[derive(Debug)]
+struct Allowlist {
+    hosts: LabelTrie<Ports>,
+    ipv4: PrefixTree<Ports>,
+    ipv6: PrefixTree<Ports>,
+}
+
+impl Allowlist {
+    fn new() -> Self {
+        Self {
+            hosts: LabelTrie::new(),
+            ipv4: PrefixTree::new(),
+            ipv6: PrefixTree::new(),
+        }
+    }
+
+    fn add_ip(&mut self, ip: IpAddr, port: Option<u16>) {
+        let slot = match canonical(ip) {
+            IpAddr::V4(v4) => self.ipv4.insert(u32::from(v4).into(), 32, 32),
+            IpAddr::V6(v6) => self.ipv6.insert(u128::from(v6), 128, 128),
+        };
+        slot.get_or_insert_with(Ports::default).add(port);
+    }
+
+    fn admits_ip(&self, ip: IpAddr, port: Option<u16>) -> bool {
+        match canonical(ip) {
+            IpAddr::V4(v4) => self.ipv4.matches(u32::from(v4).into(), 32).any(|p| p.admits(port)),
+            IpAddr::V6(v6) => self.ipv6.matches(u128::from(v6), 128).any(|p| p.admits(port)),
+        }
+    }
+
+    fn admits_host(&self, host: &str, port: Option<u16>) -> bool {
+        self.hosts.matches(host).any(|p| p.admits(port))
+    }
+}
+
+/// Names of remote addresses, from forward-confirmed reverse DNS
+///
+/// Checks read the cache and queue addresses they find no entry for; the
+/// refresh thread looks the queue up. Addresses without a name are cached
+/// as such, so they are not looked up again until the cache starts over.
+#[derive(Debug, Default)]
+pub struct ReverseDns {
+    names: RwLock<HashMap<IpAddr, Option<String>>>,
+    pending: Mutex<HashSet<IpAddr>>,
+}
+
+impl ReverseDns {
+    /// An empty cache
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Run `f` on the cached name of `ip`
+    ///
+    /// Returns `None`, and queues `ip`, if it was not looked up yet.
+    fn with_name<T>(&self, ip: IpAddr, f: impl FnOnce(Option<&str>) -> T) -> Option<T> {
+        if let Some(name) = self.names.read().get(&ip) {
+            return Some(f(name.as_deref()));
+        }
+        self.pending.lock().insert(ip);
+        None
+    }
+
+    /// Record the name of an address (`None`: it has none)
+    pub fn insert(&self, ip: IpAddr, name: Option<String>) {
+        let mut names = self.names.write();
+        if names.len() >= MAX_NAMES {
+            names.clear();
+        }
+        names.insert(ip, name);
+    }
+
+    /// Look up the queued addresses with `lookup`; returns how many
+    pub fn resolve_pending(&self, mut lookup: impl FnMut(IpAddr) -> Option<String>) -> usize {
+        let pending: Vec<IpAddr> = self.pending.lock().drain().collect();
+        for &ip in &pending {
+            self.insert(ip, lookup(ip));
+        }
+        pending.len()
+    }
+}
+
+/// Expected endpoints of every agent whose signature enforces them
+#[derive(Debug, Default)]
+pub struct EndpointPolicy {
+    agents: HashMap<String, Allowlist>,
+    /// Names of remote addresses, kept across recompiles
+    names: Arc<ReverseDns>,
+}
+
+impl EndpointPolicy {
+    /// A policy that enforces nothing
+    pub fn empty() -> Self {
+        Self::default()
+    }
+
+    /// Compile the expected endpoints of `signatures`
+    ///
+    /// `resolve` maps a hostname entry to the addresses it stands for;
+    /// pass `|_| Vec::new()` to compile without DNS. Invalid entries are
+    /// skipped.
+    pub fn compile<'a, I, R>(signatures: I, mut resolve: R) -> Self
+    where
+        I: IntoIterator<Item = &'a AgentSignature>,
+        R: FnMut(&str) -> Vec<IpAddr>,
+    {
+        let mut agents = HashMap::new();
+        for signature in signatures {
+            let endpoints = &signature.network_endpoints;
+            if !endpoints.suspicious_if_not_in_list {
+                continue;
+            }
+
+            let mut allowlist = Allowlist::new();
+            for entry in &endpoints.expected {
+                let (addr, port) = split_host_port(entry.trim());
+                let slot = match Rule::parse(addr) {
+                    Ok(Rule::Host(host)) => {
+                        for ip in resolve(host) {
+                            allowlist.add_ip(ip, port);
+                        }
+                        allowlist.hosts.insert(host)
+                    }
+                    Ok(Rule::V4(addr, len)) => allowlist.ipv4.insert(addr.into(), 32, len),
+                    Ok(Rule::V6(addr, len)) => allowlist.ipv6.insert(addr, 128, len),
+                    Err(e) => {
+                        tracing::warn!("Ignoring expected endpoint of {}: {}", signature.name, e);
+                        continue;
+                    }
+                };
+                slot.get_or_insert_with(Ports::default).add(port);
+            }
+            agents.insert(signature.name.clone(), allowlist);
+        }
+        Self {
+            agents,
+            names: Arc::default(),
+        }
+    }
+
+    /// Use `names` to check addresses by name
+    pub fn with_names(mut self, names: Arc<ReverseDns>) -> Self {
+        self.names = names;
+        self
+    }
+
+    /// Names of remote addresses the policy checks against
+    pub fn names(&self) -> &Arc<ReverseDns> {
+        &self.names
+    }
+
+    /// Number of agents whose endpoints are enforced
+    pub fn enforced(&self) -> usize {
+        self.agents.len()
+    }
+
+    /// Check a remote host (name or IP address) and port for an agent
+    ///
+    /// An address that no IP entry admits is checked by its name. It is
+    /// [`Verdict::Unknown`] until it has been looked up, and unexpected if
+    /// the lookup found no name.
+    pub fn check(&self, agent_type: &str, host: &str, port: Option<u16>) -> Verdict {
+        let Some(allowlist) = self.agents.get(agent_type) else {
+            return Verdict::NotEnforced;
+        };
+        let verdict = |admitted| if admitted { Verdict::Expected } else { Verdict::Unexpected };
+
+        let host = host.trim_start_matches('[').trim_end_matches(']');
+        let Ok(ip) = host.parse::<IpAddr>() else {
+            return verdict(allowlist.admits_host(host, port));
+        };
+        if allowlist.admits_ip(ip, port) {
+            return Verdict::Expected;
+        }
+        self.names
+            .with_name(canonical(ip), |name| name.is_some_and(|name| allowlist.admits_host(name, port)))
+            .map_or(Verdict::Unknown, verdict)
+    }
+
+    /// Check the remote end of a connection for an agent
+    ///
+    /// Connections without a remote address (listeners) are not checked.
+    pub fn check_connection(&self, agent_type: &str, conn: &ConnectionInfo) -> Verdict {
+        match &conn.remote_addr {
+            Some(addr) => self.check(agent_type, addr, conn.remote_port),
+            None => Verdict::NotEnforced,
+        }
+    }
+}
+
+/// Addresses a hostname resolves to, or none if resolution fails
+pub fn resolve_host(host: &str) -> Vec<IpAddr> {
+    match (host, 0).to_socket_addrs() {
+        Ok(addrs) => addrs.map(|addr| addr.ip()).collect(),
+        Err(e) => {
+            tracing::debug!("Cannot resolve expected endpoint {}: {}", host, e);
+            Vec::new()
+        }
+    }
+}
+
+/// Name of an address, if its reverse DNS name resolves back to it
+///
+/// A PTR record is set by whoever holds the address, so it only counts
+/// once the forward lookup confirms it.
+pub fn reverse_lookup(ip: IpAddr) -> Option<String> {
+    let ip = canonical(ip);
+    let name = ptr_name(ip)?;
+    resolve_host(&name)
+        .into_iter()
+        .any(|addr| canonical(addr) == ip)
+        .then_some(name)
+}
+
+#[cfg(unix)]
+fn ptr_name(ip: IpAddr) -> Option<String> {
+    const NI_MAXHOST: usize = 1025;
+
+    let mut storage: libc::sockaddr_storage = unsafe { std::mem::zeroed() };
+    let len = match ip {
+        IpAddr::V4(v4) => {
+            let sin = unsafe { &mut *(&mut storage as *mut _ as *mut libc::sockaddr_in) };
+            sin.sin_family = libc::AF_INET as libc::sa_family_t;
+            sin.sin_addr.s_addr = u32::from_ne_bytes(v4.octets());
+            std::mem::size_of::<libc::sockaddr_in>()
+        }
+        IpAddr::V6(v6) => {
+            let sin6 = unsafe { &mut *(&mut storage as *mut _ as *mut libc::sockaddr_in6) };
+            sin6.sin6_family = libc::AF_INET6 as libc::sa_family_t;
+            sin6.sin6_addr.s6_addr = v6.octets();
+            std::mem::size_of::<libc::sockaddr_in6>()
+        }
+    };
+
+    let mut host = [0 as libc::c_char; NI_MAXHOST];
+    let rc = unsafe {
+        libc::getnameinfo(
+            &storage as *const _ as *const libc::sockaddr,
+            len as libc::socklen_t,
+            host.as_mut_ptr(),
+            host.len() as libc::socklen_t,
+            std::ptr::null_mut(),
+            0,
+            libc::NI_NAMEREQD,
+        )
+    };
+    if rc != 0 {
+        return None;
+    }
+    let name = unsafe { std::ffi::CStr::from_ptr(host.as_ptr()) };
+    Some(name.to_string_lossy().trim_end_matches('.').to_string())
+}
+
+#[cfg(not(unix))]
+fn ptr_name(_ip: IpAddr) -> Option<String> {
+    None
+}
+
+/// Keep `policy` compiled from the current signatures, with DNS
+///
+/// The thread recompiles at start, whenever `signatures` returns a
+/// different matcher, and every few minutes to follow DNS changes. In
+/// between it looks up the names of addresses checks queued. It exits
+/// once `running` is cleared.
+pub fn spawn_refresh<S>(
+    policy: Arc<ArcSwap<EndpointPolicy>>,
+    signatures: S,
+    running: Arc<AtomicBool>,
+) -> std::io::Result<std::thread::JoinHandle<()>>
+where
+    S: Fn() -> Arc<SignatureMatcher> + Send + 'static,
+{
+    std::thread::Builder::new()
+        .name("tuai-endpoint-policy".to_string())
+        .spawn(move || {
+            let names = policy.load().names().clone();
+            let mut compiled: Option<(Arc<SignatureMatcher>, Instant)> = None;
+            while running.load(Ordering::Relaxed) {
+                let matcher = signatures();
+                let stale = match &compiled {
+                    Some((last, at)) => !Arc::ptr_eq(last, &matcher) || at.elapsed() >= DNS_REFRESH,
+                    None => true,
+                };
+                if stale {
+                    let next = EndpointPolicy::compile(matcher.signatures(), resolve_host).with_names(names.clone());
+                    tracing::debug!("Endpoint policy enforced for {} agents", next.enforced());
+                    policy.store(Arc::new(next));
+                    compiled = Some((matcher, Instant::now()));
+                }
+                let looked_up = names.resolve_pending(reverse_lookup);
+                if looked_up > 0 {
+                    tracing::debug!("Looked up names of {} remote addresses", looked_up);
+                }
+                std::thread::sleep(TICK);
+            }
+        })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tuai_common::{DetectionRules, NetworkEndpoints};
+
+    fn signature(name: &str, expected: &[&str], enforced: bool) -> AgentSignature {
+        AgentSignature {
+            name: name.to_string(),
+            display_name: name.to_string(),
+            icon: None,
+            detection: DetectionRules::default(),
+            child_process_tracking: false,
+            network_endpoints: NetworkEndpoints {
+                expected: expected.iter().map(|s| s.to_string()).collect(),
+                suspicious_if_not_in_list: enforced,
+            },
+        }
+    }
+
+    #[test]
+    fn test_hosts_ranges_and_ports() {
+        let signatures = [signature(
+            "agent",
+            &["api.example.com", "10.0.0.0/8", "fd00::/8", "localhost:11434", "192.0.2.1:443"],
+            true,
+        )];
+        let policy = EndpointPolicy::compile(&signatures, |_| Vec::new());
+        let check = |host, port| policy.check("agent", host, port);
+
+        assert_eq!(check("api.example.com", Some(443)), Verdict::Expected);
+        assert_eq!(check("eu.API.example.com", None), Verdict::Expected);
+        assert_eq!(check("example.com", Some(443)), Verdict::Unexpected);
+        assert_eq!(check("notapi.example.com", Some(443)), Verdict::Unexpected);
+
+        assert_eq!(check("10.1.2.3", Some(22)), Verdict::Expected);
+        assert_eq!(check("::ffff:10.1.2.3", Some(22)), Verdict::Expected);
+        assert_eq!(check("[fd12::1]", Some(80)), Verdict::Expected);
+
+        assert_eq!(check("localhost", Some(11434)), Verdict::Expected);
+        assert_eq!(check("localhost", Some(8080)), Verdict::Unexpected);
+        assert_eq!(check("192.0.2.1", Some(443)), Verdict::Expected);
+
+        // Other addresses go by name once it is known
+        assert_eq!(check("11.0.0.1", Some(22)), Verdict::Unknown);
+        assert_eq!(check("192.0.2.1", None), Verdict::Unknown);
+        // No confirmed name: a bare address the agent does not expect
+        policy.names().resolve_pending(|_| None);
+        assert_eq!(check("11.0.0.1", Some(22)), Verdict::Unexpected);
+        assert_eq!(check("192.0.2.1", None), Verdict::Unexpected);
+        policy.names().insert("11.0.0.1".parse().unwrap(), Some("evil.example.net".to_string()));
+        assert_eq!(check("11.0.0.1", Some(22)), Verdict::Unexpected);
+    }
+
+    #[test]
+    fn test_addresses_checked_by_name() {
+        let signatures = [signature("agent", &["example.com:443"], true)];
+        let policy = EndpointPolicy::compile(&signatures, |_| Vec::new());
+        let check = |host, port| policy.check("agent", host, port);
+
+        // Not looked up yet: unknown, and queued for the refresh thread
+        assert_eq!(check("198.51.100.7", Some(443)), Verdict::Unknown);
+        assert_eq!(check("::ffff:198.51.100.8", Some(443)), Verdict::Unknown);
+        let mut queued = Vec::new();
+        let looked_up = policy.names().resolve_pending(|ip| {
+            queued.push(ip);
+            match ip.to_string().as_str() {
+                // A subdomain behind a CDN address
+                "198.51.100.7" => Some("edge-3.api.example.com".to_string()),
+                _ => Some("tracker.example.org".to_string()),
+            }
+        });
+        assert_eq!(looked_up, 2);
+        queued.sort();
+        assert_eq!(queued, vec!["198.51.100.7".parse::<IpAddr>().unwrap(), "198.51.100.8".parse().unwrap()]);
+
+        assert_eq!(check("198.51.100.7", Some(443)), Verdict::Expected);
+        assert_eq!(check("198.51.100.7", Some(80)), Verdict::Unexpected);
+        assert_eq!(check("198.51.100.8", Some(443)), Verdict::Unexpected);
+
+        // Names survive a recompile that shares the cache
+        let names = policy.names().clone();
+        let recompiled = EndpointPolicy::compile(&signatures, |_| Vec::new()).with_names(names);
+        assert_eq!(recompiled.check("agent", "198.51.100.7", Some(443)), Verdict::Expected);
+        assert_eq!(policy.names().resolve_pending(|_| None), 0);
+    }
+
+    #[test]
+    fn test_reverse_lookup_of_loopback() {
+        // Confirmed only if the PTR name resolves back to the address
+        if let Some(name) = reverse_lookup("127.0.0.1".parse().unwrap()) {
+            assert!(resolve_host(&name).contains(&"127.0.0.1".parse().unwrap()));
+        }
+        assert_eq!(reverse_lookup("192.0.2.123".parse().unwrap()), None);
+    }
+
+    #[test]
+    fn test_resolved_hostnames() {
+        let signatures = [signature("agent", &["api.example.com:443"], true)];
+        let policy = EndpointPolicy::compile(&signatures, |host| {
+            assert_eq!(host, "api.example.com");
+            vec!["203.0.113.7".parse().unwrap()]
+        });
+        assert_eq!(policy.check("agent", "203.0.113.7", Some(443)), Verdict::Expected);
+        assert_eq!(policy.check("agent", "203.0.113.7", Some(80)), Verdict::Unknown);
+        assert_eq!(policy.check("agent", "203.0.113.8", Some(443)), Verdict::Unknown);
+    }
+
+    #[test]
+    fn test_only_enforcing_signatures() {
+        let signatures = [
+            signature("strict", &["api.example.com"], true),
+            signature("lax", &["api.example.com"], false),
+            signature("skips_invalid", &["10.0.0.0/99", "api.example.com"], true),
+        ];
+        let policy = EndpointPolicy::compile(&signatures, |_| Vec::new());
+        assert_eq!(policy.enforced(), 2);
+        assert_eq!(policy.check("lax", "198.51.100.1", Some(443)), Verdict::NotEnforced);
+        assert_eq!(policy.check("unknown", "198.51.100.1", Some(443)), Verdict::NotEnforced);
+        assert_eq!(policy.check("strict", "evil.example.net", Some(443)), Verdict::Unexpected);
+        assert_eq!(policy.check("strict", "198.51.100.1", Some(443)), Verdict::Unknown);
+        assert_eq!(policy.check("skips_invalid", "api.example.com", Some(443)), Verdict::Expected);
+
+        let listener = ConnectionInfo {
+            remote_addr: None,
+            ..ConnectionInfo::new(1, tuai_common::Protocol::Tcp)
+        };
+        assert_eq!(policy.check_connection("strict", &listener), Verdict::NotEnforced);
+    }
+}
@@ -1,240 +1,145 @@
 //! Linux /proc/net based network monitor
 //!
 //! Parses /proc/net/tcp, /proc/net/udp, and /proc/net/unix for connection info.
-
-use std::collections::HashMap;
+//! Tables are decoded at the byte level (see `net_table`), and a
+//! `ConnectionInfo` is only built for rows that are kept.
+//! Socket owners come from a [`SocketIndex`] kept across polls, so steady
+//! state polling only reads the tables. Scoped snapshots only index the
+//! requested processes and read the tables of their network namespaces
+//! through /proc/<pid>/net.
+
+use std::collections::HashSet;
 use std::fs;
-use std::net::{Ipv4Addr, Ipv6Addr};
-use std::path::Path;
+use std::net::{IpAddr, Ipv4Addr, SocketAddr};
+use std::path::{Path, PathBuf};
 use std::sync::atomic::{AtomicBool, Ordering};
 
-use chrono::Utc;
-use tuai_common::{ConnectionInfo, ConnectionState, PlatformError, PlatformResult, Protocol};
+use parking_lot::Mutex;
+use tuai_common::{ConnectionInfo, ConnectionState, PlatformResult};
 
+use super::net_table::{decode_addr, parse_table, SocketRow, TableKind, TABLES};
+use super::socket_index::SocketIndex;
 use super::NetworkMonitorBackend;
+use crate::procfs;
+
+/// Initial buffer per socket table, enough for a few hundred rows
+const TABLE_BUF_SIZE: usize = 64 * 1024;
 
 /// Network monitor using /proc/net (Linux) or sysinfo fallback
 pub struct ProcNetMonitor {
     running: AtomicBool,
-    /// Cache of inode to PID mappings
-    inode_pid_cache: HashMap<u64, u32>,
+    /// Socket inode to PID mapping, updated incrementally
+    index: Mutex<SocketIndex>,
 }
 
 impl ProcNetMonitor {
     pub fn new() -> Self {
         Self {
             running: AtomicBool::new(false),
-            inode_pid_cache: HashMap::new(),
+            index: Mutex::new(SocketIndex::new()),
         }
     }
 
-    /// Build inode to PID mapping from /proc/*/fd
-    fn build_inode_pid_map(&mut self) -> PlatformResult<()> {
-        self.inode_pid_cache.clear();
-
-        let proc_dir = match fs::read_dir("/proc") {
-            Ok(dir) => dir,
-            Err(e) => {
-                return Err(PlatformError::CollectionFailed(format!(
-                    "Failed to read /proc: {}",
-                    e
-                )))
-            }
-        };
-
-        for entry in proc_dir.flatten() {
-            let name = entry.file_name();
-            let name_str = name.to_string_lossy();
-
-            // Skip non-numeric directories
-            if !name_str.chars().all(|c| c.is_ascii_digit()) {
-                continue;
-            }
-
-            let pid: u32 = match name_str.parse() {
-                Ok(p) => p,
-                Err(_) => continue,
-            };
-
-            let fd_path = entry.path().join("fd");
-            if let Ok(fd_dir) = fs::read_dir(&fd_path) {
-                for fd_entry in fd_dir.flatten() {
-                    if let Ok(link) = fs::read_link(fd_entry.path()) {
-                        let link_str = link.to_string_lossy();
-                        // socket:[12345] format
-                        if link_str.starts_with("socket:[") {
-                            if let Some(inode_str) =
-                                link_str.strip_prefix("socket:[").and_then(|s| s.strip_suffix(']'))
-                            {
-                                if let Ok(inode) = inode_str.parse::<u64>() {
-                                    self.inode_pid_cache.insert(inode, pid);
-                                }
-                            }
-                        }
-                    }
+    /// Socket inodes held open by a process, as (inode, pid)
+    #[cfg(unix)]
+    pub(super) fn socket_inodes_for_pid(pid: u32) -> Vec<(u64, u32)> {
+        let mut inodes = Vec::new();
+        // Process may have exited or permission denied: nothing to map
+        let _ = procfs::with_fd_walker(|walker| {
+            walker.walk(pid, |link| {
+                if let Some(inode) = Self::socket_inode(link.target) {
+                    inodes.push((inode, pid));
                 }
-            }
-        }
-
-        Ok(())
+            })
+        });
+        inodes
     }
 
-    /// Parse /proc/net/tcp or /proc/net/tcp6
-    fn parse_tcp_file(&self, path: &Path, ipv6: bool) -> Vec<ConnectionInfo> {
-        let mut connections = Vec::new();
-
-        let content = match fs::read_to_string(path) {
-            Ok(c) => c,
-            Err(_) => return connections,
-        };
-
-        for line in content.lines().skip(1) {
-            // Skip header
-            let parts: Vec<&str> = line.split_whitespace().collect();
-            if parts.len() < 10 {
-                continue;
-            }
-
-            // Parse local address
-            let (local_addr, local_port) = if ipv6 {
-                parse_ipv6_addr(parts[1])
-            } else {
-                parse_ipv4_addr(parts[1])
-            };
-
-            // Parse remote address
-            let (remote_addr, remote_port) = if ipv6 {
-                parse_ipv6_addr(parts[2])
-            } else {
-                parse_ipv4_addr(parts[2])
-            };
-
-            // Parse state
-            let state_hex = u8::from_str_radix(parts[3], 16).unwrap_or(0);
-            let state = match state_hex {
-                1 => ConnectionState::Established,
-                2 => ConnectionState::Connecting, // SYN_SENT
-                7 => ConnectionState::Closed,     // CLOSE
-                _ => ConnectionState::Connecting,
-            };
-
-            // Parse inode
-            let inode: u64 = parts[9].parse().unwrap_or(0);
-
-            // Get PID from inode
-            let pid = self.inode_pid_cache.get(&inode).copied().unwrap_or(0);
-
-            if pid > 0 || !remote_addr.is_empty() {
-                let mut conn = ConnectionInfo::new(pid, Protocol::Tcp);
-                conn.local_addr = Some(local_addr);
-                conn.local_port = Some(local_port);
-                conn.remote_addr = if remote_addr.is_empty() || remote_addr == "0.0.0.0" {
-                    None
-                } else {
-                    Some(remote_addr)
-                };
-                conn.remote_port = if remote_port == 0 {
-                    None
-                } else {
-                    Some(remote_port)
-                };
-                conn.state = state;
-                conn.timestamp = Utc::now();
-                connections.push(conn);
-            }
-        }
-
-        connections
+    #[cfg(not(unix))]
+    pub(super) fn socket_inodes_for_pid(_pid: u32) -> Vec<(u64, u32)> {
+        Vec::new()
     }
 
-    /// Parse /proc/net/udp or /proc/net/udp6
-    fn parse_udp_file(&self, path: &Path, ipv6: bool) -> Vec<ConnectionInfo> {
-        let mut connections = Vec::new();
-
-        let content = match fs::read_to_string(path) {
-            Ok(c) => c,
-            Err(_) => return connections,
-        };
-
-        for line in content.lines().skip(1) {
-            let parts: Vec<&str> = line.split_whitespace().collect();
-            if parts.len() < 10 {
-                continue;
-            }
-
-            let (local_addr, local_port) = if ipv6 {
-                parse_ipv6_addr(parts[1])
-            } else {
-                parse_ipv4_addr(parts[1])
-            };
-
-            let (remote_addr, remote_port) = if ipv6 {
-                parse_ipv6_addr(parts[2])
-            } else {
-                parse_ipv4_addr(parts[2])
-            };
-
-            let inode: u64 = parts[9].parse().unwrap_or(0);
-            let pid = self.inode_pid_cache.get(&inode).copied().unwrap_or(0);
-
-            if pid > 0 || !remote_addr.is_empty() {
-                let mut conn = ConnectionInfo::new(pid, Protocol::Udp);
-                conn.local_addr = Some(local_addr);
-                conn.local_port = Some(local_port);
-                conn.remote_addr = if remote_addr.is_empty() || remote_addr == "0.0.0.0" {
-                    None
-                } else {
-                    Some(remote_addr)
-                };
-                conn.remote_port = if remote_port == 0 {
-                    None
-                } else {
-                    Some(remote_port)
-                };
-                conn.state = ConnectionState::Established;
-                conn.timestamp = Utc::now();
-                connections.push(conn);
-            }
-        }
-
-        connections
+    /// Parse a `socket:[12345]` link target
+    fn socket_inode(link: &[u8]) -> Option<u64> {
+        let digits = link.strip_prefix(b"socket:[")?.strip_suffix(b"]")?;
+        std::str::from_utf8(digits).ok()?.parse().ok()
     }
 
-    /// Parse /proc/net/unix for Unix domain sockets
-    fn parse_unix_sockets(&self) -> Vec<ConnectionInfo> {
-        let mut connections = Vec::new();
+    /// Read the socket tables under net directories such as /proc/net,
+    /// all in one batch
+    ///
+    /// Missing tables (no IPv6, say) are skipped.
+    pub(super) fn read_tables<P: AsRef<Path>>(net_dirs: &[P]) -> Vec<(TableKind, Vec<u8>)> {
+        let files: Vec<(TableKind, PathBuf)> = net_dirs
+            .iter()
+            .flat_map(|dir| TABLES.iter().map(move |kind| (*kind, dir.as_ref().join(kind.file_name()))))
+            .collect();
+        let paths: Vec<&Path> = files.iter().map(|(_, path)| path.as_path()).collect();
+        files
+            .iter()
+            .zip(procfs::read_files(&paths, TABLE_BUF_SIZE))
+            .filter_map(|((kind, _), content)| Some((*kind, content?)))
+            .collect()
+    }
 
-        let content = match fs::read_to_string("/proc/net/unix") {
-            Ok(c) => c,
-            Err(_) => return connections,
-        };
+    /// Resolve new inodes against `candidates`, then build connections
+    /// for the rows `keep` accepts given their owner
+    fn connections<F>(
+        index: &mut SocketIndex,
+        tables: &[(TableKind, Vec<u8>)],
+        candidates: &[u32],
+        keep: F,
+    ) -> Vec<ConnectionInfo>
+    where
+        F: Fn(&SocketRow<'_>, Option<u32>) -> bool,
+    {
+        let rows: Vec<SocketRow<'_>> = tables
+            .iter()
+            .flat_map(|(kind, content)| parse_table(content, *kind))
+            .collect();
+        let inodes: Vec<u64> = rows.iter().map(|row| row.inode).collect();
+        index.resolve(&inodes, candidates, Self::socket_inodes_for_pid);
+        index.retain_unowned(&inodes.into_iter().collect());
+
+        // Nothing is allocated for rows that are filtered out
+        rows.iter()
+            .filter_map(|row| {
+                let owner = index.owner(row.inode);
+                keep(row, owner).then(|| Self::connection(row, owner.unwrap_or(0)))
+            })
+            .collect()
+    }
 
-        for line in content.lines().skip(1) {
-            let parts: Vec<&str> = line.split_whitespace().collect();
-            if parts.len() < 7 {
-                continue;
+    /// Build the connection for a kept row
+    pub(super) fn connection(row: &SocketRow<'_>, pid: u32) -> ConnectionInfo {
+        let mut conn = ConnectionInfo::new(pid, row.kind.protocol());
+        if let Some(local) = row.local {
+            conn.local_addr = Some(local.ip().to_string());
+            conn.local_port = Some(local.port());
+        }
+        if let Some(remote) = row.remote {
+            // Unconnected IPv4 sockets report 0.0.0.0
+            if remote.ip() != IpAddr::V4(Ipv4Addr::UNSPECIFIED) {
+                conn.remote_addr = Some(remote.ip().to_string());
             }
-
-            let inode: u64 = parts[6].parse().unwrap_or(0);
-            let pid = self.inode_pid_cache.get(&inode).copied().unwrap_or(0);
-
-            // Socket path (if present)
-            let path = if parts.len() > 7 {
-                Some(parts[7].to_string())
-            } else {
-                None
-            };
-
-            if pid > 0 {
-                let mut conn = ConnectionInfo::new(pid, Protocol::Unix);
-                conn.local_addr = path;
-                conn.state = ConnectionState::Established;
-                conn.timestamp = Utc::now();
-                connections.push(conn);
+            if remote.port() != 0 {
+                conn.remote_port = Some(remote.port());
             }
         }
-
-        connections
+        if let Some(path) = row.path {
+            conn.local_addr = Some(String::from_utf8_lossy(path).into_owned());
+        }
+        conn.state = match row.kind {
+            TableKind::Tcp | TableKind::Tcp6 => match row.state {
+                1 => ConnectionState::Established,
+                2 => ConnectionState::Connecting, // SYN_SENT
+                7 => ConnectionState::Closed,     // CLOSE
+                _ => ConnectionState::Connecting,
+            },
+            _ => ConnectionState::Established,
+        };
+        conn
     }
 }
 
@@ -253,7 +158,7 @@ impl NetworkMonitorBackend for ProcNetMonitor {
         // Check if we're on Linux
         #[cfg(not(target_os = "linux"))]
         {
-            return Err(PlatformError::NotSupported(
+            return Err(tuai_common::PlatformError::NotSupported(
                 "/proc/net is only available on Linux".to_string(),
             ));
         }
@@ -274,83 +179,55 @@ impl NetworkMonitorBackend for ProcNetMonitor {
     }
 
     fn snapshot(&self) -> PlatformResult<Vec<ConnectionInfo>> {
-        // Rebuild inode-pid cache
-        let mut monitor = Self::new();
-        monitor.build_inode_pid_map()?;
-
-        let mut connections = Vec::new();
-
-        // TCP connections
-        connections.extend(monitor.parse_tcp_file(Path::new("/proc/net/tcp"), false));
-        connections.extend(monitor.parse_tcp_file(Path::new("/proc/net/tcp6"), true));
-
-        // UDP connections
-        connections.extend(monitor.parse_udp_file(Path::new("/proc/net/udp"), false));
-        connections.extend(monitor.parse_udp_file(Path::new("/proc/net/udp6"), true));
+        // Only new PIDs are scanned; exited ones are evicted
+        let pids = procfs::list_pids()?;
+        let mut index = self.index.lock();
+        index.sync(&pids, Self::socket_inodes_for_pid);
+
+        let tables = Self::read_tables(&["/proc/net"]);
+        // Unix sockets are only reported with a known owner
+        Ok(Self::connections(&mut index, &tables, &pids, |row, owner| {
+            owner.is_some() || row.kind != TableKind::Unix
+        }))
+    }
 
-        // Unix sockets
-        connections.extend(monitor.parse_unix_sockets());
+    fn snapshot_for(&self, pids: &[u32]) -> PlatformResult<Vec<ConnectionInfo>> {
+        let mut index = self.index.lock();
+        index.evict_exited(pids);
+        index.ensure(pids, Self::socket_inodes_for_pid);
+
+        // One process per network namespace is enough to read its tables
+        let mut namespaces: HashSet<PathBuf> = HashSet::new();
+        let mut net_dirs = Vec::new();
+        for &pid in pids {
+            // Unreadable namespace link: read this process's tables anyway
+            let namespace = fs::read_link(format!("/proc/{}/ns/net", pid))
+                .unwrap_or_else(|_| PathBuf::from(format!("pid:{}", pid)));
+            if namespaces.insert(namespace) {
+                net_dirs.push(format!("/proc/{}/net", pid));
+            }
+        }
+        let tables = Self::read_tables(&net_dirs);
 
-        Ok(connections)
+        // Only sockets owned by the requested processes
+        Ok(Self::connections(&mut index, &tables, pids, |_, owner| {
+            owner.is_some_and(|pid| pids.contains(&pid))
+        }))
     }
 }
 
 /// Parse IPv4 address in hex format (e.g., "0100007F:0050")
 pub(crate) fn parse_ipv4_addr(addr: &str) -> (String, u16) {
-    let parts: Vec<&str> = addr.split(':').collect();
-    if parts.len() != 2 {
-        return (String::new(), 0);
-    }
-
-    let ip_hex = parts[0];
-    let port_hex = parts[1];
-
-    // Parse IP (in reverse byte order on little-endian)
-    let ip = if ip_hex.len() == 8 {
-        let bytes: [u8; 4] = [
-            u8::from_str_radix(&ip_hex[6..8], 16).unwrap_or(0),
-            u8::from_str_radix(&ip_hex[4..6], 16).unwrap_or(0),
-            u8::from_str_radix(&ip_hex[2..4], 16).unwrap_or(0),
-            u8::from_str_radix(&ip_hex[0..2], 16).unwrap_or(0),
-        ];
-        Ipv4Addr::from(bytes).to_string()
-    } else {
-        String::new()
-    };
-
-    let port = u16::from_str_radix(port_hex, 16).unwrap_or(0);
-
-    (ip, port)
+    format_addr(decode_addr(addr.as_bytes(), false))
 }
 
 /// Parse IPv6 address in hex format
 pub(crate) fn parse_ipv6_addr(addr: &str) -> (String, u16) {
-    let parts: Vec<&str> = addr.split(':').collect();
-    if parts.len() != 2 {
-        return (String::new(), 0);
-    }
-
-    let ip_hex = parts[0];
-    let port_hex = parts[1];
-
-    // Parse IPv6 (32 hex chars)
-    let ip = if ip_hex.len() == 32 {
-        let mut bytes = [0u8; 16];
-        for i in 0..16 {
-            bytes[i] = u8::from_str_radix(&ip_hex[i * 2..i * 2 + 2], 16).unwrap_or(0);
-        }
-        // Swap byte order for each 4-byte group (Linux stores in host byte order)
-        for chunk in bytes.chunks_exact_mut(4) {
-            chunk.reverse();
-        }
-        Ipv6Addr::from(bytes).to_string()
-    } else {
-        String::new()
-    };
-
-    let port = u16::from_str_radix(port_hex, 16).unwrap_or(0);
+    format_addr(decode_addr(addr.as_bytes(), true))
+}
 
-    (ip, port)
+fn format_addr(addr: Option<SocketAddr>) -> (String, u16) {
+    addr.map_or((String::new(), 0), |addr| (addr.ip().to_string(), addr.port()))
 }
 
 #[cfg(test)]
@@ -364,4 +241,22 @@ mod tests {
         assert_eq!(ip, "127.0.0.1");
         assert_eq!(port, 80);
     }
+
+    #[test]
+    fn test_read_tables() {
+        let dir = tempfile::tempdir().unwrap();
+        let header = "  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode\n";
+        let row = "   0: 0100007F:0050 0100007F:1F90 01 00000000:00000000 00:00000000 00000000  1000        0 4242 1\n";
+        // Busy hosts have tables far larger than a page
+        let tcp = format!("{}{}", header, row.repeat(200));
+        assert!(tcp.len() > 16 * 1024);
+        fs::write(dir.path().join("tcp"), &tcp).unwrap();
+        fs::write(dir.path().join("udp"), header).unwrap();
+
+        let tables = ProcNetMonitor::read_tables(&[dir.path()]);
+        let kinds: Vec<TableKind> = tables.iter().map(|(kind, _)| *kind).collect();
+        assert_eq!(kinds, vec![TableKind::Tcp, TableKind::Udp]);
+        assert_eq!(tables[0].1, tcp.as_bytes());
+        assert_eq!(parse_table(&tables[0].1, TableKind::Tcp).count(), 200);
+    }
 }
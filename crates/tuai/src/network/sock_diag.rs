@@ -0,0 +1,618 @@
+//! NETLINK_SOCK_DIAG based network monitor for Linux
+//!
+//! Dumps TCP and UDP sockets through the inet_diag netlink interface
+//! instead of parsing /proc/net text. The state filter is applied by the
+//! kernel, so TIME_WAIT and LISTEN sockets, which are the bulk on busy
+//! hosts and which tuai does not report, are never sent. Records are
+//! binary `inet_diag_msg` structs carrying the socket inode and owner uid,
+//! and established TCP flows also carry `tcp_info` (rtt, bytes acked and
+//! received).
+//!
+//! Socket owners come from the same [`SocketIndex`] as ProcNetMonitor.
+//! Unix sockets are still read from /proc/net/unix. A dump only covers
+//! the network namespace tuai runs in, so scoped snapshots read the
+//! /proc/<pid>/net tables of requested processes that live in another
+//! namespace (containers, sandboxed agents), one process per namespace.
+
+#![cfg(target_os = "linux")]
+
+use std::collections::HashSet;
+use std::fs;
+use std::io;
+use std::mem;
+use std::net::{IpAddr, Ipv4Addr, Ipv6Addr, SocketAddr};
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, Ordering};
+
+use parking_lot::Mutex;
+use tuai_common::{ConnectionInfo, PlatformError, PlatformResult, TcpStats};
+
+use super::net_table::{parse_table, SocketRow, TableKind};
+use super::proc_net::ProcNetMonitor;
+use super::socket_index::SocketIndex;
+use super::NetworkMonitorBackend;
+use crate::procfs;
+
+/// Request type for sock_diag dumps (linux/sock_diag.h)
+const SOCK_DIAG_BY_FAMILY: u16 = 20;
+
+/// Netlink message types and flags
+const NLMSG_ERROR: u16 = 2;
+const NLMSG_DONE: u16 = 3;
+const NLM_F_REQUEST: u16 = 0x01;
+const NLM_F_DUMP: u16 = 0x300;
+
+/// inet_diag extension carrying struct tcp_info (linux/inet_diag.h)
+const INET_DIAG_INFO: u16 = 2;
+
+/// TCP states (include/net/tcp_states.h)
+const TCP_ESTABLISHED: u8 = 1;
+const TCP_TIME_WAIT: u8 = 6;
+const TCP_LISTEN: u8 = 10;
+
+/// Every state except TIME_WAIT and LISTEN
+pub const DEFAULT_STATES: u32 = 0xFFF & !(1 << TCP_TIME_WAIT | 1 << TCP_LISTEN);
+
+/// sizeof(struct nlmsghdr)
+const NLMSG_HDRLEN: usize = 16;
+/// sizeof(struct inet_diag_req_v2)
+const INET_DIAG_REQ_LEN: usize = 56;
+/// sizeof(struct inet_diag_msg)
+const INET_DIAG_MSG_LEN: usize = 72;
+
+/// Offsets within struct tcp_info
+const TCP_INFO_RTT: usize = 68;
+const TCP_INFO_BYTES_ACKED: usize = 120;
+const TCP_INFO_BYTES_RECEIVED: usize = 128;
+
+/// Receive buffer; the kernel fills dump replies up to about a page each
+const RECV_BUF_SIZE: usize = 64 * 1024;
+
+/// A decoded inet_diag_msg
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) struct DiagRecord {
+    /// Same shape as a /proc/net row, so connections are built the same way
+    pub row: SocketRow<'static>,
+    /// Owner uid of the socket
+    pub uid: u32,
+    pub stats: Option<TcpStats>,
+}
+
+/// Network monitor using NETLINK_SOCK_DIAG (Linux)
+pub struct SockDiagMonitor {
+    running: AtomicBool,
+    /// Kernel-side state filter (bit n set reports TCP state n)
+    states: u32,
+    /// Socket inode to PID mapping, updated incrementally
+    index: Mutex<SocketIndex>,
+}
+
+impl SockDiagMonitor {
+    pub fn new() -> Self {
+        Self::with_states(DEFAULT_STATES)
+    }
+
+    /// Monitor reporting only the TCP states set in `states`
+    pub fn with_states(states: u32) -> Self {
+        Self {
+            running: AtomicBool::new(false),
+            states,
+            index: Mutex::new(SocketIndex::new()),
+        }
+    }
+
+    /// Check if sock_diag can be used
+    ///
+    /// Dumping inet sockets needs no privileges, but the interface may be
+    /// compiled out or blocked by seccomp.
+    pub fn is_available() -> bool {
+        dump(TableKind::Tcp, 0).is_ok()
+    }
+
+    /// Whether the state filter lets sockets in `state` through
+    fn reports_state(&self, state: u8) -> bool {
+        1u32.checked_shl(state.into()).is_some_and(|bit| self.states & bit != 0)
+    }
+
+    /// Dump the TCP and UDP sockets in the current network namespace
+    fn dump_all(&self) -> PlatformResult<Vec<DiagRecord>> {
+        let mut records = Vec::new();
+        for kind in [TableKind::Tcp, TableKind::Tcp6, TableKind::Udp, TableKind::Udp6] {
+            let dumped = dump(kind, self.states).map_err(|e| {
+                PlatformError::CollectionFailed(format!("sock_diag dump failed: {}", e))
+            })?;
+            records.extend(dumped);
+        }
+        Ok(records)
+    }
+
+    /// Unix sockets, which inet_diag does not cover
+    fn unix_table() -> Vec<u8> {
+        fs::read("/proc/net/unix").unwrap_or_default()
+    }
+
+    /// Socket tables of the namespaces of `pids` other than ours
+    fn foreign_tables(pids: &[u32]) -> Vec<(TableKind, Vec<u8>)> {
+        let own = fs::read_link("/proc/self/ns/net").ok();
+        let namespace_of = |pid: u32| fs::read_link(format!("/proc/{}/ns/net", pid)).ok();
+        let net_dirs: Vec<String> = foreign_namespaces(pids, own.as_deref(), namespace_of)
+            .into_iter()
+            .map(|pid| format!("/proc/{}/net", pid))
+            .collect();
+        ProcNetMonitor::read_tables(&net_dirs)
+    }
+
+    /// Resolve new inodes against `candidates`, then build connections for
+    /// the records and the /proc table rows `keep` accepts given their owner
+    fn connections<F>(
+        index: &mut SocketIndex,
+        records: &[DiagRecord],
+        table_rows: &[SocketRow<'_>],
+        candidates: &[u32],
+        keep: F,
+    ) -> Vec<ConnectionInfo>
+    where
+        F: Fn(&SocketRow<'_>, Option<u32>) -> bool,
+    {
+        let inodes: Vec<u64> = records
+            .iter()
+            .map(|record| record.row.inode)
+            .chain(table_rows.iter().map(|row| row.inode))
+            .collect();
+        index.resolve(&inodes, candidates, ProcNetMonitor::socket_inodes_for_pid);
+        index.retain_unowned(&inodes.into_iter().collect());
+
+        let mut connections = Vec::new();
+        for record in records {
+            let owner = index.owner(record.row.inode);
+            if keep(&record.row, owner) {
+                let mut conn = ProcNetMonitor::connection(&record.row, owner.unwrap_or(0));
+                conn.stats = record.stats;
+                connections.push(conn);
+            }
+        }
+        for row in table_rows {
+            let owner = index.owner(row.inode);
+            if keep(row, owner) {
+                connections.push(ProcNetMonitor::connection(row, owner.unwrap_or(0)));
+            }
+        }
+        connections
+    }
+}
+
+impl Default for SockDiagMonitor {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl NetworkMonitorBackend for SockDiagMonitor {
+    fn start(&mut self) -> PlatformResult<()> {
+        if self.running.load(Ordering::Relaxed) {
+            return Ok(());
+        }
+
+        if !Self::is_available() {
+            return Err(PlatformError::NotSupported(
+                "NETLINK_SOCK_DIAG is not available".to_string(),
+            ));
+        }
+
+        self.running.store(true, Ordering::Relaxed);
+        tracing::info!("sock_diag network monitor started");
+        Ok(())
+    }
+
+    fn stop(&mut self) -> PlatformResult<()> {
+        self.running.store(false, Ordering::Relaxed);
+        tracing::info!("sock_diag network monitor stopped");
+        Ok(())
+    }
+
+    fn is_running(&self) -> bool {
+        self.running.load(Ordering::Relaxed)
+    }
+
+    fn snapshot(&self) -> PlatformResult<Vec<ConnectionInfo>> {
+        let records = self.dump_all()?;
+        let unix = Self::unix_table();
+        let unix_rows: Vec<SocketRow<'_>> = parse_table(&unix, TableKind::Unix).collect();
+
+        let pids = procfs::list_pids()?;
+        let mut index = self.index.lock();
+        index.sync(&pids, ProcNetMonitor::socket_inodes_for_pid);
+
+        // Unix sockets are only reported with a known owner
+        Ok(Self::connections(&mut index, &records, &unix_rows, &pids, |row, owner| {
+            owner.is_some() || row.kind != TableKind::Unix
+        }))
+    }
+
+    fn snapshot_for(&self, pids: &[u32]) -> PlatformResult<Vec<ConnectionInfo>> {
+        // No uid pre-filter: setuid processes and sockets inherited across a
+        // uid change are owned by another uid than /proc/<pid>. Ownership
+        // comes from the fd tables of the requested processes only.
+        let records = self.dump_all()?;
+
+        let unix = Self::unix_table();
+        let foreign = Self::foreign_tables(pids);
+        // Rows of other namespaces get the state filter the kernel applies
+        // to the dump
+        let table_rows: Vec<SocketRow<'_>> = parse_table(&unix, TableKind::Unix)
+            .chain(
+                foreign
+                    .iter()
+                    .flat_map(|(kind, content)| parse_table(content, *kind))
+                    .filter(|row| row.kind == TableKind::Unix || self.reports_state(row.state)),
+            )
+            .collect();
+
+        let mut index = self.index.lock();
+        index.evict_exited(pids);
+        index.ensure(pids, ProcNetMonitor::socket_inodes_for_pid);
+
+        // Only sockets owned by the requested processes
+        Ok(Self::connections(&mut index, &records, &table_rows, pids, |_, owner| {
+            owner.is_some_and(|pid| pids.contains(&pid))
+        }))
+    }
+}
+
+/// One PID per network namespace other than `own` among `pids`
+///
+/// PIDs whose namespace cannot be read are assumed to share ours; their
+/// sockets are in the dump if they are anywhere we can see.
+fn foreign_namespaces<F>(pids: &[u32], own: Option<&Path>, namespace_of: F) -> Vec<u32>
+where
+    F: Fn(u32) -> Option<PathBuf>,
+{
+    let mut seen: HashSet<PathBuf> = HashSet::new();
+    pids.iter()
+        .copied()
+        .filter(|pid| match namespace_of(*pid) {
+            Some(namespace) => Some(namespace.as_path()) != own && seen.insert(namespace),
+            None => false,
+        })
+        .collect()
+}
+
+/// Dump one socket table through a fresh sock_diag socket
+fn dump(kind: TableKind, states: u32) -> io::Result<Vec<DiagRecord>> {
+    let socket = open_diag_socket()?;
+    let request = build_request(kind, states);
+
+    let mut addr: libc::sockaddr_nl = unsafe { mem::zeroed() };
+    addr.nl_family = libc::AF_NETLINK as libc::sa_family_t;
+    let sent = unsafe {
+        libc::sendto(
+            socket.as_raw_fd(),
+            request.as_ptr() as *const libc::c_void,
+            request.len(),
+            0,
+            &addr as *const libc::sockaddr_nl as *const libc::sockaddr,
+            mem::size_of::<libc::sockaddr_nl>() as libc::socklen_t,
+        )
+    };
+    if sent < 0 {
+        return Err(io::Error::last_os_error());
+    }
+
+    let mut buf = vec![0u8; RECV_BUF_SIZE];
+    let mut records = Vec::new();
+    loop {
+        let n = unsafe {
+            libc::recv(
+                socket.as_raw_fd(),
+                buf.as_mut_ptr() as *mut libc::c_void,
+                buf.len(),
+                0,
+            )
+        };
+        if n < 0 {
+            let err = io::Error::last_os_error();
+            if err.kind() == io::ErrorKind::Interrupted {
+                continue;
+            }
+            return Err(err);
+        }
+        if n == 0 || parse_messages(&buf[..n as usize], kind, &mut records)? {
+            return Ok(records);
+        }
+    }
+}
+
+fn open_diag_socket() -> io::Result<OwnedFd> {
+    let fd = unsafe {
+        libc::socket(
+            libc::AF_NETLINK,
+            libc::SOCK_DGRAM | libc::SOCK_CLOEXEC,
+            libc::NETLINK_SOCK_DIAG,
+        )
+    };
+    if fd < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(unsafe { OwnedFd::from_raw_fd(fd) })
+}
+
+/// Build a SOCK_DIAG_BY_FAMILY dump request (nlmsghdr + inet_diag_req_v2)
+fn build_request(kind: TableKind, states: u32) -> [u8; NLMSG_HDRLEN + INET_DIAG_REQ_LEN] {
+    let mut msg = [0u8; NLMSG_HDRLEN + INET_DIAG_REQ_LEN];
+    let (family, protocol, ext) = match kind {
+        TableKind::Tcp => (libc::AF_INET, libc::IPPROTO_TCP, 1 << (INET_DIAG_INFO - 1)),
+        TableKind::Tcp6 => (libc::AF_INET6, libc::IPPROTO_TCP, 1 << (INET_DIAG_INFO - 1)),
+        TableKind::Udp => (libc::AF_INET, libc::IPPROTO_UDP, 0),
+        TableKind::Udp6 => (libc::AF_INET6, libc::IPPROTO_UDP, 0),
+        TableKind::Unix => unreachable!("Unix sockets are read from /proc/net/unix"),
+    };
+
+    // struct nlmsghdr
+    msg[0..4].copy_from_slice(&((NLMSG_HDRLEN + INET_DIAG_REQ_LEN) as u32).to_ne_bytes());
+    msg[4..6].copy_from_slice(&SOCK_DIAG_BY_FAMILY.to_ne_bytes());
+    msg[6..8].copy_from_slice(&(NLM_F_REQUEST | NLM_F_DUMP).to_ne_bytes());
+    // nlmsg_seq and nlmsg_pid stay 0
+
+    // struct inet_diag_req_v2; the socket id stays zeroed (match all)
+    msg[16] = family as u8;
+    msg[17] = protocol as u8;
+    msg[18] = ext as u8;
+    msg[20..24].copy_from_slice(&states.to_ne_bytes());
+
+    msg
+}
+
+/// Decode the dump replies in `buf`; returns true once the dump is done
+pub(crate) fn parse_messages(
+    buf: &[u8],
+    kind: TableKind,
+    out: &mut Vec<DiagRecord>,
+) -> io::Result<bool> {
+    let mut offset = 0;
+
+    while offset + NLMSG_HDRLEN <= buf.len() {
+        let len = read_u32(buf, offset) as usize;
+        let msg_type = u16::from_ne_bytes([buf[offset + 4], buf[offset + 5]]);
+        if len < NLMSG_HDRLEN || offset + len > buf.len() {
+            break;
+        }
+        let payload = &buf[offset + NLMSG_HDRLEN..offset + len];
+
+        match msg_type {
+            NLMSG_DONE => return Ok(true),
+            NLMSG_ERROR => {
+                // struct nlmsgerr starts with a negative errno (0 is an ack)
+                let errno = if payload.len() >= 4 { read_u32(payload, 0) as i32 } else { 0 };
+                if errno != 0 {
+                    return Err(io::Error::from_raw_os_error(-errno));
+                }
+                return Ok(true);
+            }
+            SOCK_DIAG_BY_FAMILY => {
+                if let Some(record) = parse_diag_msg(payload, kind) {
+                    out.push(record);
+                }
+            }
+            _ => {}
+        }
+
+        // NLMSG_ALIGN
+        offset += (len + 3) & !3;
+    }
+    Ok(false)
+}
+
+/// Decode a struct inet_diag_msg and its attributes
+fn parse_diag_msg(msg: &[u8], kind: TableKind) -> Option<DiagRecord> {
+    if msg.len() < INET_DIAG_MSG_LEN {
+        return None;
+    }
+
+    let family = msg[0] as libc::c_int;
+    let state = msg[1];
+    // struct inet_diag_sockid: ports and addresses in network byte order
+    let sport = u16::from_be_bytes([msg[4], msg[5]]);
+    let dport = u16::from_be_bytes([msg[6], msg[7]]);
+    let (src, dst) = match family {
+        libc::AF_INET => (
+            IpAddr::V4(Ipv4Addr::new(msg[8], msg[9], msg[10], msg[11])),
+            IpAddr::V4(Ipv4Addr::new(msg[24], msg[25], msg[26], msg[27])),
+        ),
+        libc::AF_INET6 => {
+            let mut src = [0u8; 16];
+            let mut dst = [0u8; 16];
+            src.copy_from_slice(&msg[8..24]);
+            dst.copy_from_slice(&msg[24..40]);
+            (IpAddr::V6(Ipv6Addr::from(src)), IpAddr::V6(Ipv6Addr::from(dst)))
+        }
+        _ => return None,
+    };
+    let uid = read_u32(msg, 64);
+    let inode = read_u32(msg, 68) as u64;
+
+    let mut stats = None;
+    if state == TCP_ESTABLISHED {
+        let mut offset = INET_DIAG_MSG_LEN;
+        // struct rtattr { u16 rta_len; u16 rta_type; }
+        while offset + 4 <= msg.len() {
+            let rta_len = u16::from_ne_bytes([msg[offset], msg[offset + 1]]) as usize;
+            let rta_type = u16::from_ne_bytes([msg[offset + 2], msg[offset + 3]]);
+            if rta_len < 4 || offset + rta_len > msg.len() {
+                break;
+            }
+            if rta_type == INET_DIAG_INFO {
+                stats = parse_tcp_info(&msg[offset + 4..offset + rta_len]);
+            }
+            // RTA_ALIGN
+            offset += (rta_len + 3) & !3;
+        }
+    }
+
+    Some(DiagRecord {
+        row: SocketRow {
+            kind,
+            inode,
+            local: Some(SocketAddr::new(src, sport)),
+            remote: Some(SocketAddr::new(dst, dport)),
+            state,
+            path: None,
+        },
+        uid,
+        stats,
+    })
+}
+
+/// Counters from struct tcp_info; older kernels send a shorter struct
+fn parse_tcp_info(info: &[u8]) -> Option<TcpStats> {
+    if info.len() < TCP_INFO_RTT + 4 {
+        return None;
+    }
+    let read_u64 = |at: usize| {
+        info.get(at..at + 8)
+            .map_or(0, |bytes| u64::from_ne_bytes(bytes.try_into().unwrap()))
+    };
+    Some(TcpStats {
+        rtt_us: read_u32(info, TCP_INFO_RTT),
+        bytes_acked: read_u64(TCP_INFO_BYTES_ACKED),
+        bytes_received: read_u64(TCP_INFO_BYTES_RECEIVED),
+    })
+}
+
+fn read_u32(buf: &[u8], at: usize) -> u32 {
+    u32::from_ne_bytes([buf[at], buf[at + 1], buf[at + 2], buf[at + 3]])
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_foreign_namespaces_one_pid_each() {
+        let own = Path::new("net:[4026531840]");
+        let namespace_of = |pid: u32| match pid {
+            1 | 2 => Some(PathBuf::from("net:[4026531840]")),
+            10 | 11 => Some(PathBuf::from("net:[4026532200]")),
+            20 => Some(PathBuf::from("net:[4026532300]")),
+            _ => None,
+        };
+        assert_eq!(foreign_namespaces(&[1, 10, 2, 11, 20, 99], Some(own), namespace_of), vec![10, 20]);
+        assert!(foreign_namespaces(&[1, 2], Some(own), namespace_of).is_empty());
+
+        let monitor = SockDiagMonitor::new();
+        assert!(monitor.reports_state(TCP_ESTABLISHED));
+        assert!(!monitor.reports_state(TCP_LISTEN));
+        assert!(!monitor.reports_state(200));
+    }
+
+    /// One dump reply holding an established IPv4 TCP socket with tcp_info
+    fn tcp_reply() -> Vec<u8> {
+        let mut info = vec![0u8; 232];
+        info[TCP_INFO_RTT..TCP_INFO_RTT + 4].copy_from_slice(&1500u32.to_ne_bytes());
+        info[TCP_INFO_BYTES_ACKED..TCP_INFO_BYTES_ACKED + 8].copy_from_slice(&4096u64.to_ne_bytes());
+        info[TCP_INFO_BYTES_RECEIVED..TCP_INFO_BYTES_RECEIVED + 8]
+            .copy_from_slice(&65536u64.to_ne_bytes());
+
+        let mut msg = vec![0u8; INET_DIAG_MSG_LEN];
+        msg[0] = libc::AF_INET as u8;
+        msg[1] = TCP_ESTABLISHED;
+        msg[4..6].copy_from_slice(&54321u16.to_be_bytes());
+        msg[6..8].copy_from_slice(&443u16.to_be_bytes());
+        msg[8..12].copy_from_slice(&[10, 0, 0, 2]);
+        msg[24..28].copy_from_slice(&[93, 184, 216, 34]);
+        msg[64..68].copy_from_slice(&1000u32.to_ne_bytes());
+        msg[68..72].copy_from_slice(&424242u32.to_ne_bytes());
+        msg.extend_from_slice(&((4 + info.len()) as u16).to_ne_bytes());
+        msg.extend_from_slice(&INET_DIAG_INFO.to_ne_bytes());
+        msg.extend_from_slice(&info);
+
+        let mut buf = Vec::new();
+        buf.extend_from_slice(&((NLMSG_HDRLEN + msg.len()) as u32).to_ne_bytes());
+        buf.extend_from_slice(&SOCK_DIAG_BY_FAMILY.to_ne_bytes());
+        buf.extend_from_slice(&[0u8; 10]);
+        buf.extend_from_slice(&msg);
+
+        // NLMSG_DONE
+        buf.extend_from_slice(&(NLMSG_HDRLEN as u32 + 4).to_ne_bytes());
+        buf.extend_from_slice(&NLMSG_DONE.to_ne_bytes());
+        buf.extend_from_slice(&[0u8; 14]);
+        buf
+    }
+
+    #[test]
+    fn test_build_request() {
+        let req = build_request(TableKind::Tcp6, DEFAULT_STATES);
+        assert_eq!(read_u32(&req, 0) as usize, req.len());
+        assert_eq!(u16::from_ne_bytes([req[4], req[5]]), SOCK_DIAG_BY_FAMILY);
+        assert_eq!(req[16], libc::AF_INET6 as u8);
+        assert_eq!(req[17], libc::IPPROTO_TCP as u8);
+        assert_eq!(req[18], 1 << (INET_DIAG_INFO - 1));
+
+        let states = read_u32(&req, 20);
+        assert_eq!(states & (1 << TCP_ESTABLISHED), 1 << TCP_ESTABLISHED);
+        assert_eq!(states & (1 << TCP_LISTEN), 0);
+        assert_eq!(states & (1 << TCP_TIME_WAIT), 0);
+    }
+
+    #[test]
+    fn test_parse_messages() {
+        let mut records = Vec::new();
+        let done = parse_messages(&tcp_reply(), TableKind::Tcp, &mut records).unwrap();
+        assert!(done);
+        assert_eq!(records.len(), 1);
+
+        let record = records[0];
+        assert_eq!(record.row.local, Some("10.0.0.2:54321".parse().unwrap()));
+        assert_eq!(record.row.remote, Some("93.184.216.34:443".parse().unwrap()));
+        assert_eq!(record.row.inode, 424242);
+        assert_eq!(record.uid, 1000);
+        assert_eq!(
+            record.stats,
+            Some(TcpStats {
+                rtt_us: 1500,
+                bytes_acked: 4096,
+                bytes_received: 65536,
+            })
+        );
+
+        let conn = ProcNetMonitor::connection(&record.row, 7);
+        assert_eq!(conn.remote_port, Some(443));
+        assert_eq!(conn.state, tuai_common::ConnectionState::Established);
+    }
+
+    #[test]
+    fn test_parse_error_reply() {
+        let mut buf = Vec::new();
+        buf.extend_from_slice(&(NLMSG_HDRLEN as u32 + 4).to_ne_bytes());
+        buf.extend_from_slice(&NLMSG_ERROR.to_ne_bytes());
+        buf.extend_from_slice(&[0u8; 10]);
+        buf.extend_from_slice(&(-libc::EPERM).to_ne_bytes());
+
+        let err = parse_messages(&buf, TableKind::Tcp, &mut Vec::new()).unwrap_err();
+        assert_eq!(err.raw_os_error(), Some(libc::EPERM));
+    }
+
+    #[test]
+    fn test_snapshot_for_own_connection() {
+        if !SockDiagMonitor::is_available() {
+            return;
+        }
+        let listener = std::net::TcpListener::bind("127.0.0.1:0").unwrap();
+        let client = std::net::TcpStream::connect(listener.local_addr().unwrap()).unwrap();
+        let _server = listener.accept().unwrap();
+        let port = client.local_addr().unwrap().port();
+
+        let monitor = SockDiagMonitor::new();
+        let connections = monitor.snapshot_for(&[std::process::id()]).unwrap();
+        let conn = connections
+            .iter()
+            .find(|c| c.local_port == Some(port))
+            .expect("own established connection");
+        assert_eq!(conn.pid, std::process::id());
+        assert!(conn.stats.is_some());
+        // The listening socket is filtered out by the kernel
+        assert!(!connections
+            .iter()
+            .any(|c| c.local_port == Some(listener.local_addr().unwrap().port()) && c.remote_port.is_none()));
+    }
+}
@@ -0,0 +1,255 @@
+//! Long-lived socket inode to PID index
+//!
+//! The socket tables in /proc/net only name sockets by inode; the owning
+//! process is found by reading `/proc/<pid>/fd` links. The index keeps that
+//! mapping between polls. A PID's fd directory is read when the PID is
+//! first seen, and its entries are dropped when it exits. Inodes that show
+//! up later (a known process opened a new socket) are resolved lazily by
+//! rescanning. Inodes a rescan cannot attribute, such as kernel sockets or
+//! processes we may not inspect, are remembered so they do not trigger a
+//! rescan on every poll.
+
+use std::collections::{HashMap, HashSet};
+use std::path::Path;
+
+use crate::procfs;
+
+/// Socket inode to owning PID, kept across polls
+#[derive(Debug, Default)]
+pub struct SocketIndex {
+    /// Socket inode -> owning PID
+    owners: HashMap<u64, u32>,
+    /// Socket inodes found in each scanned PID's fd directory
+    by_pid: HashMap<u32, Vec<u64>>,
+    /// Inodes the last rescan could not attribute
+    unowned: HashSet<u64>,
+}
+
+impl SocketIndex {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Owning PID of a socket inode, if known
+    pub fn owner(&self, inode: u64) -> Option<u32> {
+        self.owners.get(&inode).copied()
+    }
+
+    /// Number of sockets with a known owner
+    pub fn len(&self) -> usize {
+        self.owners.len()
+    }
+
+    /// Whether no socket owner is known
+    pub fn is_empty(&self) -> bool {
+        self.owners.is_empty()
+    }
+
+    /// PIDs whose fd directory has been scanned
+    pub fn pids(&self) -> Vec<u32> {
+        self.by_pid.keys().copied().collect()
+    }
+
+    /// Bring the index in line with the full list of live PIDs
+    ///
+    /// New PIDs are scanned; PIDs missing from `live` have exited and are
+    /// evicted.
+    pub fn sync<F>(&mut self, live: &[u32], scan: F)
+    where
+        F: Fn(u32) -> Vec<(u64, u32)> + Sync,
+    {
+        let live_set: HashSet<u32> = live.iter().copied().collect();
+        let exited: Vec<u32> = self
+            .by_pid
+            .keys()
+            .filter(|pid| !live_set.contains(pid))
+            .copied()
+            .collect();
+        for pid in exited {
+            self.evict(pid);
+        }
+        self.ensure(live, scan);
+    }
+
+    /// Scan the PIDs in `pids` that are not indexed yet, keeping the rest
+    pub fn ensure<F>(&mut self, pids: &[u32], scan: F)
+    where
+        F: Fn(u32) -> Vec<(u64, u32)> + Sync,
+    {
+        let new: Vec<u32> = pids
+            .iter()
+            .filter(|pid| !self.by_pid.contains_key(pid))
+            .copied()
+            .collect();
+        self.rescan(&new, scan);
+    }
+
+    /// Evict indexed PIDs that have exited, except those in `keep`
+    ///
+    /// For scoped reads, where no full PID list is at hand: only PIDs
+    /// that are indexed and not requested again are checked.
+    pub fn evict_exited(&mut self, keep: &[u32]) {
+        for pid in self.pids() {
+            if !keep.contains(&pid) && !Path::new(&format!("/proc/{}", pid)).exists() {
+                self.evict(pid);
+            }
+        }
+    }
+
+    /// Drop everything known about an exited process
+    pub fn evict(&mut self, pid: u32) {
+        if let Some(inodes) = self.by_pid.remove(&pid) {
+            for inode in inodes {
+                // The socket may have been passed on to another process
+                if self.owners.get(&inode) == Some(&pid) {
+                    self.owners.remove(&inode);
+                }
+            }
+        }
+    }
+
+    /// Attribute inodes missing from the index by rescanning `candidates`
+    ///
+    /// Only inodes that are neither known nor already found unowned cause
+    /// a rescan. Those still unattributed afterwards are remembered as
+    /// unowned. Returns whether a rescan happened.
+    pub fn resolve<F>(&mut self, inodes: &[u64], candidates: &[u32], scan: F) -> bool
+    where
+        F: Fn(u32) -> Vec<(u64, u32)> + Sync,
+    {
+        let unknown: Vec<u64> = inodes
+            .iter()
+            .filter(|inode| {
+                **inode != 0 && !self.owners.contains_key(inode) && !self.unowned.contains(inode)
+            })
+            .copied()
+            .collect();
+        if unknown.is_empty() {
+            return false;
+        }
+
+        self.rescan(candidates, scan);
+        for inode in unknown {
+            if !self.owners.contains_key(&inode) {
+                self.unowned.insert(inode);
+            }
+        }
+        true
+    }
+
+    /// Forget unowned inodes that are no longer in the socket tables
+    pub fn retain_unowned(&mut self, seen: &HashSet<u64>) {
+        self.unowned.retain(|inode| seen.contains(inode));
+    }
+
+    /// Re-read the sockets of `pids`, replacing what was known about them
+    fn rescan<F>(&mut self, pids: &[u32], scan: F)
+    where
+        F: Fn(u32) -> Vec<(u64, u32)> + Sync,
+    {
+        if pids.is_empty() {
+            return;
+        }
+
+        let pairs = procfs::par_flat_map(pids, procfs::thread_budget(), scan);
+        // Unreadable or socket-less PIDs are recorded too, so they are not
+        // scanned again until a rescan is needed
+        let mut found: HashMap<u32, Vec<u64>> = pids.iter().map(|&pid| (pid, Vec::new())).collect();
+        for (inode, pid) in pairs {
+            found.entry(pid).or_default().push(inode);
+        }
+
+        for (pid, inodes) in found {
+            self.evict(pid);
+            for &inode in &inodes {
+                self.owners.insert(inode, pid);
+                self.unowned.remove(&inode);
+            }
+            self.by_pid.insert(pid, inodes);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    /// Fake fd scan: PID n holds sockets n*10 and n*10+1
+    fn scan(pid: u32) -> Vec<(u64, u32)> {
+        vec![(pid as u64 * 10, pid), (pid as u64 * 10 + 1, pid)]
+    }
+
+    #[test]
+    fn test_sync_scans_new_and_evicts_exited() {
+        let scans = AtomicUsize::new(0);
+        let counting = |pid| {
+            scans.fetch_add(1, Ordering::Relaxed);
+            scan(pid)
+        };
+
+        let mut index = SocketIndex::new();
+        index.sync(&[1, 2], counting);
+        assert_eq!(scans.load(Ordering::Relaxed), 2);
+        assert_eq!(index.owner(10), Some(1));
+        assert_eq!(index.owner(21), Some(2));
+
+        // Steady state: nothing is rescanned
+        index.sync(&[1, 2], counting);
+        assert_eq!(scans.load(Ordering::Relaxed), 2);
+
+        // PID 1 exits, PID 3 appears
+        index.sync(&[2, 3], counting);
+        assert_eq!(scans.load(Ordering::Relaxed), 3);
+        assert_eq!(index.owner(10), None);
+        assert_eq!(index.owner(30), Some(3));
+        assert_eq!(index.len(), 4);
+    }
+
+    #[test]
+    fn test_resolve_unknown_inodes_once() {
+        let scans = AtomicUsize::new(0);
+        let opened = AtomicUsize::new(0);
+        // PID 1 opens socket 99 after its first scan
+        let scan_with_new = |pid| {
+            scans.fetch_add(1, Ordering::Relaxed);
+            let mut sockets = scan(pid);
+            if opened.load(Ordering::Relaxed) > 0 && pid == 1 {
+                sockets.push((99, pid));
+            }
+            sockets
+        };
+
+        let mut index = SocketIndex::new();
+        index.sync(&[1], scan_with_new);
+        assert!(!index.resolve(&[10, 11, 0], &[1], scan_with_new));
+
+        opened.store(1, Ordering::Relaxed);
+        assert!(index.resolve(&[10, 99], &[1], scan_with_new));
+        assert_eq!(index.owner(99), Some(1));
+
+        // 500 belongs to nobody we can see: one rescan, then cached
+        let before = scans.load(Ordering::Relaxed);
+        assert!(index.resolve(&[500], &[1], scan_with_new));
+        assert!(!index.resolve(&[500], &[1], scan_with_new));
+        assert_eq!(scans.load(Ordering::Relaxed), before + 1);
+
+        // Once 500 leaves the tables it may be resolved again
+        index.retain_unowned(&HashSet::new());
+        assert!(index.resolve(&[500], &[1], scan_with_new));
+    }
+
+    #[test]
+    fn test_ensure_keeps_other_pids() {
+        let mut index = SocketIndex::new();
+        index.ensure(&[1], scan);
+        index.ensure(&[2], scan);
+        assert_eq!(index.owner(10), Some(1));
+        assert_eq!(index.owner(20), Some(2));
+
+        index.evict(1);
+        let mut pids = index.pids();
+        pids.sort();
+        assert_eq!(pids, vec![2]);
+    }
+}
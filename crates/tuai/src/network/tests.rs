@@ -1031,6 +1031,53 @@ mod backend_tests {
         let snapshot = monitor.snapshot().unwrap();
         assert_eq!(snapshot.len(), count);
     }
+
+    #[test]
+    fn test_snapshot_for_filters_pids() {
+        let monitor = MockNetworkMonitor::with_connections(vec![
+            create_tcp_connection(1000, "10.0.0.1", 50000, "1.1.1.1", 443, ConnectionState::Established),
+            create_tcp_connection(2000, "10.0.0.1", 50001, "1.1.1.1", 443, ConnectionState::Established),
+            create_tcp_connection(3000, "10.0.0.1", 50002, "1.1.1.1", 443, ConnectionState::Established),
+        ]);
+
+        let scoped = monitor.snapshot_for(&[1000, 3000]).unwrap();
+        let mut pids: Vec<u32> = scoped.iter().map(|c| c.pid).collect();
+        pids.sort();
+        assert_eq!(pids, vec![1000, 3000]);
+
+        assert!(monitor.snapshot_for(&[]).unwrap().is_empty());
+    }
+
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_proc_net_snapshot_for_own_listener() {
+        let listener = std::net::TcpListener::bind("127.0.0.1:0").unwrap();
+        let port = listener.local_addr().unwrap().port();
+        let pid = std::process::id();
+
+        let monitor = crate::network::ProcNetMonitor::new();
+        let scoped = monitor.snapshot_for(&[pid]).unwrap();
+        assert!(scoped.iter().all(|c| c.pid == pid));
+        assert!(scoped
+            .iter()
+            .any(|c| c.protocol == Protocol::Tcp && c.local_port == Some(port)));
+    }
+
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_proc_net_index_picks_up_new_sockets() {
+        let pid = std::process::id();
+        let monitor = crate::network::ProcNetMonitor::new();
+        monitor.snapshot_for(&[pid]).unwrap();
+
+        // Opened after this PID was indexed: found by a lazy rescan
+        let listener = std::net::TcpListener::bind("127.0.0.1:0").unwrap();
+        let port = listener.local_addr().unwrap().port();
+        let scoped = monitor.snapshot_for(&[pid]).unwrap();
+        assert!(scoped
+            .iter()
+            .any(|c| c.protocol == Protocol::Tcp && c.local_port == Some(port)));
+    }
 }
 
 // ============================================================================
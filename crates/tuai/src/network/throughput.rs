@@ -0,0 +1,355 @@
+//! Per-agent network throughput accounting
+//!
+//! Each resource sample hands over the live connections with their socket
+//! counters (`tcp_info` via sock_diag; the /proc/net backend has none).
+//! Counter deltas are added to a flow per (agent, endpoint class, remote
+//! address), which keeps totals and one bucket per second in a fixed ring.
+//! Connections of processes attributed to an agent (node or git under
+//! claude) count towards that agent's flows. Rates are read from the last
+//! few buckets.
+//!
+//! Memory is bounded: rings have a fixed size, flows idle for a whole
+//! window are dropped, and at most `MAX_FLOWS` flows are kept.
+
+use std::collections::HashMap;
+
+use chrono::{DateTime, Utc};
+use tuai_common::ConnectionInfo;
+use uuid::Uuid;
+
+use super::{EndpointClass, EndpointClassifier};
+
+/// Seconds of per-second history kept per flow
+pub const WINDOW_SECS: usize = 60;
+
+/// Seconds averaged into the reported rates
+pub const RATE_SECS: usize = 10;
+
+/// Flows kept at most; the least recently active go first
+pub const MAX_FLOWS: usize = 1024;
+
+/// Traffic of one agent, with the processes attributed to it, to one
+/// remote address
+#[derive(Debug, Clone, PartialEq)]
+pub struct FlowStats {
+    /// PID of the agent
+    pub agent_pid: u32,
+    pub class: EndpointClass,
+    pub remote_addr: String,
+    /// Bytes sent (acknowledged by the peer) since the flow was first seen
+    pub bytes_sent: u64,
+    pub bytes_received: u64,
+    /// Bytes per second over the last `RATE_SECS`
+    pub sent_per_sec: f64,
+    pub received_per_sec: f64,
+    /// Latest smoothed RTT of any of the flow's connections
+    pub rtt_us: Option<u32>,
+    /// Live connections in the flow
+    pub connections: usize,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+struct FlowKey {
+    agent_pid: u32,
+    class: EndpointClass,
+    remote_addr: String,
+}
+
+#[derive(Debug)]
+struct Flow {
+    bytes_sent: u64,
+    bytes_received: u64,
+    sent: Ring,
+    received: Ring,
+    rtt_us: Option<u32>,
+    connections: usize,
+    /// Second of the last sample with traffic or live connections
+    last_active: i64,
+}
+
+/// Byte counts per second over the last `WINDOW_SECS` seconds
+#[derive(Debug)]
+struct Ring {
+    buckets: [u64; WINDOW_SECS],
+    /// Second the newest bucket belongs to
+    head: i64,
+}
+
+impl Ring {
+    fn new(now: i64) -> Self {
+        Self {
+            buckets: [0; WINDOW_SECS],
+            head: now,
+        }
+    }
+
+    /// Move the head to `now`, clearing the buckets skipped over
+    fn advance(&mut self, now: i64) {
+        let skipped = (now - self.head).clamp(0, WINDOW_SECS as i64);
+        for i in 1..=skipped {
+            self.buckets[slot(self.head + i)] = 0;
+        }
+        self.head = self.head.max(now);
+    }
+
+    fn add(&mut self, now: i64, bytes: u64) {
+        self.advance(now);
+        self.buckets[slot(now)] += bytes;
+    }
+
+    /// Average per second over the `secs` seconds up to `now`
+    fn rate(&self, now: i64, secs: usize) -> f64 {
+        let secs = secs.clamp(1, WINDOW_SECS) as i64;
+        let total: u64 = (now - secs + 1..=now)
+            .filter(|sec| *sec <= self.head && self.head - sec < WINDOW_SECS as i64)
+            .map(|sec| self.buckets[slot(sec)])
+            .sum();
+        total as f64 / secs as f64
+    }
+}
+
+fn slot(sec: i64) -> usize {
+    sec.rem_euclid(WINDOW_SECS as i64) as usize
+}
+
+/// Aggregates socket counters into per-flow totals and rates
+#[derive(Debug, Default)]
+pub struct ThroughputTracker {
+    /// Last (bytes_acked, bytes_received) per live connection
+    counters: HashMap<Uuid, (u64, u64)>,
+    flows: HashMap<FlowKey, Flow>,
+}
+
+impl ThroughputTracker {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Number of flows kept
+    pub fn len(&self) -> usize {
+        self.flows.len()
+    }
+
+    /// Whether no flow is kept
+    pub fn is_empty(&self) -> bool {
+        self.flows.is_empty()
+    }
+
+    /// Add the counters of the live connections as of `now`
+    ///
+    /// `agent_of` maps a connection's PID to the agent it is attributed
+    /// to. Connection ids must be stable across samples, as they are from
+    /// `NetworkMonitorService::poll_for`. Traffic from before a connection
+    /// was first seen counts towards the totals but not the rates.
+    pub fn record<A>(
+        &mut self,
+        live: &[ConnectionInfo],
+        classifier: &EndpointClassifier,
+        agent_of: A,
+        now: DateTime<Utc>,
+    ) where
+        A: Fn(u32) -> u32,
+    {
+        let now = now.timestamp();
+        let mut counters = HashMap::with_capacity(live.len());
+        for flow in self.flows.values_mut() {
+            flow.connections = 0;
+        }
+
+        for conn in live {
+            let (Some(remote_addr), Some(stats)) = (&conn.remote_addr, conn.stats) else {
+                continue;
+            };
+            let current = (stats.bytes_acked, stats.bytes_received);
+            let previous = self.counters.get(&conn.id).copied();
+            counters.insert(conn.id, current);
+
+            let key = FlowKey {
+                agent_pid: agent_of(conn.pid),
+                class: classifier.classify(remote_addr, conn.remote_port),
+                remote_addr: remote_addr.clone(),
+            };
+            let flow = self.flows.entry(key).or_insert_with(|| Flow {
+                bytes_sent: 0,
+                bytes_received: 0,
+                sent: Ring::new(now),
+                received: Ring::new(now),
+                rtt_us: None,
+                connections: 0,
+                last_active: now,
+            });
+            flow.connections += 1;
+            flow.last_active = now;
+            if stats.rtt_us > 0 {
+                flow.rtt_us = Some(stats.rtt_us);
+            }
+
+            let (sent, received) = match previous {
+                Some((acked, received)) => (
+                    current.0.saturating_sub(acked),
+                    current.1.saturating_sub(received),
+                ),
+                None => {
+                    flow.bytes_sent += current.0;
+                    flow.bytes_received += current.1;
+                    (0, 0)
+                }
+            };
+            flow.bytes_sent += sent;
+            flow.bytes_received += received;
+            flow.sent.add(now, sent);
+            flow.received.add(now, received);
+        }
+        // Closed connections drop out here
+        self.counters = counters;
+
+        self.flows
+            .retain(|_, flow| flow.connections > 0 || now - flow.last_active < WINDOW_SECS as i64);
+        if self.flows.len() > MAX_FLOWS {
+            let mut by_age: Vec<(i64, FlowKey)> = self
+                .flows
+                .iter()
+                .map(|(key, flow)| (flow.last_active, key.clone()))
+                .collect();
+            by_age.sort_unstable_by_key(|(last_active, _)| *last_active);
+            for (_, key) in by_age.into_iter().take(self.flows.len() - MAX_FLOWS) {
+                self.flows.remove(&key);
+            }
+        }
+    }
+
+    /// Totals and rates of every flow as of `now`
+    pub fn flows(&self, now: DateTime<Utc>) -> Vec<FlowStats> {
+        let now = now.timestamp();
+        self.flows
+            .iter()
+            .map(|(key, flow)| FlowStats {
+                agent_pid: key.agent_pid,
+                class: key.class,
+                remote_addr: key.remote_addr.clone(),
+                bytes_sent: flow.bytes_sent,
+                bytes_received: flow.bytes_received,
+                sent_per_sec: flow.sent.rate(now, RATE_SECS),
+                received_per_sec: flow.received.rate(now, RATE_SECS),
+                rtt_us: flow.rtt_us,
+                connections: flow.connections,
+            })
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use chrono::Duration;
+    use tuai_common::{Protocol, TcpStats};
+
+    fn conn(id: Uuid, remote: &str, sent: u64, received: u64) -> ConnectionInfo {
+        let mut conn = ConnectionInfo::new(7, Protocol::Tcp);
+        conn.id = id;
+        conn.remote_addr = Some(remote.to_string());
+        conn.remote_port = Some(443);
+        conn.stats = Some(TcpStats {
+            rtt_us: 20_000,
+            bytes_acked: sent,
+            bytes_received: received,
+        });
+        conn
+    }
+
+    #[test]
+    fn test_deltas_become_totals_and_rates() {
+        let classifier = EndpointClassifier::builtin();
+        let mut tracker = ThroughputTracker::new();
+        let t0 = Utc::now();
+        let id = Uuid::new_v4();
+
+        // Traffic from before the first sample: totals only
+        tracker.record(&[conn(id, "127.0.0.1", 1000, 5000)], &classifier, |pid| pid, t0);
+        let flows = tracker.flows(t0);
+        assert_eq!(flows.len(), 1);
+        assert_eq!(flows[0].class, EndpointClass::Localhost);
+        assert_eq!((flows[0].bytes_sent, flows[0].bytes_received), (1000, 5000));
+        assert_eq!(flows[0].received_per_sec, 0.0);
+
+        for i in 1..=10 {
+            let now = t0 + Duration::seconds(i);
+            let (sent, received) = (1000 + 100 * i as u64, 5000 + 1000 * i as u64);
+            tracker.record(&[conn(id, "127.0.0.1", sent, received)], &classifier, |pid| pid, now);
+        }
+        let t10 = t0 + Duration::seconds(10);
+        let flow = &tracker.flows(t10)[0];
+        assert_eq!(flow.bytes_received, 15_000);
+        assert_eq!(flow.received_per_sec, 1000.0);
+        assert_eq!(flow.sent_per_sec, 100.0);
+        assert_eq!(flow.rtt_us, Some(20_000));
+        assert_eq!(flow.connections, 1);
+
+        // Idle: the rate decays while the totals stay
+        let later = t10 + Duration::seconds(5);
+        tracker.record(&[conn(id, "127.0.0.1", 2000, 15_000)], &classifier, |pid| pid, later);
+        assert_eq!(tracker.flows(later)[0].received_per_sec, 500.0);
+    }
+
+    #[test]
+    fn test_connections_aggregate_per_remote() {
+        let classifier = EndpointClassifier::builtin();
+        let mut tracker = ThroughputTracker::new();
+        let now = Utc::now();
+        let (a, b) = (Uuid::new_v4(), Uuid::new_v4());
+
+        tracker.record(&[conn(a, "1.1.1.1", 0, 0), conn(b, "1.1.1.1", 0, 0)], &classifier, |pid| pid, now);
+        let next = now + Duration::seconds(1);
+        tracker.record(&[conn(a, "1.1.1.1", 10, 0), conn(b, "1.1.1.1", 30, 0)], &classifier, |pid| pid, next);
+
+        let flows = tracker.flows(next);
+        assert_eq!(flows.len(), 1);
+        assert_eq!(flows[0].bytes_sent, 40);
+        assert_eq!(flows[0].connections, 2);
+    }
+
+    #[test]
+    fn test_children_count_towards_their_agent() {
+        let classifier = EndpointClassifier::builtin();
+        let mut tracker = ThroughputTracker::new();
+        let now = Utc::now();
+
+        // Connections of the agent (7) and of a child (8) to the same remote
+        let mut child = conn(Uuid::new_v4(), "1.1.1.1", 0, 0);
+        child.pid = 8;
+        let agent = conn(Uuid::new_v4(), "1.1.1.1", 0, 0);
+        let agent_of = |pid| if pid == 8 { 7 } else { pid };
+        tracker.record(&[agent.clone(), child.clone()], &classifier, agent_of, now);
+
+        let next = now + Duration::seconds(1);
+        let mut agent = agent;
+        agent.stats.as_mut().unwrap().bytes_acked = 10;
+        child.stats.as_mut().unwrap().bytes_acked = 30;
+        tracker.record(&[agent, child], &classifier, agent_of, next);
+
+        let flows = tracker.flows(next);
+        assert_eq!(flows.len(), 1);
+        assert_eq!(flows[0].agent_pid, 7);
+        assert_eq!(flows[0].bytes_sent, 40);
+        assert_eq!(flows[0].connections, 2);
+    }
+
+    #[test]
+    fn test_memory_is_bounded() {
+        let classifier = EndpointClassifier::builtin();
+        let mut tracker = ThroughputTracker::new();
+        let t0 = Utc::now();
+
+        let live: Vec<_> = (0..MAX_FLOWS + 100)
+            .map(|i| conn(Uuid::new_v4(), &format!("10.0.{}.{}", i / 256, i % 256), 1, 1))
+            .collect();
+        tracker.record(&live, &classifier, |pid| pid, t0);
+        assert_eq!(tracker.len(), MAX_FLOWS);
+
+        // Flows without connections leave after a window of inactivity
+        tracker.record(&[], &classifier, |pid| pid, t0 + Duration::seconds(1));
+        assert_eq!(tracker.len(), MAX_FLOWS);
+        tracker.record(&[], &classifier, |pid| pid, t0 + Duration::seconds(WINDOW_SECS as i64));
+        assert!(tracker.is_empty());
+    }
+}
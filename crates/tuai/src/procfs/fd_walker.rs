@@ -0,0 +1,310 @@
+//! Allocation-light walker over `/proc/<pid>/fd`
+//!
+//! Opens `/proc/<pid>` once and works relative to that directory: the fd
+//! directory is listed with getdents64 into a reused buffer, link targets
+//! are read with readlinkat into a reused buffer, and fdinfo is only
+//! opened for the descriptors a caller asks flags for. Once the buffers
+//! have grown to fit, walking a process allocates nothing per descriptor.
+//! The device and inode of a target are likewise only read on demand,
+//! with one fstatat through the descriptor's link.
+
+use std::ffi::CStr;
+use std::io::{self, Write};
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd, RawFd};
+use std::os::unix::ffi::OsStrExt;
+use std::path::Path;
+
+use tuai_common::FileId;
+
+/// Initial getdents64 buffer size
+const DIRENT_BUF_SIZE: usize = 32 * 1024;
+
+/// Initial link target buffer size (grown for longer targets)
+const LINK_BUF_SIZE: usize = 1024;
+
+/// Enough for the `pos:` and `flags:` lines at the top of fdinfo
+const FDINFO_BUF_SIZE: usize = 128;
+
+/// Reusable walker over the open descriptors of processes
+pub struct FdWalker {
+    /// Path prefix, normally "/proc"
+    root: Vec<u8>,
+    path: Vec<u8>,
+    dirents: Vec<u8>,
+    link: Vec<u8>,
+    fdinfo: Vec<u8>,
+}
+
+/// One open descriptor seen by [`FdWalker::walk`]
+pub struct FdLink<'a> {
+    /// Descriptor number
+    pub fd: u32,
+    /// Link target, e.g. `/home/me/file` or `socket:[1234]`
+    pub target: &'a [u8],
+    /// NUL-terminated descriptor name inside the dirent buffer
+    name: &'a CStr,
+    fd_dir: RawFd,
+    pid_dir: RawFd,
+    fdinfo_dir: &'a mut Option<OwnedFd>,
+    fdinfo: &'a mut Vec<u8>,
+}
+
+impl FdLink<'_> {
+    /// Open flags from `fdinfo`, read on demand
+    ///
+    /// Returns None if the descriptor was closed in the meantime.
+    pub fn flags(&mut self) -> Option<u32> {
+        if self.fdinfo_dir.is_none() {
+            *self.fdinfo_dir = open_at(self.pid_dir, c"fdinfo", libc::O_DIRECTORY).ok();
+        }
+        let dir = self.fdinfo_dir.as_ref()?;
+        let file = open_at(dir.as_raw_fd(), self.name, 0).ok()?;
+
+        self.fdinfo.resize(FDINFO_BUF_SIZE, 0);
+        // SAFETY: the buffer is valid for writes of its full length
+        let n = unsafe {
+            libc::read(
+                file.as_raw_fd(),
+                self.fdinfo.as_mut_ptr().cast(),
+                self.fdinfo.len(),
+            )
+        };
+        if n <= 0 {
+            return None;
+        }
+        parse_fdinfo_flags(&self.fdinfo[..n as usize])
+    }
+
+    /// Device and inode of the open file, read on demand
+    ///
+    /// The link is followed to the file itself, so this works even when
+    /// the target path was renamed, unlinked or is not reachable from
+    /// this mount namespace. Returns None if the descriptor was closed.
+    pub fn file_id(&self) -> Option<FileId> {
+        let mut stat = std::mem::MaybeUninit::<libc::stat>::uninit();
+        // SAFETY: name is NUL-terminated and stat is valid for writes
+        if unsafe { libc::fstatat(self.fd_dir, self.name.as_ptr(), stat.as_mut_ptr(), 0) } != 0 {
+            return None;
+        }
+        // SAFETY: fstatat succeeded and filled the struct
+        let stat = unsafe { stat.assume_init() };
+        Some(FileId {
+            dev: stat.st_dev as u64,
+            ino: stat.st_ino as u64,
+        })
+    }
+}
+
+impl FdWalker {
+    /// Walker over the real /proc
+    pub fn new() -> Self {
+        Self::with_root("/proc")
+    }
+
+    /// Walker over a /proc-like tree at `root` (for tests and benchmarks)
+    pub fn with_root(root: impl AsRef<Path>) -> Self {
+        Self {
+            root: root.as_ref().as_os_str().as_bytes().to_vec(),
+            path: Vec::with_capacity(64),
+            dirents: vec![0; DIRENT_BUF_SIZE],
+            link: vec![0; LINK_BUF_SIZE],
+            fdinfo: Vec::with_capacity(FDINFO_BUF_SIZE),
+        }
+    }
+
+    /// Call `visit` for every open descriptor of `pid`
+    ///
+    /// Fails if the process is gone or not accessible; descriptors closed
+    /// during the walk are skipped.
+    pub fn walk<F>(&mut self, pid: u32, mut visit: F) -> io::Result<()>
+    where
+        F: FnMut(FdLink<'_>),
+    {
+        self.path.clear();
+        self.path.extend_from_slice(&self.root);
+        write!(self.path, "/{}\0", pid)?;
+        let path = CStr::from_bytes_with_nul(&self.path)
+            .map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, e))?;
+        let pid_dir = open_at(libc::AT_FDCWD, path, libc::O_DIRECTORY)?;
+        let fd_dir = open_at(pid_dir.as_raw_fd(), c"fd", libc::O_DIRECTORY)?;
+        let mut fdinfo_dir = None;
+
+        loop {
+            let len = read_dirents(fd_dir.as_raw_fd(), &mut self.dirents)?;
+            if len == 0 {
+                return Ok(());
+            }
+
+            let mut offset = 0;
+            while offset < len {
+                // struct linux_dirent64 { u64 d_ino; i64 d_off; u16 d_reclen; u8 d_type; char d_name[]; }
+                let record = &self.dirents[offset..len];
+                let reclen = u16::from_ne_bytes([record[16], record[17]]) as usize;
+                offset += reclen;
+                let Ok(name) = CStr::from_bytes_until_nul(&record[19..reclen]) else {
+                    continue;
+                };
+                let Some(fd) = parse_fd(name.to_bytes()) else {
+                    continue; // "." and ".."
+                };
+
+                let Some(target_len) = read_link_at(fd_dir.as_raw_fd(), name, &mut self.link) else {
+                    continue;
+                };
+                visit(FdLink {
+                    fd,
+                    target: &self.link[..target_len],
+                    name,
+                    fd_dir: fd_dir.as_raw_fd(),
+                    pid_dir: pid_dir.as_raw_fd(),
+                    fdinfo_dir: &mut fdinfo_dir,
+                    fdinfo: &mut self.fdinfo,
+                });
+            }
+        }
+    }
+}
+
+impl Default for FdWalker {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Parse the octal `flags:` line of an fdinfo file
+pub fn parse_fdinfo_flags(content: &[u8]) -> Option<u32> {
+    content
+        .split(|b| *b == b'\n')
+        .find_map(|line| line.strip_prefix(b"flags:"))
+        .and_then(|value| {
+            let value = value.trim_ascii();
+            if value.is_empty() || !value.iter().all(|b| (b'0'..=b'7').contains(b)) {
+                return None;
+            }
+            value
+                .iter()
+                .try_fold(0u32, |acc, b| acc.checked_mul(8)?.checked_add(u32::from(b - b'0')))
+        })
+}
+
+fn parse_fd(name: &[u8]) -> Option<u32> {
+    if name.is_empty() || !name.iter().all(u8::is_ascii_digit) {
+        return None;
+    }
+    name.iter()
+        .try_fold(0u32, |acc, b| acc.checked_mul(10)?.checked_add(u32::from(b - b'0')))
+}
+
+fn open_at(dir: RawFd, path: &CStr, flags: libc::c_int) -> io::Result<OwnedFd> {
+    // SAFETY: path is NUL-terminated; the returned descriptor is owned here
+    let fd = unsafe { libc::openat(dir, path.as_ptr(), libc::O_RDONLY | libc::O_CLOEXEC | flags) };
+    if fd < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    // SAFETY: fd was just opened and is not owned by anything else
+    Ok(unsafe { OwnedFd::from_raw_fd(fd) })
+}
+
+/// readlinkat into `buf`, growing it for long targets; returns the length
+fn read_link_at(dir: RawFd, name: &CStr, buf: &mut Vec<u8>) -> Option<usize> {
+    loop {
+        // SAFETY: name is NUL-terminated and buf is valid for buf.len() bytes
+        let n = unsafe { libc::readlinkat(dir, name.as_ptr(), buf.as_mut_ptr().cast(), buf.len()) };
+        if n < 0 {
+            return None;
+        }
+        let n = n as usize;
+        // A full buffer may mean the target was truncated
+        if n < buf.len() {
+            return Some(n);
+        }
+        let grown = buf.len() * 2;
+        buf.resize(grown, 0);
+    }
+}
+
+#[cfg(target_os = "linux")]
+fn read_dirents(dir: RawFd, buf: &mut [u8]) -> io::Result<usize> {
+    // SAFETY: buf is valid for writes of buf.len() bytes
+    let n = unsafe { libc::syscall(libc::SYS_getdents64, dir, buf.as_mut_ptr(), buf.len()) };
+    if n < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(n as usize)
+}
+
+/// Only Linux has /proc/<pid>/fd; elsewhere there is nothing to list
+#[cfg(not(target_os = "linux"))]
+fn read_dirents(_dir: RawFd, _buf: &mut [u8]) -> io::Result<usize> {
+    Ok(0)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_parse_fdinfo_flags() {
+        assert_eq!(parse_fdinfo_flags(b"pos:\t0\nflags:\t0100002\nmnt_id:\t25\n"), Some(0o100002));
+        assert_eq!(parse_fdinfo_flags(b"pos:\t0\nflags:\t00\n"), Some(0));
+        assert_eq!(parse_fdinfo_flags(b"pos:\t0\n"), None);
+        assert_eq!(parse_fdinfo_flags(b"flags:\t09\n"), None);
+    }
+
+    #[test]
+    fn test_walk_synthetic_tree() {
+        let root = tempfile::tempdir().unwrap();
+        let fd_dir = root.path().join("42/fd");
+        let fdinfo_dir = root.path().join("42/fdinfo");
+        std::fs::create_dir_all(&fd_dir).unwrap();
+        std::fs::create_dir_all(&fdinfo_dir).unwrap();
+
+        let long_target = format!("/{}", "x".repeat(3000));
+        let targets = ["/home/me/notes.txt", "socket:[12345]", long_target.as_str()];
+        for (fd, target) in targets.iter().enumerate() {
+            std::os::unix::fs::symlink(target, fd_dir.join(fd.to_string())).unwrap();
+            std::fs::write(fdinfo_dir.join(fd.to_string()), "pos:\t0\nflags:\t0100001\n").unwrap();
+        }
+
+        let mut walker = FdWalker::with_root(root.path());
+        let mut seen = Vec::new();
+        walker
+            .walk(42, |mut link| {
+                let flags = if link.target.starts_with(b"/") { link.flags() } else { None };
+                seen.push((link.fd, link.target.to_vec(), flags));
+            })
+            .unwrap();
+        seen.sort();
+
+        assert_eq!(seen.len(), 3);
+        assert_eq!(seen[0], (0, targets[0].as_bytes().to_vec(), Some(0o100001)));
+        assert_eq!(seen[1], (1, targets[1].as_bytes().to_vec(), None));
+        assert_eq!(seen[2].1.len(), long_target.len());
+
+        assert!(walker.walk(43, |_| {}).is_err());
+    }
+
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_walk_own_process() {
+        let file = tempfile::NamedTempFile::new().unwrap();
+        let expected = file.path().as_os_str().as_bytes().to_vec();
+
+        let mut found = None;
+        let mut file_id = None;
+        FdWalker::new()
+            .walk(std::process::id(), |mut link| {
+                if link.target == expected.as_slice() {
+                    found = link.flags();
+                    file_id = link.file_id();
+                }
+            })
+            .unwrap();
+        // Opened read-write
+        assert_eq!(found.map(|f| f & 3), Some(2));
+
+        use std::os::unix::fs::MetadataExt;
+        let meta = std::fs::metadata(file.path()).unwrap();
+        assert_eq!(file_id, Some(FileId { dev: meta.dev(), ino: meta.ino() }));
+    }
+}
@@ -0,0 +1,295 @@
+//! Shared /proc walking helpers
+//!
+//! Sweeps that visit every PID (socket inode mapping, open file listing)
+//! shard the PID list across scoped worker threads, the calling thread
+//! being one of them, and merge the results. Workers claim PIDs in chunks,
+//! so a few processes with thousands of descriptors do not serialize the
+//! sweep.
+//!
+//! The workers a sweep uses are bounded by a process-wide thread budget
+//! (`--scan-threads` / `TUAI_SCAN_THREADS`) and by the number of PIDs:
+//! every worker gets at least `MIN_PIDS_PER_THREAD`. Small hosts, and
+//! agent-scoped sweeps over fewer than twice that many processes, stay on
+//! the calling thread.
+//!
+//! Per-process descriptor listing goes through [`FdWalker`], which
+//! reuses its buffers across descriptors and processes. Whole files
+//! (stat, cmdline, fdinfo, socket tables) are read in batches with
+//! [`read_files`], over io_uring where the kernel allows it.
+
+#[cfg(unix)]
+mod fd_walker;
+#[cfg(target_os = "linux")]
+mod uring;
+
+#[cfg(unix)]
+pub use fd_walker::{parse_fdinfo_flags, FdLink, FdWalker};
+
+#[cfg(unix)]
+use std::cell::RefCell;
+use std::fs;
+use std::path::Path;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use parking_lot::Mutex;
+use tuai_common::{PlatformError, PlatformResult};
+
+/// Upper bound for the default thread budget
+const DEFAULT_MAX_THREADS: usize = 8;
+
+/// PIDs a worker claims at a time
+const CHUNK_SIZE: usize = 64;
+
+/// Fewer PIDs than this per worker and spawning costs more than it saves
+///
+/// Listing one process' descriptors takes tens of microseconds, about what
+/// starting a thread does, so a worker needs at least one full chunk.
+const MIN_PIDS_PER_THREAD: usize = CHUNK_SIZE;
+
+/// Configured thread budget; 0 means "use the default"
+static THREAD_BUDGET: AtomicUsize = AtomicUsize::new(0);
+
+/// Maximum number of threads a single /proc sweep may use
+pub fn thread_budget() -> usize {
+    match THREAD_BUDGET.load(Ordering::Relaxed) {
+        0 => std::thread::available_parallelism()
+            .map_or(1, |n| n.get())
+            .min(DEFAULT_MAX_THREADS),
+        n => n,
+    }
+}
+
+/// Set the thread budget for /proc sweeps (0 restores the default)
+pub fn set_thread_budget(threads: usize) {
+    THREAD_BUDGET.store(threads, Ordering::Relaxed);
+}
+
+/// List all PIDs in /proc
+pub fn list_pids() -> PlatformResult<Vec<u32>> {
+    let proc_dir = fs::read_dir("/proc").map_err(|e| {
+        PlatformError::CollectionFailed(format!("Failed to read /proc: {}", e))
+    })?;
+
+    Ok(proc_dir
+        .flatten()
+        .filter_map(|entry| {
+            let name = entry.file_name();
+            let name = name.to_str()?;
+            // Skip non-numeric directories
+            if !name.bytes().all(|b| b.is_ascii_digit()) {
+                return None;
+            }
+            name.parse().ok()
+        })
+        .collect())
+}
+
+#[cfg(unix)]
+thread_local! {
+    static FD_WALKER: RefCell<FdWalker> = RefCell::new(FdWalker::new());
+}
+
+/// Run `f` with this thread's /proc fd walker
+///
+/// Sweep workers keep one walker each, so buffers are reused across PIDs.
+#[cfg(unix)]
+pub fn with_fd_walker<R>(f: impl FnOnce(&mut FdWalker) -> R) -> R {
+    FD_WALKER.with(|walker| f(&mut walker.borrow_mut()))
+}
+
+/// Read whole files, None for each one that could not be read
+///
+/// Batched over io_uring when available, with std::fs as the fallback.
+/// Buffers start at `size_hint` bytes and grow for larger files.
+pub fn read_files<P: AsRef<Path>>(paths: &[P], size_hint: usize) -> Vec<Option<Vec<u8>>> {
+    if paths.is_empty() {
+        return Vec::new();
+    }
+    #[cfg(target_os = "linux")]
+    {
+        use std::os::unix::ffi::OsStrExt;
+
+        let cpaths: Option<Vec<std::ffi::CString>> = paths
+            .iter()
+            .map(|p| std::ffi::CString::new(p.as_ref().as_os_str().as_bytes()).ok())
+            .collect();
+        if let Some(contents) = cpaths.and_then(|cpaths| uring::read_files(cpaths, size_hint)) {
+            return contents;
+        }
+    }
+    paths.iter().map(|p| read_file(p.as_ref(), size_hint).ok()).collect()
+}
+
+/// Read a whole file into a buffer of `size_hint` bytes, grown as needed
+///
+/// Unlike `fs::read` this does not stat the file first, which tells
+/// nothing for /proc files anyway.
+fn read_file(path: &Path, size_hint: usize) -> std::io::Result<Vec<u8>> {
+    use std::io::Read;
+
+    let mut file = fs::File::open(path)?;
+    let mut content = vec![0; size_hint.max(1)];
+    let mut len = 0;
+    loop {
+        if len == content.len() {
+            content.resize(len * 2, 0);
+        }
+        match file.read(&mut content[len..]) {
+            Ok(0) => break,
+            Ok(n) => len += n,
+            Err(e) if e.kind() == std::io::ErrorKind::Interrupted => {}
+            Err(e) => return Err(e),
+        }
+    }
+    content.truncate(len);
+    Ok(content)
+}
+
+/// Use io_uring for [`read_files`] where available (the default)
+pub fn set_io_uring(enabled: bool) {
+    #[cfg(target_os = "linux")]
+    uring::set_enabled(enabled);
+    #[cfg(not(target_os = "linux"))]
+    let _ = enabled;
+}
+
+/// Run `f` for every PID on up to `threads` workers and concatenate the results
+///
+/// Results come back in PID-list order regardless of the thread count.
+pub fn par_flat_map<T, F>(pids: &[u32], threads: usize, f: F) -> Vec<T>
+where
+    T: Send,
+    F: Fn(u32) -> Vec<T> + Sync,
+{
+    let workers = workers_for(pids.len(), threads);
+    if workers == 1 {
+        return pids.iter().flat_map(|pid| f(*pid)).collect();
+    }
+
+    let chunks: Vec<&[u32]> = pids.chunks(CHUNK_SIZE).collect();
+    let next = AtomicUsize::new(0);
+    let done: Mutex<Vec<(usize, Vec<T>)>> = Mutex::new(Vec::with_capacity(chunks.len()));
+
+    let work = || {
+        let mut local = Vec::new();
+        loop {
+            let index = next.fetch_add(1, Ordering::Relaxed);
+            let Some(chunk) = chunks.get(index) else {
+                break;
+            };
+            local.push((index, chunk.iter().flat_map(|pid| f(*pid)).collect()));
+        }
+        done.lock().extend(local);
+    };
+    std::thread::scope(|scope| {
+        for _ in 1..workers {
+            scope.spawn(work);
+        }
+        work();
+    });
+
+    let mut done = done.into_inner();
+    done.sort_unstable_by_key(|(index, _)| *index);
+    done.into_iter().flat_map(|(_, items)| items).collect()
+}
+
+/// Workers a sweep over `pids` PIDs uses, given a budget of `threads`
+fn workers_for(pids: usize, threads: usize) -> usize {
+    threads.min(pids / MIN_PIDS_PER_THREAD).max(1)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_par_flat_map_matches_serial() {
+        let pids: Vec<u32> = (1..=5000).collect();
+        let f = |pid: u32| if pid % 3 == 0 { vec![pid, pid * 10] } else { Vec::new() };
+
+        let serial = par_flat_map(&pids, 1, f);
+        assert_eq!(serial.len(), 2 * (5000 / 3));
+        for threads in [2, 4, 7, 64] {
+            assert_eq!(par_flat_map(&pids, threads, f), serial, "threads = {}", threads);
+        }
+        assert!(par_flat_map(&[], 8, f).is_empty());
+    }
+
+    #[test]
+    fn test_workers_for_agent_sweeps() {
+        // An agent with a few dozen processes stays on the calling thread
+        assert_eq!(workers_for(40, 8), 1);
+        assert_eq!(workers_for(2 * MIN_PIDS_PER_THREAD, 8), 2);
+        assert_eq!(workers_for(100_000, 8), 8);
+        assert_eq!(workers_for(100_000, 0), 1);
+    }
+
+    #[test]
+    fn test_par_flat_map_propagates_panics() {
+        let pids: Vec<u32> = (1..=2000).collect();
+        let result = std::panic::catch_unwind(|| {
+            par_flat_map(&pids, 4, |pid| if pid == 1500 { panic!("boom") } else { vec![pid] })
+        });
+        assert!(result.is_err());
+        assert_eq!(par_flat_map(&pids, 4, |pid| vec![pid]), pids);
+    }
+
+    #[test]
+    fn test_thread_budget() {
+        assert!(thread_budget() >= 1);
+        set_thread_budget(3);
+        assert_eq!(thread_budget(), 3);
+        set_thread_budget(0);
+        assert!(thread_budget() <= DEFAULT_MAX_THREADS);
+    }
+
+    #[test]
+    fn test_read_file_grows() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("file");
+        std::fs::write(&path, vec![7u8; 1000]).unwrap();
+        assert_eq!(read_file(&path, 1).unwrap(), vec![7u8; 1000]);
+        assert_eq!(read_file(&path, 4096).unwrap().len(), 1000);
+        assert!(read_file(&dir.path().join("missing"), 16).is_err());
+    }
+
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_read_files() {
+        let dir = tempfile::tempdir().unwrap();
+        let large: Vec<u8> = (0..200_000u32).map(|i| (i % 251) as u8).collect();
+        std::fs::write(dir.path().join("large"), &large).unwrap();
+
+        let pid = std::process::id();
+        let mut paths = vec![
+            format!("/proc/{}/stat", pid).into(),
+            dir.path().join("missing"),
+            format!("/proc/{}/cmdline", pid).into(),
+            dir.path().join("large"),
+            "/proc/self/maps".into(),
+        ];
+        // More than one ring batch
+        paths.extend((0..100).map(|_| std::path::PathBuf::from("/proc/self/status")));
+
+        let contents = read_files(&paths, 64);
+        assert_eq!(contents.len(), paths.len());
+        assert!(contents[0].as_ref().unwrap().starts_with(format!("{} (", pid).as_bytes()));
+        assert!(contents[1].is_none());
+        assert_eq!(contents[2].as_deref(), Some(std::fs::read(&paths[2]).unwrap().as_slice()));
+        assert_eq!(contents[3].as_deref(), Some(large.as_slice()));
+        assert!(contents[4].as_ref().unwrap().len() > 64);
+        assert!(contents[5..].iter().all(|c| c.as_ref().unwrap().starts_with(b"Name:")));
+    }
+
+    #[cfg(target_os = "linux")]
+    #[test]
+    fn test_list_pids_and_walk() {
+        let pids = list_pids().unwrap();
+        assert!(pids.contains(&std::process::id()));
+
+        let mut count = 0;
+        with_fd_walker(|walker| walker.walk(std::process::id(), |_| count += 1)).unwrap();
+        assert!(count > 0);
+        assert!(with_fd_walker(|walker| walker.walk(u32::MAX, |_| {})).is_err());
+    }
+}
@@ -0,0 +1,435 @@
+//! Batched /proc file reads over io_uring
+//!
+//! Reading a small /proc file with std::fs costs an openat, a statx, two
+//! reads and a close. Here a batch of files is opened with one
+//! submission, read in rounds until every file hit end of file, and
+//! closed with one more, so a batch of up to `ENTRIES` files takes a
+//! handful of `io_uring_enter` calls. Reads continue at the offset the
+//! previous one stopped at, and a buffer that was filled is doubled for
+//! the next round, so large tables come back whole.
+//!
+//! The ring is set up with raw syscalls. Rings are pooled and reused:
+//! each sweep worker checks one out for the duration of a call, so there
+//! is at most one ring per concurrent worker. If io_uring is unavailable
+//! (old kernel, seccomp, `kernel.io_uring_disabled`), or a ring fails,
+//! the reader is disabled and callers fall back to std::fs.
+
+use std::ffi::CString;
+use std::io;
+use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+use std::ptr;
+use std::sync::atomic::{AtomicBool, AtomicU32, Ordering};
+
+use parking_lot::Mutex;
+
+/// Submission queue entries per ring, and so files per batch
+const ENTRIES: u32 = 64;
+
+const IORING_OFF_SQ_RING: libc::off_t = 0;
+const IORING_OFF_CQ_RING: libc::off_t = 0x800_0000;
+const IORING_OFF_SQES: libc::off_t = 0x1000_0000;
+const IORING_ENTER_GETEVENTS: u32 = 1;
+const IORING_OP_OPENAT: u8 = 18;
+const IORING_OP_CLOSE: u8 = 19;
+const IORING_OP_READ: u8 = 22;
+
+/// Set once io_uring turned out to be unavailable, or was switched off
+static DISABLED: AtomicBool = AtomicBool::new(false);
+
+/// Idle rings, one per worker that used one
+static RINGS: Mutex<Vec<Ring>> = parking_lot::const_mutex(Vec::new());
+
+/// Enable or disable the reader (it starts enabled)
+pub(super) fn set_enabled(enabled: bool) {
+    DISABLED.store(!enabled, Ordering::Relaxed);
+    if !enabled {
+        RINGS.lock().clear();
+    }
+}
+
+/// Read every file in `paths`, None per file that could not be read
+///
+/// Buffers start at `size_hint` bytes. Returns None if io_uring is not
+/// usable, in which case nothing was read.
+pub(super) fn read_files(paths: Vec<CString>, size_hint: usize) -> Option<Vec<Option<Vec<u8>>>> {
+    if DISABLED.load(Ordering::Relaxed) {
+        return None;
+    }
+    let pooled = RINGS.lock().pop();
+    let mut ring = match pooled.map_or_else(Ring::new, Ok) {
+        Ok(ring) => ring,
+        Err(e) => {
+            tracing::debug!("io_uring unavailable, reading /proc with std::fs: {}", e);
+            DISABLED.store(true, Ordering::Relaxed);
+            return None;
+        }
+    };
+
+    let mut contents = Vec::with_capacity(paths.len());
+    for start in (0..paths.len()).step_by(ENTRIES as usize) {
+        let batch = &paths[start..paths.len().min(start + ENTRIES as usize)];
+        if let Err(e) = ring.read_batch(batch, size_hint.max(1), &mut contents) {
+            tracing::warn!("io_uring read failed, reading /proc with std::fs: {}", e);
+            DISABLED.store(true, Ordering::Relaxed);
+            // The kernel may still read the paths of the failed batch
+            std::mem::forget(paths);
+            return None;
+        }
+    }
+
+    if !DISABLED.load(Ordering::Relaxed) {
+        RINGS.lock().push(ring);
+    }
+    Some(contents)
+}
+
+/// `struct io_sqring_offsets`
+#[repr(C)]
+#[derive(Default)]
+struct SqOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    flags: u32,
+    dropped: u32,
+    array: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+/// `struct io_cqring_offsets`
+#[repr(C)]
+#[derive(Default)]
+struct CqOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    overflow: u32,
+    cqes: u32,
+    flags: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+/// `struct io_uring_params`
+#[repr(C)]
+#[derive(Default)]
+struct Params {
+    sq_entries: u32,
+    cq_entries: u32,
+    flags: u32,
+    sq_thread_cpu: u32,
+    sq_thread_idle: u32,
+    features: u32,
+    wq_fd: u32,
+    resv: [u32; 3],
+    sq_off: SqOffsets,
+    cq_off: CqOffsets,
+}
+
+/// `struct io_uring_sqe`, with the fields the reader uses
+#[repr(C)]
+#[derive(Default, Clone, Copy)]
+struct Sqe {
+    opcode: u8,
+    flags: u8,
+    ioprio: u16,
+    fd: i32,
+    off: u64,
+    addr: u64,
+    len: u32,
+    op_flags: u32,
+    user_data: u64,
+    buf_index: u16,
+    personality: u16,
+    file_index: u32,
+    addr3: u64,
+    pad: u64,
+}
+
+/// `struct io_uring_cqe`
+#[repr(C)]
+struct Cqe {
+    user_data: u64,
+    res: i32,
+    flags: u32,
+}
+
+/// A shared memory mapping of the ring
+struct Mapping {
+    ptr: *mut u8,
+    len: usize,
+}
+
+impl Mapping {
+    fn new(fd: &OwnedFd, len: usize, offset: libc::off_t) -> io::Result<Self> {
+        // SAFETY: a fresh shared mapping of the ring fd; unmapped on drop
+        let ptr = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                fd.as_raw_fd(),
+                offset,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(Self { ptr: ptr.cast(), len })
+    }
+
+    /// The u32 at byte `offset`, shared with the kernel
+    fn atomic(&self, offset: u32) -> &AtomicU32 {
+        // SAFETY: offsets come from the kernel and are aligned in the mapping
+        unsafe { &*self.ptr.add(offset as usize).cast::<AtomicU32>() }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        // SAFETY: ptr and len describe a mapping owned by self
+        unsafe { libc::munmap(self.ptr.cast(), self.len) };
+    }
+}
+
+struct Ring {
+    // Unmapped before the ring fd is closed
+    sq: Mapping,
+    cq: Mapping,
+    sqes: Mapping,
+    params: Params,
+    fd: OwnedFd,
+}
+
+// SAFETY: the mappings are only touched through &mut Ring
+unsafe impl Send for Ring {}
+
+impl Ring {
+    fn new() -> io::Result<Self> {
+        let mut params = Params::default();
+        // SAFETY: params is a valid io_uring_params for the kernel to fill
+        let fd = unsafe { libc::syscall(libc::SYS_io_uring_setup, ENTRIES, &mut params as *mut Params) };
+        if fd < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        // SAFETY: fd was just returned by io_uring_setup
+        let fd = unsafe { OwnedFd::from_raw_fd(fd as libc::c_int) };
+
+        let sq_len = params.sq_off.array as usize + params.sq_entries as usize * 4;
+        let cq_len = params.cq_off.cqes as usize + params.cq_entries as usize * std::mem::size_of::<Cqe>();
+        let sqes_len = params.sq_entries as usize * std::mem::size_of::<Sqe>();
+        Ok(Self {
+            sq: Mapping::new(&fd, sq_len, IORING_OFF_SQ_RING)?,
+            cq: Mapping::new(&fd, cq_len, IORING_OFF_CQ_RING)?,
+            sqes: Mapping::new(&fd, sqes_len, IORING_OFF_SQES)?,
+            params,
+            fd,
+        })
+    }
+
+    /// Open, read and close up to `ENTRIES` files, appending their contents
+    ///
+    /// On error, operations may still be in flight, so their buffers and
+    /// descriptors are leaked rather than freed or closed.
+    fn read_batch(
+        &mut self,
+        paths: &[CString],
+        size_hint: usize,
+        contents: &mut Vec<Option<Vec<u8>>>,
+    ) -> io::Result<()> {
+        let mut results = vec![0i32; paths.len()];
+
+        for (i, path) in paths.iter().enumerate() {
+            self.push(Sqe {
+                opcode: IORING_OP_OPENAT,
+                fd: libc::AT_FDCWD,
+                addr: path.as_ptr() as u64,
+                op_flags: (libc::O_RDONLY | libc::O_CLOEXEC) as u32,
+                user_data: i as u64,
+                ..Sqe::default()
+            });
+        }
+        self.run(paths.len() as u32, &mut results)?;
+        let fds: Vec<Option<OwnedFd>> = results
+            .iter()
+            // SAFETY: a non-negative openat result is a new descriptor
+            .map(|&fd| (fd >= 0).then(|| unsafe { OwnedFd::from_raw_fd(fd) }))
+            .collect();
+
+        // Read in rounds until every open file returned 0 or failed
+        let mut buffers: Vec<Option<Vec<u8>>> = fds
+            .iter()
+            .map(|fd| fd.as_ref().map(|_| Vec::with_capacity(size_hint)))
+            .collect();
+        let mut reading: Vec<usize> = (0..paths.len()).filter(|i| fds[*i].is_some()).collect();
+        while !reading.is_empty() {
+            for &i in &reading {
+                let (Some(fd), Some(buffer)) = (&fds[i], &mut buffers[i]) else {
+                    continue;
+                };
+                if buffer.len() == buffer.capacity() {
+                    buffer.reserve(buffer.capacity());
+                }
+                let offset = buffer.len() as u64;
+                let spare = buffer.spare_capacity_mut();
+                self.push(Sqe {
+                    opcode: IORING_OP_READ,
+                    fd: fd.as_raw_fd(),
+                    off: offset,
+                    addr: spare.as_mut_ptr() as u64,
+                    len: spare.len().min(u32::MAX as usize) as u32,
+                    user_data: i as u64,
+                    ..Sqe::default()
+                });
+            }
+            if let Err(e) = self.run(reading.len() as u32, &mut results) {
+                std::mem::forget(buffers);
+                std::mem::forget(fds);
+                return Err(e);
+            }
+
+            reading.retain(|&i| {
+                let Some(buffer) = &mut buffers[i] else {
+                    return false;
+                };
+                match results[i] {
+                    0 => false,
+                    n if n > 0 => {
+                        // SAFETY: the kernel initialized n bytes past len
+                        unsafe { buffer.set_len(buffer.len() + n as usize) };
+                        true
+                    }
+                    _ => {
+                        buffers[i] = None;
+                        false
+                    }
+                }
+            });
+        }
+
+        let open: Vec<OwnedFd> = fds.into_iter().flatten().collect();
+        for (i, fd) in open.iter().enumerate() {
+            self.push(Sqe {
+                opcode: IORING_OP_CLOSE,
+                fd: fd.as_raw_fd(),
+                user_data: i as u64,
+                ..Sqe::default()
+            });
+        }
+        // Closed by the ring, or left open if it failed
+        let closed = self.run(open.len() as u32, &mut results);
+        open.into_iter().for_each(std::mem::forget);
+        closed?;
+
+        contents.extend(buffers);
+        Ok(())
+    }
+
+    /// Queue one entry; callers never queue more than `ENTRIES`
+    fn push(&mut self, sqe: Sqe) {
+        let mask = self.sq.atomic(self.params.sq_off.ring_mask).load(Ordering::Relaxed);
+        let tail = self.sq.atomic(self.params.sq_off.tail).load(Ordering::Relaxed);
+        let index = tail & mask;
+        // SAFETY: index is within the sqes and array mappings
+        unsafe {
+            self.sqes.ptr.cast::<Sqe>().add(index as usize).write(sqe);
+            self.sq
+                .ptr
+                .add(self.params.sq_off.array as usize)
+                .cast::<u32>()
+                .add(index as usize)
+                .write(index);
+        }
+        self.sq
+            .atomic(self.params.sq_off.tail)
+            .store(tail.wrapping_add(1), Ordering::Release);
+    }
+
+    /// Submit `queued` entries and wait for all of them, storing each
+    /// result at its user_data index
+    fn run(&mut self, queued: u32, results: &mut [i32]) -> io::Result<()> {
+        let mut to_submit = queued;
+        let mut pending = queued;
+        while pending > 0 {
+            // SAFETY: plain syscall on our ring fd, no signal mask
+            let n = unsafe {
+                libc::syscall(
+                    libc::SYS_io_uring_enter,
+                    self.fd.as_raw_fd(),
+                    to_submit,
+                    pending,
+                    IORING_ENTER_GETEVENTS,
+                    ptr::null::<libc::sigset_t>(),
+                    0usize,
+                )
+            };
+            if n < 0 {
+                let e = io::Error::last_os_error();
+                if e.kind() != io::ErrorKind::Interrupted {
+                    return Err(e);
+                }
+            } else {
+                to_submit -= n as u32;
+            }
+
+            let mask = self.cq.atomic(self.params.cq_off.ring_mask).load(Ordering::Relaxed);
+            let mut head = self.cq.atomic(self.params.cq_off.head).load(Ordering::Relaxed);
+            let tail = self.cq.atomic(self.params.cq_off.tail).load(Ordering::Acquire);
+            while head != tail {
+                // SAFETY: entries between head and tail were written by the kernel
+                let cqe = unsafe {
+                    &*self
+                        .cq
+                        .ptr
+                        .add(self.params.cq_off.cqes as usize)
+                        .cast::<Cqe>()
+                        .add((head & mask) as usize)
+                };
+                if let Some(result) = results.get_mut(cqe.user_data as usize) {
+                    *result = cqe.res;
+                }
+                head = head.wrapping_add(1);
+                pending -= 1;
+            }
+            self.cq.atomic(self.params.cq_off.head).store(head, Ordering::Release);
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_layouts() {
+        assert_eq!(std::mem::size_of::<Params>(), 120);
+        assert_eq!(std::mem::size_of::<Sqe>(), 64);
+        assert_eq!(std::mem::size_of::<Cqe>(), 16);
+    }
+
+    #[test]
+    fn test_matches_std_fs() {
+        let paths: Vec<CString> = ["/proc/self/stat", "/proc/self/maps", "/proc/self/fdinfo/0", "/nonexistent"]
+            .iter()
+            .map(|p| CString::new(*p).unwrap())
+            .collect();
+        let Some(contents) = read_files(paths.clone(), 16) else {
+            return; // io_uring unavailable here
+        };
+        assert_eq!(contents.len(), 4);
+        assert!(contents[0].as_ref().unwrap().ends_with(b"\n"));
+        let maps = std::fs::read("/proc/self/maps").unwrap();
+        // Mappings may change between the two reads, the first line does not
+        assert_eq!(
+            contents[1].as_ref().unwrap().split(|b| *b == b'\n').next(),
+            maps.split(|b| *b == b'\n').next()
+        );
+        assert!(contents[2].as_deref().and_then(super::super::parse_fdinfo_flags).is_some());
+        assert!(contents[3].is_none());
+    }
+}
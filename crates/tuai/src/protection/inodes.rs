@@ -0,0 +1,227 @@
+//! Protected files by device and inode
+//!
+//! Path matching misses a protected file opened through a symlink, a hard
+//! link, a bind mount or a relative path. Resolving the protected files to
+//! (device, inode) when the config is compiled catches all of those with
+//! one hash lookup per event, whatever the path looked like.
+//!
+//! Files under protected directories are resolved too, up to a limit, so
+//! large trees do not stall a reload. A file created, removed or replaced
+//! by a rename after resolving leaves the set stale. To notice that
+//! without walking the trees again, the identity of every protected file
+//! and the identity and modification time of every directory walked are
+//! recorded; `is_stale` re-stats just those.
+
+use std::collections::HashMap;
+use std::path::{Path, PathBuf};
+use std::time::SystemTime;
+
+use tuai_common::FileId;
+
+/// Most files resolved under protected directories, in total
+const MAX_DIRECTORY_FILES: usize = 16_384;
+
+/// How deep protected directories are descended into
+const MAX_DEPTH: usize = 8;
+
+/// Identity of a path, and its modification time if it is a directory
+///
+/// A rename into, out of or within a directory updates its modification
+/// time; writes to a file do not change its identity.
+type Stamp = Option<(FileId, Option<SystemTime>)>;
+
+/// Protected files keyed by identity, with the path each was resolved from
+#[derive(Debug, Clone, Default)]
+pub(super) struct ProtectedInodes {
+    files: HashMap<FileId, PathBuf>,
+    /// Files resolved so far under directories
+    directory_files: usize,
+    /// Protected files and walked directories, as they were when resolved
+    stamps: Vec<(PathBuf, bool, Stamp)>,
+}
+
+impl ProtectedInodes {
+    pub(super) fn new() -> Self {
+        Self::default()
+    }
+
+    /// Resolve a protected file; missing files are skipped
+    pub(super) fn add_file(&mut self, path: &Path) {
+        self.stamp(path, false);
+        self.insert(path);
+    }
+
+    /// Resolve a protected directory and the files below it
+    pub(super) fn add_directory(&mut self, path: &Path) {
+        self.stamp(path, true);
+        self.insert(path);
+        self.add_tree(path, 0);
+    }
+
+    /// Whether a protected file or walked directory changed since resolving
+    pub(super) fn is_stale(&self) -> bool {
+        self.stamps
+            .iter()
+            .any(|(path, directory, seen)| stamp(path, *directory) != *seen)
+    }
+
+    fn insert(&mut self, path: &Path) {
+        if let Some(id) = file_id(path) {
+            self.files.entry(id).or_insert_with(|| path.to_path_buf());
+        }
+    }
+
+    fn stamp(&mut self, path: &Path, directory: bool) {
+        self.stamps.push((path.to_path_buf(), directory, stamp(path, directory)));
+    }
+
+    fn add_tree(&mut self, dir: &Path, depth: usize) {
+        if depth >= MAX_DEPTH {
+            return;
+        }
+        let Ok(entries) = std::fs::read_dir(dir) else {
+            return;
+        };
+        for entry in entries.flatten() {
+            if self.directory_files >= MAX_DIRECTORY_FILES {
+                tracing::debug!("Stopped resolving protected directories at {} files", MAX_DIRECTORY_FILES);
+                return;
+            }
+            let path = entry.path();
+            // Symlinks inside a protected directory are not followed out of it
+            let Ok(kind) = entry.file_type() else {
+                continue;
+            };
+            if kind.is_dir() {
+                self.stamp(&path, true);
+                self.insert(&path);
+                self.add_tree(&path, depth + 1);
+            } else if kind.is_file() {
+                self.insert(&path);
+                self.directory_files += 1;
+            }
+        }
+    }
+
+    pub(super) fn contains(&self, id: &FileId) -> bool {
+        self.files.contains_key(id)
+    }
+
+    /// Path a protected file was resolved from
+    pub(super) fn path(&self, id: &FileId) -> Option<&Path> {
+        self.files.get(id).map(PathBuf::as_path)
+    }
+
+    pub(super) fn ids(&self) -> impl Iterator<Item = &FileId> {
+        self.files.keys()
+    }
+
+    pub(super) fn len(&self) -> usize {
+        self.files.len()
+    }
+}
+
+/// Device and inode of `path`, following symlinks
+#[cfg(unix)]
+pub(super) fn file_id(path: &Path) -> Option<FileId> {
+    use std::os::unix::fs::MetadataExt;
+
+    let meta = std::fs::metadata(path).ok()?;
+    Some(FileId {
+        dev: meta.dev(),
+        ino: meta.ino(),
+    })
+}
+
+#[cfg(not(unix))]
+pub(super) fn file_id(_path: &Path) -> Option<FileId> {
+    None
+}
+
+fn stamp(path: &Path, directory: bool) -> Stamp {
+    let id = file_id(path)?;
+    let modified = if directory {
+        std::fs::metadata(path).and_then(|meta| meta.modified()).ok()
+    } else {
+        None
+    };
+    Some((id, modified))
+}
+
+#[cfg(all(test, unix))]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_links_resolve_to_the_same_file() {
+        let dir = tempfile::tempdir().unwrap();
+        let secret = dir.path().join("secret");
+        std::fs::write(&secret, "x").unwrap();
+        let symlink = dir.path().join("link");
+        std::os::unix::fs::symlink(&secret, &symlink).unwrap();
+        let hardlink = dir.path().join("hard");
+        std::fs::hard_link(&secret, &hardlink).unwrap();
+
+        let mut inodes = ProtectedInodes::new();
+        inodes.add_file(&secret);
+        inodes.add_file(&dir.path().join("missing"));
+        assert_eq!(inodes.len(), 1);
+
+        for path in [&symlink, &hardlink] {
+            let id = file_id(path).unwrap();
+            assert!(inodes.contains(&id));
+            assert_eq!(inodes.path(&id), Some(secret.as_path()));
+        }
+        let other = dir.path().join("other");
+        std::fs::write(&other, "y").unwrap();
+        assert!(!inodes.contains(&file_id(&other).unwrap()));
+    }
+
+    #[test]
+    fn test_directories_resolve_their_files() {
+        let dir = tempfile::tempdir().unwrap();
+        std::fs::create_dir_all(dir.path().join("keys/nested")).unwrap();
+        std::fs::write(dir.path().join("keys/id_rsa"), "x").unwrap();
+        std::fs::write(dir.path().join("keys/nested/token"), "y").unwrap();
+
+        let mut inodes = ProtectedInodes::new();
+        inodes.add_directory(&dir.path().join("keys"));
+        assert!(inodes.contains(&file_id(&dir.path().join("keys/id_rsa")).unwrap()));
+        assert!(inodes.contains(&file_id(&dir.path().join("keys/nested/token")).unwrap()));
+        assert!(!inodes.contains(&file_id(dir.path()).unwrap()));
+    }
+
+    #[test]
+    fn test_replaced_files_make_the_set_stale() {
+        let dir = tempfile::tempdir().unwrap();
+        let secret = dir.path().join("secret");
+        std::fs::write(&secret, "x").unwrap();
+        std::fs::create_dir(dir.path().join("keys")).unwrap();
+
+        let mut inodes = ProtectedInodes::new();
+        inodes.add_file(&secret);
+        inodes.add_file(&dir.path().join("missing"));
+        inodes.add_directory(&dir.path().join("keys"));
+        assert!(!inodes.is_stale());
+
+        // Writing in place keeps the inode
+        std::fs::write(&secret, "changed").unwrap();
+        assert!(!inodes.is_stale());
+
+        // Replaced by a rename, as editors save
+        let tmp = dir.path().join("secret.tmp");
+        std::fs::write(&tmp, "new").unwrap();
+        std::fs::rename(&tmp, &secret).unwrap();
+        assert!(inodes.is_stale());
+
+        let mut inodes = ProtectedInodes::new();
+        inodes.add_file(&dir.path().join("missing"));
+        std::fs::write(dir.path().join("missing"), "now here").unwrap();
+        assert!(inodes.is_stale());
+
+        let mut inodes = ProtectedInodes::new();
+        inodes.add_directory(&dir.path().join("keys"));
+        std::fs::write(dir.path().join("keys/id_ed25519"), "y").unwrap();
+        assert!(inodes.is_stale());
+    }
+}
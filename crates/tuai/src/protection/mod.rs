@@ -2,11 +2,32 @@
 //!
 //! This module provides configuration and monitoring for protected files and directories.
 //! When AI agents access protected paths, alerts are generated and notifications are sent.
+//!
+//! The configured paths are compiled once by `rebuild_cache`, so checking a
+//! file event is one walk over a path trie and one pass of a combined glob
+//! matcher, however many entries are configured. Protected files and the
+//! files under protected directories are also resolved to device and
+//! inode, so an event that carries them is matched with one hash lookup
+//! even when it reached the file through a link or another path. That
+//! walk is left to `resolve_inodes`, so building a config stays cheap.
+//!
+//! [`ProtectionStore`] owns the config in use: it resolves the inodes of
+//! every config it swaps in, mirrors them into the kernel when eBPF is
+//! active, and keeps a config loaded from a file up to date with that
+//! file.
+
+mod inodes;
+mod paths;
+mod store;
 
-use std::collections::HashSet;
 use std::path::{Path, PathBuf};
 
 use serde::{Deserialize, Serialize};
+use tuai_common::{FileId, FileOpInfo};
+
+use inodes::ProtectedInodes;
+use paths::ProtectedPaths;
+pub use store::ProtectionStore;
 
 /// Default protected files that should trigger alerts
 pub const DEFAULT_PROTECTED_FILES: &[&str] = &[
@@ -67,13 +88,13 @@ pub struct ProtectionConfig {
     #[serde(default)]
     pub log_file: Option<PathBuf>,
 
-    /// Cached set of protected paths for quick lookup
+    /// Compiled files, directories and patterns for quick lookup
     #[serde(skip)]
-    protected_set: HashSet<PathBuf>,
+    compiled: ProtectedPaths,
 
-    /// Cached set of protected directories for prefix matching
+    /// Protected files by device and inode, once resolved
     #[serde(skip)]
-    protected_dirs_set: HashSet<PathBuf>,
+    inodes: Option<ProtectedInodes>,
 }
 
 fn default_true() -> bool {
@@ -94,8 +115,8 @@ impl Default for ProtectionConfig {
             alert_severity: "critical".to_string(),
             prevention_mode: false,
             log_file: None,
-            protected_set: HashSet::new(),
-            protected_dirs_set: HashSet::new(),
+            compiled: ProtectedPaths::new(),
+            inodes: None,
         };
         config.rebuild_cache();
         config
@@ -124,79 +145,139 @@ impl ProtectionConfig {
     }
 
     /// Rebuild the internal cache for quick lookups
+    ///
+    /// Compiles files and directories into a path trie and all patterns
+    /// into one glob matcher. Invalid patterns are skipped. Inodes
+    /// resolved earlier are dropped; see `resolve_inodes`.
     pub fn rebuild_cache(&mut self) {
-        self.protected_set.clear();
-        self.protected_dirs_set.clear();
-
-        // Add user-specified files
-        for file in &self.files {
-            self.protected_set.insert(file.clone());
+        let mut compiled = ProtectedPaths::new();
+        for file in self.all_files() {
+            compiled.add_file(file);
         }
+        for dir in self.all_directories() {
+            compiled.add_directory(dir);
+        }
+        compiled.set_patterns(self.patterns.iter().map(String::as_str));
+        self.compiled = compiled;
+        self.inodes = None;
+    }
 
-        // Add user-specified directories
-        for dir in &self.directories {
-            self.protected_dirs_set.insert(dir.clone());
+    /// Resolve protected files, and the files under protected
+    /// directories, to device and inode
+    ///
+    /// Walks the protected directories, so it is left to the owner of
+    /// the config. Does nothing when already resolved and still current
+    /// (see `inodes_stale`); files added later are resolved as they are
+    /// added.
+    pub fn resolve_inodes(&mut self) {
+        if self.inodes.is_some() && !self.inodes_stale() {
+            return;
+        }
+        let mut inodes = ProtectedInodes::new();
+        for file in self.all_files() {
+            inodes.add_file(file);
         }
+        for dir in self.all_directories() {
+            inodes.add_directory(dir);
+        }
+        self.inodes = Some(inodes);
+    }
 
-        // Add defaults if enabled
+    /// Whether protected files were created, removed or replaced since
+    /// the inodes were resolved
+    ///
+    /// Re-stats the protected files and the directories walked, not the
+    /// files below them.
+    pub fn inodes_stale(&self) -> bool {
+        self.inodes.as_ref().is_some_and(ProtectedInodes::is_stale)
+    }
+
+    fn defaults(&self) -> (&'static [&'static str], &'static [&'static str]) {
         if self.include_defaults {
-            for file in DEFAULT_PROTECTED_FILES {
-                self.protected_set.insert(PathBuf::from(file));
-            }
-            for dir in DEFAULT_PROTECTED_DIRS {
-                self.protected_dirs_set.insert(PathBuf::from(dir));
-            }
+            (DEFAULT_PROTECTED_FILES, DEFAULT_PROTECTED_DIRS)
+        } else {
+            (&[], &[])
         }
     }
 
+    /// Configured files, then the default ones
+    fn all_files(&self) -> impl Iterator<Item = &Path> {
+        self.files
+            .iter()
+            .map(PathBuf::as_path)
+            .chain(self.defaults().0.iter().map(Path::new))
+    }
+
+    /// Configured directories, then the default ones
+    fn all_directories(&self) -> impl Iterator<Item = &Path> {
+        self.directories
+            .iter()
+            .map(PathBuf::as_path)
+            .chain(self.defaults().1.iter().map(Path::new))
+    }
+
     /// Check if a path is protected
     pub fn is_protected(&self, path: &str) -> bool {
-        let path = Path::new(path);
-
-        // Exact file match
-        if self.protected_set.contains(path) {
-            return true;
-        }
+        self.compiled.contains(Path::new(path))
+    }
 
-        // Directory prefix match
-        for dir in &self.protected_dirs_set {
-            if path.starts_with(dir) {
-                return true;
-            }
-        }
+    /// Check if the file with this device and inode is protected
+    ///
+    /// Always false until the inodes are resolved.
+    pub fn is_protected_inode(&self, id: &FileId) -> bool {
+        self.inodes.as_ref().is_some_and(|inodes| inodes.contains(id))
+    }
 
-        // Pattern matching
-        for pattern in &self.patterns {
-            if let Ok(glob) = glob::Pattern::new(pattern) {
-                if glob.matches_path(path) {
-                    return true;
-                }
-            }
-        }
+    /// Check if a file event touches a protected file
+    ///
+    /// Matches by inode when the event carries one, then by path.
+    pub fn is_protected_file(&self, file_op: &FileOpInfo) -> bool {
+        file_op.file_id.is_some_and(|id| self.is_protected_inode(&id)) || self.is_protected(&file_op.path)
+    }
 
-        false
+    /// Resolved protected files with the path each was resolved from
+    pub fn protected_inodes(&self) -> impl Iterator<Item = (FileId, &Path)> {
+        self.inodes
+            .iter()
+            .flat_map(|inodes| inodes.ids().filter_map(|id| Some((*id, inodes.path(id)?))))
     }
 
     /// Add a file to the protection list
+    ///
+    /// The file is resolved too if the inodes already are. To change the
+    /// config in use, go through [`ProtectionStore::add_file`].
     pub fn add_file(&mut self, path: PathBuf) {
-        self.files.push(path.clone());
-        self.protected_set.insert(path);
+        self.compiled.add_file(&path);
+        if let Some(inodes) = &mut self.inodes {
+            inodes.add_file(&path);
+        }
+        self.files.push(path);
     }
 
     /// Add a directory to the protection list
+    ///
+    /// Like `add_file`, the files below it are resolved if the inodes
+    /// already are.
     pub fn add_directory(&mut self, path: PathBuf) {
-        self.directories.push(path.clone());
-        self.protected_dirs_set.insert(path);
+        self.compiled.add_directory(&path);
+        if let Some(inodes) = &mut self.inodes {
+            inodes.add_directory(&path);
+        }
+        self.directories.push(path);
     }
 
     /// Add a pattern to the protection list
+    ///
+    /// Recompiles the pattern matcher; to add many, extend `patterns` and
+    /// call `rebuild_cache` once.
     pub fn add_pattern(&mut self, pattern: String) {
         self.patterns.push(pattern);
+        self.compiled.set_patterns(self.patterns.iter().map(String::as_str));
     }
 
     /// Get count of protected items
     pub fn protected_count(&self) -> usize {
-        self.protected_set.len() + self.protected_dirs_set.len() + self.patterns.len()
+        self.compiled.len() + self.patterns.len()
     }
 
     /// Generate example TOML config
@@ -436,6 +517,45 @@ mod tests {
         assert!(config.is_protected("/home/user/project/.env"));
         assert!(config.is_protected("/secrets/private.key"));
         assert!(!config.is_protected("/app/.envrc"));
+
+        // Patterns added later are compiled in too
+        config.add_pattern("**/*.pem".to_string());
+        assert!(config.is_protected("/etc/tls/server.pem"));
+        assert!(config.is_protected("/app/.env"));
+        assert_eq!(config.protected_count(), 3);
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_inode_protection() {
+        let dir = tempfile::tempdir().unwrap();
+        let secret = dir.path().join("secret.txt");
+        std::fs::write(&secret, "x").unwrap();
+        let link = dir.path().join("innocent.txt");
+        std::os::unix::fs::symlink(&secret, &link).unwrap();
+
+        let mut config = ProtectionConfig {
+            include_defaults: false,
+            files: vec![secret.clone()],
+            ..Default::default()
+        };
+        config.rebuild_cache();
+        assert_eq!(config.protected_inodes().count(), 0);
+        config.resolve_inodes();
+        assert_eq!(config.protected_inodes().count(), 1);
+
+        // Opened through the symlink: the path does not match, the inode does
+        let mut file_op = FileOpInfo::new(1, tuai_common::FileOperation::Read, link.display().to_string());
+        assert!(!config.is_protected_file(&file_op));
+        file_op.file_id = inodes::file_id(&link);
+        assert!(config.is_protected_file(&file_op));
+
+        // Files added after resolving are resolved right away
+        let other = dir.path().join("other.txt");
+        std::fs::write(&other, "y").unwrap();
+        config.add_file(other.clone());
+        assert_eq!(config.protected_inodes().count(), 2);
+        assert!(config.is_protected_inode(&inodes::file_id(&other).unwrap()));
     }
 
     #[test]
@@ -0,0 +1,264 @@
+//! Compiled lookup for protected paths
+//!
+//! Protected files and directories share one trie keyed by path
+//! component, so a lookup is a single walk over the components of the
+//! path: it stops at the first protected directory, or at the end of the
+//! path on a protected file. Component comparison gives the same results
+//! as `Path::starts_with` and `PathBuf` equality (`/etc//ssh/` is
+//! `/etc/ssh`).
+//!
+//! Glob patterns are compiled together into one `GlobSet`, which checks a
+//! path against all of them in one pass instead of one match per pattern.
+//! Patterns on file names (`**/.env`, `**/*.pem`) are matched through hash
+//! lookups inside the set. Patterns with a literal directory component
+//! (`/home/*/.aws/**`) need a regex, and a set of thousands of those is
+//! slow, so they are grouped by that component instead and only tried on
+//! paths that contain it; the lookup happens during the trie walk.
+
+use std::collections::HashMap;
+use std::ffi::OsStr;
+use std::path::Path;
+
+use globset::{Glob, GlobSet, GlobSetBuilder};
+
+/// Protected files, directories and patterns, compiled for lookup
+#[derive(Debug, Clone)]
+pub(super) struct ProtectedPaths {
+    nodes: Vec<Node>,
+    files: usize,
+    directories: usize,
+    /// Patterns without a literal directory component
+    globs: GlobSet,
+    /// Other patterns, keyed by their last literal component
+    anchored: HashMap<Box<OsStr>, GlobSet>,
+}
+
+#[derive(Debug, Clone, Default)]
+struct Node {
+    /// Component -> node index, sorted by component
+    children: Vec<(Box<OsStr>, usize)>,
+    /// The path up to here is a protected file
+    file: bool,
+    /// Everything at or below the path up to here is protected
+    directory: bool,
+}
+
+impl ProtectedPaths {
+    pub(super) fn new() -> Self {
+        Self {
+            nodes: vec![Node::default()],
+            files: 0,
+            directories: 0,
+            globs: GlobSet::empty(),
+            anchored: HashMap::new(),
+        }
+    }
+
+    /// Protect one file
+    pub(super) fn add_file(&mut self, path: &Path) {
+        let node = self.node(path);
+        if !std::mem::replace(&mut self.nodes[node].file, true) {
+            self.files += 1;
+        }
+    }
+
+    /// Protect a directory and everything below it
+    pub(super) fn add_directory(&mut self, path: &Path) {
+        let node = self.node(path);
+        if !std::mem::replace(&mut self.nodes[node].directory, true) {
+            self.directories += 1;
+        }
+    }
+
+    /// Compile `patterns` into one matcher, replacing the previous ones
+    ///
+    /// Invalid patterns are skipped with a warning.
+    pub(super) fn set_patterns<'a>(&mut self, patterns: impl IntoIterator<Item = &'a str>) {
+        let mut floating = GlobSetBuilder::new();
+        let mut anchored: HashMap<String, GlobSetBuilder> = HashMap::new();
+        for pattern in patterns {
+            let glob = match Glob::new(pattern) {
+                Ok(glob) => glob,
+                Err(e) => {
+                    tracing::warn!("Ignoring protection pattern {:?}: {}", pattern, e);
+                    continue;
+                }
+            };
+            match anchor(pattern) {
+                Some(component) => anchored.entry(component).or_insert_with(GlobSetBuilder::new).add(glob),
+                None => floating.add(glob),
+            };
+        }
+
+        self.globs = build(floating);
+        self.anchored = anchored
+            .into_iter()
+            .map(|(component, builder)| (OsStr::new(&component).into(), build(builder)))
+            .collect();
+    }
+
+    /// Distinct protected files and directories
+    pub(super) fn len(&self) -> usize {
+        self.files + self.directories
+    }
+
+    /// Whether `path` is protected
+    pub(super) fn contains(&self, path: &Path) -> bool {
+        self.walk(path) || (!self.globs.is_empty() && self.globs.is_match(path))
+    }
+
+    /// Walk the trie, trying anchored patterns on the way
+    fn walk(&self, path: &Path) -> bool {
+        let mut node = Some(&self.nodes[0]);
+        for component in path.components() {
+            let component = component.as_os_str();
+            if let Some(globs) = self.anchored.get(component) {
+                if globs.is_match(path) {
+                    return true;
+                }
+            }
+
+            let Some(current) = node else {
+                if self.anchored.is_empty() {
+                    return false;
+                }
+                continue;
+            };
+            node = match current.children.binary_search_by(|(c, _)| (**c).cmp(component)) {
+                Ok(i) => Some(&self.nodes[current.children[i].1]),
+                Err(_) => None,
+            };
+            if node.is_some_and(|n| n.directory) {
+                return true;
+            }
+        }
+        node.is_some_and(|n| n.file)
+    }
+
+    /// Node for `path`, created if missing
+    fn node(&mut self, path: &Path) -> usize {
+        let mut node = 0;
+        for component in path.components() {
+            let component = component.as_os_str();
+            node = match self.nodes[node].children.binary_search_by(|(c, _)| (**c).cmp(component)) {
+                Ok(i) => self.nodes[node].children[i].1,
+                Err(i) => {
+                    let child = self.nodes.len();
+                    self.nodes.push(Node::default());
+                    self.nodes[node].children.insert(i, (component.into(), child));
+                    child
+                }
+            };
+        }
+        node
+    }
+}
+
+/// Last literal directory component of a pattern, if it has a directory
+///
+/// Any path the pattern matches contains this component, since it sits
+/// between separators in the pattern. Alternatives (`{a,b}`) may hold
+/// separators of their own, so they count as a single wildcard
+/// component: `{/etc/x,/var/y}` has no anchor.
+fn anchor(pattern: &str) -> Option<String> {
+    let pattern = without_alternatives(pattern.trim_start_matches("**/"));
+    if !pattern.contains('/') {
+        return None;
+    }
+    pattern
+        .split('/')
+        .filter(|c| !c.is_empty() && *c != "." && *c != "..")
+        .filter(|c| !c.contains(['*', '?', '[', ']', '{', '}', '\\']))
+        .last()
+        .map(str::to_string)
+}
+
+/// `pattern` with every outermost `{…}` group replaced by `*`
+fn without_alternatives(pattern: &str) -> String {
+    let mut out = String::with_capacity(pattern.len());
+    let mut depth = 0usize;
+    for c in pattern.chars() {
+        match c {
+            '{' => {
+                if depth == 0 {
+                    out.push('*');
+                }
+                depth += 1;
+            }
+            '}' if depth > 0 => depth -= 1,
+            _ if depth > 0 => {}
+            _ => out.push(c),
+        }
+    }
+    out
+}
+
+fn build(builder: GlobSetBuilder) -> GlobSet {
+    builder.build().unwrap_or_else(|e| {
+        tracing::warn!("Failed to compile protection patterns: {}", e);
+        GlobSet::empty()
+    })
+}
+
+impl Default for ProtectedPaths {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_trie_matches_like_starts_with() {
+        let mut paths = ProtectedPaths::new();
+        paths.add_file(Path::new("/etc/passwd"));
+        paths.add_directory(Path::new("/etc/ssh/"));
+        paths.add_directory(Path::new("/etc/ssh"));
+        assert_eq!(paths.len(), 2);
+
+        assert!(paths.contains(Path::new("/etc/passwd")));
+        assert!(paths.contains(Path::new("/etc//passwd")));
+        assert!(!paths.contains(Path::new("/etc/passwd/x")));
+        assert!(!paths.contains(Path::new("/etc/passwd-")));
+        assert!(!paths.contains(Path::new("/etc")));
+
+        assert!(paths.contains(Path::new("/etc/ssh")));
+        assert!(paths.contains(Path::new("/etc/ssh/sshd_config")));
+        assert!(!paths.contains(Path::new("/etc/sshd")));
+        assert!(!paths.contains(Path::new("etc/ssh/sshd_config")));
+    }
+
+    #[test]
+    fn test_patterns_in_one_set() {
+        let mut paths = ProtectedPaths::new();
+        paths.set_patterns(["**/.env", "**/*.key", "[invalid", "/home/*/.aws/**", "**/.config/gh/*.yml"]);
+        assert!(paths.contains(Path::new("/app/.env")));
+        assert!(paths.contains(Path::new("/secrets/private.key")));
+        assert!(!paths.contains(Path::new("/app/.envrc")));
+        assert!(paths.contains(Path::new("/home/dev/.aws/credentials")));
+        assert!(!paths.contains(Path::new("/srv/dev/.aws/credentials")));
+        assert!(paths.contains(Path::new("/home/dev/.config/gh/hosts.yml")));
+        assert!(!paths.contains(Path::new("/home/dev/.config/git/hosts.yml")));
+
+        paths.set_patterns(["**/*.pem"]);
+        assert!(!paths.contains(Path::new("/app/.env")));
+        assert!(paths.contains(Path::new("/tls/cert.pem")));
+    }
+
+    #[test]
+    fn test_alternatives_with_separators() {
+        assert_eq!(anchor("{/etc/x,/var/y}"), None);
+        assert_eq!(anchor("/srv/{a/b,c}/keys/*"), Some("keys".to_string()));
+        assert_eq!(anchor("/home/*/.aws/**"), Some(".aws".to_string()));
+
+        let mut paths = ProtectedPaths::new();
+        paths.set_patterns(["{/etc/x,/var/y}", "/srv/{a/b,c}/*.pem"]);
+        assert!(paths.contains(Path::new("/etc/x")));
+        assert!(paths.contains(Path::new("/var/y")));
+        assert!(paths.contains(Path::new("/srv/a/b/cert.pem")));
+        assert!(paths.contains(Path::new("/srv/c/cert.pem")));
+        assert!(!paths.contains(Path::new("/srv/d/cert.pem")));
+    }
+}
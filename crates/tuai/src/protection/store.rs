@@ -0,0 +1,295 @@
+//! Protection config with hot reload
+//!
+//! The compiled config sits behind an atomic pointer, like the signature
+//! store. When it comes from a file, a watcher thread recompiles it after
+//! the file changes and swaps the result in, so the protect list can be
+//! edited while the TUI runs. Readers keep the config they loaded until
+//! they load again; a file that fails to parse leaves the current config
+//! in place.
+//!
+//! Every config is prepared before it is swapped in: its protected inodes
+//! are resolved and, when eBPF is active, mirrored into the kernel. The
+//! store is the only place that writes the kernel map, so configs built
+//! elsewhere (defaults, tests) leave it alone. Protected files replaced
+//! by a rename get a new inode without the config changing, so a refresher
+//! thread re-stats them and prepares the config again when they moved.
+
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+
+use arc_swap::ArcSwap;
+use parking_lot::Mutex;
+
+use super::ProtectionConfig;
+use crate::watch;
+
+/// How often protected files are checked for replacement
+const REFRESH_INTERVAL: Duration = Duration::from_secs(1);
+
+/// The protection config in use, reloaded from its file on change
+pub struct ProtectionStore {
+    current: ArcSwap<ProtectionConfig>,
+    path: Option<PathBuf>,
+    /// File contents the current config was compiled from
+    contents: Mutex<String>,
+    /// Held while a config is prepared and swapped in, so the kernel
+    /// mirror and `current` change in the same order
+    update: Mutex<()>,
+}
+
+impl ProtectionStore {
+    /// Store with a fixed config
+    pub fn new(config: ProtectionConfig) -> Self {
+        Self {
+            current: ArcSwap::from_pointee(prepare(config)),
+            path: None,
+            contents: Mutex::new(String::new()),
+            update: Mutex::new(()),
+        }
+    }
+
+    /// Store with the config loaded from `path`
+    pub fn from_file(path: PathBuf) -> anyhow::Result<Self> {
+        let contents = std::fs::read_to_string(&path)?;
+        let config = ProtectionConfig::from_str(&contents)?;
+        Ok(Self {
+            current: ArcSwap::from_pointee(prepare(config)),
+            path: Some(path),
+            contents: Mutex::new(contents),
+            update: Mutex::new(()),
+        })
+    }
+
+    /// Config in use (a single atomic load, never blocks)
+    pub fn load(&self) -> Arc<ProtectionConfig> {
+        self.current.load_full()
+    }
+
+    /// Config file, if any
+    pub fn path(&self) -> Option<&Path> {
+        self.path.as_deref()
+    }
+
+    /// Swap in a config
+    pub fn store(&self, config: ProtectionConfig) {
+        let _update = self.update.lock();
+        self.current.store(Arc::new(prepare(config)));
+    }
+
+    /// Protect one more file in the config in use
+    pub fn add_file(&self, path: PathBuf) {
+        self.modify(|config| config.add_file(path));
+    }
+
+    /// Protect one more directory in the config in use
+    pub fn add_directory(&self, path: PathBuf) {
+        self.modify(|config| config.add_directory(path));
+    }
+
+    /// Swap in a changed copy of the config in use
+    fn modify(&self, change: impl FnOnce(&mut ProtectionConfig)) {
+        let _update = self.update.lock();
+        let mut config = ProtectionConfig::clone(&self.current.load_full());
+        change(&mut config);
+        self.current.store(Arc::new(prepare(config)));
+    }
+
+    /// Resolve the inodes again if protected files were replaced
+    ///
+    /// Returns whether a re-resolved config was swapped in.
+    pub fn refresh(&self) -> bool {
+        if !self.current.load().inodes_stale() {
+            return false;
+        }
+        self.modify(|_| {});
+        true
+    }
+
+    /// Recompile from the config file and swap the result in
+    ///
+    /// Unchanged contents are not recompiled. On error the current config
+    /// stays. Returns whether a new config was swapped in.
+    pub fn reload(&self) -> anyhow::Result<bool> {
+        let Some(path) = &self.path else {
+            return Ok(false);
+        };
+        let contents = std::fs::read_to_string(path)?;
+        let mut last = self.contents.lock();
+        if *last == contents {
+            return Ok(false);
+        }
+        self.store(ProtectionConfig::from_str(&contents)?);
+        *last = contents;
+        Ok(true)
+    }
+
+    /// Reload whenever the config file changes
+    ///
+    /// The file's directory is watched, so editors that replace the file
+    /// are followed. Compilation happens on the watcher thread. Without a
+    /// config file `None` is returned.
+    pub fn spawn_watcher(
+        self: &Arc<Self>,
+        running: Arc<AtomicBool>,
+    ) -> std::io::Result<Option<std::thread::JoinHandle<()>>> {
+        let Some(path) = &self.path else {
+            return Ok(None);
+        };
+        let dir = match path.parent() {
+            Some(dir) if !dir.as_os_str().is_empty() => dir.to_path_buf(),
+            _ => PathBuf::from("."),
+        };
+        let store = self.clone();
+        watch::spawn("protection", dir, running, move || match store.reload() {
+            Ok(true) => tracing::info!("Reloaded protection config: {} items", store.load().protected_count()),
+            Ok(false) => {}
+            Err(e) => tracing::warn!("Keeping current protection config: {}", e),
+        })
+        .map(Some)
+    }
+
+    /// Refresh the inodes every `REFRESH_INTERVAL` on a dedicated thread
+    ///
+    /// Runs with or without a config file. The thread exits once
+    /// `running` is cleared.
+    pub fn spawn_refresher(
+        self: &Arc<Self>,
+        running: Arc<AtomicBool>,
+    ) -> std::io::Result<std::thread::JoinHandle<()>> {
+        let store = self.clone();
+        std::thread::Builder::new()
+            .name("tuai-protect-refresh".to_string())
+            .spawn(move || {
+                while running.load(Ordering::Relaxed) {
+                    std::thread::sleep(REFRESH_INTERVAL);
+                    if store.refresh() {
+                        tracing::debug!("Protected files changed, inodes resolved again");
+                    }
+                }
+            })
+    }
+}
+
+/// Resolve the config's inodes and mirror them into the kernel
+fn prepare(mut config: ProtectionConfig) -> ProtectionConfig {
+    config.resolve_inodes();
+    #[cfg(all(target_os = "linux", ebpf_available))]
+    crate::monitor::set_protected_inodes(config.protected_inodes());
+    config
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::Ordering;
+    use std::time::{Duration, Instant};
+
+    fn write_config(path: &Path, file: &str) {
+        std::fs::write(path, format!("include_defaults = false\nfiles = [\"{}\"]\n", file)).unwrap();
+    }
+
+    #[test]
+    fn test_reload_swaps_and_keeps_old_on_error() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("protect.toml");
+        write_config(&path, "/srv/a");
+
+        let store = ProtectionStore::from_file(path.clone()).unwrap();
+        let before = store.load();
+        assert!(before.is_protected("/srv/a"));
+
+        assert!(!store.reload().unwrap());
+        assert!(Arc::ptr_eq(&before, &store.load()));
+
+        write_config(&path, "/srv/b");
+        assert!(store.reload().unwrap());
+        assert!(store.load().is_protected("/srv/b"));
+        assert!(!store.load().is_protected("/srv/a"));
+        // Readers holding the old config are unaffected
+        assert!(before.is_protected("/srv/a"));
+
+        std::fs::write(&path, "files = [").unwrap();
+        assert!(store.reload().is_err());
+        assert!(store.load().is_protected("/srv/b"));
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_store_resolves_inodes() {
+        let dir = tempfile::tempdir().unwrap();
+        let secret = dir.path().join("secret");
+        std::fs::write(&secret, "x").unwrap();
+        let config = ProtectionConfig::from_str(&format!(
+            "include_defaults = false\nfiles = [\"{}\"]\n",
+            secret.display()
+        ))
+        .unwrap();
+        assert_eq!(config.protected_inodes().count(), 0);
+
+        let store = ProtectionStore::new(config);
+        assert_eq!(store.load().protected_inodes().count(), 1);
+
+        let keys = dir.path().join("keys");
+        std::fs::create_dir(&keys).unwrap();
+        std::fs::write(keys.join("id"), "y").unwrap();
+        let before = store.load();
+        store.add_directory(keys.clone());
+        assert!(store.load().is_protected(&keys.join("id").display().to_string()));
+        // The directory and the file below it
+        assert_eq!(store.load().protected_inodes().count(), 3);
+        assert_eq!(before.protected_inodes().count(), 1);
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_refresh_follows_replaced_files() {
+        let dir = tempfile::tempdir().unwrap();
+        let secret = dir.path().join("secret");
+        std::fs::write(&secret, "x").unwrap();
+        let store = ProtectionStore::new(
+            ProtectionConfig::from_str(&format!("include_defaults = false\nfiles = [\"{}\"]\n", secret.display()))
+                .unwrap(),
+        );
+        assert!(!store.refresh());
+
+        let tmp = dir.path().join("secret.tmp");
+        std::fs::write(&tmp, "y").unwrap();
+        std::fs::rename(&tmp, &secret).unwrap();
+        let new_id = super::super::inodes::file_id(&secret).unwrap();
+        assert!(!store.load().is_protected_inode(&new_id));
+
+        assert!(store.refresh());
+        assert!(store.load().is_protected_inode(&new_id));
+        assert_eq!(store.load().protected_inodes().count(), 1);
+        assert!(!store.refresh());
+    }
+
+    #[test]
+    fn test_watcher_follows_file() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("protect.toml");
+        write_config(&path, "/srv/a");
+        let store = Arc::new(ProtectionStore::from_file(path.clone()).unwrap());
+        assert!(ProtectionStore::new(ProtectionConfig::new()).path().is_none());
+
+        let running = Arc::new(AtomicBool::new(true));
+        let handle = store.spawn_watcher(running.clone()).unwrap().unwrap();
+        std::thread::sleep(Duration::from_millis(100));
+
+        // Replace the file the way editors do
+        let tmp = dir.path().join(".protect.toml.swp");
+        write_config(&tmp, "/srv/b");
+        std::fs::rename(&tmp, &path).unwrap();
+
+        let deadline = Instant::now() + Duration::from_secs(5);
+        while !store.load().is_protected("/srv/b") && Instant::now() < deadline {
+            std::thread::sleep(Duration::from_millis(50));
+        }
+        assert!(store.load().is_protected("/srv/b"));
+
+        running.store(false, Ordering::Relaxed);
+        handle.join().unwrap();
+    }
+}
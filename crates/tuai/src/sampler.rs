@@ -0,0 +1,374 @@
+//! Background sampler publishing immutable monitor snapshots
+//!
+//! The sampler thread is the only code that polls the monitors. After each
+//! tick it publishes a fresh `Arc<Snapshot>` through an atomic pointer
+//! swap (RCU style). Readers (TUI, event streamer, gRPC handlers) load the
+//! current snapshot with a single atomic operation. They never block on a
+//! lock and never trigger a /proc scan themselves.
+//!
+//! Process changes are carried forward as the monitor's generation deltas,
+//! so readers can keep asking for "changes since generation N" without
+//! touching the monitor.
+
+use std::collections::{HashMap, VecDeque};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+
+use arc_swap::ArcSwap;
+use chrono::{DateTime, Utc};
+use tokio::sync::broadcast;
+use tracing::{debug, warn};
+use tuai_common::{ConnectionEvent, ConnectionInfo, FileOpInfo, ProcessInfo};
+
+use crate::file::FileMonitorService;
+use crate::monitor::{ProcessDelta, ProcessMonitorService};
+use crate::network::{FlowStats, NetworkMonitorService};
+
+/// How often processes are sampled
+const PROCESS_INTERVAL: Duration = Duration::from_millis(500);
+
+/// How often connections and open files are sampled
+const RESOURCE_INTERVAL: Duration = Duration::from_millis(1000);
+
+/// Number of recent process deltas kept in each snapshot
+const RECENT_DELTAS: usize = 64;
+
+/// Immutable view of all monitors at one point in time
+#[derive(Debug, Clone)]
+pub struct Snapshot {
+    /// When the snapshot was published
+    pub taken_at: DateTime<Utc>,
+    /// Live processes by PID
+    ///
+    /// Entries are shared between snapshots: a new table copies pointers
+    /// to the processes that did not change, not the processes.
+    pub processes: Arc<HashMap<u32, Arc<ProcessInfo>>>,
+    /// Active network connections
+    pub connections: Arc<Vec<ConnectionInfo>>,
+    /// Open files
+    pub file_ops: Arc<Vec<FileOpInfo>>,
+    /// Traffic of tracked agents per endpoint
+    pub throughput: Arc<Vec<FlowStats>>,
+    process_generation: u64,
+    /// Recent deltas as (base generation, delta), oldest first
+    recent: VecDeque<(u64, Arc<ProcessDelta>)>,
+}
+
+impl Snapshot {
+    /// A snapshot with nothing in it
+    pub fn empty() -> Self {
+        Self {
+            taken_at: Utc::now(),
+            processes: Arc::new(HashMap::new()),
+            connections: Arc::new(Vec::new()),
+            file_ops: Arc::new(Vec::new()),
+            throughput: Arc::new(Vec::new()),
+            process_generation: 0,
+            recent: VecDeque::new(),
+        }
+    }
+
+    /// A snapshot holding just `processes` at `generation`
+    #[cfg(test)]
+    pub(crate) fn with_processes(generation: u64, processes: Vec<ProcessInfo>) -> Self {
+        Self {
+            processes: Arc::new(processes.into_iter().map(|p| (p.pid, Arc::new(p))).collect()),
+            process_generation: generation,
+            ..Self::empty()
+        }
+    }
+
+    /// The same snapshot, also carrying `delta` from generation `base`
+    #[cfg(test)]
+    pub(crate) fn with_delta(mut self, base: u64, delta: ProcessDelta) -> Self {
+        self.recent.push_back((base, Arc::new(delta)));
+        self
+    }
+
+    /// Generation of the process table in this snapshot
+    pub fn process_generation(&self) -> u64 {
+        self.process_generation
+    }
+
+    /// All processes, in no particular order
+    pub fn process_list(&self) -> Vec<ProcessInfo> {
+        self.processes.values().map(|p| ProcessInfo::clone(p)).collect()
+    }
+
+    /// Process changes between `generation` and this snapshot
+    ///
+    /// Pass 0 on the first call. Readers that fell behind the recent
+    /// deltas kept here get a full resync.
+    pub fn process_changes_since(&self, generation: u64) -> ProcessDelta {
+        if generation != 0 && generation == self.process_generation {
+            return ProcessDelta {
+                generation,
+                ..Default::default()
+            };
+        }
+
+        if generation != 0 {
+            if let Some(start) = self.recent.iter().position(|(base, _)| *base == generation) {
+                let merged = ProcessDelta::merge(self.recent.range(start..).map(|(_, d)| d.as_ref()));
+                if !merged.full_resync {
+                    return merged;
+                }
+            }
+        }
+
+        ProcessDelta::full(self.process_generation, self.process_list())
+    }
+}
+
+impl Default for Snapshot {
+    fn default() -> Self {
+        Self::empty()
+    }
+}
+
+/// Owns the monitors and publishes snapshots of them
+pub struct Sampler {
+    monitor: Arc<ProcessMonitorService>,
+    network_monitor: NetworkMonitorService,
+    file_monitor: FileMonitorService,
+    published: Arc<ArcSwap<Snapshot>>,
+    /// Next snapshot being assembled; shares unchanged parts with the last one
+    current: Snapshot,
+}
+
+impl Sampler {
+    /// Take ownership of already started monitors
+    pub fn new(
+        monitor: ProcessMonitorService,
+        network_monitor: NetworkMonitorService,
+        file_monitor: FileMonitorService,
+    ) -> Self {
+        Self {
+            monitor: Arc::new(monitor),
+            network_monitor,
+            file_monitor,
+            published: Arc::new(ArcSwap::from_pointee(Snapshot::empty())),
+            current: Snapshot::empty(),
+        }
+    }
+
+    /// The process monitor, for event subscriptions and tracked-PID hints
+    pub fn process_monitor(&self) -> Arc<ProcessMonitorService> {
+        self.monitor.clone()
+    }
+
+    /// Connection lifecycle events, emitted as connections are sampled
+    pub fn connection_events(&self) -> broadcast::Sender<ConnectionEvent> {
+        self.network_monitor.event_sender()
+    }
+
+    /// Where snapshots are published
+    pub fn published(&self) -> Arc<ArcSwap<Snapshot>> {
+        self.published.clone()
+    }
+
+    /// Sample all monitors once and publish the result
+    pub fn sample_all(&mut self) {
+        self.sample_processes();
+        self.sample_resources();
+        self.publish();
+    }
+
+    /// Run the sampling loop on a dedicated thread
+    ///
+    /// The thread exits once `running` is cleared.
+    pub fn spawn(mut self, running: Arc<AtomicBool>) -> std::io::Result<std::thread::JoinHandle<()>> {
+        std::thread::Builder::new()
+            .name("tuai-sampler".to_string())
+            .spawn(move || {
+                let mut last_resources = Instant::now();
+                while running.load(Ordering::Relaxed) {
+                    std::thread::sleep(PROCESS_INTERVAL);
+
+                    let mut changed = self.sample_processes();
+                    if last_resources.elapsed() >= RESOURCE_INTERVAL {
+                        self.sample_resources();
+                        last_resources = Instant::now();
+                        changed = true;
+                    }
+                    if changed {
+                        self.publish();
+                    }
+                }
+                debug!("Sampler thread exited");
+            })
+    }
+
+    /// Pull the process delta; returns whether anything changed
+    fn sample_processes(&mut self) -> bool {
+        let delta = match self.monitor.changes_since(self.current.process_generation) {
+            Ok(delta) => delta,
+            Err(e) => {
+                warn!("Process sampling failed: {}", e);
+                return false;
+            }
+        };
+        if delta.is_empty() {
+            return false;
+        }
+
+        // Copy-on-write: the published snapshot keeps the old table intact
+        apply(&delta, Arc::make_mut(&mut self.current.processes));
+
+        let base = self.current.process_generation;
+        self.current.process_generation = delta.generation;
+        if delta.full_resync {
+            self.current.recent.clear();
+        }
+        self.current.recent.push_back((base, Arc::new(delta)));
+        while self.current.recent.len() > RECENT_DELTAS {
+            self.current.recent.pop_front();
+        }
+        true
+    }
+
+    /// Refresh connections and open files of tracked agents
+    ///
+    /// Only agents and the processes attributed to them are read, so the
+    /// cost follows the agents' process trees rather than the number of
+    /// processes on the host. Polling the network monitor
+    /// also publishes connection open and close events. Protected opens
+    /// reported by the process monitor are added to the open files.
+    fn sample_resources(&mut self) {
+        let tracked = self.monitor.tracked_pids();
+        let attribution = self.monitor.attribution();
+        let sampled = sampled_pids(&tracked, &attribution);
+        let agent_of = |pid| attribution.get(&pid).copied().unwrap_or(pid);
+        match self.network_monitor.poll_for(&sampled, agent_of) {
+            Ok(connections) => {
+                self.current.connections = Arc::new(connections);
+                self.current.throughput = Arc::new(self.network_monitor.throughput());
+            }
+            Err(e) => debug!("Network sampling failed: {}", e),
+        }
+        match self.file_monitor.snapshot_for(&sampled) {
+            Ok(files) => self.current.file_ops = Arc::new(files),
+            Err(e) => debug!("File sampling failed: {}", e),
+        }
+        // Protected opens the kernel reported since the last sample
+        let opened = self.monitor.take_file_ops();
+        if !opened.is_empty() {
+            Arc::make_mut(&mut self.current.file_ops).extend(opened);
+        }
+    }
+
+    fn publish(&mut self) {
+        self.current.taken_at = Utc::now();
+        self.published.store(Arc::new(self.current.clone()));
+    }
+}
+
+/// Apply a process delta to a snapshot's table
+///
+/// Only changed processes are allocated; the others keep their entry.
+fn apply(delta: &ProcessDelta, processes: &mut HashMap<u32, Arc<ProcessInfo>>) {
+    if delta.full_resync {
+        processes.clear();
+    }
+    for pid in &delta.removed {
+        processes.remove(pid);
+    }
+    for process in delta.added.iter().chain(&delta.updated) {
+        processes.insert(process.pid, Arc::new(process.clone()));
+    }
+}
+
+/// PIDs whose connections and open files are read: every process
+/// attributed to an agent, and tracked agents without attribution yet
+fn sampled_pids(tracked: &[u32], attribution: &HashMap<u32, u32>) -> Vec<u32> {
+    let mut sampled: Vec<u32> = attribution.keys().copied().collect();
+    sampled.extend(tracked.iter().filter(|pid| !attribution.contains_key(pid)));
+    sampled
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn process(pid: u32, name: &str) -> ProcessInfo {
+        ProcessInfo::new(pid, name.to_string())
+    }
+
+    /// Build a snapshot the way the sampler does, one delta at a time
+    fn push(snapshot: &mut Snapshot, delta: ProcessDelta) {
+        apply(&delta, Arc::make_mut(&mut snapshot.processes));
+        let base = snapshot.process_generation;
+        snapshot.process_generation = delta.generation;
+        snapshot.recent.push_back((base, Arc::new(delta)));
+    }
+
+    #[test]
+    fn test_changes_since_merges_recent_deltas() {
+        let mut snapshot = Snapshot::empty();
+        push(&mut snapshot, ProcessDelta::full(1, vec![process(1, "init"), process(2, "bash")]));
+        push(
+            &mut snapshot,
+            ProcessDelta {
+                generation: 2,
+                added: vec![process(3, "claude")],
+                ..Default::default()
+            },
+        );
+        push(
+            &mut snapshot,
+            ProcessDelta {
+                generation: 3,
+                removed: vec![2],
+                ..Default::default()
+            },
+        );
+
+        let first = snapshot.process_changes_since(0);
+        assert!(first.full_resync);
+        assert_eq!(first.added.len(), 2);
+
+        let d = snapshot.process_changes_since(1);
+        assert!(!d.full_resync);
+        assert_eq!(d.generation, 3);
+        assert_eq!(d.added.iter().map(|p| p.pid).collect::<Vec<_>>(), vec![3]);
+        assert_eq!(d.removed, vec![2]);
+
+        assert!(snapshot.process_changes_since(3).is_empty());
+        // Unknown generation: resync
+        assert!(snapshot.process_changes_since(42).full_resync);
+    }
+
+    #[test]
+    fn test_sampled_pids_cover_attributed_processes() {
+        let attribution = HashMap::from([(100, 100), (101, 100), (102, 100)]);
+        let mut sampled = sampled_pids(&[100, 200], &attribution);
+        sampled.sort_unstable();
+        assert_eq!(sampled, vec![100, 101, 102, 200]);
+    }
+
+    #[test]
+    fn test_published_snapshot_is_immutable() {
+        let published = ArcSwap::from_pointee(Snapshot::empty());
+        let mut current = Snapshot::empty();
+        push(&mut current, ProcessDelta::full(1, vec![process(1, "init")]));
+        published.store(Arc::new(current.clone()));
+
+        let reader = published.load_full();
+        push(
+            &mut current,
+            ProcessDelta {
+                generation: 2,
+                added: vec![process(2, "bash")],
+                ..Default::default()
+            },
+        );
+        published.store(Arc::new(current.clone()));
+
+        // The old reader still sees its own consistent view
+        assert_eq!(reader.processes.len(), 1);
+        assert_eq!(published.load_full().processes.len(), 2);
+        // The unchanged process is shared, not copied
+        assert!(Arc::ptr_eq(&reader.processes[&1], &published.load_full().processes[&1]));
+    }
+}
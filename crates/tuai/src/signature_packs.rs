@@ -0,0 +1,281 @@
+//! Signature packs loaded from a directory, with hot reload
+//!
+//! Agent signatures can be added or overridden without a rebuild by
+//! dropping pack files into a directory. Each `.yaml`, `.yml` or `.toml`
+//! file holds one signature, a list of them, or a `signatures` list. Packs
+//! are read in file name order on top of the built-in signatures; a
+//! signature replaces any earlier one with the same name.
+//!
+//! ```yaml
+//! signatures:
+//!   - name: new_agent
+//!     display_name: New Agent
+//!     detection:
+//!       process_names: [new-agent]
+//!       command_patterns:
+//!         - regex: "new-agent\\s+run"
+//!     child_process_tracking: true
+//! ```
+//!
+//! The compiled matcher sits behind an atomic pointer. A reload compiles a
+//! complete new matcher on the watcher thread and swaps it in; readers keep
+//! using the matcher they loaded until they load again. A pack that fails
+//! to parse or compile leaves the current matcher in place.
+
+use std::path::{Path, PathBuf};
+use std::sync::atomic::AtomicBool;
+use std::sync::Arc;
+
+use arc_swap::ArcSwap;
+use serde::Deserialize;
+use tuai_common::{default_signatures, AgentSignature, PlatformError, PlatformResult, SignatureMatcher};
+
+use crate::watch;
+
+/// Contents of one pack file
+#[derive(Deserialize)]
+#[serde(untagged)]
+enum Pack {
+    Wrapped { signatures: Vec<AgentSignature> },
+    List(Vec<AgentSignature>),
+    Single(AgentSignature),
+}
+
+impl Pack {
+    fn into_signatures(self) -> Vec<AgentSignature> {
+        match self {
+            Pack::Wrapped { signatures } | Pack::List(signatures) => signatures,
+            Pack::Single(signature) => vec![signature],
+        }
+    }
+}
+
+/// Parse a pack file; the format follows the extension
+pub fn parse_pack(path: &Path, contents: &str) -> PlatformResult<Vec<AgentSignature>> {
+    let invalid = |e: String| {
+        PlatformError::InitializationFailed(format!("Invalid signature pack {}: {}", path.display(), e))
+    };
+    let pack: Pack = match path.extension().and_then(|e| e.to_str()) {
+        Some("toml") => toml::from_str(contents).map_err(|e| invalid(e.to_string()))?,
+        _ => serde_yaml::from_str(contents).map_err(|e| invalid(e.to_string()))?,
+    };
+    Ok(pack.into_signatures())
+}
+
+/// Read every pack in `dir`, in file name order
+pub fn load_packs(dir: &Path) -> PlatformResult<Vec<AgentSignature>> {
+    let entries = std::fs::read_dir(dir).map_err(|e| {
+        PlatformError::InitializationFailed(format!("Cannot read {}: {}", dir.display(), e))
+    })?;
+    let mut paths: Vec<PathBuf> = entries
+        .flatten()
+        .map(|entry| entry.path())
+        .filter(|path| {
+            matches!(
+                path.extension().and_then(|e| e.to_str()),
+                Some("yaml" | "yml" | "toml")
+            )
+        })
+        .collect();
+    paths.sort();
+
+    let mut signatures = Vec::new();
+    for path in paths {
+        let contents = std::fs::read_to_string(&path).map_err(|e| {
+            PlatformError::InitializationFailed(format!("Cannot read {}: {}", path.display(), e))
+        })?;
+        signatures.extend(parse_pack(&path, &contents)?);
+    }
+    Ok(signatures)
+}
+
+/// Built-in signatures with `packs` laid over them by name
+pub fn merge(mut signatures: Vec<AgentSignature>, packs: Vec<AgentSignature>) -> Vec<AgentSignature> {
+    for signature in packs {
+        match signatures.iter_mut().find(|s| s.name == signature.name) {
+            Some(existing) => *existing = signature,
+            None => signatures.push(signature),
+        }
+    }
+    signatures
+}
+
+/// Compile the built-in signatures plus the packs in `dir`
+fn compile(dir: Option<&Path>) -> PlatformResult<SignatureMatcher> {
+    let packs = match dir {
+        Some(dir) => load_packs(dir)?,
+        None => Vec::new(),
+    };
+    let mut matcher = SignatureMatcher::new();
+    matcher
+        .load(merge(default_signatures(), packs))
+        .map_err(|e| PlatformError::InitializationFailed(format!("Invalid signature: {}", e)))?;
+    Ok(matcher)
+}
+
+/// Current signature matcher, swappable while in use
+pub struct SignatureStore {
+    current: ArcSwap<SignatureMatcher>,
+    dir: Option<PathBuf>,
+}
+
+impl SignatureStore {
+    /// Store with the built-in signatures only
+    pub fn builtin() -> Self {
+        let matcher = compile(None).unwrap_or_else(|e| {
+            tracing::warn!("Failed to load default signatures: {}", e);
+            SignatureMatcher::new()
+        });
+        Self {
+            current: ArcSwap::from_pointee(matcher),
+            dir: None,
+        }
+    }
+
+    /// Store with the built-in signatures and the packs in `dir`
+    pub fn with_dir(dir: PathBuf) -> PlatformResult<Self> {
+        let matcher = compile(Some(&dir))?;
+        Ok(Self {
+            current: ArcSwap::from_pointee(matcher),
+            dir: Some(dir),
+        })
+    }
+
+    /// Matcher in use (a single atomic load, never blocks)
+    pub fn load(&self) -> Arc<SignatureMatcher> {
+        self.current.load_full()
+    }
+
+    /// Pack directory, if any
+    pub fn dir(&self) -> Option<&Path> {
+        self.dir.as_deref()
+    }
+
+    /// Swap in a matcher
+    pub fn store(&self, matcher: SignatureMatcher) {
+        self.current.store(Arc::new(matcher));
+    }
+
+    /// Recompile from the pack directory and swap the result in
+    ///
+    /// On error the current matcher stays. Returns the number of
+    /// signatures now loaded.
+    pub fn reload(&self) -> PlatformResult<usize> {
+        let matcher = compile(self.dir.as_deref())?;
+        let count = matcher.signatures().count();
+        self.store(matcher);
+        Ok(count)
+    }
+
+    /// Reload whenever the pack directory changes
+    ///
+    /// Compilation happens on the watcher thread. Without a pack
+    /// directory there is nothing to watch and `None` is returned.
+    pub fn spawn_watcher(
+        self: &Arc<Self>,
+        running: Arc<AtomicBool>,
+    ) -> std::io::Result<Option<std::thread::JoinHandle<()>>> {
+        let Some(dir) = self.dir.clone() else {
+            return Ok(None);
+        };
+        let store = self.clone();
+        watch::spawn("signatures", dir, running, move || match store.reload() {
+            Ok(count) => tracing::info!("Reloaded signature packs: {} signatures", count),
+            Err(e) => tracing::warn!("Keeping current signatures: {}", e),
+        })
+        .map(Some)
+    }
+}
+
+impl Default for SignatureStore {
+    fn default() -> Self {
+        Self::builtin()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tuai_common::ProcessInfo;
+
+    const PACK: &str = r#"
+signatures:
+  - name: new_agent
+    display_name: New Agent
+    detection:
+      process_names: [new-agent]
+  - name: aider
+    display_name: Aider (pinned)
+    detection:
+      process_names: [aider-pinned]
+"#;
+
+    fn process(name: &str) -> ProcessInfo {
+        ProcessInfo::new(1, name.to_string())
+    }
+
+    #[test]
+    fn test_pack_formats() {
+        let yaml = parse_pack(Path::new("a.yaml"), PACK).unwrap();
+        assert_eq!(yaml.len(), 2);
+
+        let single = parse_pack(
+            Path::new("b.yml"),
+            "name: one\ndisplay_name: One\ndetection:\n  process_names: [one]\n",
+        )
+        .unwrap();
+        assert_eq!(single[0].name, "one");
+
+        let toml = parse_pack(
+            Path::new("c.toml"),
+            r#"
+            [[signatures]]
+            name = "two"
+            display_name = "Two"
+            [signatures.detection]
+            process_names = ["two"]
+            "#,
+        )
+        .unwrap();
+        assert_eq!(toml[0].detection.process_names, vec!["two"]);
+
+        assert!(parse_pack(Path::new("d.yaml"), "name: [").is_err());
+    }
+
+    #[test]
+    fn test_packs_add_and_override() {
+        let dir = tempfile::tempdir().unwrap();
+        std::fs::write(dir.path().join("10-pack.yaml"), PACK).unwrap();
+        std::fs::write(dir.path().join("README.md"), "not a pack").unwrap();
+
+        let store = SignatureStore::with_dir(dir.path().to_path_buf()).unwrap();
+        let matcher = store.load();
+        assert_eq!(matcher.match_process(&process("new-agent")), Some("new_agent"));
+        assert_eq!(matcher.match_process(&process("aider-pinned")), Some("aider"));
+        assert_eq!(matcher.get("aider").unwrap().display_name, "Aider (pinned)");
+        // Built-ins that were not overridden stay
+        assert_eq!(matcher.match_process(&process("claude")), Some("claude_code"));
+    }
+
+    #[test]
+    fn test_reload_swaps_and_keeps_old_on_error() {
+        let dir = tempfile::tempdir().unwrap();
+        let store = SignatureStore::with_dir(dir.path().to_path_buf()).unwrap();
+        let before = store.load();
+        assert_eq!(before.match_process(&process("new-agent")), None);
+
+        std::fs::write(dir.path().join("pack.yaml"), PACK).unwrap();
+        store.reload().unwrap();
+        assert_eq!(store.load().match_process(&process("new-agent")), Some("new_agent"));
+        // A reader holding the old matcher is unaffected
+        assert_eq!(before.match_process(&process("new-agent")), None);
+
+        std::fs::write(
+            dir.path().join("pack.yaml"),
+            "name: bad\ndisplay_name: Bad\ndetection:\n  command_patterns: [{regex: \"(\"}]\n",
+        )
+        .unwrap();
+        assert!(store.reload().is_err());
+        assert_eq!(store.load().match_process(&process("new-agent")), Some("new_agent"));
+    }
+}
@@ -1,7 +1,7 @@
 //! DuckDB-based storage layer for telemetry data
 //!
-//! Provides persistent storage for process, network, and file events
-//! with time-series optimized queries.
+//! Provides persistent storage for process, network, and file events,
+//! and endpoint violation alerts, with time-series optimized queries.
 
 use std::path::Path;
 use std::sync::Arc;
@@ -11,7 +11,8 @@ use chrono::{DateTime, Utc};
 use duckdb::{params, Connection};
 use parking_lot::Mutex;
 use tuai_common::{
-    ConnectionInfo, ConnectionState, FileOpInfo, ProcessInfo, Protocol,
+    ConnectionEventType, ConnectionInfo, ConnectionState, EndpointViolation, FileOpInfo, ProcessEventType,
+    ProcessInfo, Protocol, TelemetryEvent,
 };
 use uuid::Uuid;
 
@@ -138,6 +139,24 @@ impl Storage {
             "#,
         )?;
 
+        // Connections of agents to endpoints their signature does not expect
+        conn.execute_batch(
+            r#"
+            CREATE TABLE IF NOT EXISTS endpoint_violations (
+                id VARCHAR PRIMARY KEY,
+                connection_id VARCHAR NOT NULL,
+                pid INTEGER NOT NULL,
+                agent_type VARCHAR NOT NULL,
+                remote_addr VARCHAR,
+                remote_port INTEGER,
+                timestamp TIMESTAMP NOT NULL
+            );
+
+            CREATE INDEX IF NOT EXISTS idx_endpoint_violations_agent ON endpoint_violations(agent_type);
+            CREATE INDEX IF NOT EXISTS idx_endpoint_violations_time ON endpoint_violations(timestamp);
+            "#,
+        )?;
+
         Ok(())
     }
 
@@ -203,6 +222,16 @@ impl Storage {
         Ok(())
     }
 
+    /// Update the state of a recorded connection
+    pub fn update_connection_state(&self, id: &Uuid, state: &ConnectionState) -> Result<()> {
+        let conn = self.conn.lock();
+        conn.execute(
+            "UPDATE connections SET state = ? WHERE id = ?",
+            params![format!("{:?}", state).to_lowercase(), id.to_string()],
+        )?;
+        Ok(())
+    }
+
     /// Insert a file operation event
     pub fn insert_file_op(&self, file_op: &FileOpInfo) -> Result<()> {
         let conn = self.conn.lock();
@@ -224,6 +253,50 @@ impl Storage {
         Ok(())
     }
 
+    /// Insert an endpoint violation alert
+    pub fn insert_endpoint_violation(&self, violation: &EndpointViolation) -> Result<()> {
+        let conn = self.conn.lock();
+        conn.execute(
+            r#"
+            INSERT INTO endpoint_violations (id, connection_id, pid, agent_type, remote_addr, remote_port, timestamp)
+            VALUES (?, ?, ?, ?, ?, ?, ?)
+            "#,
+            params![
+                Uuid::new_v4().to_string(),
+                violation.connection.id.to_string(),
+                violation.connection.pid,
+                violation.agent_type,
+                violation.connection.remote_addr,
+                violation.connection.remote_port,
+                violation.timestamp.to_rfc3339(),
+            ],
+        )?;
+        Ok(())
+    }
+
+    /// Persist a collected telemetry event
+    pub fn record_event(&self, event: &TelemetryEvent) -> Result<()> {
+        match event {
+            TelemetryEvent::Process(event) => match event.event_type {
+                ProcessEventType::Spawn | ProcessEventType::Update => {
+                    self.insert_process(&event.process)
+                }
+                ProcessEventType::Exit => {
+                    self.update_process_exit(&event.process.id, event.timestamp)
+                }
+            },
+            TelemetryEvent::Connection(event) => match event.event_type {
+                ConnectionEventType::Opened => self.insert_connection(&event.connection),
+                ConnectionEventType::StateChanged | ConnectionEventType::Closed => {
+                    self.update_connection_state(&event.connection.id, &event.connection.state)
+                }
+            },
+            TelemetryEvent::FileOp(file_op) => self.insert_file_op(file_op),
+            // The connection itself is stored through its Connection event
+            TelemetryEvent::EndpointViolation(violation) => self.insert_endpoint_violation(violation),
+        }
+    }
+
     /// Query processes within a time range
     pub fn query_processes(
         &self,
@@ -277,6 +350,7 @@ impl Storage {
                 cmdline: row.get(4)?,
                 exe_path: row.get(5)?,
                 agent_type: row.get(6)?,
+                agent_confidence: None,
                 start_time: DateTime::parse_from_rfc3339(&row.get::<_, String>(7)?)
                     .map(|dt| dt.with_timezone(&Utc))
                     .unwrap_or_else(|_| Utc::now()),
@@ -323,6 +397,7 @@ impl Storage {
                     "closed" => ConnectionState::Closed,
                     _ => ConnectionState::Connecting,
                 },
+                stats: None,
                 timestamp: DateTime::parse_from_rfc3339(&row.get::<_, String>(9)?)
                     .map(|dt| dt.with_timezone(&Utc))
                     .unwrap_or_else(|_| Utc::now()),
@@ -349,7 +424,9 @@ impl Storage {
         let processes: i64 = conn.query_row("SELECT COUNT(*) FROM processes", [], |row| row.get(0))?;
         let connections: i64 = conn.query_row("SELECT COUNT(*) FROM connections", [], |row| row.get(0))?;
         let file_ops: i64 = conn.query_row("SELECT COUNT(*) FROM file_ops", [], |row| row.get(0))?;
-        Ok(processes + connections + file_ops)
+        let violations: i64 =
+            conn.query_row("SELECT COUNT(*) FROM endpoint_violations", [], |row| row.get(0))?;
+        Ok(processes + connections + file_ops + violations)
     }
 
     /// Cleanup data older than retention period
@@ -365,6 +442,11 @@ impl Storage {
             params![&cutoff_str],
         )?;
 
+        deleted += conn.execute(
+            "DELETE FROM endpoint_violations WHERE timestamp < ?",
+            params![&cutoff_str],
+        )?;
+
         deleted += conn.execute(
             "DELETE FROM connections WHERE timestamp < ?",
             params![&cutoff_str],
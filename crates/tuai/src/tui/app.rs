@@ -1,5 +1,6 @@
 use std::collections::{HashMap, HashSet, VecDeque};
 use std::io;
+use std::sync::atomic::{AtomicBool, Ordering};
 use std::sync::Arc;
 use std::time::{Duration, Instant};
 
@@ -9,13 +10,15 @@ use crossterm::terminal::{
     disable_raw_mode, enable_raw_mode, EnterAlternateScreen, LeaveAlternateScreen,
 };
 use crossterm::ExecutableCommand;
-use parking_lot::RwLock;
 use ratatui::prelude::*;
+use tokio::sync::broadcast;
 
+use crate::collector::display_name;
 use crate::grpc::AgentState;
-use crate::protection::ProtectionConfig;
+use crate::network::FlowStats;
+use crate::protection::{ProtectionConfig, ProtectionStore};
 use crate::tui::ui;
-use tuai_common::ProcessInfo;
+use tuai_common::{ConnectionEventType, FileOpInfo, ProcessEventType, ProcessInfo, TelemetryEvent};
 
 const MAX_EVENTS: usize = 2000;
 
@@ -56,6 +59,8 @@ pub struct DisplayEvent {
     pub process_name: String,
     pub details: String,
     pub is_protected: bool,
+    /// The file operation, kept to re-check it when protection changes
+    pub file_op: Option<FileOpInfo>,
 }
 
 #[derive(Debug, Clone, PartialEq, Eq)]
@@ -69,6 +74,8 @@ pub enum EventType {
     FileCreate,
     FileDelete,
     ProtectedAccess,
+    /// An agent connected outside its expected endpoints
+    UnexpectedEndpoint,
 }
 
 impl EventType {
@@ -79,7 +86,7 @@ impl EventType {
             EventType::Network => "NET",
             EventType::FileOpen | EventType::FileRead | EventType::FileWrite
             | EventType::FileCreate | EventType::FileDelete => "FILE",
-            EventType::ProtectedAccess => "ALERT",
+            EventType::ProtectedAccess | EventType::UnexpectedEndpoint => "ALERT",
         }
     }
 
@@ -91,7 +98,7 @@ impl EventType {
             EventType::FileOpen | EventType::FileRead => Color::White,
             EventType::FileWrite | EventType::FileCreate => Color::Yellow,
             EventType::FileDelete => Color::Red,
-            EventType::ProtectedAccess => Color::LightRed,
+            EventType::ProtectedAccess | EventType::UnexpectedEndpoint => Color::LightRed,
         }
     }
 }
@@ -140,13 +147,16 @@ impl View {
 }
 
 pub struct App {
-    state: Arc<RwLock<AgentState>>,
-    protection_config: Option<ProtectionConfig>,
+    state: Arc<AgentState>,
+    protection: Option<Arc<ProtectionStore>>,
+    /// Config file events were last checked against
+    protection_config: Option<Arc<ProtectionConfig>>,
     pub(crate) events: VecDeque<DisplayEvent>,
     pub(crate) tracked_pids: HashSet<u32>,
+    /// Agents and their descendants
     pub(crate) known_processes: HashMap<u32, ProcessInfo>,
-    known_connections: HashSet<(u32, String, u16)>,
-    known_files: HashSet<(u32, String)>,
+    /// Events from the shared collection engine
+    telemetry: broadcast::Receiver<TelemetryEvent>,
     pub(crate) stats: Stats,
     start_time: Instant,
     pub(crate) view: View,
@@ -160,17 +170,19 @@ pub struct App {
 
 impl App {
     pub fn new(
-        state: Arc<RwLock<AgentState>>,
-        protection_config: Option<ProtectionConfig>,
+        state: Arc<AgentState>,
+        protection: Option<Arc<ProtectionStore>>,
     ) -> Self {
+        let telemetry = state.telemetry.subscribe();
+        let protection_config = protection.as_ref().map(|store| store.load());
         let mut app = Self {
             state,
+            protection,
             protection_config,
             events: VecDeque::with_capacity(MAX_EVENTS),
             tracked_pids: HashSet::new(),
             known_processes: HashMap::new(),
-            known_connections: HashSet::new(),
-            known_files: HashSet::new(),
+            telemetry,
             stats: Stats::default(),
             start_time: Instant::now(),
             view: View::Agents,
@@ -186,208 +198,206 @@ impl App {
     }
 
     fn init_tracking(&mut self) {
-        let state_lock = self.state.read();
-        if let Ok(processes) = state_lock.monitor.snapshot() {
-            for process in &processes {
-                if state_lock.signature_matcher.match_process(process).is_some() {
-                    self.tracked_pids.insert(process.pid);
-                }
-                self.known_processes.insert(process.pid, process.clone());
-            }
+        for agent in self.state.telemetry.agents() {
+            self.tracked_pids.insert(agent.pid);
+            self.known_processes.insert(agent.pid, agent);
         }
+        self.stats.ai_agents = self.tracked_pids.len();
     }
 
-    fn get_display_name(
-        process: &ProcessInfo,
-        state_lock: &parking_lot::RwLockReadGuard<AgentState>,
-    ) -> String {
-        if let Some(agent) = state_lock.signature_matcher.match_process(process) {
-            agent.to_string()
-        } else if process
-            .name
-            .chars()
-            .all(|c| c.is_ascii_digit() || c == '.')
-        {
-            process
-                .cmdline
-                .as_ref()
-                .and_then(|c| c.split_whitespace().next())
-                .and_then(|s| s.rsplit('/').next())
-                .unwrap_or(&process.name)
-                .to_string()
-        } else {
-            process.name.clone()
-        }
-    }
-
-    fn is_protected_path(&self, path: &str) -> bool {
+    fn is_protected_file(&self, file_op: &FileOpInfo) -> bool {
         self.protection_config
             .as_ref()
-            .map_or(false, |cfg| cfg.is_protected(path))
+            .map_or(false, |cfg| cfg.is_protected_file(file_op))
+    }
+
+    /// Pick up a reloaded protection config
+    ///
+    /// File events still in the list are checked again against the new
+    /// rules, so alerts appear or clear without waiting for new accesses.
+    fn refresh_protection(&mut self) {
+        let Some(current) = self.protection.as_ref().map(|store| store.load()) else {
+            return;
+        };
+        if self.protection_config.as_ref().is_some_and(|cfg| Arc::ptr_eq(cfg, &current)) {
+            return;
+        }
+        self.protection_config = Some(current);
+
+        let mut events = std::mem::take(&mut self.events);
+        for event in events.iter_mut() {
+            let Some(file_op) = &event.file_op else {
+                continue;
+            };
+            let is_protected = self.is_protected_file(file_op);
+            if is_protected == event.is_protected {
+                continue;
+            }
+            if is_protected {
+                self.stats.protected_alerts += 1;
+            } else {
+                self.stats.protected_alerts = self.stats.protected_alerts.saturating_sub(1);
+            }
+            (event.event_type, event.severity) = file_event_kind(file_op, is_protected);
+            event.is_protected = is_protected;
+        }
+        self.events = events;
     }
 
+    /// Drain events from the collection engine
+    ///
+    /// Cheap enough to call on every frame; the collector does the diffing.
     pub fn poll_events(&mut self) {
-        let mut pending_events = Vec::new();
-
-        {
-            let state_lock = self.state.read();
-
-            // Poll processes
-            if let Ok(processes) = state_lock.monitor.snapshot() {
-                let current_pids: HashSet<u32> = processes.iter().map(|p| p.pid).collect();
-                self.stats.total_processes = current_pids.len();
-                self.stats.ai_agents = self.tracked_pids.len();
-
-                for process in &processes {
-                    if !self.known_processes.contains_key(&process.pid) {
-                        let is_agent =
-                            state_lock.signature_matcher.match_process(process).is_some();
-                        if is_agent {
+        self.refresh_protection();
+        loop {
+            let event = match self.telemetry.try_recv() {
+                Ok(event) => event,
+                Err(broadcast::error::TryRecvError::Lagged(_)) => continue,
+                Err(_) => break,
+            };
+            if let Some(event) = self.display_event(event) {
+                self.push_event(event);
+            }
+        }
+
+        self.stats.total_processes = self.state.snapshot().processes.len();
+        self.stats.ai_agents = self.tracked_pids.len();
+        self.stats.uptime = self.start_time.elapsed();
+    }
+
+    /// Update local state from a collected event and render it
+    fn display_event(&mut self, event: TelemetryEvent) -> Option<DisplayEvent> {
+        match event {
+            TelemetryEvent::Process(event) => {
+                let process = event.process;
+                match event.event_type {
+                    ProcessEventType::Spawn => {
+                        if process.agent_type.is_some() {
                             self.tracked_pids.insert(process.pid);
                         }
-
-                        let parent_tracked = process
-                            .ppid
-                            .map(|p| self.tracked_pids.contains(&p))
-                            .unwrap_or(false);
-                        let display_name = Self::get_display_name(process, &state_lock);
-
-                        if is_agent || parent_tracked || self.tracked_pids.contains(&process.pid) {
-                            pending_events.push(DisplayEvent {
-                                timestamp: Utc::now(),
-                                event_type: EventType::ProcessSpawn,
-                                severity: Severity::Info,
-                                pid: process.pid,
-                                process_name: display_name,
-                                details: process.cmdline.clone().unwrap_or_default(),
-                                is_protected: false,
-                            });
+                        let display = DisplayEvent {
+                            timestamp: event.timestamp,
+                            event_type: EventType::ProcessSpawn,
+                            severity: Severity::Info,
+                            pid: process.pid,
+                            process_name: display_name(&process),
+                            details: process.cmdline.clone().unwrap_or_default(),
+                            is_protected: false,
+                            file_op: None,
+                        };
+                        self.known_processes.insert(process.pid, process);
+                        Some(display)
+                    }
+                    ProcessEventType::Update => {
+                        // Reloaded signatures can add or drop an agent type
+                        if process.agent_type.is_some() {
+                            self.tracked_pids.insert(process.pid);
+                        } else {
+                            self.tracked_pids.remove(&process.pid);
                         }
-
-                        self.known_processes.insert(process.pid, process.clone());
+                        self.known_processes.insert(process.pid, process);
+                        None
                     }
-                }
-
-                // Detect exited processes
-                let exited: Vec<(u32, String)> = self
-                    .known_processes
-                    .iter()
-                    .filter(|(pid, _)| !current_pids.contains(pid))
-                    .map(|(pid, p)| (*pid, p.name.clone()))
-                    .collect();
-
-                for (pid, name) in exited {
-                    if self.tracked_pids.contains(&pid) {
-                        pending_events.push(DisplayEvent {
-                            timestamp: Utc::now(),
+                    ProcessEventType::Exit => {
+                        self.known_processes.remove(&process.pid);
+                        if !self.tracked_pids.remove(&process.pid) {
+                            return None;
+                        }
+                        Some(DisplayEvent {
+                            timestamp: event.timestamp,
                             event_type: EventType::ProcessExit,
                             severity: Severity::Warning,
-                            pid,
-                            process_name: name,
+                            pid: process.pid,
+                            process_name: process.name,
                             details: String::new(),
                             is_protected: false,
-                        });
-                        self.tracked_pids.remove(&pid);
+                            file_op: None,
+                        })
                     }
-                    self.known_processes.remove(&pid);
                 }
             }
-
-            // Poll network
-            if let Ok(connections) = state_lock.network_monitor.snapshot() {
-                for conn in &connections {
-                    if self.tracked_pids.contains(&conn.pid) {
-                        let remote_addr = conn.remote_addr.as_deref().unwrap_or("").to_string();
-                        let remote_port = conn.remote_port.unwrap_or(0);
-                        let key = (conn.pid, remote_addr.clone(), remote_port);
-
-                        if !self.known_connections.contains(&key)
-                            && !remote_addr.is_empty()
-                            && remote_port > 0
-                        {
-                            self.known_connections.insert(key);
-                            let proc_name = self
-                                .known_processes
-                                .get(&conn.pid)
-                                .map(|p| p.name.clone())
-                                .unwrap_or_else(|| "?".to_string());
-                            let local_info = format!(
-                                "{}:{}",
-                                conn.local_addr.as_deref().unwrap_or("?"),
-                                conn.local_port
-                                    .map(|p| p.to_string())
-                                    .unwrap_or_else(|| "?".to_string())
-                            );
-                            pending_events.push(DisplayEvent {
-                                timestamp: Utc::now(),
-                                event_type: EventType::Network,
-                                severity: Severity::Info,
-                                pid: conn.pid,
-                                process_name: proc_name,
-                                details: format!(
-                                    "{:?} {} -> {}:{}",
-                                    conn.protocol, local_info, remote_addr, remote_port
-                                ),
-                                is_protected: false,
-                            });
-                        }
-                    }
-                }
+            TelemetryEvent::Connection(event) => {
+                // Opens and closes only; state changes would flood the list
+                let lifetime = match event.event_type {
+                    ConnectionEventType::Opened => String::new(),
+                    ConnectionEventType::Closed => format!(
+                        " (closed after {:.1}s)",
+                        event.duration_ms.unwrap_or(0) as f64 / 1000.0
+                    ),
+                    ConnectionEventType::StateChanged => return None,
+                };
+                let conn = &event.connection;
+                let local_info = format!(
+                    "{}:{}",
+                    conn.local_addr.as_deref().unwrap_or("?"),
+                    conn.local_port
+                        .map(|p| p.to_string())
+                        .unwrap_or_else(|| "?".to_string())
+                );
+                Some(DisplayEvent {
+                    timestamp: event.timestamp,
+                    event_type: EventType::Network,
+                    severity: Severity::Info,
+                    pid: conn.pid,
+                    process_name: self.process_name(conn.pid),
+                    details: format!(
+                        "{:?} {} -> {}:{}{}",
+                        conn.protocol,
+                        local_info,
+                        conn.remote_addr.as_deref().unwrap_or(""),
+                        conn.remote_port.unwrap_or(0),
+                        lifetime
+                    ),
+                    is_protected: false,
+                    file_op: None,
+                })
             }
-
-            // Poll file operations
-            if let Ok(files) = state_lock.file_monitor.snapshot() {
-                for file_op in &files {
-                    if self.tracked_pids.contains(&file_op.pid) {
-                        let key = (file_op.pid, file_op.path.clone());
-
-                        if !self.known_files.contains(&key) {
-                            self.known_files.insert(key);
-                            let proc_name = self
-                                .known_processes
-                                .get(&file_op.pid)
-                                .map(|p| p.name.clone())
-                                .unwrap_or_else(|| "?".to_string());
-                            let is_protected = self.is_protected_path(&file_op.path);
-
-                            let (event_type, severity) = if is_protected {
-                                (EventType::ProtectedAccess, Severity::Critical)
-                            } else {
-                                let et = match file_op.operation {
-                                    tuai_common::FileOperation::Open => EventType::FileOpen,
-                                    tuai_common::FileOperation::Read => EventType::FileRead,
-                                    tuai_common::FileOperation::Write => EventType::FileWrite,
-                                    tuai_common::FileOperation::Create => EventType::FileCreate,
-                                    tuai_common::FileOperation::Delete => EventType::FileDelete,
-                                    tuai_common::FileOperation::Rename => EventType::FileWrite,
-                                };
-                                (et, Severity::Info)
-                            };
-
-                            pending_events.push(DisplayEvent {
-                                timestamp: Utc::now(),
-                                event_type,
-                                severity,
-                                pid: file_op.pid,
-                                process_name: proc_name,
-                                details: format!("{:?} {}", file_op.operation, file_op.path),
-                                is_protected,
-                            });
-                        }
-                    }
-                }
+            TelemetryEvent::FileOp(file_op) => {
+                let is_protected = self.is_protected_file(&file_op);
+                let (event_type, severity) = file_event_kind(&file_op, is_protected);
+
+                Some(DisplayEvent {
+                    timestamp: Utc::now(),
+                    event_type,
+                    severity,
+                    pid: file_op.pid,
+                    process_name: self.process_name(file_op.pid),
+                    details: format!("{:?} {}", file_op.operation, file_op.path),
+                    is_protected,
+                    file_op: Some(file_op),
+                })
+            }
+            TelemetryEvent::EndpointViolation(violation) => {
+                let conn = &violation.connection;
+                Some(DisplayEvent {
+                    timestamp: violation.timestamp,
+                    event_type: EventType::UnexpectedEndpoint,
+                    severity: Severity::Alert,
+                    pid: conn.pid,
+                    process_name: self.process_name(conn.pid),
+                    details: format!(
+                        "Unexpected endpoint {}:{} for {}",
+                        conn.remote_addr.as_deref().unwrap_or(""),
+                        conn.remote_port.unwrap_or(0),
+                        violation.agent_type
+                    ),
+                    is_protected: false,
+                    file_op: None,
+                })
             }
-        } // state_lock dropped here
-
-        for event in pending_events {
-            self.push_event(event);
         }
-        self.stats.uptime = self.start_time.elapsed();
+    }
+
+    fn process_name(&self, pid: u32) -> String {
+        self.known_processes
+            .get(&pid)
+            .map(|p| p.name.clone())
+            .unwrap_or_else(|| "?".to_string())
     }
 
     fn push_event(&mut self, event: DisplayEvent) {
         match event.event_type {
-            EventType::ProtectedAccess => self.stats.protected_alerts += 1,
+            EventType::ProtectedAccess | EventType::UnexpectedEndpoint => self.stats.protected_alerts += 1,
             EventType::Network => self.stats.network_connections += 1,
             EventType::FileOpen | EventType::FileRead | EventType::FileWrite
             | EventType::FileCreate | EventType::FileDelete => {
@@ -569,15 +579,62 @@ impl App {
             .collect()
     }
 
+    /// Traffic of tracked agents per endpoint, busiest first
+    pub fn throughput(&self) -> Vec<(String, FlowStats)> {
+        let mut flows: Vec<_> = self
+            .state
+            .snapshot()
+            .throughput
+            .iter()
+            .filter(|f| self.tracked_pids.contains(&f.agent_pid))
+            .map(|f| (self.process_name(f.agent_pid), f.clone()))
+            .collect();
+        flows.sort_by(|(_, a), (_, b)| {
+            let rate = |f: &FlowStats| f.sent_per_sec + f.received_per_sec;
+            rate(b)
+                .total_cmp(&rate(a))
+                .then((b.bytes_sent + b.bytes_received).cmp(&(a.bytes_sent + a.bytes_received)))
+        });
+        flows
+    }
+
     pub fn protected_events(&self) -> Vec<&DisplayEvent> {
         self.events.iter().filter(|e| e.is_protected).collect()
     }
 }
 
+/// How a file event is shown, depending on whether it is protected
+fn file_event_kind(file_op: &FileOpInfo, is_protected: bool) -> (EventType, Severity) {
+    if is_protected {
+        return (EventType::ProtectedAccess, Severity::Critical);
+    }
+    let et = match file_op.operation {
+        tuai_common::FileOperation::Open => EventType::FileOpen,
+        tuai_common::FileOperation::Read => EventType::FileRead,
+        tuai_common::FileOperation::Write => EventType::FileWrite,
+        tuai_common::FileOperation::Create => EventType::FileCreate,
+        tuai_common::FileOperation::Delete => EventType::FileDelete,
+        tuai_common::FileOperation::Rename => EventType::FileWrite,
+    };
+    (et, Severity::Info)
+}
+
 pub async fn run_tui(
-    state: Arc<RwLock<AgentState>>,
-    protection_config: Option<ProtectionConfig>,
+    state: Arc<AgentState>,
+    protection: Option<Arc<ProtectionStore>>,
 ) -> io::Result<()> {
+    // Reload the protection config, and follow replaced protected files,
+    // off the UI thread while the TUI runs
+    let watching = Arc::new(AtomicBool::new(true));
+    if let Some(store) = &protection {
+        if let Err(e) = store.spawn_watcher(watching.clone()) {
+            tracing::warn!("Protection config will not be reloaded: {}", e);
+        }
+        if let Err(e) = store.spawn_refresher(watching.clone()) {
+            tracing::warn!("Replaced protected files will not be resolved again: {}", e);
+        }
+    }
+
     enable_raw_mode()?;
     io::stdout().execute(EnterAlternateScreen)?;
 
@@ -585,15 +642,10 @@ pub async fn run_tui(
     let mut terminal = Terminal::new(backend)?;
     terminal.clear()?;
 
-    let mut app = App::new(state, protection_config);
-    let mut last_poll = Instant::now();
-    let poll_interval = Duration::from_millis(500);
+    let mut app = App::new(state, protection);
 
     loop {
-        if last_poll.elapsed() >= poll_interval {
-            app.poll_events();
-            last_poll = Instant::now();
-        }
+        app.poll_events();
 
         terminal.draw(|frame| ui::draw(frame, &app))?;
 
@@ -610,6 +662,7 @@ pub async fn run_tui(
         }
     }
 
+    watching.store(false, Ordering::Relaxed);
     disable_raw_mode()?;
     io::stdout().execute(LeaveAlternateScreen)?;
     Ok(())
@@ -2,6 +2,8 @@ use chrono::Local;
 use ratatui::prelude::*;
 use ratatui::widgets::*;
 
+use crate::collector::agent_label;
+use crate::network::FlowStats;
 use crate::tui::app::{App, Severity, View};
 
 pub fn draw(frame: &mut Frame, app: &App) {
@@ -167,7 +169,7 @@ fn draw_agents_view(frame: &mut Frame, area: Rect, app: &App) {
         .skip(app.scroll_offset)
         .take(area.height.saturating_sub(3) as usize)
         .map(|(_, proc_info)| {
-            let agent_type = proc_info.agent_type.as_deref().unwrap_or("-");
+            let agent_type = agent_label(proc_info).unwrap_or_else(|| "-".to_string());
             let cwd = proc_info.cwd.as_deref().unwrap_or("-");
             let cmdline = proc_info
                 .cmdline
@@ -287,6 +289,20 @@ fn draw_events_view(frame: &mut Frame, area: Rect, app: &App) {
 }
 
 fn draw_network_view(frame: &mut Frame, area: Rect, app: &App) {
+    let flows = app.throughput();
+    let area = if flows.is_empty() {
+        area
+    } else {
+        // Throughput on top, sized to its rows (at most half the view)
+        let height = (flows.len() as u16 + 3).min(area.height / 2);
+        let chunks = Layout::default()
+            .direction(Direction::Vertical)
+            .constraints([Constraint::Length(height), Constraint::Min(5)])
+            .split(area);
+        draw_throughput(frame, chunks[0], &flows);
+        chunks[1]
+    };
+
     let net_events = app.network_events();
 
     let header_cells = ["TIME", "PID", "PROCESS", "CONNECTION"]
@@ -344,6 +360,68 @@ fn draw_network_view(frame: &mut Frame, area: Rect, app: &App) {
     frame.render_widget(table, area);
 }
 
+fn draw_throughput(frame: &mut Frame, area: Rect, flows: &[(String, FlowStats)]) {
+    let header_cells = ["PROCESS", "CLASS", "REMOTE", "TX/s", "RX/s", "TX", "RX", "RTT"]
+        .iter()
+        .map(|h| {
+            Cell::from(*h).style(
+                Style::default()
+                    .fg(Color::DarkGray)
+                    .add_modifier(Modifier::BOLD),
+            )
+        });
+    let header = Row::new(header_cells).height(1);
+
+    let rows: Vec<Row> = flows
+        .iter()
+        .take(area.height.saturating_sub(3) as usize)
+        .map(|(name, flow)| {
+            let rtt = flow
+                .rtt_us
+                .map(|us| format!("{:.1}ms", us as f64 / 1000.0))
+                .unwrap_or_else(|| "-".to_string());
+            let cells = vec![
+                Cell::from(format!("{} ({})", truncate(name, 12), flow.agent_pid))
+                    .style(Style::default().fg(Color::Cyan)),
+                Cell::from(flow.class.name()).style(Style::default().fg(Color::Magenta)),
+                Cell::from(flow.remote_addr.clone()).style(Style::default().fg(Color::Blue)),
+                Cell::from(format_bytes(flow.sent_per_sec as u64)),
+                Cell::from(format_bytes(flow.received_per_sec as u64)),
+                Cell::from(format_bytes(flow.bytes_sent)).style(Style::default().fg(Color::DarkGray)),
+                Cell::from(format_bytes(flow.bytes_received))
+                    .style(Style::default().fg(Color::DarkGray)),
+                Cell::from(rtt).style(Style::default().fg(Color::Yellow)),
+            ];
+            Row::new(cells)
+        })
+        .collect();
+
+    let table = Table::new(
+        rows,
+        [
+            Constraint::Length(20),
+            Constraint::Length(16),
+            Constraint::Min(16),
+            Constraint::Length(9),
+            Constraint::Length(9),
+            Constraint::Length(9),
+            Constraint::Length(9),
+            Constraint::Length(8),
+        ],
+    )
+    .header(header)
+    .block(
+        Block::default()
+            .title(format!(" Throughput ({}) ", flows.len()))
+            .title_style(Style::default().fg(Color::White))
+            .borders(Borders::ALL)
+            .border_style(Style::default().fg(Color::DarkGray))
+            .border_type(BorderType::Rounded),
+    );
+
+    frame.render_widget(table, area);
+}
+
 fn draw_alerts_view(frame: &mut Frame, area: Rect, app: &App) {
     let protected = app.protected_events();
 
@@ -500,7 +578,7 @@ fn draw_help_overlay(frame: &mut Frame) {
         Line::from(""),
         help_line("1", "Agents - tracked AI processes"),
         help_line("2", "Events - live event log"),
-        help_line("3", "Network - connections"),
+        help_line("3", "Network - connections, throughput"),
         help_line("4", "Alerts - protected file access"),
         Line::from(""),
         Line::from(Span::styled(
@@ -557,6 +635,21 @@ fn centered_rect(percent_x: u16, percent_y: u16, r: Rect) -> Rect {
         .split(popup[1])[1]
 }
 
+fn format_bytes(bytes: u64) -> String {
+    const UNITS: [&str; 4] = ["B", "K", "M", "G"];
+    let mut value = bytes as f64;
+    let mut unit = 0;
+    while value >= 1024.0 && unit < UNITS.len() - 1 {
+        value /= 1024.0;
+        unit += 1;
+    }
+    if unit == 0 {
+        format!("{}B", bytes)
+    } else {
+        format!("{:.1}{}", value, UNITS[unit])
+    }
+}
+
 fn truncate(s: &str, max: usize) -> String {
     if s.len() <= max {
         s.to_string()
@@ -0,0 +1,182 @@
+//! Change notification for configuration directories
+//!
+//! A watcher thread waits for changes in one directory and calls back once
+//! a burst of changes has settled, so an editor writing a temporary file
+//! and renaming it over the original causes a single reload. On Linux the
+//! thread blocks on inotify. Elsewhere, or when inotify is unavailable
+//! (e.g. the instance limit is reached), the directory listing is polled
+//! for changed names, sizes and modification times.
+//!
+//! The callback runs on the watcher thread, so reload work never stalls
+//! the sampler or the collector.
+
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::time::{Duration, SystemTime};
+
+use tracing::debug;
+
+/// How long changes must stay quiet before the callback runs
+const DEBOUNCE: Duration = Duration::from_millis(250);
+
+/// How often `running` is checked, and the directory polled without inotify
+const TICK: Duration = Duration::from_millis(500);
+
+/// Watch `dir` on a dedicated thread, calling `on_change` after changes
+///
+/// The thread exits once `running` is cleared.
+pub fn spawn<F>(
+    name: &str,
+    dir: PathBuf,
+    running: Arc<AtomicBool>,
+    mut on_change: F,
+) -> std::io::Result<std::thread::JoinHandle<()>>
+where
+    F: FnMut() + Send + 'static,
+{
+    std::thread::Builder::new()
+        .name(format!("tuai-watch-{}", name))
+        .spawn(move || {
+            #[cfg(target_os = "linux")]
+            match linux::Inotify::watch(&dir) {
+                Ok(inotify) => {
+                    while running.load(Ordering::Relaxed) {
+                        if inotify.wait(TICK) {
+                            // Let the burst settle, then swallow the rest of it
+                            std::thread::sleep(DEBOUNCE);
+                            while inotify.wait(Duration::ZERO) {}
+                            on_change();
+                        }
+                    }
+                    debug!("Watcher for {} exited", dir.display());
+                    return;
+                }
+                Err(e) => debug!("inotify unavailable for {}, polling: {}", dir.display(), e),
+            }
+
+            let mut last = fingerprint(&dir);
+            while running.load(Ordering::Relaxed) {
+                std::thread::sleep(TICK);
+                let current = fingerprint(&dir);
+                if current != last {
+                    std::thread::sleep(DEBOUNCE);
+                    last = fingerprint(&dir);
+                    on_change();
+                }
+            }
+            debug!("Watcher for {} exited", dir.display());
+        })
+}
+
+/// Names, sizes and modification times of the entries of `dir`
+fn fingerprint(dir: &Path) -> Vec<(PathBuf, u64, Option<SystemTime>)> {
+    let Ok(entries) = std::fs::read_dir(dir) else {
+        return Vec::new();
+    };
+    let mut entries: Vec<_> = entries
+        .flatten()
+        .map(|entry| {
+            let meta = entry.metadata().ok();
+            (
+                entry.path(),
+                meta.as_ref().map_or(0, |m| m.len()),
+                meta.and_then(|m| m.modified().ok()),
+            )
+        })
+        .collect();
+    entries.sort();
+    entries
+}
+
+#[cfg(target_os = "linux")]
+mod linux {
+    use std::ffi::CString;
+    use std::io;
+    use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+    use std::os::unix::ffi::OsStrExt;
+    use std::path::Path;
+    use std::time::Duration;
+
+    /// Directory events that can change what a reload reads
+    const MASK: u32 = libc::IN_CLOSE_WRITE
+        | libc::IN_CREATE
+        | libc::IN_DELETE
+        | libc::IN_MOVED_FROM
+        | libc::IN_MOVED_TO
+        | libc::IN_DELETE_SELF
+        | libc::IN_MOVE_SELF;
+
+    /// An inotify instance watching one directory
+    pub(super) struct Inotify {
+        fd: OwnedFd,
+    }
+
+    impl Inotify {
+        pub(super) fn watch(dir: &Path) -> io::Result<Self> {
+            let fd = unsafe { libc::inotify_init1(libc::IN_CLOEXEC | libc::IN_NONBLOCK) };
+            if fd < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            let fd = unsafe { OwnedFd::from_raw_fd(fd) };
+
+            let path = CString::new(dir.as_os_str().as_bytes())
+                .map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, e))?;
+            if unsafe { libc::inotify_add_watch(fd.as_raw_fd(), path.as_ptr(), MASK) } < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(Self { fd })
+        }
+
+        /// Wait up to `timeout` for events and consume them
+        ///
+        /// Returns whether any event arrived.
+        pub(super) fn wait(&self, timeout: Duration) -> bool {
+            let mut pollfd = libc::pollfd {
+                fd: self.fd.as_raw_fd(),
+                events: libc::POLLIN,
+                revents: 0,
+            };
+            let ready = unsafe { libc::poll(&mut pollfd, 1, timeout.as_millis() as libc::c_int) };
+            if ready <= 0 {
+                return false;
+            }
+
+            // Only the fact that something changed matters, not what
+            let mut buf = [0u8; 4096];
+            let mut any = false;
+            loop {
+                let n = unsafe { libc::read(self.fd.as_raw_fd(), buf.as_mut_ptr().cast(), buf.len()) };
+                if n <= 0 {
+                    return any;
+                }
+                any = true;
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::mpsc;
+
+    #[test]
+    fn test_change_triggers_callback() {
+        let dir = tempfile::tempdir().unwrap();
+        let running = Arc::new(AtomicBool::new(true));
+        let (tx, rx) = mpsc::channel();
+        let handle = spawn("test", dir.path().to_path_buf(), running.clone(), move || {
+            let _ = tx.send(());
+        })
+        .unwrap();
+
+        // Give the thread time to set up its watch
+        std::thread::sleep(Duration::from_millis(100));
+        std::fs::write(dir.path().join("a.yaml"), "x").unwrap();
+        assert!(rx.recv_timeout(Duration::from_secs(5)).is_ok());
+
+        running.store(false, Ordering::Relaxed);
+        handle.join().unwrap();
+    }
+}